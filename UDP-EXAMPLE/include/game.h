@@ -0,0 +1,97 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+#include "protocol.h"
+
+// Eventos devueltos por game_step
+#define GAME_EVENT_GOAL_P1 0x01   // Jugador 1 anotó
+#define GAME_EVENT_GOAL_P2 0x02   // Jugador 2 anotó
+
+/**
+ * Tipo numérico de la simulación
+ *
+ * Por defecto float. Con -DGAME_FIXED_POINT (make FIXED_POINT=1) se usa
+ * punto fijo Q16.16: la simulación da el mismo resultado bit a bit en
+ * cualquier compilador y plataforma, lo que permite repetir partidas y
+ * comparar estados entre máquinas. En ambos modos game_step es
+ * determinista para un mismo binario: no lee relojes ni estado global.
+ */
+#ifdef GAME_FIXED_POINT
+#include <math.h>
+typedef int32_t game_scalar;
+#define GAME_FRAC_BITS 16
+#define GAME_ONE (1 << GAME_FRAC_BITS)
+#define GAME_SCALAR(x) ((game_scalar)((x) * GAME_ONE + 0.5))   // Solo constantes >= 0
+#define GAME_TO_FLOAT(v) ((float)(v) / GAME_ONE)
+#define GAME_FROM_FLOAT(f) ((game_scalar)lrintf((f) * GAME_ONE))
+#define GAME_DIV(a, b) ((game_scalar)(((int64_t)(a) * GAME_ONE) / (b)))
+#else
+typedef float game_scalar;
+#define GAME_SCALAR(x) ((game_scalar)(x))
+#define GAME_TO_FLOAT(v) (v)
+#define GAME_FROM_FLOAT(f) (f)
+#define GAME_DIV(a, b) ((a) / (b))
+#endif
+
+// Límites del campo en el tipo de la simulación
+#define PADDLE_MIN_Y GAME_SCALAR(PADDLE_HEIGHT / 2)
+#define PADDLE_MAX_Y GAME_SCALAR(FIELD_HEIGHT - PADDLE_HEIGHT / 2)
+#define BALL_MIN_Y   GAME_SCALAR(BALL_SIZE / 2)
+#define BALL_MAX_Y   GAME_SCALAR(FIELD_HEIGHT - BALL_SIZE / 2)
+#define BALL_LEFT_X  GAME_SCALAR(PADDLE_WIDTH + BALL_SIZE / 2)
+#define BALL_RIGHT_X GAME_SCALAR(FIELD_WIDTH - PADDLE_WIDTH - BALL_SIZE / 2)
+#define PADDLE_REACH GAME_SCALAR(PADDLE_HEIGHT / 2)
+
+/**
+ * Estado de una partida
+ * Compartido por el servidor (simulación autoritativa) y el cliente
+ * (predicción de su propia paleta). Todo lo que influye en el siguiente
+ * frame está aquí, incluido el generador aleatorio: con el mismo estado y
+ * las mismas acciones, game_step produce siempre el mismo resultado.
+ *
+ * Las velocidades están en unidades por frame de TARGET_FPS. Si el servidor
+ * simula más rápido (un múltiplo de TARGET_FPS), cada paso avanza
+ * 1 / frame_ticks de frame: la partida va a la misma velocidad por segundo
+ * y solo cambia la resolución de las colisiones.
+ */
+struct game_state {
+    game_scalar paddle1_y;
+    game_scalar paddle2_y;
+    game_scalar ball_x;
+    game_scalar ball_y;
+    game_scalar ball_vx;
+    game_scalar ball_vy;
+    uint8_t score1;
+    uint8_t score2;
+    uint32_t tick;             // Pasos simulados desde game_init
+    uint32_t rng;              // Estado del generador (xorshift32, nunca 0)
+    uint8_t frame_ticks;       // Pasos por frame de TARGET_FPS (1 = un frame por paso)
+};
+
+/**
+ * Inicializa el estado de una partida (un paso por frame)
+ * @param seed Semilla del generador de la partida
+ */
+void game_init(struct game_state *game, uint32_t seed);
+
+/**
+ * Reinicia la pelota al centro con una velocidad aleatoria
+ */
+void game_reset_ball(struct game_state *game);
+
+/**
+ * Mueve una paleta un frame según la acción y la limita al campo
+ * @return Nueva posición Y de la paleta
+ */
+game_scalar game_move_paddle(game_scalar paddle_y, int8_t action);
+
+/**
+ * Avanza la simulación un paso (game->tick + 1): 1 / frame_ticks de frame
+ * @param action1 Acción del jugador 1 (ACTION_IDLE si no está activo)
+ * @param action2 Acción del jugador 2 (ACTION_IDLE si no está activo)
+ * @return Eventos ocurridos (GAME_EVENT_*)
+ */
+int game_step(struct game_state *game, int8_t action1, int8_t action2);
+
+#endif // GAME_H
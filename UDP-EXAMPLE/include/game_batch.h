@@ -0,0 +1,97 @@
+#ifndef GAME_BATCH_H
+#define GAME_BATCH_H
+
+#include <stdint.h>
+#include "game.h"
+#include "protocol.h"
+
+/**
+ * Almacén de partidas en estructura de arreglos (SoA)
+ *
+ * Cada campo de game_state es un arreglo contiguo indexado por "carril"
+ * (el índice de sala en el servidor). Así el kernel de paso carga 4 u 8
+ * pelotas por instrucción y reemplaza las ramas de rebote, colisión y gol
+ * por comparaciones y mezclas. El resultado es idéntico bit a bit al de
+ * game_step: las mismas operaciones IEEE en el mismo orden, y los goles
+ * (que consumen el generador aleatorio) se resuelven aparte con el
+ * camino escalar.
+ */
+
+// Carriles del almacén: uno por sala del shard
+#define GAME_BATCH_LANES MAX_ROOMS
+
+// Kernels de paso disponibles
+enum game_kernel {
+    GAME_KERNEL_SCALAR,   // game_step carril por carril (siempre disponible)
+    GAME_KERNEL_SSE2,     // 4 carriles por instrucción (x86-64)
+    GAME_KERNEL_AVX2      // 8 carriles por instrucción (si la CPU lo soporta)
+};
+
+struct game_batch {
+    // Calientes: el kernel los lee y escribe en cada paso
+    game_scalar paddle1_y[GAME_BATCH_LANES];
+    game_scalar paddle2_y[GAME_BATCH_LANES];
+    game_scalar ball_x[GAME_BATCH_LANES];
+    game_scalar ball_y[GAME_BATCH_LANES];
+    game_scalar ball_vx[GAME_BATCH_LANES];
+    game_scalar ball_vy[GAME_BATCH_LANES];
+    int8_t action1[GAME_BATCH_LANES];   // Entrada del paso
+    int8_t action2[GAME_BATCH_LANES];
+    uint8_t live[GAME_BATCH_LANES];     // 1 = el carril avanza en el paso
+    uint8_t events[GAME_BATCH_LANES];   // Salida: GAME_EVENT_* del último paso
+    
+    // Fríos: solo cambian en goles (y el tick una vez por paso)
+    uint8_t score1[GAME_BATCH_LANES];
+    uint8_t score2[GAME_BATCH_LANES];
+    uint32_t tick[GAME_BATCH_LANES];
+    uint32_t rng[GAME_BATCH_LANES];
+    
+    // Pasos por frame de TARGET_FPS, el mismo para todos los carriles (lo
+    // fija quien crea el almacén, antes del primer paso)
+    uint8_t frame_ticks;
+};
+
+/**
+ * Inicia una partida nueva en un carril (como game_init); queda inactivo
+ * @param seed Semilla del generador de la partida
+ */
+void game_batch_init_lane(struct game_batch *batch, int lane, uint32_t seed);
+
+/**
+ * Copia el estado de un carril a un game_state
+ */
+void game_batch_load(const struct game_batch *batch, int lane, struct game_state *game);
+
+/**
+ * Copia un game_state a un carril (frame_ticks es del almacén y no se copia)
+ */
+void game_batch_store(struct game_batch *batch, int lane, const struct game_state *game);
+
+/**
+ * Avanza un frame los carriles [0, count) con live = 1, con el mejor
+ * kernel que soporte la CPU. Deja los eventos de cada carril en events.
+ */
+void game_batch_step(struct game_batch *batch, int count);
+
+/**
+ * Igual que game_batch_step pero con un kernel concreto (benchmarks)
+ */
+void game_batch_step_kernel(struct game_batch *batch, int count, enum game_kernel kernel);
+
+/**
+ * Indica si el kernel se puede usar en esta CPU y compilación
+ * (en modo punto fijo solo existe el escalar)
+ */
+int game_kernel_supported(enum game_kernel kernel);
+
+/**
+ * Mejor kernel disponible
+ */
+enum game_kernel game_kernel_best(void);
+
+/**
+ * Nombre del kernel para los reportes
+ */
+const char *game_kernel_name(enum game_kernel kernel);
+
+#endif // GAME_BATCH_H
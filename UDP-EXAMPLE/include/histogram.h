@@ -0,0 +1,68 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/**
+ * Histograma de latencias con buckets log-lineales (estilo HDR)
+ *
+ * Cada potencia de 2 se divide en HIST_SUB_BUCKETS buckets iguales, así
+ * que el error relativo de un percentil queda acotado (~3% con 32
+ * sub-buckets) sin importar la magnitud. Los valores son enteros (la
+ * convención en este proyecto es microsegundos) y se recortan a
+ * HIST_MAX_VALUE. Memoria fija, registro O(1) sin asignaciones y dos
+ * histogramas se combinan sumando buckets.
+ */
+
+// Precisión: 2^HIST_SUB_BITS buckets por potencia de 2
+#define HIST_SUB_BITS 5
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+
+// Rango: hasta 2^HIST_MAX_BITS - 1 (≈ 16.7 s en microsegundos)
+#define HIST_MAX_BITS 24
+#define HIST_MAX_VALUE ((1ULL << HIST_MAX_BITS) - 1)
+
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+/**
+ * Deja el histograma vacío
+ */
+void histogram_init(struct histogram *h);
+
+/**
+ * Registra un valor (se recorta a HIST_MAX_VALUE)
+ */
+void histogram_record(struct histogram *h, uint64_t value);
+
+/**
+ * Suma los registros de src a dst (p. ej. varios hilos o clientes)
+ */
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+/**
+ * Valor bajo el cual cae el percentil indicado
+ * @param percentile 0-100 (p. ej. 99.9)
+ * @return Mayor valor equivalente del bucket, o 0 si está vacío
+ */
+uint64_t histogram_percentile(const struct histogram *h, double percentile);
+
+/**
+ * Cantidad de valores registrados que no superan value
+ * (con la precisión de los buckets: el bucket de value cuenta entero)
+ */
+uint64_t histogram_count_below(const struct histogram *h, uint64_t value);
+
+/**
+ * Media exacta de los valores registrados
+ */
+double histogram_mean(const struct histogram *h);
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,99 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+/**
+ * Inputs redundantes y aplicación exactamente una vez
+ *
+ * El cliente genera un input por frame (input_seq consecutivo). Cada
+ * MSG_INPUT lleva el del frame en curso y, en input_history, las acciones
+ * de los INPUT_REDUNDANCY frames anteriores a 2 bits cada una: la más
+ * nueva en los bits bajos. Los números de frame no viajan, salen de
+ * input_seq. Un paquete perdido se recupera con cualquiera de los
+ * siguientes sin reenvíos ni paquetes extra, y el cliente puede enviar
+ * menos seguido que su ritmo de frames sin perder inputs.
+ *
+ * El servidor guarda lo recibido en un input_buffer por jugador y cada tick
+ * aplica el siguiente input por secuencia, una sola vez. Si todavía no
+ * llegó, la paleta sigue con la última acción. Si ya llegó uno posterior y
+ * ni la redundancia lo trajo, se da por perdido. La espera se acota
+ * descartando los más viejos: siempre a INPUT_MAX_BACKLOG frames, y de a
+ * uno si durante INPUT_TRIM_WINDOW ticks nunca hubo menos de dos
+ * esperando (una ráfaga dejó latencia que ya no hace falta).
+ */
+
+#define INPUT_REDUNDANCY 8         // Frames anteriores en cada MSG_INPUT (16 bits)
+#define INPUT_BUFFER 32            // Inputs por jugador en el servidor (potencia de 2)
+#define INPUT_MAX_BACKLOG 8        // Frames que pueden esperar su tick (>= frames por paquete)
+#define INPUT_TRIM_WINDOW 30       // Ticks para decidir si sobra un frame de espera
+
+// Código de 2 bits de un frame sin input (antes del primero)
+#define INPUT_CODE_NONE 3
+#define INPUT_HISTORY_EMPTY 0xFFFF
+
+/**
+ * Agrega al historial la acción del frame que termina
+ */
+static inline uint16_t input_history_push(uint16_t history, int8_t action) {
+    uint16_t code = action == 0 ? 0 : action > 0 ? 1 : 2;
+    return (uint16_t)((history << 2) | code);
+}
+
+/**
+ * Acción de age frames antes del input del paquete (1..INPUT_REDUNDANCY)
+ * @return 0 si tuvo éxito, -1 si ese frame no tiene input
+ */
+static inline int input_history_get(uint16_t history, int age, int8_t *action) {
+    int code = (history >> ((age - 1) * 2)) & 3;
+    if (code == INPUT_CODE_NONE) return -1;
+    *action = code == 0 ? 0 : code == 1 ? 1 : -1;
+    return 0;
+}
+
+/**
+ * Contadores de inputs (uno por hilo, compartido por sus jugadores)
+ */
+struct input_stats {
+    uint32_t recovered;            // Inputs que llegaron solo por la redundancia
+    uint32_t lost;                 // Perdidos aun con la redundancia
+    uint32_t trimmed;              // Descartados para acotar la espera
+    uint32_t starved;              // Ticks sin input nuevo (se repitió la acción)
+};
+
+/**
+ * Inputs de un jugador pendientes de aplicar
+ */
+struct input_buffer {
+    int8_t actions[INPUT_BUFFER];
+    uint16_t seqs[INPUT_BUFFER];
+    uint8_t present[INPUT_BUFFER];
+    uint16_t newest;               // Input más nuevo recibido
+    uint16_t applied;              // Último input aplicado (se confirma al cliente)
+    int started;                   // Ya llegó algún input
+    uint16_t window_ticks;         // Ticks de la ventana de recorte en curso
+    uint16_t window_min;           // Mínimo de inputs esperando en la ventana
+};
+
+/**
+ * Deja el buffer vacío (jugador nuevo en el lugar)
+ */
+void input_buffer_init(struct input_buffer *buf);
+
+/**
+ * Guarda el input de un paquete y los anteriores que trae su historial.
+ * Lo ya aplicado se ignora; lo pendiente se reemplaza (el cliente puede
+ * corregir la acción de un frame que todavía no terminó).
+ * @return Inputs nuevos guardados
+ */
+int input_buffer_receive(struct input_buffer *buf, struct input_stats *stats, uint16_t seq,
+                         int8_t action, uint16_t history);
+
+/**
+ * Saca el input que le toca al tick
+ * @param action Acción a aplicar (se deja igual si no hay input nuevo)
+ * @return 1 si aplicó un input, 0 si no había ninguno pendiente
+ */
+int input_buffer_next(struct input_buffer *buf, struct input_stats *stats, int8_t *action);
+
+#endif // INPUT_H
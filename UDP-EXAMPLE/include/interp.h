@@ -0,0 +1,77 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stdint.h>
+#include "protocol.h"
+
+// Ticks guardados para interpolar (potencia de 2): con snapshots a 10 Hz
+// y la simulación a 120 Hz quedan ~10 snapshots
+#define INTERP_BUFFER 128
+
+// Límites del retardo de reproducción adaptativo (ms)
+#define INTERP_MIN_DELAY_MS (1000.0 / TARGET_FPS)
+#define INTERP_MAX_DELAY_MS 250.0
+
+// Tiempo máximo que se extrapola cuando se cortan los snapshots (ms)
+#define INTERP_MAX_EXTRAPOLATE_MS 100.0
+
+// Resultado de interp_sample_at
+#define INTERP_NONE 0          // Aún no hay snapshots
+#define INTERP_INTERPOLATED 1  // Entre dos snapshots
+#define INTERP_EXTRAPOLATED 2  // Más allá del último (pérdida breve)
+#define INTERP_HELD 3          // Pérdida larga: se congela el último
+
+/**
+ * Posiciones de un snapshot, ya en unidades del campo
+ */
+struct interp_sample {
+    uint32_t tick;             // Tick del servidor (extendido a 32 bits)
+    float paddle1_y;
+    float paddle2_y;
+    float ball_x;
+    float ball_y;
+};
+
+/**
+ * Buffer de reproducción: guarda los snapshots recientes y dibuja el
+ * estado en un instante ligeramente atrasado, interpolando entre dos
+ * snapshots. El retardo se adapta al jitter medido sobre el tiempo del
+ * servidor (tick * duración del tick) frente al tiempo local de llegada, y
+ * a la separación entre snapshots (el servidor puede no enviar todos los
+ * ticks, ver update_player_rate en pong_server).
+ */
+struct interp_buffer {
+    struct interp_sample samples[INTERP_BUFFER];
+    uint32_t newest_tick;
+    int count;                 // Snapshots aceptados en total
+    double tick_ms;            // Duración de un tick del servidor
+    double gap_ms;             // Separación media entre snapshots aceptados
+    
+    double base_transit_ms;    // Menor (llegada local - tiempo servidor) observado
+    double last_transit_ms;
+    double jitter_ms;          // Variación de retardo (estimador RFC 3550)
+    double delay_ms;           // Retardo de reproducción actual
+    
+    uint32_t dropped;          // Snapshots descartados por llegar desordenados
+};
+
+/**
+ * Inicializa el buffer vacío
+ * @param tick_rate Ticks por segundo del servidor (respuesta al JOIN)
+ */
+void interp_init(struct interp_buffer *ib, int tick_rate);
+
+/**
+ * Agrega un snapshot recibido
+ * @param now_ms Tiempo local monotónico de llegada
+ * @return 1 si se aceptó, 0 si se descartó por viejo o duplicado
+ */
+int interp_push(struct interp_buffer *ib, const struct interp_sample *sample, double now_ms);
+
+/**
+ * Calcula el estado a mostrar en el instante local now_ms
+ * @return Modo usado (INTERP_*)
+ */
+int interp_sample_at(struct interp_buffer *ib, double now_ms, struct interp_sample *out);
+
+#endif // INTERP_H
@@ -0,0 +1,52 @@
+#ifndef LFQUEUE_H
+#define LFQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/**
+ * Cola acotada sin locks, varios productores y varios consumidores
+ *
+ * Arreglo circular de celdas reservado una sola vez; cada celda lleva un
+ * número de secuencia que indica si está libre para la vuelta actual del
+ * productor o lista para el consumidor (esquema de D. Vyukov). Encolar y
+ * desencolar son un CAS sobre la cabeza o la cola más una copia del
+ * elemento: ningún hilo espera a otro y no se asigna memoria. El orden es
+ * FIFO, y los elementos que encola un mismo productor salen en su orden.
+ */
+
+struct lf_queue {
+    unsigned char *cells;      // capacity celdas de stride bytes: [secuencia][elemento]
+    size_t stride;
+    size_t elem_size;
+    uint64_t mask;             // Capacidad - 1
+    _Alignas(64) _Atomic uint64_t head;  // Próxima posición a escribir
+    _Alignas(64) _Atomic uint64_t tail;  // Próxima posición a leer
+};
+
+/**
+ * Reserva una cola de elementos de elem_size bytes
+ * @param capacity Se redondea a la potencia de 2 siguiente
+ * @return 0 si tuvo éxito, -1 sin memoria
+ */
+int lf_queue_init(struct lf_queue *queue, uint32_t capacity, size_t elem_size);
+
+/**
+ * Libera la memoria de la cola
+ */
+void lf_queue_free(struct lf_queue *queue);
+
+/**
+ * Encola una copia del elemento
+ * @return 0 si se encoló, -1 si la cola está llena
+ */
+int lf_queue_push(struct lf_queue *queue, const void *elem);
+
+/**
+ * Desencola el elemento más antiguo
+ * @return 0 si había uno (copiado en elem), -1 si la cola está vacía
+ */
+int lf_queue_pop(struct lf_queue *queue, void *elem);
+
+#endif // LFQUEUE_H
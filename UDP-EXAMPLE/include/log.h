@@ -0,0 +1,220 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+/**
+ * Log asíncrono y estructurado
+ *
+ * Quien registra no formatea ni escribe. Guarda en un registro de tamaño
+ * fijo el puntero al formato (un literal, vive todo el proceso), la hora
+ * y una copia tipada de los argumentos, y lo encola en una lf_queue. Un
+ * hilo escritor lo saca, arma la salida y la escribe en lotes. Los tipos
+ * salen del propio formato printf: cada hilo lo analiza la primera vez y
+ * lo recuerda en un caché por puntero. Si la cola está llena el registro
+ * se descarta y se cuenta; quien registra nunca espera.
+ *
+ * Salidas:
+ *   texto    "[HH:MM:SS] mensaje", como siempre (con el nivel delante si no es info)
+ *   JSON     un objeto por línea: hora, nivel, hilo, mensaje, formato y argumentos
+ *   binaria  cada formato una sola vez y los argumentos crudos (ver pong_logcat)
+ *
+ * Sin log_init, cada llamada formatea y escribe en stdout en el acto
+ * (clientes y herramientas que no necesitan el escritor).
+ *
+ * Formatos admitidos: conversiones d i u o x X c s p f F e E g G a A con
+ * cualquier largo (hh h l ll z j t L). El ancho o la precisión con '*'
+ * consumen su argumento pero no se aplican. Las conversiones después de
+ * LOG_MAX_ARGS salen tal cual en el texto; el mensaje se cuenta y el
+ * escritor lo avisa, como los descartados.
+ */
+
+#define LOG_MAX_ARGS 16
+#define LOG_STRING_SPACE 96        // Bytes para copiar los %s de un registro
+#define LOG_QUEUE_CAPACITY 8192    // Registros en vuelo (~2 MB)
+#define LOG_POLL_MS 5              // Espera del escritor con la cola vacía
+#define LOG_LINE_MAX 1024          // Línea de texto/JSON más larga
+#define LOG_MAX_FORMATS 4096       // Formatos distintos en la salida binaria
+
+enum log_level {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR
+};
+
+enum log_output {
+    LOG_OUTPUT_TEXT,
+    LOG_OUTPUT_JSON,
+    LOG_OUTPUT_BINARY
+};
+
+// Tipos de argumento guardados
+#define LOG_ARG_INT 1              // args[i].i
+#define LOG_ARG_UINT 2             // args[i].u
+#define LOG_ARG_DOUBLE 3           // args[i].d
+#define LOG_ARG_STRING 4           // args[i].s, bytes en strings (sin '\0')
+#define LOG_ARG_CHAR 5             // args[i].i
+#define LOG_ARG_PTR 6              // args[i].u
+
+union log_arg {
+    int64_t i;
+    uint64_t u;
+    double d;
+    struct {
+        uint8_t offset;
+        uint8_t len;
+    } s;
+};
+
+/**
+ * Un mensaje. En la cola time_ns es monotónico (get_time_ns); el escritor
+ * lo pasa a hora Unix antes de armar la salida.
+ */
+struct log_record {
+    uint64_t time_ns;
+    const char *format;
+    uint8_t level;                 // enum log_level
+    int8_t thread;                 // log_set_thread (-1 = hilo principal)
+    uint8_t nargs;
+    uint8_t strings_used;
+    uint8_t types[LOG_MAX_ARGS];
+    union log_arg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_SPACE];
+};
+
+/**
+ * Archivo binario: cabecera y luego entradas que empiezan con su tipo (u8).
+ * Todo en little-endian y sin relleno.
+ *
+ *   LOG_BIN_FORMAT  [id u16][largo u16][texto del formato]
+ *   LOG_BIN_EVENT   [time_ns u64][nivel u8][hilo i8][id u16][nargs u8] y por
+ *                   argumento [tipo u8] + 8 bytes, o [tipo u8][largo u8][bytes]
+ *                   si es una cadena
+ *
+ * Los mensajes descartados se avisan con un LOG_BIN_EVENT de nivel warn.
+ */
+#define LOG_MAGIC "PONGLOG"        // 8 bytes con el '\0'
+#define LOG_VERSION 1
+#define LOG_BIN_FORMAT 1
+#define LOG_BIN_EVENT 2
+
+struct log_header {
+    char magic[8];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t pid;
+    uint64_t start_ms;             // Hora de inicio (Unix, ms)
+} __attribute__((packed));
+
+/**
+ * Lector de archivos binarios (pong_logcat)
+ */
+struct log_reader {
+    const uint8_t *data;
+    size_t len;
+    size_t offset;
+    char *formats[LOG_MAX_FORMATS];
+};
+
+/**
+ * Prepara la cola y el destino. Con salida binaria escribe la cabecera.
+ * Se puede volver a llamar mientras no haya escritor (pruebas).
+ * @param fd Destino (STDOUT_FILENO, un archivo, ...)
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int log_init(enum log_level level, enum log_output output, int fd);
+
+/**
+ * Arranca el hilo escritor (después de log_init)
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int log_start(void);
+
+/**
+ * Cambia el nivel mínimo que se registra
+ */
+void log_set_level(enum log_level level);
+
+/**
+ * Identifica al hilo actual en los mensajes (el shard)
+ */
+void log_set_thread(int id);
+
+/**
+ * Registra un mensaje; nunca bloquea si hay log_init
+ */
+void log_write(enum log_level level, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void log_vwrite(enum log_level level, const char *format, va_list args);
+
+/**
+ * Atajos por nivel (log_msg es info)
+ */
+void log_debug(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void log_msg(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void log_warn(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void log_error(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Saca los mensajes pendientes, los formatea y los escribe (lo llama el
+ * hilo escritor; sin él, quien use log_init a mano)
+ * @return Cantidad de mensajes escritos
+ */
+int log_drain(void);
+
+/**
+ * Vacía la cola sin escribir nada (benchmarks)
+ * @return Cantidad de mensajes descartados
+ */
+int log_discard(void);
+
+/**
+ * Mensajes descartados porque la cola estaba llena
+ */
+uint64_t log_dropped(void);
+
+/**
+ * Mensajes con más de LOG_MAX_ARGS argumentos (los que sobran no se guardan)
+ */
+uint64_t log_truncated(void);
+
+/**
+ * Nombre de nivel ("debug", "info", "warn", "error") -> nivel
+ * @return 0 si tuvo éxito, -1 si no lo conoce
+ */
+int log_parse_level(const char *name, enum log_level *level);
+
+/**
+ * Nombre de salida ("text", "json", "bin") -> salida
+ * @return 0 si tuvo éxito, -1 si no la conoce
+ */
+int log_parse_output(const char *name, enum log_output *output);
+
+/**
+ * Arma la línea de un mensaje (time_ns en hora Unix) en texto o JSON,
+ * terminada en '\n'
+ * @return Largo de la línea (sin el '\0')
+ */
+size_t log_render(const struct log_record *rec, enum log_output output, char *out, size_t size);
+
+/**
+ * Abre un archivo binario ya leído en memoria
+ * @return 0 si tuvo éxito, -1 si la cabecera no es válida
+ */
+int log_reader_init(struct log_reader *reader, const uint8_t *data, size_t len);
+
+/**
+ * Siguiente mensaje (los formatos se registran solos al pasar)
+ * @return 1 si hay mensaje, 0 al final, -1 si el archivo está dañado
+ */
+int log_reader_next(struct log_reader *reader, struct log_record *rec);
+
+/**
+ * Libera los formatos del lector
+ */
+void log_reader_free(struct log_reader *reader);
+
+#endif // LOG_H
@@ -0,0 +1,74 @@
+#ifndef MATCHMAKING_H
+#define MATCHMAKING_H
+
+#include <stdint.h>
+#include "lfqueue.h"
+
+/**
+ * Cola de emparejamiento compartida por todos los shards
+ *
+ * Cada sala con un jugador esperando rival publica un ticket; el próximo
+ * jugador que busca partida toma uno y se sienta en esa sala, aunque viva
+ * en otro shard. Con agrupación por RTT hay una cola por bucket de
+ * bucket_ms de ancho (el último junta todo lo demás) y quien busca empieza
+ * por su bucket y se abre a los vecinos a medida que espera. Las colas son
+ * lf_queue: publicar y tomar no bloquean a ningún shard.
+ *
+ * Los tickets no se retiran: una sala que deja de esperar cambia de
+ * generación y quien toma un ticket viejo lo descarta (ver match_take).
+ */
+
+// Buckets de RTT como máximo
+#define MATCH_BUCKETS 8
+
+struct match_ticket {
+    uint16_t shard;            // Shard dueño de la sala
+    uint16_t room;
+    uint32_t gen;              // Generación de espera de la sala al publicar
+};
+
+struct match_queue {
+    struct lf_queue buckets[MATCH_BUCKETS];
+    int num_buckets;           // 1 si no se agrupa por RTT
+    uint32_t bucket_ms;        // Ancho de cada bucket (0 = sin agrupar)
+};
+
+/**
+ * Indica si un ticket sigue vigente (la sala todavía espera con esa generación)
+ */
+typedef int (*match_valid_fn)(void *ctx, const struct match_ticket *ticket);
+
+/**
+ * Reserva las colas
+ * @param bucket_ms Ancho de los buckets de RTT (0 = una sola cola)
+ * @param capacity Tickets por bucket
+ * @return 0 si tuvo éxito, -1 sin memoria
+ */
+int match_queue_init(struct match_queue *mq, uint32_t bucket_ms, uint32_t capacity);
+
+/**
+ * Libera las colas
+ */
+void match_queue_free(struct match_queue *mq);
+
+/**
+ * Bucket que corresponde a un RTT
+ */
+int match_bucket(const struct match_queue *mq, float rtt_ms);
+
+/**
+ * Publica el ticket de una sala que espera rival
+ * @return 0 si se publicó, -1 si el bucket está lleno
+ */
+int match_publish(struct match_queue *mq, int bucket, const struct match_ticket *ticket);
+
+/**
+ * Toma el primer ticket vigente del bucket y, si no hay, de los vecinos
+ * hasta widen buckets de distancia (más cercanos primero). Los vencidos
+ * que encuentra en el camino se descartan.
+ * @return 0 si encontró uno (en out), -1 si no
+ */
+int match_take(struct match_queue *mq, int bucket, int widen,
+               match_valid_fn valid, void *ctx, struct match_ticket *out);
+
+#endif // MATCHMAKING_H
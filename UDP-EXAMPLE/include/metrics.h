@@ -0,0 +1,137 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * Métricas en el formato de texto de Prometheus
+ *
+ * Cada hilo de trabajo publica sus contadores en su propio bloque de
+ * _Atomic uint64_t: tiene un único escritor, así que sumar es leer y
+ * guardar (relaxed, sin instrucciones con lock). Un hilo aparte atiende
+ * el endpoint HTTP: en cada scrape lee los bloques de todos los hilos,
+ * también relaxed, suma y arma el texto con una función del programa.
+ * Nadie toma locks y el hilo del tick nunca espera al scrape.
+ *
+ * El endpoint escucha en TCP (solo 127.0.0.1 si no se indica la dirección)
+ * o en un socket Unix, y responde GET /metrics. Se le pueden agregar otras
+ * rutas antes de arrancarlo (p. ej. /trace del perfilador).
+ */
+
+#define METRICS_REQUEST_MAX 2048
+#define METRICS_TIMEOUT_MS 1000       // Espera máxima por el pedido de un cliente
+#define METRICS_MAX_ROUTES 4
+#define METRICS_ACCEPT_BACKOFF_MS 100 // Pausa tras un accept fallido (p. ej. EMFILE)
+
+/**
+ * Texto de una respuesta (crece según haga falta y se reutiliza)
+ */
+struct metrics_text {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+/**
+ * Arma el texto de un scrape (lo llama el hilo del endpoint)
+ */
+typedef void (*metrics_render_fn)(struct metrics_text *text, void *ctx);
+
+struct metrics_route {
+    const char *path;                 // "/metrics"
+    const char *content_type;
+    metrics_render_fn render;
+    void *ctx;
+};
+
+struct metrics_server {
+    int fd;
+    pthread_t thread;
+    struct metrics_route routes[METRICS_MAX_ROUTES];
+    int num_routes;
+    struct metrics_text text;
+};
+
+/**
+ * Suma a un contador con un único escritor (el hilo dueño del bloque)
+ */
+static inline void metrics_add(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+/**
+ * Guarda un valor (gauge o total que el dueño ya lleva en 64 bits)
+ */
+static inline void metrics_set(_Atomic uint64_t *value, uint64_t n) {
+    atomic_store_explicit(value, n, memory_order_relaxed);
+}
+
+/**
+ * Lee un valor publicado por otro hilo
+ */
+static inline uint64_t metrics_get(_Atomic uint64_t *value) {
+    return atomic_load_explicit(value, memory_order_relaxed);
+}
+
+/**
+ * Agrega una ruta (antes de metrics_server_start)
+ * @return 0 si tuvo éxito, -1 si no hay lugar
+ */
+int metrics_server_route(struct metrics_server *server, const char *path,
+                         const char *content_type, metrics_render_fn render, void *ctx);
+
+/**
+ * Abre el endpoint y arranca su hilo; render atiende GET /metrics
+ * @param addr "PUERTO" (127.0.0.1), "IP:PUERTO" o la ruta de un socket Unix
+ *             ("/ruta" o "unix:ruta")
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int metrics_server_start(struct metrics_server *server, const char *addr,
+                         metrics_render_fn render, void *ctx);
+
+/**
+ * Vacía el texto para un scrape nuevo
+ */
+void metrics_text_reset(struct metrics_text *text);
+
+/**
+ * Agrega texto con formato printf
+ */
+void metrics_printf(struct metrics_text *text, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Líneas # HELP y # TYPE de una familia
+ * @param type "counter", "gauge" o "histogram"
+ */
+void metrics_header(struct metrics_text *text, const char *name, const char *type,
+                    const char *help);
+
+/**
+ * Una muestra entera
+ * @param labels Etiquetas sin llaves (p. ej. "reason=\"full\"") o NULL
+ */
+void metrics_uint(struct metrics_text *text, const char *name, const char *labels, uint64_t value);
+
+/**
+ * Una muestra real
+ */
+void metrics_double(struct metrics_text *text, const char *name, const char *labels, double value);
+
+/**
+ * Familia histogram completa (buckets acumulados, _sum y _count) a partir
+ * de microsegundos; la exporta en segundos
+ * @param bounds_us Límite superior de cada bucket
+ * @param counts Cantidad por bucket (no acumulada), nbounds + 1 entradas:
+ *               la última es lo que supera al último límite
+ * @param sum_us Suma de los valores
+ */
+void metrics_histogram(struct metrics_text *text, const char *name, const char *help,
+                       const uint32_t *bounds_us, const uint64_t *counts, int nbounds,
+                       uint64_t sum_us);
+
+#endif // METRICS_H
@@ -0,0 +1,80 @@
+#ifndef NETIO_H
+#define NETIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// Datagramas por syscall en recvmmsg/sendmmsg
+#define NETIO_BATCH 64
+
+// Tamaño máximo de cada datagrama del lote
+#define NETIO_DGRAM_MAX 256
+
+/**
+ * Lote de datagramas para E/S con recvmmsg/sendmmsg
+ * Cada entrada tiene su propio buffer y dirección de origen/destino.
+ */
+struct dgram_batch {
+    struct mmsghdr msgs[NETIO_BATCH];
+    struct iovec iov[NETIO_BATCH];
+    struct sockaddr_in addrs[NETIO_BATCH];
+    uint8_t bufs[NETIO_BATCH][NETIO_DGRAM_MAX];
+    int count;                 // Entradas válidas (recibidas o encoladas)
+    uint64_t dropped;          // Datagramas que el kernel no aceptó al enviar
+};
+
+/**
+ * Configura un descriptor como non-blocking
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int set_nonblocking(int fd);
+
+/**
+ * Crea un timerfd periódico (CLOCK_MONOTONIC, non-blocking)
+ * @param period_ns Periodo del timer en nanosegundos
+ * @return Descriptor del timer o -1 en error
+ */
+int create_tick_timer(uint64_t period_ns);
+
+/**
+ * Lee cuántas veces expiró el timer desde la última lectura
+ * @return Número de expiraciones (0 si no hubo ninguna)
+ */
+uint64_t read_timer_expirations(int timer_fd);
+
+/**
+ * Registra un descriptor en epoll para eventos de lectura
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int epoll_add_reader(int epoll_fd, int fd);
+
+/**
+ * Inicializa un lote vacío
+ */
+void dgram_batch_init(struct dgram_batch *batch);
+
+/**
+ * Recibe hasta NETIO_BATCH datagramas con una sola llamada a recvmmsg
+ * Los datos quedan en batch->bufs[i], su largo en batch->msgs[i].msg_len
+ * y el remitente en batch->addrs[i].
+ * @return Datagramas recibidos (0 si la cola está vacía)
+ */
+int dgram_batch_recv(int fd, struct dgram_batch *batch);
+
+/**
+ * Encola un datagrama para enviarlo en el próximo flush
+ * Si el lote está lleno se envía automáticamente antes de encolar.
+ * @return 0 si se encoló, -1 si el datagrama excede NETIO_DGRAM_MAX
+ */
+int dgram_batch_queue(int fd, struct dgram_batch *batch, const void *data, size_t len,
+                      const struct sockaddr_in *addr);
+
+/**
+ * Envía todos los datagramas encolados con sendmmsg
+ * @return Datagramas aceptados por el kernel
+ */
+int dgram_batch_flush(int fd, struct dgram_batch *batch);
+
+#endif // NETIO_H
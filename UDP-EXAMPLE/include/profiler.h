@@ -0,0 +1,111 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "metrics.h"
+
+/**
+ * Perfilador de fases del tick (make PROFILE=1)
+ *
+ * Cada shard mide sus fases (recibir, procesar mensajes, física, armado de
+ * snapshots, envío, espectadores, ...) con PROF_BEGIN/PROF_END y las guarda
+ * en un anillo propio: un único escritor, sin locks. Al vencer cada tick
+ * se cierra el cuadro: si el tick arrancó tarde o el anterior se pasó del
+ * presupuesto, se registra un desborde con su causa, la fase que más
+ * tiempo ocupó al hilo desde el tick anterior, o "sistema" si el hilo no
+ * estuvo ocupado (el kernel no lo despertó a tiempo).
+ *
+ * El anillo se exporta a pedido como JSON de Chrome trace-event
+ * (chrome://tracing o Perfetto): un bloque por fase en la fila de cada
+ * shard y una marca por desborde.
+ *
+ * Sin PONG_PROFILE las macros no generan código.
+ */
+
+#define PROF_RING_EVENTS 32768     // Por shard (~9 s a 60 Hz con carga)
+#define PROF_WARN_INTERVAL_MS 1000 // Un aviso de desborde por segundo como máximo
+
+enum prof_phase {
+    PROF_RECV,                     // recvmmsg
+    PROF_PROCESS,                  // process_client_message de un lote
+    PROF_INBOX,                    // Mensajes de otros shards
+    PROF_PHYSICS,                  // update_physics
+    PROF_BROADCAST,                // broadcast_state de todas las salas
+    PROF_SEND,                     // sendmmsg del tick
+    PROF_SPECTATORS,               // Fan-out a espectadores
+    PROF_MATCHMAKING,
+    PROF_SWEEP,                    // Sesiones inactivas
+    PROF_REPORT,                   // Reporte de capacidad
+    PROF_PHASES,
+    PROF_SYSTEM = PROF_PHASES      // Causa de desborde: el hilo no estaba ocupado
+};
+
+#define PROF_EVENT_OVERRUN 1       // dur_ns es el atraso; phase es la causa
+
+struct prof_event {
+    uint64_t start_ns;             // get_time_ns
+    uint32_t dur_ns;
+    uint32_t tick;
+    uint8_t phase;
+    uint8_t flags;
+};
+
+/**
+ * Anillo de un shard. Solo el hilo del shard escribe; el exportador copia
+ * y descarta lo que se pisó mientras copiaba (ver prof_export_chrome).
+ */
+struct prof_ring {
+    int id;
+    struct prof_event events[PROF_RING_EVENTS];
+    _Atomic uint64_t head;         // Eventos escritos (total)
+    
+    // Cuadro en curso: tiempo de cada fase desde el tick anterior
+    uint64_t frame_ns[PROF_PHASES];
+    uint64_t last_warn_ns;
+    
+    // Desbordes por causa desde el reporte anterior (los lee y pone en
+    // cero el reporte de capacidad, en el mismo hilo)
+    uint32_t overruns[PROF_PHASES + 1];
+};
+
+#ifdef PONG_PROFILE
+#define PROF_BEGIN(var) uint64_t var = get_time_ns()
+#define PROF_END(ring, phase, var, tick) prof_record((ring), (phase), (var), get_time_ns(), (tick))
+#else
+#define PROF_BEGIN(var) do {} while (0)
+#define PROF_END(ring, phase, var, tick) do {} while (0)
+#endif
+
+/**
+ * Prepara un anillo vacío
+ */
+void prof_ring_init(struct prof_ring *ring, int id);
+
+/**
+ * Guarda una fase
+ */
+void prof_record(struct prof_ring *ring, int phase, uint64_t start_ns, uint64_t end_ns,
+                 uint32_t tick);
+
+/**
+ * Cierra el cuadro de un tick que vence
+ * @param late_ns Cuánto después de su plazo arrancó el tick
+ * @param prev_tick_ns Duración del tick anterior
+ * @param budget_ns Presupuesto de un tick (un frame)
+ * @return Causa (enum prof_phase o PROF_SYSTEM) si hubo desborde, -1 si no
+ */
+int prof_frame_end(struct prof_ring *ring, uint32_t tick, uint64_t now_ns, uint64_t late_ns,
+                   uint64_t prev_tick_ns, uint64_t budget_ns);
+
+/**
+ * Nombre de una fase o causa
+ */
+const char *prof_phase_name(int phase);
+
+/**
+ * Exporta los anillos como JSON de Chrome trace-event (una fila por shard)
+ */
+void prof_export_chrome(struct metrics_text *text, struct prof_ring **rings, int num_rings);
+
+#endif // PROFILER_H
@@ -6,7 +6,8 @@
 // Configuración del protocolo
 #define SERVER_PORT 8080
 #define BUFFER_SIZE 1024
-#define MAX_PLAYERS 2
+#define MAX_PLAYERS 2       // Jugadores por sala (partida)
+#define MAX_ROOMS 8192      // Salas simultáneas por proceso servidor
 #define PLAYER_NAME_LEN 16
 
 // Tipos de mensajes: Cliente -> Servidor
@@ -14,11 +15,35 @@
 #define MSG_INPUT 2
 #define MSG_STATS 3
 #define MSG_LEAVE 4
+#define MSG_SPECTATE 5        // Mirar una sala sin jugar (ver client_message)
 
 // Tipos de mensajes: Servidor -> Cliente
 #define MSG_STATE 1
 #define MSG_STATS_RESPONSE 2
 #define MSG_ERROR 3
+#define MSG_SNAPSHOT 4        // Estado por tick, cuantizado y delta (ver snapshot.h)
+#define MSG_PEER_LEFT 5       // El rival dejó la sala (ver struct peer_left_message)
+#define MSG_INPUTS 6          // Acciones aplicadas por frame (modo rollback, ver rollback.h)
+#define MSG_SYNC 7            // Estado completo de la partida (modo rollback, ver rollback.h)
+#define MSG_SNAPSHOT_NEXT 8   // MSG_SNAPSHOT con base en el tick anterior (sin byte de base)
+
+// Motivos de MSG_PEER_LEFT
+#define PEER_LEFT_QUIT 0      // El rival envió LEAVE
+#define PEER_LEFT_TIMEOUT 1   // El rival dejó de enviar paquetes
+
+// Espectadores: el MSG_STATE de respuesta trae este player_id; un
+// MSG_ERROR con el room_id avisa que la sala no existe o se cerró
+#define SPECTATOR_PLAYER_ID 0
+#define SPECTATE_ANY_ROOM 0xFFFF    // La primera partida en curso del shard
+#define SPECTATE_ANY_SHARD 0xFF     // El shard que recibe el pedido
+#define SPECTATE_KEEPALIVE_MS 250   // Cada cuánto el espectador confirma lo recibido
+
+// Cada cuántos frames viajan las estadísticas dentro de un snapshot
+#define SNAPSHOT_STATS_INTERVAL TARGET_FPS
+
+// Cada cuántos frames como mínimo el servidor devuelve el timestamp del
+// cliente (eco para medir RTT, ver SNAP_ECHO)
+#define RTT_ECHO_INTERVAL 12
 
 // Acciones del jugador
 #define ACTION_DOWN -1
@@ -32,34 +57,67 @@
 #define PADDLE_HEIGHT 15.0f
 #define BALL_SIZE 2.0f
 
-// Velocidades
+// Velocidades (por frame)
 #define PADDLE_SPEED 4.5f  // Aumentada para mejor control
 #define BALL_SPEED 0.6f    // Reducida para mejor jugabilidad
 
-// FPS del juego
+// FPS del juego: el ritmo de frames (e inputs) de los clientes y la unidad
+// de las velocidades. El servidor simula a un múltiplo que elige al
+// arrancar (pong_server -r) y lo informa en la respuesta al JOIN; los
+// ticks de los snapshots van a ese ritmo.
 #define TARGET_FPS 60
 #define FRAME_TIME_MS (1000 / TARGET_FPS)
+#define FRAME_TIME_NS (1000000000ULL / TARGET_FPS)
 
 /**
  * Mensaje del Cliente al Servidor
- * Tamaño: 26 bytes
+ * El servidor identifica al remitente por su dirección (ip:puerto) y el
+ * token de sesión que entregó en el JOIN tiene que coincidir.
+ *
+ * MSG_SPECTATE sin token pide mirar una sala: input_seq = sala y
+ * ack_hold_ms = shard (o SPECTATE_ANY_*). Con token es el keepalive del
+ * espectador: ack_tick/ack_hold_ms como en un INPUT.
+ *
+ * Un MSG_JOIN con action = JOIN_ROLLBACK pide el modo rollback: además de
+ * los snapshots recibe MSG_INPUTS y MSG_SYNC (ver rollback.h).
+ *
+ * Jugadores y espectadores informan en snapshots_recv el total de
+ * snapshots recibidos (16 bits): contra lo enviado hasta el ack, el
+ * servidor estima la pérdida de bajada de cada uno y le baja el ritmo de
+ * snapshots a los enlaces malos.
+ *
+ * En un INPUT, input_seq numera los frames del cliente (uno por frame) y
+ * input_history repite las acciones de los INPUT_REDUNDANCY frames
+ * anteriores (ver input.h): el servidor aplica cada frame una sola vez y un
+ * paquete perdido no pierde inputs.
+ * Tamaño: 37 bytes
  */
 struct client_message {
-    uint8_t type;              // Tipo de mensaje (JOIN, INPUT, STATS, LEAVE)
-    uint32_t timestamp;        // Timestamp en milisegundos
-    uint8_t player_id;         // ID del jugador (0 si es JOIN)
+    uint8_t type;              // Tipo de mensaje (JOIN, INPUT, STATS, LEAVE, SPECTATE)
+    uint32_t timestamp;        // Timestamp en milisegundos (el servidor lo devuelve como eco)
+    uint16_t seq;              // Secuencia del paquete (detección de pérdida y desorden)
+    uint32_t session_token;    // Token de la respuesta al JOIN (0 si es JOIN)
+    uint16_t ack_tick;         // Último snapshot recibido (16 bits bajos, 0 = ninguno)
+    uint8_t ack_hold_ms;       // Tiempo que ese snapshot esperó en el cliente antes del ack
+    uint16_t input_seq;        // Secuencia del input (el servidor la devuelve como ack)
     int8_t action;             // -1=ABAJO, 0=QUIETO, 1=ARRIBA
+    uint16_t input_history;    // Acciones de los frames anteriores, 2 bits c/u (ver input.h)
+    uint16_t snapshots_recv;   // Snapshots recibidos (total, 16 bits)
     char player_name[PLAYER_NAME_LEN];  // Nombre del jugador (solo para JOIN)
 } __attribute__((packed));
 
 /**
- * Mensaje del Servidor al Cliente
- * Tamaño: 40 bytes
+ * Mensaje del Servidor al Cliente (respuesta a JOIN con el estado completo)
+ * Durante la partida el estado viaja como MSG_SNAPSHOT (ver snapshot.h).
+ * Tamaño: 43 bytes
  */
 struct server_message {
     uint8_t type;              // Tipo de mensaje (STATE, STATS, ERROR)
     uint32_t timestamp;        // Timestamp del servidor
     uint8_t player_id;         // ID asignado al jugador (solo en respuesta a JOIN)
+    uint16_t room_id;          // Sala en la que juega el jugador
+    uint32_t session_token;    // Token de sesión para los mensajes siguientes
+    uint16_t tick_rate;        // Ticks por segundo de la simulación (los de los snapshots)
     
     // Estado del juego
     float paddle1_y;           // Posición Y paleta jugador 1 (0-100)
@@ -76,4 +134,15 @@ struct server_message {
     uint32_t packets_recv;     // Total paquetes recibidos
 } __attribute__((packed));
 
+/**
+ * Aviso del Servidor: el rival dejó la sala. Su lugar queda libre y la
+ * partida se detiene hasta que llegue otro jugador.
+ * Tamaño: 3 bytes
+ */
+struct peer_left_message {
+    uint8_t type;              // MSG_PEER_LEFT
+    uint8_t player_id;         // Jugador que salió
+    uint8_t reason;            // PEER_LEFT_QUIT o PEER_LEFT_TIMEOUT
+} __attribute__((packed));
+
 #endif // PROTOCOL_H
@@ -0,0 +1,194 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "game.h"
+#include "lfqueue.h"
+
+/**
+ * Repeticiones: grabación binaria de partidas
+ *
+ * Un archivo por shard: una cabecera y después registros de todas sus
+ * salas intercalados en orden de tick. Por partida se graba el inicio
+ * (jugadores y estado inicial), las acciones solo cuando cambian y un
+ * keyframe con el game_state completo cada REPLAY_KEYFRAME_TICKS; como
+ * game_step es determinista, eso alcanza para reconstruir cualquier tick
+ * (ver pong_replay). Todo en little-endian y sin relleno.
+ *
+ * El hilo del tick solo copia el registro en un bloque en memoria. Los
+ * bloques llenos pasan por una lf_queue a un hilo escritor que hace los
+ * write() y devuelve los bloques vacíos por otra: el tick nunca espera al
+ * disco. Si el escritor se atrasa y no quedan bloques, los registros se
+ * descartan y el siguiente bloque empieza con REPLAY_GAP.
+ */
+
+#define REPLAY_MAGIC "PONGRPL"     // 8 bytes con el '\0'
+#define REPLAY_VERSION 1
+#define REPLAY_KEYFRAME_TICKS 300  // Un keyframe cada 300 ticks (5 s a 60 Hz)
+#define REPLAY_CHUNK_SIZE 65536
+#define REPLAY_CHUNKS 64           // Bloques por archivo (4 MB)
+#define REPLAY_FLUSH_MS 250        // Antigüedad máxima de un bloque sin escribir
+
+// Tipos de registro
+#define REPLAY_MATCH_START 1       // struct replay_match_start + keyframe del tick 0
+#define REPLAY_INPUT 2             // struct replay_input
+#define REPLAY_KEYFRAME 3          // struct replay_keyframe
+#define REPLAY_MATCH_END 4         // struct replay_match_end
+#define REPLAY_GAP 5               // Se perdieron registros antes de este
+
+// Sala de los registros que no son de una sala
+#define REPLAY_NO_ROOM UINT16_MAX
+
+struct replay_header {
+    char magic[8];
+    uint16_t version;
+    uint16_t tick_rate;           // Ticks por segundo (TARGET_FPS * game_state.frame_ticks)
+    uint8_t fixed_point;          // 1 = game_scalar en Q16.16, 0 = float
+    uint8_t shard;
+    uint16_t keyframe_ticks;
+    uint64_t start_ms;            // Hora de inicio (Unix, ms)
+} __attribute__((packed));
+
+/**
+ * Cabecera de cada registro; le siguen size bytes de datos. Un lector
+ * puede saltar los tipos que no conoce.
+ */
+struct replay_record {
+    uint8_t type;
+    uint8_t size;
+    uint16_t room;
+    uint32_t tick;                // Tick de la partida (0 = inicio)
+} __attribute__((packed));
+
+struct replay_match_start {
+    uint64_t wall_ms;             // Hora de inicio (Unix, ms)
+    char names[MAX_PLAYERS][PLAYER_NAME_LEN];
+} __attribute__((packed));
+
+/**
+ * Acciones que usan los pasos desde este tick hasta el próximo cambio
+ */
+struct replay_input {
+    int8_t action1;
+    int8_t action2;
+} __attribute__((packed));
+
+/**
+ * Estado completo tras el paso que llevó a la partida a este tick, y las
+ * acciones vigentes en ese momento (para arrancar desde aquí)
+ */
+struct replay_keyframe {
+    game_scalar paddle1_y;
+    game_scalar paddle2_y;
+    game_scalar ball_x;
+    game_scalar ball_y;
+    game_scalar ball_vx;
+    game_scalar ball_vy;
+    uint8_t score1;
+    uint8_t score2;
+    uint32_t rng;
+    int8_t action1;
+    int8_t action2;
+} __attribute__((packed));
+
+struct replay_match_end {
+    uint8_t score1;
+    uint8_t score2;
+    uint8_t player_id;            // Quién dejó la sala
+    uint8_t reason;               // PEER_LEFT_*
+} __attribute__((packed));
+
+struct replay_chunk {
+    size_t used;
+    uint8_t data[REPLAY_CHUNK_SIZE];
+};
+
+/**
+ * Un archivo de repeticiones. Solo el hilo de su shard graba en él.
+ */
+struct replay_stream {
+    int fd;
+    int wake_fd;                  // eventfd del escritor (-1 = sin escritor)
+    struct replay_chunk *chunks;  // Reserva de REPLAY_CHUNKS bloques
+    struct replay_chunk *current; // Bloque que se está llenando (NULL = ninguno)
+    struct lf_queue full;         // Shard -> escritor
+    struct lf_queue spare;        // Escritor -> shard
+    uint64_t opened_ns;           // Cuándo empezó a llenarse el bloque actual
+    int lost;                     // Se descartaron registros desde el último bloque
+    uint64_t dropped;             // Registros descartados (total)
+    _Atomic uint64_t written;     // Bytes escritos (lo actualiza el escritor)
+};
+
+struct replay_writer {
+    struct replay_stream *streams;
+    int num_streams;
+    int wake_fd;
+    pthread_t thread;
+};
+
+/**
+ * Prepara un archivo ya abierto: escribe la cabecera y reserva los bloques
+ * @param wake_fd eventfd que despierta al escritor al pasarle un bloque (-1 = ninguno)
+ * @param tick_rate Ticks por segundo de la simulación (múltiplo de TARGET_FPS)
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int replay_stream_init(struct replay_stream *stream, int fd, int wake_fd, int shard,
+                       int tick_rate);
+
+/**
+ * Libera los bloques (no cierra el archivo)
+ */
+void replay_stream_free(struct replay_stream *stream);
+
+/**
+ * Agrega un registro al bloque actual; si no entra, pasa el bloque al escritor
+ */
+void replay_append(struct replay_stream *stream, uint8_t type, uint16_t room, uint32_t tick,
+                   const void *data, uint8_t size);
+
+/**
+ * Pasa el bloque actual al escritor si lleva más de REPLAY_FLUSH_MS abierto
+ */
+void replay_flush_due(struct replay_stream *stream, uint64_t now_ns);
+
+/**
+ * Escribe los bloques llenos pendientes y los devuelve a la reserva (lo
+ * llama el hilo escritor)
+ * @return Cantidad de bloques escritos
+ */
+int replay_stream_drain(struct replay_stream *stream);
+
+/**
+ * Crea un archivo por shard en dir y arranca el hilo escritor
+ * @param tick_rate Ticks por segundo de la simulación
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int replay_writer_start(struct replay_writer *writer, const char *dir, int num_streams,
+                        int tick_rate);
+
+/**
+ * Guarda el estado de una partida como keyframe con sus acciones vigentes
+ */
+void replay_keyframe_from_state(struct replay_keyframe *kf, const struct game_state *game,
+                                int8_t action1, int8_t action2);
+
+/**
+ * Reconstruye el game_state de un keyframe del tick indicado
+ */
+void replay_keyframe_to_state(const struct replay_keyframe *kf, uint32_t tick,
+                              struct game_state *game);
+
+/**
+ * Hora actual (Unix, ms) para las cabeceras
+ */
+uint64_t replay_wall_ms(void);
+
+/**
+ * Lee el registro en offset y avanza offset al siguiente
+ * @return El registro o NULL al final del archivo (o si está truncado)
+ */
+const struct replay_record *replay_next(const uint8_t *data, size_t len, size_t *offset);
+
+#endif // REPLAY_H
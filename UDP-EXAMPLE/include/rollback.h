@@ -0,0 +1,131 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <stdint.h>
+#include "protocol.h"
+#include "game.h"
+#include "replay.h"
+
+/**
+ * Modo rollback del cliente (pong_client -k)
+ *
+ * El servidor sigue siendo autoritativo, pero a los jugadores que lo piden
+ * en el JOIN les reenvía las acciones que aplicó a las dos paletas en cada
+ * frame (MSG_INPUTS, con el tick de la partida en que empiezan a regir) y
+ * cada tanto el estado completo de la partida (MSG_SYNC). Con eso el
+ * cliente corre game_step por su cuenta y se adelanta a lo confirmado lo
+ * que tardan sus inputs en llegar: su paleta responde al instante y la
+ * pelota y el rival se ven en el presente en vez de un RTT atrás. La
+ * acción del rival se predice repitiendo la última confirmada.
+ *
+ * Cada frame simulado guarda en un anillo el estado con que empezó y las
+ * acciones que usó. Cuando llegan las acciones reales de un frame y no son
+ * las que se usaron, se vuelve al estado de ese frame y se re-simula hasta
+ * el presente (a lo sumo ROLLBACK_FRAMES, ~0.3 µs en make bench). El cliente
+ * no se adelanta más de ROLLBACK_FRAMES a lo confirmado: con más latencia
+ * espera. MSG_SYNC verifica que la simulación local no se haya separado de
+ * la del servidor y, si se separó o se perdieron frames, la reemplaza.
+ *
+ * Un frame son frame_ticks pasos de la partida (el ritmo de simulación del
+ * servidor, ver pong_server -r) y empieza en un tick con el mismo resto
+ * módulo frame_ticks que el de MSG_SYNC.
+ */
+
+#define ROLLBACK_FRAMES 12          // Lo más que se re-simula: 200 ms a 60 Hz
+#define ROLLBACK_RING 16            // Frames guardados (potencia de 2, > ROLLBACK_FRAMES)
+#define ROLLBACK_SYNC_FRAMES 60     // Cada cuántos frames el servidor envía MSG_SYNC
+
+// client_message.action de un MSG_JOIN que pide el modo rollback
+#define JOIN_ROLLBACK 1
+
+/**
+ * Acciones que aplicó el servidor: las del frame que empieza en tick y,
+ * en history1/history2, las de los frames anteriores (ver input.h)
+ * Tamaño: 11 bytes
+ */
+struct input_relay {
+    uint8_t type;              // MSG_INPUTS
+    uint32_t tick;             // Tick de la partida en que empieza el frame más nuevo
+    int8_t action1;
+    int8_t action2;
+    uint16_t history1;         // Jugador 1, INPUT_REDUNDANCY frames anteriores
+    uint16_t history2;
+} __attribute__((packed));
+
+/**
+ * Estado completo de la partida al empezar un frame, con las acciones del
+ * frame anterior (la predicción del rival arranca de ahí)
+ * Tamaño: 37 bytes
+ */
+struct sync_message {
+    uint8_t type;              // MSG_SYNC
+    uint32_t tick;             // Tick de la partida (inicio de un frame)
+    struct replay_keyframe state;
+} __attribute__((packed));
+
+/**
+ * Simulación local con vuelta atrás
+ */
+struct rollback {
+    struct game_state states[ROLLBACK_RING];     // Estado al empezar cada frame
+    int8_t used[ROLLBACK_RING][MAX_PLAYERS];     // Acciones con que se simuló
+    int8_t real[ROLLBACK_RING][MAX_PLAYERS];     // Acciones que aplicó el servidor
+    uint32_t real_frame[ROLLBACK_RING];          // Frame de real[] (UINT32_MAX = ninguno)
+    uint32_t frame;            // Frame presente: states[frame] es lo que se muestra
+    uint32_t confirmed;        // Primer frame sin las acciones reales
+    uint32_t resim_from;       // Primer frame a re-simular (UINT32_MAX = ninguno)
+    int8_t last_real[MAX_PLAYERS];  // Acciones del último frame confirmado
+    int own;                   // Paleta propia (0 o 1)
+    int synced;                // Ya llegó un MSG_SYNC y no se perdió el hilo
+    uint8_t frame_ticks;
+    
+    // Contadores
+    uint32_t rollbacks;        // Veces que se volvió atrás
+    uint32_t resimulated;      // Frames re-simulados
+    uint32_t stalls;           // Frames que se esperó por ir demasiado adelante
+    uint32_t desyncs;          // MSG_SYNC que no coincidió con lo simulado
+    uint32_t lost;             // Veces que faltaron frames y hubo que esperar un MSG_SYNC
+};
+
+/**
+ * Deja la simulación sin estado (espera un MSG_SYNC)
+ * @param own Paleta propia (0 = jugador 1, 1 = jugador 2)
+ */
+void rollback_init(struct rollback *rb, int own);
+
+/**
+ * Aplica un MSG_SYNC: si el frame ya se simuló con las acciones reales lo
+ * compara, y si difiere (o no hay con qué comparar) parte de él
+ * @return 1 si hubo que corregir, 0 si coincidió, -1 si el mensaje es inválido
+ */
+int rollback_sync(struct rollback *rb, const struct sync_message *msg, uint8_t frame_ticks);
+
+/**
+ * Guarda las acciones reales de un MSG_INPUTS (el frame más nuevo y los
+ * anteriores de su historial). Lo que contradiga a lo simulado queda
+ * marcado para re-simular.
+ * @return 0 si tuvo éxito, -1 si se perdió el hilo (espera un MSG_SYNC)
+ */
+int rollback_confirm(struct rollback *rb, const struct input_relay *relay);
+
+/**
+ * Vuelve al primer frame marcado y re-simula hasta el presente
+ * @return Frames re-simulados
+ */
+int rollback_resimulate(struct rollback *rb);
+
+/**
+ * Simula el frame presente con la acción propia y la del rival predicha
+ * (o las reales, si ya llegaron)
+ * @return 1 si avanzó, 0 si ya va ROLLBACK_FRAMES delante de lo confirmado
+ */
+int rollback_advance(struct rollback *rb, int8_t own_action);
+
+/**
+ * Estado del frame presente
+ */
+static inline const struct game_state *rollback_state(const struct rollback *rb) {
+    return &rb->states[rb->frame % ROLLBACK_RING];
+}
+
+#endif // ROLLBACK_H
@@ -0,0 +1,66 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+ * Tabla de sesiones: dirección del cliente (ip:puerto) -> sesión
+ *
+ * Direccionamiento abierto con sondeo lineal sobre un arreglo reservado una
+ * sola vez: buscar, insertar y borrar no asignan memoria. La capacidad es
+ * la potencia de 2 que deja la ocupación en 50% o menos, así que el sondeo
+ * medio se mantiene en ~1.5 entradas sin importar cuántas sesiones haya.
+ * Los borrados desplazan hacia atrás las entradas siguientes en lugar de
+ * dejar lápidas, para que una tabla con muchas altas y bajas no se degrade.
+ */
+
+// Valor que devuelve session_find si la dirección no tiene sesión
+#define SESSION_NONE UINT32_MAX
+
+struct session_entry {
+    uint32_t ip;               // Orden de red, como en sockaddr_in
+    uint16_t port;
+    uint32_t value;            // SESSION_NONE = entrada libre
+};
+
+struct session_table {
+    struct session_entry *entries;
+    uint32_t mask;             // Capacidad - 1
+    uint32_t shift;            // 64 - log2(capacidad), para el hash multiplicativo
+    uint32_t count;
+    uint32_t max_sessions;
+    uint64_t seed;             // Mezcla del hash (distinta por tabla)
+};
+
+/**
+ * Reserva una tabla para hasta max_sessions sesiones
+ * @param seed Semilla del hash (p. ej. aleatoria por proceso)
+ * @return 0 si tuvo éxito, -1 sin memoria
+ */
+int session_table_init(struct session_table *table, uint32_t max_sessions, uint64_t seed);
+
+/**
+ * Libera la memoria de la tabla
+ */
+void session_table_free(struct session_table *table);
+
+/**
+ * Busca la sesión de una dirección
+ * @return Valor guardado o SESSION_NONE
+ */
+uint32_t session_find(const struct session_table *table, const struct sockaddr_in *addr);
+
+/**
+ * Asocia una dirección a una sesión (reemplaza si ya existía)
+ * @return 0 si tuvo éxito, -1 si la tabla está llena
+ */
+int session_insert(struct session_table *table, const struct sockaddr_in *addr, uint32_t value);
+
+/**
+ * Quita la sesión de una dirección
+ * @return 0 si existía, -1 si no
+ */
+int session_remove(struct session_table *table, const struct sockaddr_in *addr);
+
+#endif // SESSION_H
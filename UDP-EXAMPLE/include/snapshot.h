@@ -0,0 +1,127 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Codificación compacta del estado del juego (MSG_SNAPSHOT)
+ *
+ * Formato en el cable:
+ *   [type u8][tick u16][base u8][mask u8][campos...]
+ *
+ * - tick: 16 bits bajos del tick del servidor
+ * - base: distancia en ticks al snapshot base (0 = keyframe completo)
+ * - mask: campos presentes (SNAP_*)
+ *
+ * A 60 Hz el cliente suele haber confirmado el tick anterior: ese caso va
+ * como MSG_SNAPSHOT_NEXT, sin el byte de base (cabecera de 4 bytes).
+ *
+ * Las posiciones se cuantizan a 16 bits en punto fijo sobre el campo
+ * 0-100. En un keyframe cada posición va absoluta (2 bytes); en un delta
+ * va la diferencia contra la base como varint zigzag y los campos sin
+ * cambios se omiten. Las estadísticas solo viajan cuando se piden.
+ * El ack de input (8 bits bajos del último input procesado para ese
+ * cliente) permite la reconciliación de la predicción del cliente.
+ * El eco devuelve los 16 bits bajos del timestamp del último paquete del
+ * cliente junto con el tiempo que esperó en el servidor, de modo que el
+ * cliente calcula RTT = ahora - eco - espera sin contar el tick.
+ */
+
+// Bits de la máscara de campos
+#define SNAP_PADDLE1 0x01
+#define SNAP_PADDLE2 0x02
+#define SNAP_BALL_X  0x04
+#define SNAP_BALL_Y  0x08
+#define SNAP_SCORE   0x10
+#define SNAP_STATS   0x20
+#define SNAP_INPUT_ACK 0x40
+#define SNAP_ECHO    0x80
+
+// Ticks recordados para usar como base (potencia de 2, menos de 256): a
+// 120 Hz y con un jugador a 10 Hz alcanza para un RTT de ~400 ms
+#define SNAP_HISTORY 64
+
+// Tamaño máximo de un snapshot codificado
+#define SNAP_MAX_SIZE 48
+
+/**
+ * Estado cuantizado de una partida en un tick
+ */
+struct snapshot {
+    uint32_t tick;
+    uint16_t paddle1_y;
+    uint16_t paddle2_y;
+    uint16_t ball_x;
+    uint16_t ball_y;
+    uint8_t score1;
+    uint8_t score2;
+};
+
+/**
+ * Estadísticas de red que acompañan a un snapshot a baja frecuencia
+ */
+struct snapshot_stats {
+    uint16_t rtt_ms;
+    uint8_t loss_percent;
+    uint32_t packets_sent;
+    uint32_t packets_recv;
+};
+
+/**
+ * Campos propios de cada destinatario (no dependen del estado del juego)
+ */
+struct snapshot_extra {
+    uint8_t mask;              // Subconjunto de SNAP_STATS | SNAP_INPUT_ACK | SNAP_ECHO
+    struct snapshot_stats stats;
+    uint8_t input_ack;         // 8 bits bajos del último input procesado
+    uint16_t echo_ts;          // 16 bits bajos del timestamp del cliente
+    uint8_t echo_hold_ms;      // Tiempo que ese timestamp esperó en el servidor
+};
+
+/**
+ * Cabecera de un snapshot recibido
+ */
+struct snapshot_header {
+    uint16_t tick;             // 16 bits bajos del tick
+    uint8_t base_offset;       // 0 = keyframe
+    uint8_t mask;
+    uint8_t size;              // Bytes de cabecera (4 con MSG_SNAPSHOT_NEXT, si no 5)
+};
+
+/**
+ * Cuantiza una coordenada del campo (0-100) a 16 bits
+ */
+uint16_t snapshot_quantize(float value);
+
+/**
+ * Convierte una coordenada cuantizada de vuelta a unidades del campo
+ */
+float snapshot_dequantize(uint16_t value);
+
+/**
+ * Codifica un snapshot, como delta contra base o completo si base es NULL
+ * @param base Snapshot ya confirmado por el cliente (NULL = keyframe)
+ * @param extra Campos del destinatario a incluir según extra->mask (NULL = ninguno)
+ * @return Bytes escritos en buf
+ */
+size_t snapshot_encode(uint8_t *buf, const struct snapshot *cur, const struct snapshot *base,
+                       const struct snapshot_extra *extra);
+
+/**
+ * Lee la cabecera de un snapshot para poder buscar su base
+ * @return 0 si tuvo éxito, -1 si el datagrama no es un snapshot válido
+ */
+int snapshot_read_header(const uint8_t *buf, size_t len, struct snapshot_header *header);
+
+/**
+ * Decodifica un snapshot
+ * @param base Snapshot base (obligatorio si header.base_offset != 0)
+ * @param out Estado reconstruido; out->tick se deja intacto
+ * @param extra Campos del destinatario; extra->mask indica cuáles vinieron
+ * @return 0 si tuvo éxito, -1 si el datagrama está truncado o falta la base
+ */
+int snapshot_decode(const uint8_t *buf, size_t len, const struct snapshot *base,
+                    struct snapshot *out, struct snapshot_extra *extra);
+
+#endif // SNAPSHOT_H
@@ -2,7 +2,7 @@
 #define STATS_H
 
 #include <stdint.h>
-#include <time.h>
+#include "histogram.h"
 
 /**
  * Estructura para almacenar estadísticas de red
@@ -12,6 +12,11 @@ struct network_stats {
     uint32_t packets_sent;
     uint32_t packets_received;
     uint32_t packets_lost;
+    uint32_t packets_reordered;
+    
+    // Secuencia del par remoto (detección de pérdida y desorden)
+    uint16_t highest_seq;
+    int seq_started;
     
     // Bytes transferidos
     uint64_t bytes_sent;
@@ -22,13 +27,15 @@ struct network_stats {
     float rtt_max;
     float rtt_avg;
     float rtt_current;
+    uint32_t rtt_samples;        // Mediciones recibidas (0 = el promedio todavía no arrancó)
+    struct histogram *rtt_hist;  // Percentiles de RTT en µs (opcional, NULL = no)
     
     // Rendimiento
     float throughput_bps;
     
-    // Timestamps
-    time_t start_time;
-    time_t last_update;
+    // Timestamps (ns del reloj monotónico, ver clock_now_ns)
+    uint64_t start_time;
+    uint64_t last_update;
 };
 
 /**
@@ -57,7 +64,16 @@ void stats_packet_received(struct network_stats *stats, int bytes);
 void stats_packet_lost(struct network_stats *stats);
 
 /**
- * Calcula el porcentaje de pérdida de paquetes
+ * Registra la secuencia de un paquete recibido
+ * Un salto hacia adelante cuenta los paquetes intermedios como perdidos;
+ * si uno de ellos llega después, se descuenta de las pérdidas y se
+ * cuenta como desordenado.
+ * @return 1 si es el paquete más nuevo, 0 si llegó desordenado o duplicado
+ */
+int stats_track_sequence(struct network_stats *stats, uint16_t seq);
+
+/**
+ * Calcula el porcentaje de pérdida de paquetes (perdidos / esperados)
  */
 uint8_t stats_get_loss_percent(struct network_stats *stats);
 
@@ -0,0 +1,68 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/**
+ * Rueda de temporizadores (hashed timing wheel)
+ *
+ * Cada id (0..max_ids-1) tiene a lo sumo un plazo, guardado en una lista
+ * doblemente enlazada intrusiva dentro de la ranura plazo % TIMER_WHEEL_SLOTS.
+ * Programar y cancelar son O(1) y avanzar un instante solo recorre los ids
+ * que vencen en él, así que el costo no depende de cuántos ids haya
+ * programados. El tiempo se mide en unidades que elige el usuario (p. ej.
+ * múltiplos de 100 ms). Los arreglos se reservan una sola vez.
+ */
+
+// Ranuras de la rueda (potencia de 2): plazos de hasta TIMER_WHEEL_SLOTS - 1
+// unidades; uno más lejano se acorta y vence antes
+#define TIMER_WHEEL_SLOTS 64
+
+// Fin de lista / id sin plazo
+#define TIMER_NONE UINT32_MAX
+
+struct timer_wheel {
+    uint32_t heads[TIMER_WHEEL_SLOTS];
+    uint32_t *next;            // Enlaces por id
+    uint32_t *prev;
+    uint32_t *slot;            // Ranura del id o TIMER_NONE si no está programado
+    uint32_t now;              // Último instante procesado
+    uint32_t count;            // Ids programados
+};
+
+/**
+ * Callback de vencimiento. El id ya salió de la rueda, así que puede
+ * volver a programarse (o cancelar otros) desde el callback.
+ */
+typedef void (*timer_wheel_fn)(void *ctx, uint32_t id);
+
+/**
+ * Reserva una rueda para ids en [0, max_ids)
+ * @param now Instante inicial
+ * @return 0 si tuvo éxito, -1 sin memoria
+ */
+int timer_wheel_init(struct timer_wheel *wheel, uint32_t max_ids, uint32_t now);
+
+/**
+ * Libera la memoria de la rueda
+ */
+void timer_wheel_free(struct timer_wheel *wheel);
+
+/**
+ * Programa (o reprograma) un id para que venza en el instante due
+ * (se recorta al rango [now + 1, now + TIMER_WHEEL_SLOTS - 1])
+ */
+void timer_wheel_schedule(struct timer_wheel *wheel, uint32_t id, uint32_t due);
+
+/**
+ * Quita el plazo de un id (no hace nada si no tenía)
+ */
+void timer_wheel_cancel(struct timer_wheel *wheel, uint32_t id);
+
+/**
+ * Avanza la rueda hasta el instante now llamando a fn por cada id vencido
+ * @return Cantidad de ids vencidos
+ */
+uint32_t timer_wheel_advance(struct timer_wheel *wheel, uint32_t now, timer_wheel_fn fn, void *ctx);
+
+#endif // TIMER_WHEEL_H
@@ -4,11 +4,45 @@
 #include <stdint.h>
 
 /**
- * Obtiene el tiempo actual en milisegundos
- * @return Timestamp en milisegundos
+ * Reloj monotónico en nanosegundos (CLOCK_MONOTONIC)
+ *
+ * Todos los tiempos del proyecto salen de este reloj: no retrocede ni salta
+ * si se ajusta la hora del sistema (NTP, cambio manual), así que las
+ * duraciones, los timeouts y el planificador de frames no se rompen.
+ * @return Nanosegundos desde un origen arbitrario
+ */
+uint64_t get_time_ns(void);
+
+/**
+ * Tiempo monotónico en milisegundos, truncado a 32 bits
+ * Da la vuelta cada ~49 días: comparar siempre por diferencia (a - b)
+ * @return Milisegundos desde un origen arbitrario
  */
 uint32_t get_time_ms(void);
 
+/**
+ * Tiempo monotónico en microsegundos (para medir duraciones)
+ * @return Microsegundos desde un origen arbitrario
+ */
+uint64_t get_time_us(void);
+
+/**
+ * Lee el reloj y lo guarda como el "ahora" del hilo
+ *
+ * Los loops de eventos la llaman una vez por despertar (o por lote de
+ * datagramas); el código por paquete (estadísticas, último visto) lee
+ * clock_now_ns y no paga una lectura del reloj por paquete.
+ * @return El nuevo "ahora" en nanosegundos
+ */
+uint64_t clock_refresh(void);
+
+/**
+ * "Ahora" del hilo guardado por el último clock_refresh
+ * Si el hilo nunca llamó a clock_refresh, lee el reloj.
+ * @return Nanosegundos (mismo origen que get_time_ns)
+ */
+uint64_t clock_now_ns(void);
+
 /**
  * Limita un valor a un rango específico
  * @param value Valor a limitar
@@ -18,10 +52,4 @@ uint32_t get_time_ms(void);
  */
 float clamp(float value, float min, float max);
 
-/**
- * Imprime un mensaje con timestamp
- * @param format Formato del mensaje (estilo printf)
- */
-void log_msg(const char *format, ...);
-
 #endif // UTILS_H
@@ -0,0 +1,130 @@
+#include "game.h"
+#include "protocol.h"
+
+static game_scalar scalar_clamp(game_scalar value, game_scalar min, game_scalar max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+static game_scalar scalar_abs(game_scalar value) {
+    return value < 0 ? -value : value;
+}
+
+/**
+ * Siguiente número del generador (xorshift32)
+ * Definido aquí y no con rand_r para que la secuencia no dependa de la libc.
+ */
+static uint32_t next_random(struct game_state *game) {
+    uint32_t x = game->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    game->rng = x;
+    return x;
+}
+
+/**
+ * Inicializa el estado de una partida
+ */
+void game_init(struct game_state *game, uint32_t seed) {
+    game->paddle1_y = GAME_SCALAR(FIELD_HEIGHT / 2.0f);
+    game->paddle2_y = GAME_SCALAR(FIELD_HEIGHT / 2.0f);
+    game->ball_x = GAME_SCALAR(FIELD_WIDTH / 2.0f);
+    game->ball_y = GAME_SCALAR(FIELD_HEIGHT / 2.0f);
+    game->ball_vx = GAME_SCALAR(BALL_SPEED);
+    game->ball_vy = GAME_SCALAR(BALL_SPEED * 0.5f);
+    game->score1 = 0;
+    game->score2 = 0;
+    game->tick = 0;
+    game->rng = seed ? seed : 0x9e3779b9u;  // xorshift no sale nunca del 0
+    game->frame_ticks = 1;
+}
+
+/**
+ * Reinicia la pelota al centro
+ */
+void game_reset_ball(struct game_state *game) {
+    game->ball_x = GAME_SCALAR(FIELD_WIDTH / 2.0f);
+    game->ball_y = GAME_SCALAR(FIELD_HEIGHT / 2.0f);
+    
+    // Dirección horizontal al azar y vertical en [-0.5, 0.5) * BALL_SPEED
+    game->ball_vx = (next_random(game) & 1) ? GAME_SCALAR(BALL_SPEED) : -GAME_SCALAR(BALL_SPEED);
+    game->ball_vy = GAME_SCALAR(BALL_SPEED) * ((int)(next_random(game) % 100) - 50) / 100;
+}
+
+static game_scalar move_paddle(game_scalar paddle_y, int8_t action, game_scalar speed) {
+    paddle_y += action * speed;
+    return scalar_clamp(paddle_y, PADDLE_MIN_Y, PADDLE_MAX_Y);
+}
+
+/**
+ * Mueve una paleta un frame según la acción
+ */
+game_scalar game_move_paddle(game_scalar paddle_y, int8_t action) {
+    return move_paddle(paddle_y, action, GAME_SCALAR(PADDLE_SPEED));
+}
+
+/**
+ * Avanza la simulación un paso
+ */
+int game_step(struct game_state *game, int8_t action1, int8_t action2) {
+    int events = 0;
+    game->tick++;
+    
+    // Actualizar posiciones de paletas según acciones (la fracción de frame
+    // del paso; dividir por 1 no cambia el valor)
+    game_scalar paddle_speed = GAME_SCALAR(PADDLE_SPEED) / game->frame_ticks;
+    game->paddle1_y = move_paddle(game->paddle1_y, action1, paddle_speed);
+    game->paddle2_y = move_paddle(game->paddle2_y, action2, paddle_speed);
+    
+    // Actualizar posición de la pelota
+    game->ball_x += game->ball_vx / game->frame_ticks;
+    game->ball_y += game->ball_vy / game->frame_ticks;
+    
+    // Rebote en paredes superior e inferior
+    if (game->ball_y <= BALL_MIN_Y || game->ball_y >= BALL_MAX_Y) {
+        game->ball_vy = -game->ball_vy;
+        game->ball_y = scalar_clamp(game->ball_y, BALL_MIN_Y, BALL_MAX_Y);
+    }
+    
+    // Colisión con paleta izquierda (jugador 1)
+    if (game->ball_x <= BALL_LEFT_X) {
+        game_scalar offset = game->ball_y - game->paddle1_y;
+        if (scalar_abs(offset) <= PADDLE_REACH) {
+            game->ball_vx = scalar_abs(game->ball_vx); // Rebote hacia la derecha
+            game->ball_x = BALL_LEFT_X;
+            
+            // Agregar efecto según dónde golpea (±0.5 en los extremos)
+            game->ball_vy += GAME_DIV(offset, PADDLE_REACH) / 2;
+        }
+    }
+    
+    // Colisión con paleta derecha (jugador 2)
+    if (game->ball_x >= BALL_RIGHT_X) {
+        game_scalar offset = game->ball_y - game->paddle2_y;
+        if (scalar_abs(offset) <= PADDLE_REACH) {
+            game->ball_vx = -scalar_abs(game->ball_vx); // Rebote hacia la izquierda
+            game->ball_x = BALL_RIGHT_X;
+            
+            // Agregar efecto según dónde golpea (±0.5 en los extremos)
+            game->ball_vy += GAME_DIV(offset, PADDLE_REACH) / 2;
+        }
+    }
+    
+    // Gol del jugador 2 (pelota sale por la izquierda)
+    if (game->ball_x < 0) {
+        game->score2++;
+        events |= GAME_EVENT_GOAL_P2;
+        game_reset_ball(game);
+    }
+    
+    // Gol del jugador 1 (pelota sale por la derecha)
+    if (game->ball_x > GAME_SCALAR(FIELD_WIDTH)) {
+        game->score1++;
+        events |= GAME_EVENT_GOAL_P1;
+        game_reset_ball(game);
+    }
+    
+    return events;
+}
@@ -0,0 +1,377 @@
+#include "game_batch.h"
+#include <string.h>
+
+// Kernels vectoriales: solo x86-64 y solo con float (en punto fijo la
+// división del efecto de paleta es entera de 64 bits y no tiene versión SIMD)
+#if defined(__x86_64__) && !defined(GAME_FIXED_POINT)
+#define GAME_BATCH_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+ * Inicia una partida nueva en un carril
+ */
+void game_batch_init_lane(struct game_batch *batch, int lane, uint32_t seed) {
+    struct game_state game;
+    game_init(&game, seed);
+    game_batch_store(batch, lane, &game);
+    
+    batch->action1[lane] = ACTION_IDLE;
+    batch->action2[lane] = ACTION_IDLE;
+    batch->live[lane] = 0;
+    batch->events[lane] = 0;
+}
+
+/**
+ * Copia el estado de un carril a un game_state
+ */
+void game_batch_load(const struct game_batch *batch, int lane, struct game_state *game) {
+    game->paddle1_y = batch->paddle1_y[lane];
+    game->paddle2_y = batch->paddle2_y[lane];
+    game->ball_x = batch->ball_x[lane];
+    game->ball_y = batch->ball_y[lane];
+    game->ball_vx = batch->ball_vx[lane];
+    game->ball_vy = batch->ball_vy[lane];
+    game->score1 = batch->score1[lane];
+    game->score2 = batch->score2[lane];
+    game->tick = batch->tick[lane];
+    game->rng = batch->rng[lane];
+    game->frame_ticks = batch->frame_ticks;
+}
+
+/**
+ * Copia un game_state a un carril
+ */
+void game_batch_store(struct game_batch *batch, int lane, const struct game_state *game) {
+    batch->paddle1_y[lane] = game->paddle1_y;
+    batch->paddle2_y[lane] = game->paddle2_y;
+    batch->ball_x[lane] = game->ball_x;
+    batch->ball_y[lane] = game->ball_y;
+    batch->ball_vx[lane] = game->ball_vx;
+    batch->ball_vy[lane] = game->ball_vy;
+    batch->score1[lane] = game->score1;
+    batch->score2[lane] = game->score2;
+    batch->tick[lane] = game->tick;
+    batch->rng[lane] = game->rng;
+}
+
+/**
+ * Camino escalar de un carril: exactamente game_step
+ */
+static void step_lane_scalar(struct game_batch *batch, int lane) {
+    if (!batch->live[lane]) {
+        batch->events[lane] = 0;
+        return;
+    }
+    
+    struct game_state game;
+    game_batch_load(batch, lane, &game);
+    batch->events[lane] = (uint8_t)game_step(&game, batch->action1[lane], batch->action2[lane]);
+    game_batch_store(batch, lane, &game);
+}
+
+static void step_scalar(struct game_batch *batch, int first, int last) {
+    for (int lane = first; lane < last; lane++) {
+        step_lane_scalar(batch, lane);
+    }
+}
+
+#ifdef GAME_BATCH_SIMD
+
+/**
+ * Cierre de los carriles que avanzó un kernel vectorial: tick y goles.
+ * Un gol reinicia la pelota con el generador de la partida, así que se
+ * resuelve con game_reset_ball sobre una copia del carril (es raro: una
+ * vez cada varios segundos por sala).
+ */
+static void finish_lanes(struct game_batch *batch, int first, int last) {
+    for (int lane = first; lane < last; lane++) {
+        batch->tick[lane] += batch->live[lane];
+        if (batch->events[lane] == 0) continue;
+        
+        struct game_state game;
+        game_batch_load(batch, lane, &game);
+        if (batch->events[lane] & GAME_EVENT_GOAL_P2) {
+            game.score2++;
+            game_reset_ball(&game);
+        }
+        if (batch->events[lane] & GAME_EVENT_GOAL_P1) {
+            game.score1++;
+            game_reset_ball(&game);
+        }
+        game_batch_store(batch, lane, &game);
+    }
+}
+
+/**
+ * Escribe los eventos de un grupo de carriles a partir de las máscaras de gol
+ */
+static void write_events(uint8_t *events, int goals_p1, int goals_p2, int lanes) {
+    if ((goals_p1 | goals_p2) == 0) {
+        memset(events, 0, (size_t)lanes);
+        return;
+    }
+    
+    for (int k = 0; k < lanes; k++) {
+        events[k] = (uint8_t)((((goals_p1 >> k) & 1) ? GAME_EVENT_GOAL_P1 : 0) |
+                              (((goals_p2 >> k) & 1) ? GAME_EVENT_GOAL_P2 : 0));
+    }
+}
+
+/**
+ * 4 bytes con signo -> 4 enteros de 32 bits (SSE2 no tiene cvtepi8_epi32)
+ */
+static __m128i load_bytes_sse2(const void *bytes) {
+    int32_t raw;
+    memcpy(&raw, bytes, sizeof(raw));
+    __m128i v = _mm_cvtsi32_si128(raw);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    return _mm_srai_epi32(v, 24);
+}
+
+static __m128 select_sse2(__m128 mask, __m128 if_true, __m128 if_false) {
+    return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+}
+
+/**
+ * Valor absoluto igual al de game.c (v < 0 ? -v : v), incluido el -0.0
+ */
+static __m128 abs_sse2(__m128 v) {
+    __m128 negative = _mm_cmplt_ps(v, _mm_setzero_ps());
+    return select_sse2(negative, _mm_xor_ps(v, _mm_set1_ps(-0.0f)), v);
+}
+
+/**
+ * Kernel SSE2: 4 carriles por iteración, mismas operaciones que game_step
+ */
+static int step_sse2(struct game_batch *batch, int first, int last) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 paddle_speed = _mm_set1_ps(GAME_SCALAR(PADDLE_SPEED) / batch->frame_ticks);
+    const __m128 frame_ticks = _mm_set1_ps(batch->frame_ticks);
+    const __m128 paddle_min = _mm_set1_ps(PADDLE_MIN_Y);
+    const __m128 paddle_max = _mm_set1_ps(PADDLE_MAX_Y);
+    const __m128 ball_min = _mm_set1_ps(BALL_MIN_Y);
+    const __m128 ball_max = _mm_set1_ps(BALL_MAX_Y);
+    const __m128 left_x = _mm_set1_ps(BALL_LEFT_X);
+    const __m128 right_x = _mm_set1_ps(BALL_RIGHT_X);
+    const __m128 reach = _mm_set1_ps(PADDLE_REACH);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 field_width = _mm_set1_ps(GAME_SCALAR(FIELD_WIDTH));
+    
+    int lane = first;
+    for (; lane + 4 <= last; lane += 4) {
+        __m128 live = _mm_castsi128_ps(_mm_cmpgt_epi32(load_bytes_sse2(batch->live + lane),
+                                                       _mm_setzero_si128()));
+        __m128 action1 = _mm_cvtepi32_ps(load_bytes_sse2(batch->action1 + lane));
+        __m128 action2 = _mm_cvtepi32_ps(load_bytes_sse2(batch->action2 + lane));
+        __m128 p1 = _mm_loadu_ps(batch->paddle1_y + lane);
+        __m128 p2 = _mm_loadu_ps(batch->paddle2_y + lane);
+        __m128 x = _mm_loadu_ps(batch->ball_x + lane);
+        __m128 y = _mm_loadu_ps(batch->ball_y + lane);
+        __m128 vx = _mm_loadu_ps(batch->ball_vx + lane);
+        __m128 vy = _mm_loadu_ps(batch->ball_vy + lane);
+        
+        // Paletas
+        __m128 np1 = _mm_add_ps(p1, _mm_mul_ps(action1, paddle_speed));
+        __m128 np2 = _mm_add_ps(p2, _mm_mul_ps(action2, paddle_speed));
+        np1 = _mm_min_ps(_mm_max_ps(np1, paddle_min), paddle_max);
+        np2 = _mm_min_ps(_mm_max_ps(np2, paddle_min), paddle_max);
+        
+        // Pelota
+        __m128 nx = _mm_add_ps(x, _mm_div_ps(vx, frame_ticks));
+        __m128 ny = _mm_add_ps(y, _mm_div_ps(vy, frame_ticks));
+        __m128 nvx = vx;
+        __m128 nvy = vy;
+        
+        // Rebote en paredes (dentro del campo el recorte no cambia nada)
+        __m128 wall = _mm_or_ps(_mm_cmple_ps(ny, ball_min), _mm_cmpge_ps(ny, ball_max));
+        nvy = select_sse2(wall, _mm_xor_ps(nvy, sign), nvy);
+        ny = _mm_min_ps(_mm_max_ps(ny, ball_min), ball_max);
+        
+        // Paleta izquierda
+        __m128 offset = _mm_sub_ps(ny, np1);
+        __m128 hit = _mm_and_ps(_mm_cmple_ps(nx, left_x), _mm_cmple_ps(abs_sse2(offset), reach));
+        nvx = select_sse2(hit, abs_sse2(nvx), nvx);
+        nx = select_sse2(hit, left_x, nx);
+        nvy = select_sse2(hit, _mm_add_ps(nvy, _mm_div_ps(_mm_div_ps(offset, reach), two)), nvy);
+        
+        // Paleta derecha
+        offset = _mm_sub_ps(ny, np2);
+        hit = _mm_and_ps(_mm_cmpge_ps(nx, right_x), _mm_cmple_ps(abs_sse2(offset), reach));
+        nvx = select_sse2(hit, _mm_xor_ps(abs_sse2(nvx), sign), nvx);
+        nx = select_sse2(hit, right_x, nx);
+        nvy = select_sse2(hit, _mm_add_ps(nvy, _mm_div_ps(_mm_div_ps(offset, reach), two)), nvy);
+        
+        // Goles (se resuelven en finish_lanes)
+        int goals_p2 = _mm_movemask_ps(_mm_and_ps(live, _mm_cmplt_ps(nx, zero)));
+        int goals_p1 = _mm_movemask_ps(_mm_and_ps(live, _mm_cmpgt_ps(nx, field_width)));
+        write_events(batch->events + lane, goals_p1, goals_p2, 4);
+        
+        // Solo los carriles vivos cambian
+        _mm_storeu_ps(batch->paddle1_y + lane, select_sse2(live, np1, p1));
+        _mm_storeu_ps(batch->paddle2_y + lane, select_sse2(live, np2, p2));
+        _mm_storeu_ps(batch->ball_x + lane, select_sse2(live, nx, x));
+        _mm_storeu_ps(batch->ball_y + lane, select_sse2(live, ny, y));
+        _mm_storeu_ps(batch->ball_vx + lane, select_sse2(live, nvx, vx));
+        _mm_storeu_ps(batch->ball_vy + lane, select_sse2(live, nvy, vy));
+    }
+    
+    finish_lanes(batch, first, lane);
+    return lane;
+}
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static __m256 abs_avx2(__m256 v) {
+    __m256 negative = _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LT_OQ);
+    return _mm256_blendv_ps(v, _mm256_xor_ps(v, _mm256_set1_ps(-0.0f)), negative);
+}
+
+AVX2_TARGET static __m256i load_bytes_avx2(const void *bytes) {
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)bytes));
+}
+
+/**
+ * Kernel AVX2: 8 carriles por iteración, mismas operaciones que step_sse2
+ */
+AVX2_TARGET static int step_avx2(struct game_batch *batch, int first, int last) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 paddle_speed = _mm256_set1_ps(GAME_SCALAR(PADDLE_SPEED) / batch->frame_ticks);
+    const __m256 frame_ticks = _mm256_set1_ps(batch->frame_ticks);
+    const __m256 paddle_min = _mm256_set1_ps(PADDLE_MIN_Y);
+    const __m256 paddle_max = _mm256_set1_ps(PADDLE_MAX_Y);
+    const __m256 ball_min = _mm256_set1_ps(BALL_MIN_Y);
+    const __m256 ball_max = _mm256_set1_ps(BALL_MAX_Y);
+    const __m256 left_x = _mm256_set1_ps(BALL_LEFT_X);
+    const __m256 right_x = _mm256_set1_ps(BALL_RIGHT_X);
+    const __m256 reach = _mm256_set1_ps(PADDLE_REACH);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 field_width = _mm256_set1_ps(GAME_SCALAR(FIELD_WIDTH));
+    
+    int lane = first;
+    for (; lane + 8 <= last; lane += 8) {
+        __m256 live = _mm256_castsi256_ps(_mm256_cmpgt_epi32(load_bytes_avx2(batch->live + lane),
+                                                             _mm256_setzero_si256()));
+        __m256 action1 = _mm256_cvtepi32_ps(load_bytes_avx2(batch->action1 + lane));
+        __m256 action2 = _mm256_cvtepi32_ps(load_bytes_avx2(batch->action2 + lane));
+        __m256 p1 = _mm256_loadu_ps(batch->paddle1_y + lane);
+        __m256 p2 = _mm256_loadu_ps(batch->paddle2_y + lane);
+        __m256 x = _mm256_loadu_ps(batch->ball_x + lane);
+        __m256 y = _mm256_loadu_ps(batch->ball_y + lane);
+        __m256 vx = _mm256_loadu_ps(batch->ball_vx + lane);
+        __m256 vy = _mm256_loadu_ps(batch->ball_vy + lane);
+        
+        // Paletas
+        __m256 np1 = _mm256_add_ps(p1, _mm256_mul_ps(action1, paddle_speed));
+        __m256 np2 = _mm256_add_ps(p2, _mm256_mul_ps(action2, paddle_speed));
+        np1 = _mm256_min_ps(_mm256_max_ps(np1, paddle_min), paddle_max);
+        np2 = _mm256_min_ps(_mm256_max_ps(np2, paddle_min), paddle_max);
+        
+        // Pelota
+        __m256 nx = _mm256_add_ps(x, _mm256_div_ps(vx, frame_ticks));
+        __m256 ny = _mm256_add_ps(y, _mm256_div_ps(vy, frame_ticks));
+        __m256 nvx = vx;
+        __m256 nvy = vy;
+        
+        // Rebote en paredes (dentro del campo el recorte no cambia nada)
+        __m256 wall = _mm256_or_ps(_mm256_cmp_ps(ny, ball_min, _CMP_LE_OQ),
+                                   _mm256_cmp_ps(ny, ball_max, _CMP_GE_OQ));
+        nvy = _mm256_blendv_ps(nvy, _mm256_xor_ps(nvy, sign), wall);
+        ny = _mm256_min_ps(_mm256_max_ps(ny, ball_min), ball_max);
+        
+        // Paleta izquierda
+        __m256 offset = _mm256_sub_ps(ny, np1);
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(nx, left_x, _CMP_LE_OQ),
+                                   _mm256_cmp_ps(abs_avx2(offset), reach, _CMP_LE_OQ));
+        nvx = _mm256_blendv_ps(nvx, abs_avx2(nvx), hit);
+        nx = _mm256_blendv_ps(nx, left_x, hit);
+        nvy = _mm256_blendv_ps(nvy, _mm256_add_ps(nvy, _mm256_div_ps(_mm256_div_ps(offset, reach), two)), hit);
+        
+        // Paleta derecha
+        offset = _mm256_sub_ps(ny, np2);
+        hit = _mm256_and_ps(_mm256_cmp_ps(nx, right_x, _CMP_GE_OQ),
+                            _mm256_cmp_ps(abs_avx2(offset), reach, _CMP_LE_OQ));
+        nvx = _mm256_blendv_ps(nvx, _mm256_xor_ps(abs_avx2(nvx), sign), hit);
+        nx = _mm256_blendv_ps(nx, right_x, hit);
+        nvy = _mm256_blendv_ps(nvy, _mm256_add_ps(nvy, _mm256_div_ps(_mm256_div_ps(offset, reach), two)), hit);
+        
+        // Goles (se resuelven en finish_lanes)
+        int goals_p2 = _mm256_movemask_ps(_mm256_and_ps(live, _mm256_cmp_ps(nx, zero, _CMP_LT_OQ)));
+        int goals_p1 = _mm256_movemask_ps(_mm256_and_ps(live, _mm256_cmp_ps(nx, field_width, _CMP_GT_OQ)));
+        write_events(batch->events + lane, goals_p1, goals_p2, 8);
+        
+        // Solo los carriles vivos cambian
+        _mm256_storeu_ps(batch->paddle1_y + lane, _mm256_blendv_ps(p1, np1, live));
+        _mm256_storeu_ps(batch->paddle2_y + lane, _mm256_blendv_ps(p2, np2, live));
+        _mm256_storeu_ps(batch->ball_x + lane, _mm256_blendv_ps(x, nx, live));
+        _mm256_storeu_ps(batch->ball_y + lane, _mm256_blendv_ps(y, ny, live));
+        _mm256_storeu_ps(batch->ball_vx + lane, _mm256_blendv_ps(vx, nvx, live));
+        _mm256_storeu_ps(batch->ball_vy + lane, _mm256_blendv_ps(vy, nvy, live));
+    }
+    
+    finish_lanes(batch, first, lane);
+    return lane;
+}
+
+#endif // GAME_BATCH_SIMD
+
+/**
+ * Indica si el kernel se puede usar
+ */
+int game_kernel_supported(enum game_kernel kernel) {
+    if (kernel == GAME_KERNEL_SCALAR) return 1;
+#ifdef GAME_BATCH_SIMD
+    if (kernel == GAME_KERNEL_SSE2) return 1;
+    if (kernel == GAME_KERNEL_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+    return 0;
+}
+
+/**
+ * Mejor kernel disponible
+ */
+enum game_kernel game_kernel_best(void) {
+    if (game_kernel_supported(GAME_KERNEL_AVX2)) return GAME_KERNEL_AVX2;
+    if (game_kernel_supported(GAME_KERNEL_SSE2)) return GAME_KERNEL_SSE2;
+    return GAME_KERNEL_SCALAR;
+}
+
+/**
+ * Nombre del kernel
+ */
+const char *game_kernel_name(enum game_kernel kernel) {
+    if (kernel == GAME_KERNEL_SSE2) return "sse2";
+    if (kernel == GAME_KERNEL_AVX2) return "avx2";
+    return "escalar";
+}
+
+/**
+ * Avanza los carriles con un kernel concreto; los que no llenan un
+ * vector completo van por el camino escalar
+ */
+void game_batch_step_kernel(struct game_batch *batch, int count, enum game_kernel kernel) {
+    int lane = 0;
+    
+#ifdef GAME_BATCH_SIMD
+    if (kernel == GAME_KERNEL_AVX2 && game_kernel_supported(GAME_KERNEL_AVX2)) {
+        lane = step_avx2(batch, lane, count);
+    }
+    if (kernel != GAME_KERNEL_SCALAR) {
+        lane = step_sse2(batch, lane, count);
+    }
+#else
+    (void)kernel;
+#endif
+    
+    step_scalar(batch, lane, count);
+}
+
+/**
+ * Avanza los carriles con el mejor kernel disponible
+ */
+void game_batch_step(struct game_batch *batch, int count) {
+    game_batch_step_kernel(batch, count, game_kernel_best());
+}
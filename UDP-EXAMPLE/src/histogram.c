@@ -0,0 +1,104 @@
+#include "histogram.h"
+#include <string.h>
+
+/**
+ * Bucket de un valor: los primeros 2 * HIST_SUB_BUCKETS valores tienen
+ * bucket propio; por encima, cada potencia de 2 usa HIST_SUB_BUCKETS
+ */
+static int bucket_index(uint64_t value) {
+    int magnitude = 63 - __builtin_clzll(value | 1);
+    int shift = magnitude - HIST_SUB_BITS;
+    if (shift < 0) shift = 0;
+    
+    return (shift << HIST_SUB_BITS) + (int)(value >> shift);
+}
+
+/**
+ * Mayor valor que cae en un bucket
+ */
+static uint64_t bucket_highest(int index) {
+    int shift = (index >> HIST_SUB_BITS) - 1;
+    if (shift < 0) shift = 0;
+    
+    uint64_t lowest = (uint64_t)(index - (shift << HIST_SUB_BITS)) << shift;
+    return lowest + (1ULL << shift) - 1;
+}
+
+/**
+ * Deja el histograma vacío
+ */
+void histogram_init(struct histogram *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+/**
+ * Registra un valor (se recorta a HIST_MAX_VALUE)
+ */
+void histogram_record(struct histogram *h, uint64_t value) {
+    if (value > HIST_MAX_VALUE) value = HIST_MAX_VALUE;
+    
+    h->buckets[bucket_index(value)]++;
+    if (h->count == 0 || value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    h->count++;
+    h->sum += value;
+}
+
+/**
+ * Suma los registros de src a dst
+ */
+void histogram_merge(struct histogram *dst, const struct histogram *src) {
+    if (src->count == 0) return;
+    
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    if (dst->count == 0 || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+    dst->sum += src->sum;
+}
+
+/**
+ * Valor bajo el cual cae el percentil indicado
+ */
+uint64_t histogram_percentile(const struct histogram *h, double percentile) {
+    if (h->count == 0) return 0;
+    
+    // Posición (1..count) del valor buscado
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > h->count) rank = h->count;
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            // El bucket puede cubrir más allá del máximo real
+            uint64_t value = bucket_highest(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Cantidad de valores registrados que no superan value
+ */
+uint64_t histogram_count_below(const struct histogram *h, uint64_t value) {
+    if (value > HIST_MAX_VALUE) return h->count;
+    
+    uint64_t count = 0;
+    int last = bucket_index(value);
+    for (int i = 0; i <= last; i++) {
+        count += h->buckets[i];
+    }
+    return count;
+}
+
+/**
+ * Media exacta de los valores registrados
+ */
+double histogram_mean(const struct histogram *h) {
+    return h->count ? (double)h->sum / h->count : 0.0;
+}
@@ -0,0 +1,149 @@
+#include "input.h"
+#include <string.h>
+
+/**
+ * Deja el buffer vacío
+ */
+void input_buffer_init(struct input_buffer *buf) {
+    memset(buf, 0, sizeof(*buf));
+    buf->window_min = UINT16_MAX;
+}
+
+/**
+ * Avanza lo aplicado hasta target sin aplicar nada: lo que estaba
+ * esperando se descarta y lo que falta se da por perdido
+ */
+static void skip_to(struct input_buffer *buf, struct input_stats *stats, uint16_t target) {
+    uint16_t gap = (uint16_t)(target - buf->applied);
+    
+    if (gap > INPUT_BUFFER) {
+        // Más de un buffer: todo lo guardado queda atrás
+        uint32_t pending = 0;
+        for (int i = 0; i < INPUT_BUFFER; i++) {
+            pending += buf->present[i];
+        }
+        memset(buf->present, 0, sizeof(buf->present));
+        stats->trimmed += pending;
+        stats->lost += gap - pending;
+        buf->applied = target;
+        return;
+    }
+    
+    while (buf->applied != target) {
+        uint16_t seq = ++buf->applied;
+        uint16_t slot = seq & (INPUT_BUFFER - 1);
+        if (buf->present[slot] && buf->seqs[slot] == seq) {
+            buf->present[slot] = 0;
+            stats->trimmed++;
+        } else {
+            stats->lost++;
+        }
+    }
+}
+
+/**
+ * Guarda un input si todavía no se aplicó
+ * @return 1 si es nuevo
+ */
+static int store(struct input_buffer *buf, struct input_stats *stats, uint16_t seq,
+                 int8_t action, int redundant) {
+    int16_t ahead = (int16_t)(seq - buf->applied);
+    if (ahead <= 0) {
+        return 0;
+    }
+    
+    // Demasiado adelante (el jugador estuvo sin enviar): dejarle lugar
+    if (ahead >= INPUT_BUFFER) {
+        skip_to(buf, stats, (uint16_t)(seq - INPUT_BUFFER + 1));
+    }
+    
+    uint16_t slot = seq & (INPUT_BUFFER - 1);
+    int fresh = !buf->present[slot] || buf->seqs[slot] != seq;
+    buf->actions[slot] = action;
+    buf->seqs[slot] = seq;
+    buf->present[slot] = 1;
+    if (fresh && redundant) {
+        stats->recovered++;
+    }
+    return fresh;
+}
+
+/**
+ * Guarda el input de un paquete y su historial
+ */
+int input_buffer_receive(struct input_buffer *buf, struct input_stats *stats, uint16_t seq,
+                         int8_t action, uint16_t history) {
+    int stored = 0;
+    
+    // El primer input fija el punto de partida (lo anterior ya no sirve)
+    if (!buf->started) {
+        buf->started = 1;
+        buf->applied = (uint16_t)(seq - 1);
+        buf->newest = buf->applied;
+    }
+    
+    // Del más viejo al más nuevo: si hay que hacer lugar, que sea una vez
+    for (int age = INPUT_REDUNDANCY; age >= 1; age--) {
+        int8_t old_action;
+        if (input_history_get(history, age, &old_action) == 0) {
+            stored += store(buf, stats, (uint16_t)(seq - age), old_action, 1);
+        }
+    }
+    stored += store(buf, stats, seq, action, 0);
+    
+    if ((int16_t)(seq - buf->newest) > 0) {
+        buf->newest = seq;
+    }
+    return stored;
+}
+
+/**
+ * Saca el input que le toca al tick
+ */
+int input_buffer_next(struct input_buffer *buf, struct input_stats *stats, int8_t *action) {
+    if (!buf->started) {
+        return 0;
+    }
+    
+    int16_t pending = (int16_t)(buf->newest - buf->applied);
+    if (pending < 0) {
+        pending = 0;
+    }
+    
+    // Espera que sobró toda la ventana: descartar un frame
+    if ((uint16_t)pending < buf->window_min) {
+        buf->window_min = (uint16_t)pending;
+    }
+    if (++buf->window_ticks >= INPUT_TRIM_WINDOW) {
+        if (buf->window_min > 1) {
+            skip_to(buf, stats, (uint16_t)(buf->applied + 1));
+            pending--;
+        }
+        buf->window_ticks = 0;
+        buf->window_min = UINT16_MAX;
+    }
+    
+    if (pending == 0) {
+        stats->starved++;
+        return 0;
+    }
+    
+    // Acotar la espera: un input que espera más suma latencia a todos los siguientes
+    if (pending > INPUT_MAX_BACKLOG) {
+        skip_to(buf, stats, (uint16_t)(buf->newest - INPUT_MAX_BACKLOG));
+    }
+    
+    // El siguiente por secuencia; si falta y ya llegó uno posterior, ni la
+    // redundancia lo trajo
+    while (buf->applied != buf->newest) {
+        uint16_t seq = ++buf->applied;
+        uint16_t slot = seq & (INPUT_BUFFER - 1);
+        if (buf->present[slot] && buf->seqs[slot] == seq) {
+            buf->present[slot] = 0;
+            *action = buf->actions[slot];
+            return 1;
+        }
+        stats->lost++;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include "interp.h"
+#include "protocol.h"
+#include "utils.h"
+#include <string.h>
+#include <math.h>
+
+// Saltos mayores a esto (p. ej. la pelota vuelve al centro tras un gol)
+// no se interpolan: se muestra directamente el snapshot nuevo
+#define TELEPORT_DISTANCE (FIELD_WIDTH / 4.0f)
+
+/**
+ * Inicializa el buffer vacío
+ */
+void interp_init(struct interp_buffer *ib, int tick_rate) {
+    memset(ib, 0, sizeof(*ib));
+    ib->tick_ms = 1000.0 / tick_rate;
+    ib->gap_ms = ib->tick_ms;
+    ib->delay_ms = 2 * INTERP_MIN_DELAY_MS;
+}
+
+/**
+ * Agrega un snapshot recibido
+ */
+int interp_push(struct interp_buffer *ib, const struct interp_sample *sample, double now_ms) {
+    // Desordenado o duplicado: el estado ya avanzó
+    if (ib->count > 0 && (int32_t)(sample->tick - ib->newest_tick) <= 0) {
+        ib->dropped++;
+        return 0;
+    }
+    
+    // Separación con el anterior: los ticks que el servidor no envió o se perdieron
+    if (ib->count > 0) {
+        double gap = (sample->tick - ib->newest_tick) * ib->tick_ms;
+        ib->gap_ms += (gap - ib->gap_ms) / 8.0;
+    }
+    
+    ib->samples[sample->tick % INTERP_BUFFER] = *sample;
+    ib->newest_tick = sample->tick;
+    
+    // Tránsito = llegada local - tiempo del servidor (incluye el desfase de relojes)
+    double transit = now_ms - sample->tick * ib->tick_ms;
+    
+    if (ib->count == 0) {
+        ib->base_transit_ms = transit;
+    } else {
+        // Jitter según RFC 3550: J += (|D| - J) / 16
+        double d = fabs(transit - ib->last_transit_ms);
+        ib->jitter_ms += (d - ib->jitter_ms) / 16.0;
+        
+        // La base sigue al paquete más rápido; sube muy lento para acompañar
+        // la deriva entre relojes
+        if (transit < ib->base_transit_ms) {
+            ib->base_transit_ms = transit;
+        } else {
+            ib->base_transit_ms += (transit - ib->base_transit_ms) / 512.0;
+        }
+    }
+    ib->last_transit_ms = transit;
+    ib->count++;
+    
+    // Retardo objetivo: un frame (o lo que separa a los snapshots, si es
+    // más) más margen para el jitter, suavizado
+    double spacing = ib->gap_ms > INTERP_MIN_DELAY_MS ? ib->gap_ms : INTERP_MIN_DELAY_MS;
+    double target = spacing + 3.0 * ib->jitter_ms;
+    if (target > INTERP_MAX_DELAY_MS) target = INTERP_MAX_DELAY_MS;
+    ib->delay_ms += (target - ib->delay_ms) * 0.05;
+    
+    return 1;
+}
+
+/**
+ * Busca el snapshot de un tick concreto en el buffer
+ */
+static const struct interp_sample *find_sample(const struct interp_buffer *ib, uint32_t tick) {
+    const struct interp_sample *s = &ib->samples[tick % INTERP_BUFFER];
+    return s->tick == tick ? s : NULL;
+}
+
+/**
+ * Snapshot más nuevo anterior a un tick (puede haber ticks sin snapshot)
+ */
+static const struct interp_sample *find_before(const struct interp_buffer *ib, uint32_t tick) {
+    for (uint32_t i = 1; i < INTERP_BUFFER; i++) {
+        const struct interp_sample *s = find_sample(ib, tick - i);
+        if (s != NULL) return s;
+    }
+    return NULL;
+}
+
+static float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+/**
+ * Interpola posición a posición; los saltos grandes no se suavizan
+ */
+static void blend(const struct interp_sample *a, const struct interp_sample *b, float t,
+                  struct interp_sample *out) {
+    out->paddle1_y = lerp(a->paddle1_y, b->paddle1_y, t);
+    out->paddle2_y = lerp(a->paddle2_y, b->paddle2_y, t);
+    
+    if (fabsf(b->ball_x - a->ball_x) > TELEPORT_DISTANCE) {
+        out->ball_x = b->ball_x;
+        out->ball_y = b->ball_y;
+    } else {
+        out->ball_x = lerp(a->ball_x, b->ball_x, t);
+        out->ball_y = lerp(a->ball_y, b->ball_y, t);
+    }
+}
+
+/**
+ * Calcula el estado a mostrar en el instante local now_ms
+ */
+int interp_sample_at(struct interp_buffer *ib, double now_ms, struct interp_sample *out) {
+    if (ib->count == 0) return INTERP_NONE;
+    
+    const struct interp_sample *newest = find_sample(ib, ib->newest_tick);
+    
+    // Instante a reproducir, expresado en ticks del servidor
+    double render_ticks = (now_ms - ib->base_transit_ms - ib->delay_ms) / ib->tick_ms;
+    double newest_ticks = (double)ib->newest_tick;
+    if (render_ticks < 0.0) render_ticks = 0.0;
+    
+    if (render_ticks >= newest_ticks) {
+        // Sin snapshot posterior: extrapolar poco tiempo con la última velocidad
+        double ahead_ms = (render_ticks - newest_ticks) * ib->tick_ms;
+        const struct interp_sample *prev = find_before(ib, ib->newest_tick);
+        
+        *out = *newest;
+        if (prev == NULL || ahead_ms > INTERP_MAX_EXTRAPOLATE_MS) {
+            return INTERP_HELD;
+        }
+        
+        // Velocidad por tick entre los dos últimos snapshots
+        float t = (float)((render_ticks - newest_ticks) / (double)(newest->tick - prev->tick));
+        if (fabsf(newest->ball_x - prev->ball_x) <= TELEPORT_DISTANCE) {
+            out->ball_x = clamp(newest->ball_x + (newest->ball_x - prev->ball_x) * t,
+                                0.0f, FIELD_WIDTH);
+            out->ball_y = clamp(newest->ball_y + (newest->ball_y - prev->ball_y) * t,
+                                0.0f, FIELD_HEIGHT);
+        }
+        return INTERP_EXTRAPOLATED;
+    }
+    
+    // Buscar el par de snapshots que rodea el instante (puede haber huecos)
+    uint32_t from_tick = (uint32_t)floor(render_ticks);
+    const struct interp_sample *a = NULL;
+    const struct interp_sample *b = NULL;
+    
+    for (uint32_t i = 0; i < INTERP_BUFFER && a == NULL; i++) {
+        a = find_sample(ib, from_tick - i);
+    }
+    for (uint32_t i = 1; i <= INTERP_BUFFER && b == NULL; i++) {
+        if ((int32_t)(from_tick + i - ib->newest_tick) > 0) break;
+        b = find_sample(ib, from_tick + i);
+    }
+    
+    if (a == NULL) {
+        // Demasiado atrás en el tiempo: mostrar lo más viejo disponible
+        *out = b ? *b : *newest;
+        return INTERP_INTERPOLATED;
+    }
+    if (b == NULL) {
+        *out = *a;
+        return INTERP_INTERPOLATED;
+    }
+    
+    float t = (float)((render_ticks - a->tick) / (double)(b->tick - a->tick));
+    out->tick = a->tick;
+    blend(a, b, t, out);
+    return INTERP_INTERPOLATED;
+}
@@ -0,0 +1,101 @@
+#include "lfqueue.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Número de secuencia al principio de cada celda
+ */
+static _Atomic uint64_t *cell_seq(const struct lf_queue *queue, uint64_t pos) {
+    return (_Atomic uint64_t *)(queue->cells + (pos & queue->mask) * queue->stride);
+}
+
+/**
+ * Reserva la cola
+ */
+int lf_queue_init(struct lf_queue *queue, uint32_t capacity, size_t elem_size) {
+    uint64_t cells = 2;
+    while (cells < capacity) {
+        cells <<= 1;
+    }
+    
+    // Secuencia + elemento, redondeado a 8 bytes para alinear la secuencia
+    queue->stride = (sizeof(uint64_t) + elem_size + 7) & ~(size_t)7;
+    queue->elem_size = elem_size;
+    queue->mask = cells - 1;
+    queue->cells = aligned_alloc(64, (cells * queue->stride + 63) & ~(size_t)63);
+    if (queue->cells == NULL) {
+        return -1;
+    }
+    
+    // La celda i queda libre para la primera vuelta del productor
+    for (uint64_t i = 0; i < cells; i++) {
+        atomic_init(cell_seq(queue, i), i);
+    }
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return 0;
+}
+
+/**
+ * Libera la cola
+ */
+void lf_queue_free(struct lf_queue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+/**
+ * Encola: reserva la posición de la cabeza con CAS si la celda ya quedó
+ * libre en la vuelta anterior, copia y la publica
+ */
+int lf_queue_push(struct lf_queue *queue, const void *elem) {
+    uint64_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    _Atomic uint64_t *seq;
+    
+    while (1) {
+        seq = cell_seq(queue, pos);
+        int64_t dif = (int64_t)(atomic_load_explicit(seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return -1; // Llena: la celda todavía no se consumió
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+    
+    memcpy((unsigned char *)seq + sizeof(uint64_t), elem, queue->elem_size);
+    atomic_store_explicit(seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+/**
+ * Desencola: reserva la posición de la cola con CAS si la celda ya fue
+ * publicada, copia y la deja libre para la vuelta siguiente
+ */
+int lf_queue_pop(struct lf_queue *queue, void *elem) {
+    uint64_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    _Atomic uint64_t *seq;
+    
+    while (1) {
+        seq = cell_seq(queue, pos);
+        int64_t dif = (int64_t)(atomic_load_explicit(seq, memory_order_acquire) - (pos + 1));
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return -1; // Vacía
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    
+    memcpy(elem, (unsigned char *)seq + sizeof(uint64_t), queue->elem_size);
+    atomic_store_explicit(seq, pos + queue->mask + 1, memory_order_release);
+    return 0;
+}
@@ -0,0 +1,979 @@
+#define _GNU_SOURCE
+#include "log.h"
+#include "lfqueue.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LOG_OUT_BUFFER 65536
+#define LOG_CACHE_SLOTS 64         // Formatos recordados por hilo
+#define LOG_FORMAT_SLOTS (2 * LOG_MAX_FORMATS)
+#define LOG_MAX_FETCH (2 * LOG_MAX_ARGS)
+#define LOG_BIN_EVENT_SIZE 14      // Tipo, hora, nivel, hilo, id, nargs
+
+// Cómo sacar cada argumento del va_list (depende de la conversión y el largo)
+#define FETCH_INT 0
+#define FETCH_SCHAR 1
+#define FETCH_SHORT 2
+#define FETCH_LONG 3
+#define FETCH_LLONG 4
+#define FETCH_SSIZE 5
+#define FETCH_INTMAX 6
+#define FETCH_PTRDIFF 7
+#define FETCH_UINT 8
+#define FETCH_UCHAR 9
+#define FETCH_USHORT 10
+#define FETCH_ULONG 11
+#define FETCH_ULLONG 12
+#define FETCH_SIZE 13
+#define FETCH_UINTMAX 14
+#define FETCH_CHAR 15
+#define FETCH_DOUBLE 16
+#define FETCH_LDOUBLE 17
+#define FETCH_STRING 18
+#define FETCH_PTR 19
+#define FETCH_STAR 20              // Ancho o precisión '*': se consume y no se guarda
+
+// Largos de conversión
+#define LEN_NONE 0
+#define LEN_HH 1
+#define LEN_H 2
+#define LEN_L 3
+#define LEN_LL 4
+#define LEN_Z 5
+#define LEN_J 6
+#define LEN_T 7
+#define LEN_LONG_DOUBLE 8
+
+/**
+ * Una conversión de un formato printf
+ */
+struct log_spec {
+    const char *start;             // El '%'
+    const char *end;               // Después de la conversión
+    char body[24];                 // Flags, ancho y precisión (sin '*')
+    int stars;
+    int length;                    // LEN_*
+    char conv;                     // '\0' si el formato termina en '%'
+};
+
+/**
+ * Cómo leer los argumentos de un formato (caché por hilo)
+ */
+struct log_format_info {
+    const char *format;
+    uint8_t truncated;             // Tiene más argumentos de los que se guardan
+    uint8_t nfetch;
+    uint8_t fetch[LOG_MAX_FETCH];
+};
+
+struct logger {
+    struct lf_queue queue;
+    int ready;                     // Hay cola (log_init)
+    int started;                   // Hay hilo escritor
+    int fd;
+    enum log_output output;
+    _Atomic int level;
+    _Atomic uint64_t dropped;
+    uint64_t dropped_reported;
+    _Atomic uint64_t truncated;
+    uint64_t truncated_reported;
+    pthread_t thread;
+    
+    // Del escritor
+    char out[LOG_OUT_BUFFER];
+    size_t out_used;
+    const char *format_keys[LOG_FORMAT_SLOTS];
+    uint16_t format_ids[LOG_FORMAT_SLOTS];
+    int num_formats;
+};
+
+static struct logger logger = {.level = LOG_LEVEL_INFO, .fd = STDOUT_FILENO};
+
+static _Thread_local struct log_format_info format_cache[LOG_CACHE_SLOTS];
+static _Thread_local int8_t log_thread = -1;
+
+static const char *level_names[] = {"debug", "info", "warn", "error"};
+static const char *level_tags[] = {"DEBUG ", "", "WARN ", "ERROR "};
+
+/**
+ * Escribe todo el buffer aunque write() lo haga en partes
+ * @return 0 si tuvo éxito, -1 en error
+ */
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Siguiente conversión a partir de p
+ * @return Puntero al '%' o NULL si no quedan
+ */
+static const char *next_spec(const char *p, struct log_spec *spec) {
+    p = strchr(p, '%');
+    if (p == NULL) {
+        return NULL;
+    }
+    spec->start = p++;
+    spec->stars = 0;
+    
+    size_t body = 0;
+    while (*p != '\0' && strchr("-+ #0'123456789.*", *p) != NULL) {
+        if (*p == '*') {
+            spec->stars++;
+        } else if (body < sizeof(spec->body) - 1) {
+            spec->body[body++] = *p;
+        }
+        p++;
+    }
+    spec->body[body] = '\0';
+    
+    spec->length = LEN_NONE;
+    if (p[0] == 'h' && p[1] == 'h') {
+        spec->length = LEN_HH;
+        p += 2;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        spec->length = LEN_LL;
+        p += 2;
+    } else if (*p == 'h') {
+        spec->length = LEN_H;
+        p++;
+    } else if (*p == 'l') {
+        spec->length = LEN_L;
+        p++;
+    } else if (*p == 'z') {
+        spec->length = LEN_Z;
+        p++;
+    } else if (*p == 'j') {
+        spec->length = LEN_J;
+        p++;
+    } else if (*p == 't') {
+        spec->length = LEN_T;
+        p++;
+    } else if (*p == 'L' || *p == 'q') {
+        spec->length = *p == 'L' ? LEN_LONG_DOUBLE : LEN_LL;
+        p++;
+    }
+    
+    spec->conv = *p;
+    spec->end = *p != '\0' ? p + 1 : p;
+    return spec->start;
+}
+
+/**
+ * Cómo leer el argumento de una conversión
+ * @return FETCH_* o -1 si no lleva argumento ("%%" o desconocida)
+ */
+static int spec_fetch(const struct log_spec *spec) {
+    static const int8_t signed_fetch[] = {FETCH_INT, FETCH_SCHAR, FETCH_SHORT, FETCH_LONG,
+                                          FETCH_LLONG, FETCH_SSIZE, FETCH_INTMAX, FETCH_PTRDIFF,
+                                          FETCH_INT};
+    static const int8_t unsigned_fetch[] = {FETCH_UINT, FETCH_UCHAR, FETCH_USHORT, FETCH_ULONG,
+                                            FETCH_ULLONG, FETCH_SIZE, FETCH_UINTMAX, FETCH_SIZE,
+                                            FETCH_UINT};
+    char c = spec->conv;
+    
+    if (c == 'd' || c == 'i') return signed_fetch[spec->length];
+    if (c == 'u' || c == 'o' || c == 'x' || c == 'X') return unsigned_fetch[spec->length];
+    if (c != '\0' && strchr("fFeEgGaA", c) != NULL) {
+        return spec->length == LEN_LONG_DOUBLE ? FETCH_LDOUBLE : FETCH_DOUBLE;
+    }
+    if (c == 's') return FETCH_STRING;
+    if (c == 'c') return FETCH_CHAR;
+    if (c == 'p') return FETCH_PTR;
+    return -1;
+}
+
+/**
+ * Analiza un formato: qué leer del va_list y en qué orden
+ */
+static void parse_format(const char *format, struct log_format_info *info) {
+    struct log_spec spec;
+    const char *p = format;
+    int stored = 0;
+    
+    info->format = format;
+    info->truncated = 0;
+    info->nfetch = 0;
+    while (next_spec(p, &spec) != NULL) {
+        p = spec.end;
+        int fetch = spec_fetch(&spec);
+        if (fetch < 0) continue;
+        
+        // No entra: esta conversión y las siguientes quedan sin argumento
+        if (stored == LOG_MAX_ARGS || info->nfetch + spec.stars >= LOG_MAX_FETCH) {
+            info->truncated = 1;
+            break;
+        }
+        for (int i = 0; i < spec.stars; i++) {
+            info->fetch[info->nfetch++] = FETCH_STAR;
+        }
+        info->fetch[info->nfetch++] = (uint8_t)fetch;
+        stored++;
+    }
+}
+
+/**
+ * Formato analizado, del caché del hilo
+ */
+static const struct log_format_info *format_info(const char *format) {
+    uint32_t slot = (uint32_t)(((uintptr_t)format * 0x9e3779b97f4a7c15ULL) >> 58);
+    struct log_format_info *info = &format_cache[slot];
+    if (info->format != format) {
+        parse_format(format, info);
+    }
+    return info;
+}
+
+/**
+ * Copia un %s al espacio de cadenas del registro (lo que no entra se corta)
+ */
+static void store_string(struct log_record *rec, union log_arg *arg, const char *s) {
+    if (s == NULL) s = "(null)";
+    size_t room = LOG_STRING_SPACE - rec->strings_used;
+    size_t len = strnlen(s, room);
+    memcpy(rec->strings + rec->strings_used, s, len);
+    arg->s.offset = rec->strings_used;
+    arg->s.len = (uint8_t)len;
+    rec->strings_used += (uint8_t)len;
+}
+
+/**
+ * Diferencia entre la hora Unix y el reloj monotónico (ns)
+ */
+static int64_t wall_offset_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t wall = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    return (int64_t)(wall - get_time_ns());
+}
+
+/**
+ * Mensaje armado en el acto (sin log_init)
+ */
+static void write_now(struct log_record *rec) {
+    char line[LOG_LINE_MAX];
+    rec->time_ns += (uint64_t)wall_offset_ns();
+    log_render(rec, LOG_OUTPUT_TEXT, line, sizeof(line));
+    fputs(line, stdout);
+    fflush(stdout);
+}
+
+/**
+ * Registra un mensaje
+ */
+void log_vwrite(enum log_level level, const char *format, va_list args) {
+    if ((int)level < atomic_load_explicit(&logger.level, memory_order_relaxed)) return;
+    
+    struct log_record rec;
+    rec.time_ns = get_time_ns();
+    rec.format = format;
+    rec.level = (uint8_t)level;
+    rec.thread = log_thread;
+    rec.strings_used = 0;
+    
+    const struct log_format_info *info = format_info(format);
+    int n = 0;
+    for (int i = 0; i < info->nfetch; i++) {
+        int fetch = info->fetch[i];
+        union log_arg *arg = &rec.args[n];
+        
+        // Los más comunes primero
+        if (fetch == FETCH_INT) {
+            arg->i = va_arg(args, int);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_UINT) {
+            arg->u = va_arg(args, unsigned int);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_DOUBLE) {
+            arg->d = va_arg(args, double);
+            rec.types[n++] = LOG_ARG_DOUBLE;
+        } else if (fetch == FETCH_STRING) {
+            store_string(&rec, arg, va_arg(args, const char *));
+            rec.types[n++] = LOG_ARG_STRING;
+        } else if (fetch == FETCH_ULLONG) {
+            arg->u = va_arg(args, unsigned long long);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_LLONG) {
+            arg->i = va_arg(args, long long);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_ULONG) {
+            arg->u = va_arg(args, unsigned long);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_LONG) {
+            arg->i = va_arg(args, long);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_SIZE) {
+            arg->u = va_arg(args, size_t);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_SSIZE) {
+            arg->i = va_arg(args, ssize_t);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_SCHAR) {
+            arg->i = (signed char)va_arg(args, int);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_SHORT) {
+            arg->i = (short)va_arg(args, int);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_UCHAR) {
+            arg->u = (unsigned char)va_arg(args, unsigned int);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_USHORT) {
+            arg->u = (unsigned short)va_arg(args, unsigned int);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_INTMAX) {
+            arg->i = va_arg(args, intmax_t);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_PTRDIFF) {
+            arg->i = va_arg(args, ptrdiff_t);
+            rec.types[n++] = LOG_ARG_INT;
+        } else if (fetch == FETCH_UINTMAX) {
+            arg->u = va_arg(args, uintmax_t);
+            rec.types[n++] = LOG_ARG_UINT;
+        } else if (fetch == FETCH_CHAR) {
+            arg->i = va_arg(args, int);
+            rec.types[n++] = LOG_ARG_CHAR;
+        } else if (fetch == FETCH_LDOUBLE) {
+            arg->d = (double)va_arg(args, long double);
+            rec.types[n++] = LOG_ARG_DOUBLE;
+        } else if (fetch == FETCH_PTR) {
+            arg->u = (uintptr_t)va_arg(args, void *);
+            rec.types[n++] = LOG_ARG_PTR;
+        } else {
+            (void)va_arg(args, int);  // FETCH_STAR
+        }
+    }
+    rec.nargs = (uint8_t)n;
+    if (info->truncated) {
+        atomic_fetch_add_explicit(&logger.truncated, 1, memory_order_relaxed);
+    }
+    
+    if (!logger.ready) {
+        write_now(&rec);
+        return;
+    }
+    if (lf_queue_push(&logger.queue, &rec) < 0) {
+        atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * Registra un mensaje del nivel indicado
+ */
+void log_write(enum log_level level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(level, format, args);
+    va_end(args);
+}
+
+void log_debug(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_DEBUG, format, args);
+    va_end(args);
+}
+
+void log_msg(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_INFO, format, args);
+    va_end(args);
+}
+
+void log_warn(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_WARN, format, args);
+    va_end(args);
+}
+
+void log_error(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(LOG_LEVEL_ERROR, format, args);
+    va_end(args);
+}
+
+/**
+ * Línea en construcción; siempre deja lugar para el '\n' y el '\0'
+ */
+struct line {
+    char *buf;
+    size_t size;
+    size_t used;
+};
+
+static void line_append(struct line *line, const char *text, size_t len) {
+    size_t room = line->size - 2 - line->used;
+    if (len > room) len = room;
+    memcpy(line->buf + line->used, text, len);
+    line->used += len;
+}
+
+static void line_printf(struct line *line, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void line_printf(struct line *line, const char *format, ...) {
+    size_t room = line->size - 1 - line->used;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line->buf + line->used, room, format, args);
+    va_end(args);
+    
+    if (n < 0) return;
+    line->used += (size_t)n < room - 1 ? (size_t)n : room - 1;
+}
+
+/**
+ * Agrega un texto escapado para JSON (sin comillas)
+ */
+static void line_json_string(struct line *line, const char *text, size_t len) {
+    for (size_t i = 0; i < len && line->used < line->size - 2; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            char esc[2] = {'\\', (char)c};
+            line_append(line, esc, 2);
+        } else if (c < 0x20) {
+            line_printf(line, "\\u%04x", c);
+        } else {
+            line->buf[line->used++] = (char)c;
+        }
+    }
+}
+
+/**
+ * Una conversión con su argumento guardado. Arma el formato de nuevo con
+ * el largo del tipo guardado (ll para enteros, nada para double).
+ */
+static void render_arg(struct line *line, const struct log_record *rec, const struct log_spec *spec,
+                       int i) {
+    char fmt[40];
+    const union log_arg *arg = &rec->args[i];
+    uint8_t type = rec->types[i];
+    char conv = spec->conv;
+    
+    if (type == LOG_ARG_INT) {
+        snprintf(fmt, sizeof(fmt), "%%%sll%c", spec->body, conv == 'i' ? 'i' : 'd');
+        line_printf(line, fmt, (long long)arg->i);
+    } else if (type == LOG_ARG_UINT) {
+        if (conv != 'o' && conv != 'x' && conv != 'X') conv = 'u';
+        snprintf(fmt, sizeof(fmt), "%%%sll%c", spec->body, conv);
+        line_printf(line, fmt, (unsigned long long)arg->u);
+    } else if (type == LOG_ARG_DOUBLE) {
+        if (conv == '\0' || strchr("fFeEgGaA", conv) == NULL) conv = 'g';
+        snprintf(fmt, sizeof(fmt), "%%%s%c", spec->body, conv);
+        line_printf(line, fmt, arg->d);
+    } else if (type == LOG_ARG_STRING) {
+        char text[LOG_STRING_SPACE + 1];
+        size_t len = arg->s.len;
+        if (arg->s.offset + len > LOG_STRING_SPACE) len = 0;
+        memcpy(text, rec->strings + arg->s.offset, len);
+        text[len] = '\0';
+        snprintf(fmt, sizeof(fmt), "%%%ss", spec->body);
+        line_printf(line, fmt, text);
+    } else if (type == LOG_ARG_CHAR) {
+        snprintf(fmt, sizeof(fmt), "%%%sc", spec->body);
+        line_printf(line, fmt, (int)arg->i);
+    } else {
+        snprintf(fmt, sizeof(fmt), "%%%sp", spec->body);
+        line_printf(line, fmt, (void *)(uintptr_t)arg->u);
+    }
+}
+
+/**
+ * El mensaje formateado (sin '\n')
+ */
+static void render_message(struct line *line, const struct log_record *rec) {
+    struct log_spec spec;
+    const char *p = rec->format;
+    int i = 0;
+    
+    while (next_spec(p, &spec) != NULL) {
+        line_append(line, p, (size_t)(spec.start - p));
+        p = spec.end;
+        if (spec.conv == '%') {
+            line_append(line, "%", 1);
+        } else if (spec_fetch(&spec) < 0 || i >= rec->nargs) {
+            line_append(line, spec.start, (size_t)(spec.end - spec.start));
+        } else {
+            render_arg(line, rec, &spec, i++);
+        }
+    }
+    line_append(line, p, strlen(p));
+}
+
+/**
+ * Argumentos como arreglo JSON
+ */
+static void render_json_args(struct line *line, const struct log_record *rec) {
+    line_append(line, "[", 1);
+    for (int i = 0; i < rec->nargs; i++) {
+        const union log_arg *arg = &rec->args[i];
+        uint8_t type = rec->types[i];
+        if (i > 0) line_append(line, ",", 1);
+        
+        if (type == LOG_ARG_INT || type == LOG_ARG_CHAR) {
+            line_printf(line, "%lld", (long long)arg->i);
+        } else if (type == LOG_ARG_UINT) {
+            line_printf(line, "%llu", (unsigned long long)arg->u);
+        } else if (type == LOG_ARG_DOUBLE) {
+            // NaN e infinito no existen en JSON
+            if (arg->d != arg->d || arg->d > 1e308 || arg->d < -1e308) {
+                line_append(line, "null", 4);
+            } else {
+                line_printf(line, "%.15g", arg->d);
+            }
+        } else if (type == LOG_ARG_STRING) {
+            size_t len = arg->s.len;
+            if (arg->s.offset + len > LOG_STRING_SPACE) len = 0;
+            line_append(line, "\"", 1);
+            line_json_string(line, rec->strings + arg->s.offset, len);
+            line_append(line, "\"", 1);
+        } else {
+            line_printf(line, "\"0x%llx\"", (unsigned long long)arg->u);
+        }
+    }
+    line_append(line, "]", 1);
+}
+
+/**
+ * Arma la línea de un mensaje
+ */
+size_t log_render(const struct log_record *rec, enum log_output output, char *out, size_t size) {
+    struct line line = {out, size, 0};
+    time_t secs = (time_t)(rec->time_ns / 1000000000ULL);
+    int level = rec->level <= LOG_LEVEL_ERROR ? rec->level : LOG_LEVEL_ERROR;
+    struct tm t;
+    
+    if (output == LOG_OUTPUT_JSON) {
+        gmtime_r(&secs, &t);
+        line_printf(&line, "{\"ts\":\"%04d-%02d-%02dT%02d:%02d:%02d.%03dZ\",\"level\":\"%s\"",
+                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+                    (int)(rec->time_ns / 1000000ULL % 1000), level_names[level]);
+        if (rec->thread >= 0) {
+            line_printf(&line, ",\"thread\":%d", rec->thread);
+        }
+            
+        // El mensaje se arma aparte para escaparlo
+        char msg[LOG_LINE_MAX];
+        struct line text = {msg, sizeof(msg), 0};
+        render_message(&text, rec);
+        line_append(&line, ",\"msg\":\"", 8);
+        line_json_string(&line, msg, text.used);
+        line_append(&line, "\",\"fmt\":\"", 9);
+        line_json_string(&line, rec->format, strlen(rec->format));
+        line_append(&line, "\",\"args\":", 9);
+        render_json_args(&line, rec);
+        line_append(&line, "}", 1);
+    } else {
+        localtime_r(&secs, &t);
+        line_printf(&line, "[%02d:%02d:%02d] %s", t.tm_hour, t.tm_min, t.tm_sec, level_tags[level]);
+        render_message(&line, rec);
+    }
+    
+    line.buf[line.used++] = '\n';
+    line.buf[line.used] = '\0';
+    return line.used;
+}
+
+/**
+ * Escribe lo acumulado por el escritor
+ */
+static void flush_out(void) {
+    if (logger.out_used == 0) return;
+    if (write_all(logger.fd, logger.out, logger.out_used) < 0) {
+        perror("Error al escribir el log");
+    }
+    logger.out_used = 0;
+}
+
+static void out_bytes(const void *data, size_t len) {
+    memcpy(logger.out + logger.out_used, data, len);
+    logger.out_used += len;
+}
+
+/**
+ * Id del formato en la salida binaria; la primera vez lo escribe
+ * @return Id o -1 si ya no entran más formatos
+ */
+static int binary_format_id(const char *format) {
+    uint32_t i = (uint32_t)(((uintptr_t)format * 0x9e3779b97f4a7c15ULL) >> 51);
+    while (logger.format_keys[i] != NULL) {
+        if (logger.format_keys[i] == format) {
+            return logger.format_ids[i];
+        }
+        i = (i + 1) & (LOG_FORMAT_SLOTS - 1);
+    }
+    if (logger.num_formats >= LOG_MAX_FORMATS) {
+        return -1;
+    }
+    
+    uint16_t id = (uint16_t)logger.num_formats++;
+    logger.format_keys[i] = format;
+    logger.format_ids[i] = id;
+    
+    size_t len = strlen(format);
+    if (len > LOG_LINE_MAX) len = LOG_LINE_MAX;
+    uint8_t kind = LOG_BIN_FORMAT;
+    uint16_t len16 = (uint16_t)len;
+    out_bytes(&kind, 1);
+    out_bytes(&id, 2);
+    out_bytes(&len16, 2);
+    out_bytes(format, len);
+    return id;
+}
+
+/**
+ * Registro en binario
+ */
+static void write_binary(const struct log_record *rec) {
+    int id = binary_format_id(rec->format);
+    if (id < 0) {
+        atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    
+    uint8_t head[LOG_BIN_EVENT_SIZE];
+    uint16_t id16 = (uint16_t)id;
+    head[0] = LOG_BIN_EVENT;
+    memcpy(head + 1, &rec->time_ns, 8);
+    head[9] = rec->level;
+    head[10] = (uint8_t)rec->thread;
+    memcpy(head + 11, &id16, 2);
+    head[13] = rec->nargs;
+    out_bytes(head, sizeof(head));
+    
+    for (int i = 0; i < rec->nargs; i++) {
+        out_bytes(&rec->types[i], 1);
+        if (rec->types[i] == LOG_ARG_STRING) {
+            out_bytes(&rec->args[i].s.len, 1);
+            out_bytes(rec->strings + rec->args[i].s.offset, rec->args[i].s.len);
+        } else {
+            out_bytes(&rec->args[i], 8);
+        }
+    }
+}
+
+/**
+ * Agrega un registro (ya en hora Unix) a la salida del escritor
+ */
+static void write_record(const struct log_record *rec) {
+    // Un formato nuevo más el registro entran siempre en 2 líneas máximas
+    if (logger.out_used + 2 * LOG_LINE_MAX + 64 > sizeof(logger.out)) {
+        flush_out();
+    }
+    
+    if (logger.output == LOG_OUTPUT_BINARY) {
+        write_binary(rec);
+    } else {
+        logger.out_used += log_render(rec, logger.output, logger.out + logger.out_used,
+                                      sizeof(logger.out) - logger.out_used);
+    }
+}
+
+/**
+ * Escribe un aviso del propio log con una cantidad
+ */
+static void write_note(const char *format, uint64_t count, int64_t offset) {
+    struct log_record note;
+    note.time_ns = get_time_ns() + (uint64_t)offset;
+    note.format = format;
+    note.level = LOG_LEVEL_WARN;
+    note.thread = -1;
+    note.nargs = 1;
+    note.strings_used = 0;
+    note.types[0] = LOG_ARG_UINT;
+    note.args[0].u = count;
+    write_record(&note);
+}
+
+/**
+ * Saca, formatea y escribe lo pendiente
+ */
+int log_drain(void) {
+    if (!logger.ready) return 0;
+    
+    struct log_record rec;
+    int64_t offset = wall_offset_ns();
+    int count = 0;
+    
+    while (lf_queue_pop(&logger.queue, &rec) == 0) {
+        rec.time_ns += (uint64_t)offset;
+        write_record(&rec);
+        count++;
+    }
+    
+    // Avisar en el mismo log cuántos se perdieron o salieron incompletos
+    uint64_t dropped = atomic_load_explicit(&logger.dropped, memory_order_relaxed);
+    if (dropped != logger.dropped_reported) {
+        write_note("📝 %llu mensajes de log descartados (cola llena)",
+                   dropped - logger.dropped_reported, offset);
+        logger.dropped_reported = dropped;
+    }
+    uint64_t truncated = atomic_load_explicit(&logger.truncated, memory_order_relaxed);
+    if (truncated != logger.truncated_reported) {
+        write_note("📝 %llu mensajes de log con más argumentos de los que se guardan "
+                   "(los que sobran salen sin reemplazar)",
+                   truncated - logger.truncated_reported, offset);
+        logger.truncated_reported = truncated;
+    }
+    
+    flush_out();
+    return count;
+}
+
+/**
+ * Vacía la cola sin escribir
+ */
+int log_discard(void) {
+    if (!logger.ready) return 0;
+    
+    struct log_record rec;
+    int count = 0;
+    while (lf_queue_pop(&logger.queue, &rec) == 0) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Hilo escritor: vacía la cola y duerme un rato cuando no hay nada
+ */
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec pause = {0, LOG_POLL_MS * 1000000L};
+    
+    for (;;) {
+        if (log_drain() == 0) {
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Prepara la cola y el destino
+ */
+int log_init(enum log_level level, enum log_output output, int fd) {
+    if (logger.started) {
+        return -1;
+    }
+    if (logger.ready) {
+        lf_queue_free(&logger.queue);
+        logger.ready = 0;
+    }
+    
+    atomic_store(&logger.level, level);
+    atomic_store(&logger.dropped, 0);
+    logger.dropped_reported = 0;
+    atomic_store(&logger.truncated, 0);
+    logger.truncated_reported = 0;
+    logger.output = output;
+    logger.fd = fd;
+    logger.out_used = 0;
+    logger.num_formats = 0;
+    memset(logger.format_keys, 0, sizeof(logger.format_keys));
+    
+    if (output == LOG_OUTPUT_BINARY) {
+        struct log_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC));
+        header.version = LOG_VERSION;
+        header.pid = (uint32_t)getpid();
+        header.start_ms = ((uint64_t)wall_offset_ns() + get_time_ns()) / 1000000ULL;
+        if (write_all(fd, &header, sizeof(header)) < 0) {
+            return -1;
+        }
+    }
+    
+    if (lf_queue_init(&logger.queue, LOG_QUEUE_CAPACITY, sizeof(struct log_record)) < 0) {
+        return -1;
+    }
+    logger.ready = 1;
+    return 0;
+}
+
+/**
+ * Arranca el hilo escritor
+ */
+int log_start(void) {
+    if (!logger.ready || logger.started) {
+        return -1;
+    }
+    if (pthread_create(&logger.thread, NULL, writer_main, NULL) != 0) {
+        return -1;
+    }
+    pthread_detach(logger.thread);
+    logger.started = 1;
+    return 0;
+}
+
+/**
+ * Cambia el nivel mínimo
+ */
+void log_set_level(enum log_level level) {
+    atomic_store_explicit(&logger.level, level, memory_order_relaxed);
+}
+
+/**
+ * Identifica al hilo actual
+ */
+void log_set_thread(int id) {
+    log_thread = (int8_t)id;
+}
+
+/**
+ * Mensajes descartados
+ */
+uint64_t log_dropped(void) {
+    return atomic_load_explicit(&logger.dropped, memory_order_relaxed);
+}
+
+/**
+ * Mensajes con argumentos de más
+ */
+uint64_t log_truncated(void) {
+    return atomic_load_explicit(&logger.truncated, memory_order_relaxed);
+}
+
+/**
+ * Nombre de nivel -> nivel
+ */
+int log_parse_level(const char *name, enum log_level *level) {
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_ERROR; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = (enum log_level)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Nombre de salida -> salida
+ */
+int log_parse_output(const char *name, enum log_output *output) {
+    if (strcmp(name, "text") == 0) {
+        *output = LOG_OUTPUT_TEXT;
+    } else if (strcmp(name, "json") == 0) {
+        *output = LOG_OUTPUT_JSON;
+    } else if (strcmp(name, "bin") == 0) {
+        *output = LOG_OUTPUT_BINARY;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Abre un archivo binario en memoria
+ */
+int log_reader_init(struct log_reader *reader, const uint8_t *data, size_t len) {
+    memset(reader, 0, sizeof(*reader));
+    
+    struct log_header header;
+    if (len < sizeof(header)) {
+        return -1;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || header.version != LOG_VERSION) {
+        return -1;
+    }
+    
+    reader->data = data;
+    reader->len = len;
+    reader->offset = sizeof(header);
+    return 0;
+}
+
+/**
+ * Siguiente mensaje
+ */
+int log_reader_next(struct log_reader *reader, struct log_record *rec) {
+    const uint8_t *data = reader->data;
+    
+    while (reader->offset < reader->len) {
+        size_t pos = reader->offset;
+        size_t left = reader->len - pos;
+        
+        if (data[pos] == LOG_BIN_FORMAT) {
+            uint16_t id, len;
+            if (left < 5) return 0;
+            memcpy(&id, data + pos + 1, 2);
+            memcpy(&len, data + pos + 3, 2);
+            if (left < 5 + (size_t)len) return 0;  // Cortado a la mitad
+            if (id >= LOG_MAX_FORMATS) return -1;
+            
+            free(reader->formats[id]);
+            reader->formats[id] = strndup((const char *)data + pos + 5, len);
+            reader->offset += 5 + (size_t)len;
+            continue;
+        }
+        if (data[pos] != LOG_BIN_EVENT) {
+            return -1;
+        }
+        
+        if (left < LOG_BIN_EVENT_SIZE) return 0;
+        uint16_t id;
+        memcpy(&rec->time_ns, data + pos + 1, 8);
+        rec->level = data[pos + 9];
+        rec->thread = (int8_t)data[pos + 10];
+        memcpy(&id, data + pos + 11, 2);
+        rec->nargs = data[pos + 13];
+        rec->strings_used = 0;
+        if (id >= LOG_MAX_FORMATS || reader->formats[id] == NULL || rec->nargs > LOG_MAX_ARGS) {
+            return -1;
+        }
+        rec->format = reader->formats[id];
+        
+        pos += LOG_BIN_EVENT_SIZE;
+        for (int i = 0; i < rec->nargs; i++) {
+            if (pos + 2 > reader->len) return 0;
+            uint8_t type = data[pos++];
+            rec->types[i] = type;
+            if (type == LOG_ARG_STRING) {
+                uint8_t len = data[pos++];
+                if (pos + len > reader->len) return 0;
+                if (rec->strings_used + len > LOG_STRING_SPACE) return -1;
+                memcpy(rec->strings + rec->strings_used, data + pos, len);
+                rec->args[i].s.offset = rec->strings_used;
+                rec->args[i].s.len = len;
+                rec->strings_used += len;
+                pos += len;
+            } else if (type >= LOG_ARG_INT && type <= LOG_ARG_PTR) {
+                if (pos + 8 > reader->len) return 0;
+                memcpy(&rec->args[i], data + pos, 8);
+                pos += 8;
+            } else {
+                return -1;
+            }
+        }
+        reader->offset = pos;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Libera los formatos del lector
+ */
+void log_reader_free(struct log_reader *reader) {
+    for (int i = 0; i < LOG_MAX_FORMATS; i++) {
+        free(reader->formats[i]);
+        reader->formats[i] = NULL;
+    }
+}
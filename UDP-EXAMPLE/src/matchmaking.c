@@ -0,0 +1,80 @@
+#include "matchmaking.h"
+
+/**
+ * Reserva las colas
+ */
+int match_queue_init(struct match_queue *mq, uint32_t bucket_ms, uint32_t capacity) {
+    mq->bucket_ms = bucket_ms;
+    mq->num_buckets = bucket_ms == 0 ? 1 : MATCH_BUCKETS;
+    
+    for (int i = 0; i < mq->num_buckets; i++) {
+        if (lf_queue_init(&mq->buckets[i], capacity, sizeof(struct match_ticket)) < 0) {
+            while (--i >= 0) {
+                lf_queue_free(&mq->buckets[i]);
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Libera las colas
+ */
+void match_queue_free(struct match_queue *mq) {
+    for (int i = 0; i < mq->num_buckets; i++) {
+        lf_queue_free(&mq->buckets[i]);
+    }
+}
+
+/**
+ * Bucket de un RTT
+ */
+int match_bucket(const struct match_queue *mq, float rtt_ms) {
+    if (mq->bucket_ms == 0 || rtt_ms < 0) {
+        return 0;
+    }
+    
+    uint32_t bucket = (uint32_t)rtt_ms / mq->bucket_ms;
+    return bucket >= (uint32_t)mq->num_buckets ? mq->num_buckets - 1 : (int)bucket;
+}
+
+/**
+ * Publica un ticket
+ */
+int match_publish(struct match_queue *mq, int bucket, const struct match_ticket *ticket) {
+    return lf_queue_push(&mq->buckets[bucket], ticket);
+}
+
+/**
+ * Primer ticket vigente de un bucket (descartando los vencidos)
+ */
+static int take_from(struct match_queue *mq, int bucket, match_valid_fn valid, void *ctx,
+                     struct match_ticket *out) {
+    while (lf_queue_pop(&mq->buckets[bucket], out) == 0) {
+        if (valid(ctx, out)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Toma un ticket del bucket o de sus vecinos
+ */
+int match_take(struct match_queue *mq, int bucket, int widen,
+               match_valid_fn valid, void *ctx, struct match_ticket *out) {
+    if (take_from(mq, bucket, valid, ctx, out) == 0) {
+        return 0;
+    }
+    
+    for (int d = 1; d <= widen && d < mq->num_buckets; d++) {
+        if (bucket - d >= 0 && take_from(mq, bucket - d, valid, ctx, out) == 0) {
+            return 0;
+        }
+        if (bucket + d < mq->num_buckets && take_from(mq, bucket + d, valid, ctx, out) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,313 @@
+#define _GNU_SOURCE
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * Envía todo el buffer; MSG_NOSIGNAL para que un cliente que cortó no
+ * mate al servidor con SIGPIPE
+ * @return 0 si tuvo éxito, -1 en error
+ */
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Vacía el texto
+ */
+void metrics_text_reset(struct metrics_text *text) {
+    text->len = 0;
+    if (text->data != NULL) {
+        text->data[0] = '\0';
+    }
+}
+
+/**
+ * Agrega texto con formato
+ */
+void metrics_printf(struct metrics_text *text, const char *format, ...) {
+    va_list args;
+    
+    for (;;) {
+        size_t room = text->cap - text->len;
+        va_start(args, format);
+        int n = room > 0 ? vsnprintf(text->data + text->len, room, format, args) : -1;
+        va_end(args);
+        
+        if (n >= 0 && (size_t)n < room) {
+            text->len += (size_t)n;
+            return;
+        }
+        
+        // No entró: duplicar y volver a formatear
+        size_t cap = text->cap == 0 ? 4096 : text->cap * 2;
+        while (n >= 0 && cap - text->len <= (size_t)n) {
+            cap *= 2;
+        }
+        char *data = realloc(text->data, cap);
+        if (data == NULL) {
+            return;
+        }
+        text->data = data;
+        text->cap = cap;
+    }
+}
+
+/**
+ * Líneas # HELP y # TYPE
+ */
+void metrics_header(struct metrics_text *text, const char *name, const char *type,
+                    const char *help) {
+    metrics_printf(text, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * Muestra entera
+ */
+void metrics_uint(struct metrics_text *text, const char *name, const char *labels, uint64_t value) {
+    if (labels != NULL) {
+        metrics_printf(text, "%s{%s} %llu\n", name, labels, (unsigned long long)value);
+    } else {
+        metrics_printf(text, "%s %llu\n", name, (unsigned long long)value);
+    }
+}
+
+/**
+ * Muestra real
+ */
+void metrics_double(struct metrics_text *text, const char *name, const char *labels, double value) {
+    if (labels != NULL) {
+        metrics_printf(text, "%s{%s} %.17g\n", name, labels, value);
+    } else {
+        metrics_printf(text, "%s %.17g\n", name, value);
+    }
+}
+
+/**
+ * Histograma en segundos a partir de buckets en microsegundos
+ */
+void metrics_histogram(struct metrics_text *text, const char *name, const char *help,
+                       const uint32_t *bounds_us, const uint64_t *counts, int nbounds,
+                       uint64_t sum_us) {
+    uint64_t cumulative = 0;
+    
+    metrics_header(text, name, "histogram", help);
+    for (int i = 0; i < nbounds; i++) {
+        cumulative += counts[i];
+        metrics_printf(text, "%s_bucket{le=\"%g\"} %llu\n", name, bounds_us[i] / 1e6,
+                       (unsigned long long)cumulative);
+    }
+    cumulative += counts[nbounds];
+    metrics_printf(text, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+    metrics_printf(text, "%s_sum %.6f\n", name, sum_us / 1e6);
+    metrics_printf(text, "%s_count %llu\n", name, (unsigned long long)cumulative);
+}
+
+/**
+ * Atiende una conexión: lee el pedido y contesta
+ */
+static void serve_client(struct metrics_server *server, int fd) {
+    struct timeval timeout = {METRICS_TIMEOUT_MS / 1000, (METRICS_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    
+    // Solo interesa la primera línea, pero se lee hasta el fin de las
+    // cabeceras para no cortar la conexión con datos sin leer
+    char request[METRICS_REQUEST_MAX];
+    size_t len = 0;
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) break;
+    }
+    request[len] = '\0';
+    
+    // Ruta pedida: "GET /ruta[?...] HTTP/1.1"
+    const struct metrics_route *route = NULL;
+    if (strncmp(request, "GET ", 4) == 0) {
+        const char *path = request + 4;
+        size_t path_len = strcspn(path, " ?");
+        for (int i = 0; i < server->num_routes; i++) {
+            if (strlen(server->routes[i].path) == path_len &&
+                strncmp(path, server->routes[i].path, path_len) == 0) {
+                route = &server->routes[i];
+                break;
+            }
+        }
+    }
+    
+    char header[256];
+    if (route == NULL) {
+        metrics_text_reset(&server->text);
+        metrics_printf(&server->text, "Rutas:");
+        for (int i = 0; i < server->num_routes; i++) {
+            metrics_printf(&server->text, " GET %s", server->routes[i].path);
+        }
+        metrics_printf(&server->text, "\n");
+        int n = snprintf(header, sizeof(header),
+                         "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain; charset=utf-8\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n\r\n", server->text.len);
+        if (send_all(fd, header, (size_t)n) == 0) {
+            send_all(fd, server->text.data, server->text.len);
+        }
+        return;
+    }
+    
+    metrics_text_reset(&server->text);
+    route->render(&server->text, route->ctx);
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\nContent-Type: %s\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                     route->content_type, server->text.len);
+    if (send_all(fd, header, (size_t)n) == 0) {
+        send_all(fd, server->text.data, server->text.len);
+    }
+}
+
+/**
+ * Hilo del endpoint: un cliente a la vez (los scrapes son de a uno cada
+ * tantos segundos)
+ */
+static void *server_main(void *arg) {
+    struct metrics_server *server = arg;
+    struct timespec pause = {0, METRICS_ACCEPT_BACKOFF_MS * 1000000L};
+    
+    for (;;) {
+        int fd = accept4(server->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            // Un error que persiste (sin descriptores libres) no tiene que
+            // dejar al hilo girando sobre un núcleo
+            if (errno != EINTR && errno != ECONNABORTED) {
+                nanosleep(&pause, NULL);
+            }
+            continue;
+        }
+        serve_client(server, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/**
+ * Socket de escucha para la dirección indicada
+ * @return Descriptor o -1 en error
+ */
+static int open_listener(const char *addr) {
+    int fd;
+    
+    if (addr[0] == '/' || strncmp(addr, "unix:", 5) == 0) {
+        const char *path = addr[0] == '/' ? addr : addr + 5;
+        struct sockaddr_un un;
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        if (strlen(path) >= sizeof(un.sun_path)) {
+            fprintf(stderr, "Ruta de socket demasiado larga: %s\n", path);
+            return -1;
+        }
+        strcpy(un.sun_path, path);
+        
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(path);  // Un socket que quedó de una ejecución anterior
+        if (fd < 0 || bind(fd, (struct sockaddr *)&un, sizeof(un)) < 0) {
+            perror(path);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    } else {
+        // "PUERTO" escucha solo en loopback: las métricas no se publican
+        // hacia afuera salvo que se pida una IP
+        char host[64] = "127.0.0.1";
+        const char *colon = strrchr(addr, ':');
+        const char *port = addr;
+        if (colon != NULL) {
+            size_t host_len = (size_t)(colon - addr);
+            if (host_len >= sizeof(host)) return -1;
+            memcpy(host, addr, host_len);
+            host[host_len] = '\0';
+            port = colon + 1;
+        }
+        
+        struct sockaddr_in in;
+        memset(&in, 0, sizeof(in));
+        in.sin_family = AF_INET;
+        in.sin_port = htons((uint16_t)atoi(port));
+        if (atoi(port) <= 0 || atoi(port) > 65535 || inet_pton(AF_INET, host, &in.sin_addr) != 1) {
+            fprintf(stderr, "Dirección de métricas inválida: %s\n", addr);
+            return -1;
+        }
+        
+        int one = 1;
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+            bind(fd, (struct sockaddr *)&in, sizeof(in)) < 0) {
+            perror("Error al abrir el endpoint de métricas");
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    
+    if (listen(fd, 16) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Agrega una ruta
+ */
+int metrics_server_route(struct metrics_server *server, const char *path,
+                         const char *content_type, metrics_render_fn render, void *ctx) {
+    if (server->num_routes >= METRICS_MAX_ROUTES) {
+        return -1;
+    }
+    struct metrics_route *route = &server->routes[server->num_routes++];
+    route->path = path;
+    route->content_type = content_type;
+    route->render = render;
+    route->ctx = ctx;
+    return 0;
+}
+
+/**
+ * Abre el endpoint y arranca su hilo
+ */
+int metrics_server_start(struct metrics_server *server, const char *addr,
+                         metrics_render_fn render, void *ctx) {
+    // Las rutas agregadas antes se conservan
+    memset(&server->text, 0, sizeof(server->text));
+    if (metrics_server_route(server, "/metrics", "text/plain; version=0.0.4; charset=utf-8",
+                             render, ctx) < 0) {
+        return -1;
+    }
+    server->fd = open_listener(addr);
+    if (server->fd < 0) {
+        return -1;
+    }
+    
+    if (pthread_create(&server->thread, NULL, server_main, server) != 0) {
+        close(server->fd);
+        return -1;
+    }
+    pthread_detach(server->thread);
+    return 0;
+}
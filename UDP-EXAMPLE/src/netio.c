@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+#include "netio.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/**
+ * Configura un descriptor como non-blocking
+ */
+int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/**
+ * Crea un timerfd periódico
+ */
+int create_tick_timer(uint64_t period_ns) {
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) return -1;
+    
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = period_ns / 1000000000ULL;
+    spec.it_interval.tv_nsec = period_ns % 1000000000ULL;
+    spec.it_value = spec.it_interval;  // Primer disparo tras un periodo
+    
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) < 0) {
+        close(timer_fd);
+        return -1;
+    }
+    
+    return timer_fd;
+}
+
+/**
+ * Lee cuántas veces expiró el timer desde la última lectura
+ */
+uint64_t read_timer_expirations(int timer_fd) {
+    uint64_t expirations = 0;
+    if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+    return expirations;
+}
+
+/**
+ * Registra un descriptor en epoll para eventos de lectura
+ */
+int epoll_add_reader(int epoll_fd, int fd) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**
+ * Inicializa un lote vacío
+ */
+void dgram_batch_init(struct dgram_batch *batch) {
+    memset(batch, 0, sizeof(*batch));
+    
+    for (int i = 0; i < NETIO_BATCH; i++) {
+        batch->iov[i].iov_base = batch->bufs[i];
+        batch->iov[i].iov_len = NETIO_DGRAM_MAX;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    }
+}
+
+/**
+ * Recibe hasta NETIO_BATCH datagramas con una sola llamada a recvmmsg
+ */
+int dgram_batch_recv(int fd, struct dgram_batch *batch) {
+    // recvmmsg sobreescribe largos de dirección y buffer: restaurarlos
+    for (int i = 0; i < NETIO_BATCH; i++) {
+        batch->iov[i].iov_len = NETIO_DGRAM_MAX;
+        batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    }
+    
+    int received;
+    do {
+        received = recvmmsg(fd, batch->msgs, NETIO_BATCH, MSG_DONTWAIT, NULL);
+    } while (received < 0 && errno == EINTR);
+    
+    batch->count = received > 0 ? received : 0;
+    return batch->count;
+}
+
+/**
+ * Encola un datagrama para enviarlo en el próximo flush
+ */
+int dgram_batch_queue(int fd, struct dgram_batch *batch, const void *data, size_t len,
+                      const struct sockaddr_in *addr) {
+    if (len > NETIO_DGRAM_MAX) return -1;
+    
+    if (batch->count == NETIO_BATCH) {
+        dgram_batch_flush(fd, batch);
+    }
+    
+    int i = batch->count++;
+    memcpy(batch->bufs[i], data, len);
+    batch->iov[i].iov_len = len;
+    batch->addrs[i] = *addr;
+    batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+    
+    return 0;
+}
+
+/**
+ * Envía todos los datagramas encolados con sendmmsg
+ */
+int dgram_batch_flush(int fd, struct dgram_batch *batch) {
+    int total = 0;
+    
+    while (total < batch->count) {
+        int sent = sendmmsg(fd, batch->msgs + total, batch->count - total, MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Buffer de envío lleno: descartar el resto (es UDP)
+                batch->dropped += batch->count - total;
+                break;
+            }
+            // Error de un destino concreto: saltarlo y seguir con el lote
+            batch->dropped++;
+            total++;
+            continue;
+        }
+        total += sent;
+    }
+    
+    batch->count = 0;
+    return total;
+}
@@ -0,0 +1,1577 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <math.h>
+#include "protocol.h"
+#include "utils.h"
+#include "stats.h"
+#include "snapshot.h"
+#include "netio.h"
+#include "game.h"
+#include "game_batch.h"
+#include "histogram.h"
+#include "session.h"
+#include "timer_wheel.h"
+#include "lfqueue.h"
+#include "matchmaking.h"
+#include "replay.h"
+#include "log.h"
+#include "profiler.h"
+#include "input.h"
+#include "rollback.h"
+
+/**
+ * Micro-benchmarks de los caminos calientes (make bench)
+ *
+ * Cada caso se mide en varias rondas y se reporta la mejor (la menos
+ * afectada por interrupciones) en ns por operación, junto con las
+ * asignaciones de memoria por operación. Las asignaciones se cuentan
+ * enlazando con -Wl,--wrap=malloc,...: solo se ven las del código del
+ * proyecto, no las internas de la libc.
+ *
+ * Con -b se compara contra una línea base y el proceso termina con error
+ * si algún caso empeora más del umbral; con -w se guarda la línea base.
+ */
+
+#define BENCH_ROUNDS 5
+#define BENCH_DEFAULT_THRESHOLD 20.0   // % de empeoramiento tolerado
+#define BENCH_MAX_CASES 32
+#define BENCH_NAME_LEN 32
+
+// Contadores de asignaciones (ver wrappers al final)
+uint64_t alloc_count;
+
+// Evita que el compilador elimine el trabajo medido
+static volatile uint64_t sink;
+
+struct bench_result {
+    char name[BENCH_NAME_LEN];
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+struct bench_result results[BENCH_MAX_CASES];
+int num_results;
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Ejecuta un caso: fn hace `ops` operaciones por llamada
+ */
+void run_case(const char *name, void (*fn)(uint64_t ops), uint64_t ops) {
+    double best = 0;
+    uint64_t allocs = 0;
+    
+    fn(ops / 10);  // Calentar caches y predictor de saltos
+    
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t allocs_before = alloc_count;
+        uint64_t start = now_ns();
+        fn(ops);
+        double ns = (double)(now_ns() - start) / ops;
+        
+        allocs = alloc_count - allocs_before;
+        if (round == 0 || ns < best) best = ns;
+    }
+    
+    struct bench_result *r = &results[num_results++];
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->ns_per_op = best;
+    r->allocs_per_op = (double)allocs / ops;
+}
+
+// --- Casos ---------------------------------------------------------------
+
+/**
+ * Física de una partida (núcleo de update_physics)
+ */
+void bench_game_step(uint64_t ops) {
+    struct game_state game;
+    game_init(&game, 12345);
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        int8_t action1 = (int8_t)((i / 37) % 3) - 1;
+        int8_t action2 = (int8_t)((i / 53) % 3) - 1;
+        game_step(&game, action1, action2);
+    }
+    sink += game.tick + game.score1;
+}
+
+/**
+ * Física en lote: ns por sala y paso con un kernel concreto
+ */
+#define BENCH_BATCH_ROOMS 4096
+struct game_batch batch;
+
+void bench_game_batch(uint64_t ops, enum game_kernel kernel) {
+    batch.frame_ticks = 1;
+    for (int r = 0; r < BENCH_BATCH_ROOMS; r++) {
+        game_batch_init_lane(&batch, r, (uint32_t)r + 1);
+        batch.live[r] = 1;
+    }
+    
+    for (uint64_t done = 0; done < ops; done += BENCH_BATCH_ROOMS) {
+        for (int r = 0; r < BENCH_BATCH_ROOMS; r += 64) {
+            batch.action1[r] = (int8_t)((done / 37) % 3) - 1;
+            batch.action2[r] = (int8_t)((done / 53) % 3) - 1;
+        }
+        game_batch_step_kernel(&batch, BENCH_BATCH_ROOMS, kernel);
+    }
+    sink += batch.tick[0] + batch.score1[0];
+}
+
+void bench_game_batch_scalar(uint64_t ops) {
+    bench_game_batch(ops, GAME_KERNEL_SCALAR);
+}
+
+void bench_game_batch_sse2(uint64_t ops) {
+    bench_game_batch(ops, GAME_KERNEL_SSE2);
+}
+
+void bench_game_batch_avx2(uint64_t ops) {
+    bench_game_batch(ops, GAME_KERNEL_AVX2);
+}
+
+/**
+ * Compara dos estados campo a campo (bit a bit en los escalares)
+ */
+int game_state_equal(const struct game_state *a, const struct game_state *b) {
+    return memcmp(&a->paddle1_y, &b->paddle1_y, sizeof(game_scalar)) == 0 &&
+           memcmp(&a->paddle2_y, &b->paddle2_y, sizeof(game_scalar)) == 0 &&
+           memcmp(&a->ball_x, &b->ball_x, sizeof(game_scalar)) == 0 &&
+           memcmp(&a->ball_y, &b->ball_y, sizeof(game_scalar)) == 0 &&
+           memcmp(&a->ball_vx, &b->ball_vx, sizeof(game_scalar)) == 0 &&
+           memcmp(&a->ball_vy, &b->ball_vy, sizeof(game_scalar)) == 0 &&
+           a->score1 == b->score1 && a->score2 == b->score2 &&
+           a->tick == b->tick && a->rng == b->rng;
+}
+
+/**
+ * Verifica que un kernel en lote dé exactamente lo mismo que game_step:
+ * salas con acciones pseudoaleatorias (algunas inactivas, y una cantidad
+ * que no llena el último vector) comparadas en cada tick
+ * @param frame_ticks Pasos por frame (simulación a un múltiplo de TARGET_FPS)
+ * @return 0 si coincide, -1 si difiere
+ */
+#define VERIFY_ROOMS 1021
+#define VERIFY_TICKS 20000
+int verify_kernel(enum game_kernel kernel, int frame_ticks) {
+    static struct game_state reference[VERIFY_ROOMS];
+    uint32_t actions = 0x12345678u;
+    
+    batch.frame_ticks = (uint8_t)frame_ticks;
+    for (int r = 0; r < VERIFY_ROOMS; r++) {
+        game_init(&reference[r], (uint32_t)r + 1);
+        reference[r].frame_ticks = (uint8_t)frame_ticks;
+        game_batch_init_lane(&batch, r, (uint32_t)r + 1);
+        batch.live[r] = r % 7 != 3;
+    }
+    
+    for (uint32_t t = 0; t < VERIFY_TICKS; t++) {
+        for (int r = 0; r < VERIFY_ROOMS; r++) {
+            // Cambiar de acción cada tanto para alcanzar paredes y pelota
+            actions = actions * 1664525u + 1013904223u;
+            if ((actions >> 28) == 0) {
+                batch.action1[r] = (int8_t)((actions >> 8) % 3) - 1;
+                batch.action2[r] = (int8_t)((actions >> 16) % 3) - 1;
+            }
+        }
+        game_batch_step_kernel(&batch, VERIFY_ROOMS, kernel);
+        
+        for (int r = 0; r < VERIFY_ROOMS; r++) {
+            int events = 0;
+            if (batch.live[r]) {
+                events = game_step(&reference[r], batch.action1[r], batch.action2[r]);
+            }
+            
+            struct game_state lane;
+            game_batch_load(&batch, r, &lane);
+            if (events != batch.events[r] || !game_state_equal(&lane, &reference[r])) {
+                printf("❌ Kernel %s difiere de game_step: sala %d, tick %u (%d pasos por frame)\n",
+                       game_kernel_name(kernel), r, t + 1, frame_ticks);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Verifica que simular a un múltiplo de TARGET_FPS no cambie la velocidad
+ * del juego: frame_ticks pasos mueven paletas y pelota lo mismo que un
+ * frame (antes de la primera colisión, que el paso más fino resuelve antes)
+ * @return 0 si coincide, -1 si difiere
+ */
+int verify_frame_ticks(void) {
+    for (int ticks = 2; ticks <= 4; ticks++) {
+        struct game_state frame;
+        struct game_state fine;
+        game_init(&frame, 99);
+        game_init(&fine, 99);
+        fine.frame_ticks = (uint8_t)ticks;
+        
+        for (int f = 0; f < 10; f++) {
+            int8_t action = f < 5 ? ACTION_UP : ACTION_DOWN;
+            game_step(&frame, action, ACTION_IDLE);
+            for (int t = 0; t < ticks; t++) {
+                game_step(&fine, action, ACTION_IDLE);
+            }
+        }
+        
+        float error = fabsf(GAME_TO_FLOAT(frame.paddle1_y) - GAME_TO_FLOAT(fine.paddle1_y)) +
+                      fabsf(GAME_TO_FLOAT(frame.ball_x) - GAME_TO_FLOAT(fine.ball_x)) +
+                      fabsf(GAME_TO_FLOAT(frame.ball_y) - GAME_TO_FLOAT(fine.ball_y));
+        if (error > 0.01f || fine.tick != frame.tick * (uint32_t)ticks) {
+            printf("❌ Con %d pasos por frame la partida avanza distinto (error %.4f)\n",
+                   ticks, error);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Estados consecutivos reales para los casos de serialización
+ */
+#define BENCH_STATES 1024
+struct snapshot states[BENCH_STATES];
+
+void prepare_states(void) {
+    struct game_state game;
+    game_init(&game, 777);
+    
+    for (int i = 0; i < BENCH_STATES; i++) {
+        game_step(&game, (int8_t)((i / 20) % 3) - 1, (int8_t)((i / 30) % 3) - 1);
+        states[i].tick = (uint32_t)i + 1;
+        states[i].paddle1_y = snapshot_quantize(GAME_TO_FLOAT(game.paddle1_y));
+        states[i].paddle2_y = snapshot_quantize(GAME_TO_FLOAT(game.paddle2_y));
+        states[i].ball_x = snapshot_quantize(GAME_TO_FLOAT(game.ball_x));
+        states[i].ball_y = snapshot_quantize(GAME_TO_FLOAT(game.ball_y));
+        states[i].score1 = game.score1;
+        states[i].score2 = game.score2;
+    }
+}
+
+/**
+ * Codificación de un snapshot delta como en broadcast_state
+ */
+void bench_snapshot_delta(uint64_t ops) {
+    uint8_t buf[SNAP_MAX_SIZE];
+    struct snapshot_extra extra;
+    extra.mask = SNAP_INPUT_ACK;
+    extra.input_ack = 42;
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        unsigned int idx = (unsigned int)(i % (BENCH_STATES - 2)) + 2;
+        sink += snapshot_encode(buf, &states[idx], &states[idx - 2], &extra);
+    }
+}
+
+/**
+ * Codificación de un keyframe (cliente sin ack)
+ */
+void bench_snapshot_keyframe(uint64_t ops) {
+    uint8_t buf[SNAP_MAX_SIZE];
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        sink += snapshot_encode(buf, &states[i % BENCH_STATES], NULL, NULL);
+    }
+}
+
+/**
+ * Fan-out a espectadores: lo que cuesta cada espectador en el hilo del
+ * tick con el keyframe ya codificado (una vez por sala) es encolarlo en
+ * el lote. El lote se vacía a mano en lugar de con sendmmsg para medir
+ * solo el espacio de usuario.
+ */
+struct dgram_batch bench_batch;
+
+void bench_spectator_queue(uint64_t ops) {
+    uint8_t buf[SNAP_MAX_SIZE];
+    size_t len = snapshot_encode(buf, &states[0], NULL, NULL);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        if (bench_batch.count == NETIO_BATCH) {
+            bench_batch.count = 0;
+        }
+        addr.sin_port = (uint16_t)i;
+        dgram_batch_queue(-1, &bench_batch, buf, len, &addr);
+    }
+    sink += bench_batch.count;
+}
+
+/**
+ * Decodificación de un snapshot delta (lado cliente)
+ */
+void bench_snapshot_decode(uint64_t ops) {
+    uint8_t bufs[64][SNAP_MAX_SIZE];
+    size_t lens[64];
+    for (int i = 0; i < 64; i++) {
+        lens[i] = snapshot_encode(bufs[i], &states[i + 2], &states[i], NULL);
+    }
+    
+    struct snapshot out;
+    struct snapshot_extra extra;
+    for (uint64_t i = 0; i < ops; i++) {
+        unsigned int k = (unsigned int)(i % 64);
+        snapshot_decode(bufs[k], lens[k], &states[k], &out, &extra);
+        sink += out.ball_x;
+    }
+}
+
+/**
+ * Verifica que los snapshots se decodifican igual con cualquier base y mide
+ * el tamaño medio con el ritmo de extras de broadcast_state: base en el tick
+ * anterior, ack en todos, eco cada RTT_ECHO_INTERVAL y estadísticas cada
+ * SNAPSHOT_STATS_INTERVAL
+ * @return 0 si todo coincide y el promedio queda por debajo de SNAP_TARGET_BYTES
+ */
+#define SNAP_TARGET_BYTES 12.0
+
+int verify_snapshot(void) {
+    static const uint8_t offsets[] = {0, 1, 2, 5, SNAP_HISTORY - 1};
+    uint8_t buf[SNAP_MAX_SIZE];
+    uint64_t bytes = 0, count = 0;
+    int ok = 1;
+    
+    for (int i = SNAP_HISTORY; i < BENCH_STATES; i++) {
+        struct snapshot_extra extra;
+        extra.mask = SNAP_INPUT_ACK;
+        extra.input_ack = (uint8_t)i;
+        if (i % RTT_ECHO_INTERVAL == 0) {
+            extra.mask |= SNAP_ECHO;
+            extra.echo_ts = (uint16_t)(i * 17);
+            extra.echo_hold_ms = 3;
+        }
+        if (i % SNAPSHOT_STATS_INTERVAL == 0) {
+            extra.mask |= SNAP_STATS;
+            extra.stats.rtt_ms = 25;
+            extra.stats.loss_percent = 1;
+            extra.stats.packets_sent = (uint32_t)i;
+            extra.stats.packets_recv = (uint32_t)i - 3;
+        }
+        
+        for (size_t k = 0; k < sizeof(offsets); k++) {
+            const struct snapshot *base = offsets[k] ? &states[i - offsets[k]] : NULL;
+            size_t len = snapshot_encode(buf, &states[i], base, &extra);
+            if (offsets[k] == 1) {
+                bytes += len;
+                count++;
+            }
+            
+            struct snapshot_header header;
+            struct snapshot out;
+            struct snapshot_extra got;
+            ok = snapshot_read_header(buf, len, &header) == 0 && ok;
+            ok = snapshot_decode(buf, len, base, &out, &got) == 0 && ok;
+            ok = ok && header.base_offset == offsets[k] && header.tick == (uint16_t)states[i].tick &&
+                 out.paddle1_y == states[i].paddle1_y && out.paddle2_y == states[i].paddle2_y &&
+                 out.ball_x == states[i].ball_x && out.ball_y == states[i].ball_y &&
+                 out.score1 == states[i].score1 && out.score2 == states[i].score2 &&
+                 got.mask == extra.mask && got.input_ack == extra.input_ack;
+            
+            // Truncado en cualquier byte tiene que fallar, no leer de más
+            ok = ok && snapshot_decode(buf, len - 1, base, &out, &got) < 0;
+        }
+    }
+    
+    double avg = (double)bytes / (double)count;
+    printf("📦 Snapshot delta: %.2f bytes/cliente/tick (objetivo < %.0f)\n", avg, SNAP_TARGET_BYTES);
+    if (!ok || avg >= SNAP_TARGET_BYTES) {
+        printf("❌ Snapshot: decodificación incorrecta o promedio sobre el objetivo\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Armado del server_message (respuesta a JOIN)
+ */
+void bench_server_message(uint64_t ops) {
+    struct game_state game;
+    game_init(&game, 1);
+    struct server_message msg;
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.type = MSG_STATE;
+        msg.timestamp = (uint32_t)i;
+        msg.paddle1_y = GAME_TO_FLOAT(game.paddle1_y);
+        msg.paddle2_y = GAME_TO_FLOAT(game.paddle2_y);
+        msg.ball_x = GAME_TO_FLOAT(game.ball_x);
+        msg.ball_y = GAME_TO_FLOAT(game.ball_y);
+        msg.score1 = game.score1;
+        msg.score2 = game.score2;
+        sink += ((volatile uint8_t *)&msg)[i % sizeof(msg)];
+    }
+}
+
+void bench_stats_update_rtt(uint64_t ops) {
+    struct network_stats stats;
+    stats_init(&stats);
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        stats_update_rtt(&stats, (float)(i & 63));
+    }
+    sink += (uint64_t)stats.rtt_avg;
+}
+
+void bench_stats_update_rtt_hist(uint64_t ops) {
+    struct network_stats stats;
+    static struct histogram hist;
+    stats_init(&stats);
+    histogram_init(&hist);
+    stats.rtt_hist = &hist;
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        stats_update_rtt(&stats, (float)(i & 63));
+    }
+    sink += hist.count;
+}
+
+/**
+ * Verifica que un promedio de RTT en 0 (red local) siga suavizando en
+ * lugar de tomar la próxima medición como si fuera la primera
+ * @return 0 si el promedio es el esperado
+ */
+int verify_stats_rtt(void) {
+    struct network_stats stats;
+    stats_init(&stats);
+    stats_update_rtt(&stats, 0);
+    stats_update_rtt(&stats, 0);
+    stats_update_rtt(&stats, 10);
+    
+    if (fabsf(stats.rtt_avg - 1.0f) > 0.001f || stats.rtt_samples != 3) {
+        printf("❌ RTT: promedio %.3f ms tras 0, 0 y 10 ms (esperado 1.000)\n", stats.rtt_avg);
+        return -1;
+    }
+    return 0;
+}
+
+void bench_stats_packet_sent(uint64_t ops) {
+    struct network_stats stats;
+    stats_init(&stats);
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        stats_packet_sent(&stats, 12);
+    }
+    sink += stats.packets_sent;
+}
+
+void bench_stats_track_sequence(uint64_t ops) {
+    struct network_stats stats;
+    stats_init(&stats);
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        // Un paquete de cada 64 se pierde
+        stats_track_sequence(&stats, (uint16_t)(i + (i >> 6)));
+    }
+    sink += stats.packets_lost;
+}
+
+void bench_histogram_record(uint64_t ops) {
+    static struct histogram hist;
+    histogram_init(&hist);
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        histogram_record(&hist, (i * 2654435761u) & 0xfffff);
+    }
+    sink += hist.count;
+}
+
+void bench_get_time_ms(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        sink += get_time_ms();
+    }
+}
+
+void bench_get_time_us(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        sink += get_time_us();
+    }
+}
+
+void bench_get_time_ns(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        sink += get_time_ns();
+    }
+}
+
+/**
+ * Lectura del "ahora" cacheado (lo que pagan las estadísticas por paquete)
+ */
+void bench_clock_now_ns(uint64_t ops) {
+    clock_refresh();
+    for (uint64_t i = 0; i < ops; i++) {
+        sink += clock_now_ns();
+    }
+}
+
+/**
+ * Tabla de sesiones con 100k clientes (direcciones tipo NAT: pocas IP,
+ * muchos puertos)
+ */
+#define BENCH_SESSIONS 100000
+struct session_table sessions;
+
+struct sockaddr_in session_addr(uint32_t i) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = 0x0a000000u + i / 50000;
+    addr.sin_port = (uint16_t)(1024 + i % 50000);
+    return addr;
+}
+
+void fill_sessions(void) {
+    for (uint32_t i = 0; i < BENCH_SESSIONS; i++) {
+        struct sockaddr_in addr = session_addr(i);
+        session_insert(&sessions, &addr, i);
+    }
+}
+
+void bench_session_find(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        struct sockaddr_in addr = session_addr((uint32_t)((i * 7919) % BENCH_SESSIONS));
+        sink += session_find(&sessions, &addr);
+    }
+}
+
+/**
+ * Alta y baja de una sesión con la tabla llena (reciclado de lugares)
+ */
+void bench_session_churn(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        struct sockaddr_in addr = session_addr((uint32_t)((i * 7919) % BENCH_SESSIONS));
+        session_remove(&sessions, &addr);
+        session_insert(&sessions, &addr, (uint32_t)i);
+    }
+    sink += sessions.count;
+}
+
+/**
+ * Verifica la tabla: todas las sesiones se encuentran, las borradas no,
+ * y las que quedan siguen accesibles tras los desplazamientos del borrado
+ * @return 0 si todo coincide
+ */
+int verify_sessions(void) {
+    fill_sessions();
+    for (uint32_t i = 0; i < BENCH_SESSIONS; i += 2) {
+        struct sockaddr_in addr = session_addr(i);
+        session_remove(&sessions, &addr);
+    }
+    
+    for (uint32_t i = 0; i < BENCH_SESSIONS; i++) {
+        struct sockaddr_in addr = session_addr(i);
+        uint32_t expected = (i % 2) ? i : SESSION_NONE;
+        if (session_find(&sessions, &addr) != expected) {
+            printf("❌ Tabla de sesiones: la sesión %u no coincide\n", i);
+            return -1;
+        }
+    }
+    
+    fill_sessions();
+    return sessions.count == BENCH_SESSIONS ? 0 : -1;
+}
+
+/**
+ * Rueda de inactividad como la usa el servidor: cada id vence una vez por
+ * período y se reprograma (el jugador siguió enviando). El costo por
+ * revisión tiene que ser el mismo con 1k que con 100k ids.
+ */
+#define IDLE_PERIOD 50
+struct timer_wheel idle_wheel;
+
+void rearm_idle(void *ctx, uint32_t id) {
+    (void)ctx;
+    timer_wheel_schedule(&idle_wheel, id, idle_wheel.now + IDLE_PERIOD);
+}
+
+void bench_idle_wheel(uint64_t ops, uint32_t ids) {
+    timer_wheel_init(&idle_wheel, ids, 0);
+    for (uint32_t i = 0; i < ids; i++) {
+        timer_wheel_schedule(&idle_wheel, i, 1 + i % IDLE_PERIOD);
+    }
+    
+    uint64_t fired = 0;
+    while (fired < ops) {
+        fired += timer_wheel_advance(&idle_wheel, idle_wheel.now + 1, rearm_idle, NULL);
+    }
+    sink += fired;
+    timer_wheel_free(&idle_wheel);
+}
+
+void bench_idle_wheel_1k(uint64_t ops) {
+    bench_idle_wheel(ops, 1000);
+}
+
+void bench_idle_wheel_100k(uint64_t ops) {
+    bench_idle_wheel(ops, BENCH_SESSIONS);
+}
+
+/**
+ * Verifica la rueda: cada id vence justo en su plazo, los cancelados no
+ * vencen y un salto de varias vueltas vence todo lo pendiente
+ * @return 0 si todo coincide
+ */
+uint32_t wheel_fired_at[4096];
+
+void record_fire(void *ctx, uint32_t id) {
+    wheel_fired_at[id] = *(uint32_t *)ctx;
+}
+
+int verify_timer_wheel(void) {
+    struct timer_wheel wheel;
+    if (timer_wheel_init(&wheel, 4096, 1000) < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < 4096; i++) {
+        timer_wheel_schedule(&wheel, i, 1001 + i % (TIMER_WHEEL_SLOTS - 1));
+        wheel_fired_at[i] = 0;
+    }
+    for (uint32_t i = 0; i < 4096; i += 3) {
+        timer_wheel_cancel(&wheel, i);
+    }
+    
+    for (uint32_t now = 1001; now < 1001 + TIMER_WHEEL_SLOTS; now++) {
+        timer_wheel_advance(&wheel, now, record_fire, &now);
+    }
+    for (uint32_t i = 0; i < 4096; i++) {
+        uint32_t expected = (i % 3 == 0) ? 0 : 1001 + i % (TIMER_WHEEL_SLOTS - 1);
+        if (wheel_fired_at[i] != expected || wheel.count != 0) {
+            printf("❌ Rueda de temporizadores: el id %u venció en %u (esperado %u)\n",
+                   i, wheel_fired_at[i], expected);
+            timer_wheel_free(&wheel);
+            return -1;
+        }
+    }
+    
+    for (uint32_t i = 0; i < 4096; i++) {
+        timer_wheel_schedule(&wheel, i, wheel.now + 1 + i % 10);
+    }
+    uint32_t later = wheel.now + 10 * TIMER_WHEEL_SLOTS;
+    uint32_t fired = timer_wheel_advance(&wheel, later, record_fire, &later);
+    timer_wheel_free(&wheel);
+    if (fired != 4096) {
+        printf("❌ Rueda de temporizadores: el salto venció %u de 4096\n", fired);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Encolar y desencolar sin competencia: el costo base de cada salto entre
+ * shards (reenvío de paquetes y tickets de emparejamiento)
+ */
+struct lf_queue bench_queue;
+
+void bench_lfqueue_push_pop(uint64_t ops) {
+    struct shard_like_msg { uint64_t words[4]; } msg = {{0}};
+    for (uint64_t i = 0; i < ops; i++) {
+        msg.words[0] = i;
+        lf_queue_push(&bench_queue, &msg);
+        lf_queue_pop(&bench_queue, &msg);
+    }
+    sink += msg.words[0];
+}
+
+/**
+ * Publicar el ticket de una sala y que otro jugador lo tome (el
+ * emparejamiento completo de una partida, sin el resto del servidor)
+ */
+struct match_queue bench_match;
+
+int bench_ticket_valid(void *ctx, const struct match_ticket *ticket) {
+    (void)ctx;
+    return ticket->gen != 0;
+}
+
+void bench_match_publish_take(uint64_t ops) {
+    struct match_ticket ticket = {0, 0, 1};
+    struct match_ticket taken;
+    for (uint64_t i = 0; i < ops; i++) {
+        ticket.room = (uint16_t)i;
+        match_publish(&bench_match, 0, &ticket);
+        match_take(&bench_match, 0, 0, bench_ticket_valid, NULL, &taken);
+    }
+    sink += taken.room;
+}
+
+/**
+ * Verifica la cola con varios productores y un consumidor a la vez: cada
+ * valor sale exactamente una vez y los de un mismo productor en orden
+ * @return 0 si todo coincide
+ */
+#define LFQ_PRODUCERS 4
+#define LFQ_PER_PRODUCER 200000
+
+struct lfq_item {
+    uint32_t producer;
+    uint32_t seq;
+};
+
+struct lf_queue verify_queue;
+
+void *lfq_producer(void *arg) {
+    struct lfq_item item = {(uint32_t)(uintptr_t)arg, 0};
+    for (; item.seq < LFQ_PER_PRODUCER; item.seq++) {
+        while (lf_queue_push(&verify_queue, &item) < 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int verify_lfqueue(void) {
+    if (lf_queue_init(&verify_queue, 1024, sizeof(struct lfq_item)) < 0) {
+        return -1;
+    }
+    
+    pthread_t threads[LFQ_PRODUCERS];
+    for (uint32_t p = 0; p < LFQ_PRODUCERS; p++) {
+        pthread_create(&threads[p], NULL, lfq_producer, (void *)(uintptr_t)p);
+    }
+    
+    uint32_t next[LFQ_PRODUCERS] = {0};
+    uint64_t received = 0;
+    int ok = 1;
+    struct lfq_item item;
+    while (received < (uint64_t)LFQ_PRODUCERS * LFQ_PER_PRODUCER) {
+        if (lf_queue_pop(&verify_queue, &item) < 0) {
+            sched_yield();
+            continue;
+        }
+        if (item.producer >= LFQ_PRODUCERS || item.seq != next[item.producer]) {
+            ok = 0;
+        } else {
+            next[item.producer]++;
+        }
+        received++;
+    }
+    
+    for (uint32_t p = 0; p < LFQ_PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    ok = ok && lf_queue_pop(&verify_queue, &item) < 0;
+    lf_queue_free(&verify_queue);
+    
+    if (!ok) {
+        printf("❌ Cola sin locks: se perdió, duplicó o desordenó algún elemento\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Grabar un cambio de acciones en la repetición: lo que paga el hilo del
+ * tick por sala cuando se graba (el write() lo hace otro hilo; aquí se
+ * vacía a /dev/null cada tanto para que no falten bloques)
+ */
+struct replay_stream bench_replay;
+
+void bench_replay_append(uint64_t ops) {
+    struct replay_input input = {ACTION_UP, ACTION_DOWN};
+    for (uint64_t i = 0; i < ops; i++) {
+        input.action1 = (int8_t)(i & 1);
+        replay_append(&bench_replay, REPLAY_INPUT, (uint16_t)(i & 1023), (uint32_t)i,
+                      &input, sizeof(input));
+        if ((i & 4095) == 0) {
+            replay_stream_drain(&bench_replay);
+        }
+    }
+    replay_stream_drain(&bench_replay);
+    sink += bench_replay.dropped;
+}
+
+/**
+ * Verifica la repetición de ida y vuelta: lo que se graba (en varios
+ * bloques) se lee igual, y si el escritor no vacía a tiempo se descartan
+ * registros y el lector ve un REPLAY_GAP antes de los siguientes
+ * @return 0 si todo coincide
+ */
+#define VERIFY_REPLAY_RECORDS 20000
+
+int verify_replay(void) {
+    char path[] = "/tmp/pong_bench_replayXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    
+    struct replay_stream stream;
+    if (replay_stream_init(&stream, fd, -1, 7, TARGET_FPS) < 0) {
+        close(fd);
+        return -1;
+    }
+    
+    // Registros de tamaños distintos, vaciados de a tandas
+    struct replay_keyframe kf;
+    memset(&kf, 0, sizeof(kf));
+    for (uint32_t i = 0; i < VERIFY_REPLAY_RECORDS; i++) {
+        kf.rng = i * 2654435761u;
+        replay_append(&stream, (i % 3) ? REPLAY_INPUT : REPLAY_KEYFRAME, (uint16_t)(i % 500), i,
+                      &kf, (i % 3) ? sizeof(struct replay_input) : sizeof(kf));
+        if (i % 1000 == 0) replay_stream_drain(&stream);
+    }
+    
+    // Sin vaciar hasta agotar los bloques: lo que no entra se descarta
+    uint64_t appended = 0;
+    while (stream.dropped == 0) {
+        replay_append(&stream, REPLAY_KEYFRAME, 0, 0, &kf, sizeof(kf));
+        appended++;
+    }
+    replay_stream_drain(&stream);
+    replay_append(&stream, REPLAY_MATCH_END, 1, 99, &kf, sizeof(struct replay_match_end));
+    replay_flush_due(&stream, UINT64_MAX);
+    replay_stream_drain(&stream);
+    
+    size_t len = (size_t)lseek(fd, 0, SEEK_END);
+    uint8_t *buf = malloc(len);
+    int ok = buf != NULL && pread(fd, buf, len, 0) == (ssize_t)len &&
+             memcmp(((struct replay_header *)buf)->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) == 0 &&
+             ((struct replay_header *)buf)->shard == 7;
+    
+    size_t offset = sizeof(struct replay_header);
+    const struct replay_record *record;
+    for (uint32_t i = 0; ok && i < VERIFY_REPLAY_RECORDS; i++) {
+        record = replay_next(buf, len, &offset);
+        ok = record != NULL && record->tick == i && record->room == i % 500 &&
+             record->type == ((i % 3) ? REPLAY_INPUT : REPLAY_KEYFRAME) &&
+             ((i % 3) || ((const struct replay_keyframe *)(record + 1))->rng == i * 2654435761u);
+    }
+    for (uint64_t i = 0; ok && i + 1 < appended; i++) {
+        record = replay_next(buf, len, &offset);
+        ok = record != NULL && record->type == REPLAY_KEYFRAME;
+    }
+    record = ok ? replay_next(buf, len, &offset) : NULL;
+    ok = ok && record != NULL && record->type == REPLAY_GAP;
+    record = ok ? replay_next(buf, len, &offset) : NULL;
+    ok = ok && record != NULL && record->type == REPLAY_MATCH_END && record->tick == 99 &&
+         replay_next(buf, len, &offset) == NULL;
+    
+    free(buf);
+    replay_stream_free(&stream);
+    close(fd);
+    if (!ok) {
+        printf("❌ Repetición: lo leído no coincide con lo grabado\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Registrar un gol desde el hilo del tick: solo copiar los argumentos y
+ * encolar (el formateo y el write() los hace el hilo del log; aquí la cola
+ * se vacía sin escribir cada tanto para que no se llene)
+ */
+void bench_log_msg(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        log_msg("⚽ [shard %d] GOL en sala %d! Jugador 2 anota. Marcador: %d - %d",
+                1, (int)(i & 8191), (int)(i & 7), 3);
+        if ((i & 4095) == 4095) {
+            log_discard();
+        }
+    }
+    log_discard();
+    sink += log_dropped();
+}
+
+/**
+ * Lo mismo con un %s (el nombre se copia al registro)
+ */
+void bench_log_msg_string(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        log_msg("🎮 [shard %d] Jugador %d conectado a sala %d: %s", 0, (int)(i & 1) + 1,
+                (int)(i & 8191), "bot1234");
+        if ((i & 4095) == 4095) {
+            log_discard();
+        }
+    }
+    log_discard();
+    sink += log_dropped();
+}
+
+/**
+ * Un input por frame del lado del servidor: guardar el paquete (con su
+ * historial) y sacarlo en el tick
+ */
+void bench_input_buffer(uint64_t ops) {
+    struct input_buffer buf;
+    struct input_stats stats = {0, 0, 0, 0};
+    uint16_t history = INPUT_HISTORY_EMPTY;
+    int8_t action = ACTION_IDLE;
+    
+    input_buffer_init(&buf);
+    for (uint64_t i = 0; i < ops; i++) {
+        int8_t frame_action = (int8_t)((i / 7) % 3) - 1;
+        input_buffer_receive(&buf, &stats, (uint16_t)i, frame_action, history);
+        input_buffer_next(&buf, &stats, &action);
+        history = input_history_push(history, frame_action);
+    }
+    sink += (uint64_t)action + stats.lost;
+}
+
+/**
+ * Verifica los inputs: el historial se lee igual que se escribió; con
+ * pérdida de paquetes (dentro de la redundancia) y desorden cada frame se
+ * aplica a lo sumo una vez y en orden, y lo que no se aplica se cuenta
+ * como descartado o perdido
+ * @return 0 si todo coincide
+ */
+#define VERIFY_INPUT_FRAMES 5000
+
+int verify_input(void) {
+    struct input_buffer buf;
+    struct input_stats stats = {0, 0, 0, 0};
+    static int8_t sent[VERIFY_INPUT_FRAMES];
+    uint16_t history = INPUT_HISTORY_EMPTY;
+    int ok = 1;
+    
+    for (int i = 0; i < INPUT_REDUNDANCY; i++) {
+        history = input_history_push(history, (int8_t)(i % 3) - 1);
+    }
+    for (int age = 1; age <= INPUT_REDUNDANCY; age++) {
+        int8_t action;
+        ok = ok && input_history_get(history, age, &action) == 0 &&
+             action == (int8_t)((INPUT_REDUNDANCY - age) % 3) - 1;
+    }
+    
+    // Un paquete cada 2 frames; se pierden 3 de cada 10 y uno de cada 7 llega
+    // después del siguiente. Un tick por frame.
+    input_buffer_init(&buf);
+    history = INPUT_HISTORY_EMPTY;
+    int first = -1, last = -1, applied = 0;
+    int late_seq = -1;
+    uint16_t late_history = 0;
+    for (int frame = 0; frame < VERIFY_INPUT_FRAMES; frame++) {
+        sent[frame] = (int8_t)((frame * 7 / 5) % 3) - 1;
+        if (frame % 2 == 1) {
+            int packet = frame / 2;
+            if (packet % 7 == 3) {
+                late_seq = frame;
+                late_history = history;
+            } else if (packet % 10 >= 3) {
+                input_buffer_receive(&buf, &stats, (uint16_t)frame, sent[frame], history);
+                if (late_seq >= 0) {
+                    input_buffer_receive(&buf, &stats, (uint16_t)late_seq, sent[late_seq],
+                                         late_history);
+                    late_seq = -1;
+                }
+            }
+        }
+        history = input_history_push(history, sent[frame]);
+        
+        // Lo aplicado avanza de a un frame, con la acción que se envió
+        int8_t action;
+        if (input_buffer_next(&buf, &stats, &action)) {
+            int seq = buf.applied;
+            ok = ok && seq > last && action == sent[seq];
+            if (first < 0) first = seq;
+            last = seq;
+            applied++;
+        }
+    }
+    ok = ok && stats.lost == 0 && stats.recovered > 0 &&
+         applied + (int)stats.trimmed == last - first + 1;
+    
+    // Más pérdida que redundancia: se cuenta; una ráfaga se recorta
+    struct input_stats gap_stats = {0, 0, 0, 0};
+    int8_t action;
+    input_buffer_init(&buf);
+    input_buffer_receive(&buf, &gap_stats, 100, ACTION_UP, INPUT_HISTORY_EMPTY);
+    ok = ok && input_buffer_next(&buf, &gap_stats, &action) && action == ACTION_UP;
+    input_buffer_receive(&buf, &gap_stats, 100 + INPUT_REDUNDANCY + 3, ACTION_DOWN, 0);
+    ok = ok && input_buffer_next(&buf, &gap_stats, &action) && action == ACTION_IDLE &&
+         buf.applied == 100 + INPUT_REDUNDANCY + 3 - INPUT_MAX_BACKLOG + 1 &&
+         gap_stats.lost == 2 && gap_stats.trimmed == 1;
+    input_buffer_receive(&buf, &gap_stats, 200, ACTION_UP, INPUT_HISTORY_EMPTY);
+    while (input_buffer_next(&buf, &gap_stats, &action)) {}
+    ok = ok && action == ACTION_UP && buf.applied == 200 && gap_stats.starved == 1;
+    
+    if (!ok) {
+        printf("❌ Inputs: historial, orden o conteo de perdidos incorrectos\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * MSG_SYNC del estado de una partida al empezar un frame
+ */
+void make_sync(struct sync_message *sync, const struct game_state *game, int8_t action1,
+               int8_t action2) {
+    sync->type = MSG_SYNC;
+    sync->tick = game->tick;
+    replay_keyframe_from_state(&sync->state, game, action1, action2);
+}
+
+/**
+ * MSG_INPUTS del frame frame, con el historial de los anteriores
+ */
+void make_relay(struct input_relay *relay, const int8_t *action1, const int8_t *action2,
+                uint32_t frame, int frame_ticks) {
+    relay->type = MSG_INPUTS;
+    relay->tick = frame * (uint32_t)frame_ticks;
+    relay->action1 = action1[frame];
+    relay->action2 = action2[frame];
+    relay->history1 = INPUT_HISTORY_EMPTY;
+    relay->history2 = INPUT_HISTORY_EMPTY;
+    for (uint32_t f = frame > INPUT_REDUNDANCY ? frame - INPUT_REDUNDANCY : 0; f < frame; f++) {
+        relay->history1 = input_history_push(relay->history1, action1[f]);
+        relay->history2 = input_history_push(relay->history2, action2[f]);
+    }
+}
+
+/**
+ * Una vuelta atrás de ROLLBACK_FRAMES: el cliente va al límite delante de
+ * lo confirmado, simula un frame más y llega la acción real del rival en
+ * el más viejo, distinta de la predicha
+ */
+void bench_rollback(uint64_t ops) {
+    static struct rollback rb;
+    struct game_state game;
+    struct sync_message sync;
+    struct input_relay relay;
+    
+    game_init(&game, 4242);
+    make_sync(&sync, &game, ACTION_IDLE, ACTION_IDLE);
+    rollback_init(&rb, 0);
+    rollback_sync(&rb, &sync, 1);
+    for (int f = 0; f < ROLLBACK_FRAMES - 1; f++) {
+        rollback_advance(&rb, ACTION_UP);
+    }
+    
+    for (uint64_t i = 0; i < ops; i++) {
+        int8_t peer = (i & 1) ? ACTION_DOWN : ACTION_UP;
+        rollback_advance(&rb, (i & 64) ? ACTION_UP : ACTION_DOWN);
+        relay.type = MSG_INPUTS;
+        relay.tick = rb.confirmed;
+        relay.action1 = rb.used[rb.confirmed % ROLLBACK_RING][0];
+        relay.action2 = peer;
+        relay.history1 = INPUT_HISTORY_EMPTY;
+        relay.history2 = INPUT_HISTORY_EMPTY;
+        rollback_confirm(&rb, &relay);
+        sink += (uint64_t)rollback_resimulate(&rb);
+    }
+    sink += rollback_state(&rb)->tick;
+}
+
+/**
+ * Verifica el modo rollback contra la simulación del servidor: el cliente
+ * predice al rival, los MSG_INPUTS llegan tarde y se pierden 2 de cada 10
+ * (dentro del historial) y cada tanto el servidor aplica una acción propia
+ * distinta de la simulada. Lo confirmado coincide siempre con el servidor y
+ * un MSG_SYNC de un frame confirmado no corrige nada (uno alterado, sí).
+ * Sin MSG_INPUTS el cliente espera a ROLLBACK_FRAMES; con un hueco mayor
+ * que el historial pierde el hilo y el siguiente MSG_SYNC lo retoma.
+ * @param frame_ticks Pasos por frame
+ * @return 0 si todo coincide
+ */
+#define VERIFY_ROLLBACK_FRAMES 3000
+#define VERIFY_ROLLBACK_DELAY 6    // Frames que tarda un MSG_INPUTS
+
+int verify_rollback(int frame_ticks) {
+    static struct game_state server[VERIFY_ROLLBACK_FRAMES + 1];
+    static int8_t action1[VERIFY_ROLLBACK_FRAMES];
+    static int8_t action2[VERIFY_ROLLBACK_FRAMES];
+    static struct rollback rb;
+    struct sync_message sync;
+    struct input_relay relay;
+    int ok = 1;
+    
+    game_init(&server[0], 31337);
+    server[0].frame_ticks = (uint8_t)frame_ticks;
+    for (uint32_t f = 0; f < VERIFY_ROLLBACK_FRAMES; f++) {
+        action1[f] = (int8_t)((f * 7 / 23) % 3) - 1;
+        action2[f] = (int8_t)((f / 11 + f / 17) % 3) - 1;
+        server[f + 1] = server[f];
+        for (int t = 0; t < frame_ticks; t++) {
+            game_step(&server[f + 1], action1[f], action2[f]);
+        }
+    }
+    
+    rollback_init(&rb, 0);
+    make_sync(&sync, &server[0], ACTION_IDLE, ACTION_IDLE);
+    ok = ok && rollback_sync(&rb, &sync, (uint8_t)frame_ticks) == 1;
+    
+    for (uint32_t step = 0; step < VERIFY_ROLLBACK_FRAMES + VERIFY_ROLLBACK_DELAY; step++) {
+        uint32_t arrived = step - VERIFY_ROLLBACK_DELAY;
+        if (step >= VERIFY_ROLLBACK_DELAY && arrived % 10 != 3 && arrived % 10 != 4) {
+            make_relay(&relay, action1, action2, arrived, frame_ticks);
+            ok = rollback_confirm(&rb, &relay) == 0 && ok;
+        }
+        rollback_resimulate(&rb);
+        
+        if (rb.frame < VERIFY_ROLLBACK_FRAMES) {
+            int8_t own = rb.frame % 97 == 5 ? (int8_t)-action1[rb.frame] : action1[rb.frame];
+            ok = rollback_advance(&rb, own) == 1 && ok;
+        }
+        if (rb.confirmed <= rb.frame) {
+            ok = ok && game_state_equal(&rb.states[rb.confirmed % ROLLBACK_RING],
+                                        &server[rb.confirmed]);
+        }
+    }
+    make_sync(&sync, &server[VERIFY_ROLLBACK_FRAMES], action1[VERIFY_ROLLBACK_FRAMES - 1],
+              action2[VERIFY_ROLLBACK_FRAMES - 1]);
+    ok = ok && rb.confirmed == VERIFY_ROLLBACK_FRAMES && rb.rollbacks > 0 &&
+         rollback_sync(&rb, &sync, (uint8_t)frame_ticks) == 0 && rb.desyncs == 0;
+    
+    // Un MSG_SYNC distinto de lo simulado se cuenta y lo reemplaza
+    sync.state.score1++;
+    ok = ok && rollback_sync(&rb, &sync, (uint8_t)frame_ticks) == 1 && rb.desyncs == 1 &&
+         rollback_state(&rb)->score1 == server[VERIFY_ROLLBACK_FRAMES].score1 + 1;
+    
+    // Sin MSG_INPUTS: a ROLLBACK_FRAMES de lo confirmado se espera
+    rollback_init(&rb, 1);
+    make_sync(&sync, &server[100], action1[99], action2[99]);
+    rollback_sync(&rb, &sync, (uint8_t)frame_ticks);
+    for (int f = 0; f < ROLLBACK_FRAMES + 5; f++) {
+        rollback_advance(&rb, action2[rb.frame]);
+    }
+    ok = ok && rb.frame == 100 + ROLLBACK_FRAMES && rb.stalls == 5;
+    
+    // Un hueco mayor que el historial pierde el hilo; el MSG_SYNC lo retoma
+    make_relay(&relay, action1, action2, 100 + INPUT_REDUNDANCY + 1, frame_ticks);
+    ok = ok && rollback_confirm(&rb, &relay) < 0 && rb.lost == 1 && !rollback_advance(&rb, 0);
+    make_sync(&sync, &server[110], action1[109], action2[109]);
+    ok = ok && rollback_sync(&rb, &sync, (uint8_t)frame_ticks) == 1 && rb.synced &&
+         game_state_equal(rollback_state(&rb), &server[110]);
+    
+    if (!ok) {
+        printf("❌ Rollback: lo simulado no coincide con el servidor (%d pasos por frame)\n",
+               frame_ticks);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Un alcance del perfilador (PROF_BEGIN/PROF_END con make PROFILE=1): dos
+ * lecturas del reloj y un evento en el anillo
+ */
+struct prof_ring bench_ring;
+
+void bench_prof_scope(uint64_t ops) {
+    for (uint64_t i = 0; i < ops; i++) {
+        uint64_t start = get_time_ns();
+        prof_record(&bench_ring, PROF_PHYSICS, start, get_time_ns(), (uint32_t)i);
+    }
+    prof_frame_end(&bench_ring, 0, get_time_ns(), 0, 0, FRAME_TIME_NS);
+    sink += atomic_load_explicit(&bench_ring.head, memory_order_relaxed);
+}
+
+/**
+ * Verifica el perfilador: la causa de un desborde es la fase que más ocupó
+ * al hilo (o "sistema" si estuvo libre) y el export trae solo lo que sigue
+ * en el anillo después de dar la vuelta
+ * @return 0 si todo coincide
+ */
+int verify_profiler(void) {
+    struct prof_ring *ring = malloc(sizeof(struct prof_ring));
+    struct metrics_text text = {NULL, 0, 0};
+    if (ring == NULL) {
+        return -1;
+    }
+    prof_ring_init(ring, 3);
+    
+    // A tiempo, atrasado por una fase y atrasado con el hilo libre
+    prof_record(ring, PROF_BROADCAST, 1000, 2000, 1);
+    int ok = prof_frame_end(ring, 1, 3000, 0, 1000, FRAME_TIME_NS) < 0;
+    prof_record(ring, PROF_PHYSICS, 10000, 12000, 2);
+    prof_record(ring, PROF_BROADCAST, 12000, 10000000 + 12000, 2);
+    ok = ok && prof_frame_end(ring, 2, 20000000, 9000000, 10000000, FRAME_TIME_NS) == PROF_BROADCAST;
+    prof_record(ring, PROF_RECV, 20000000, 20001000, 3);
+    ok = ok && prof_frame_end(ring, 3, 40000000, 12000000, 100000, FRAME_TIME_NS) == PROF_SYSTEM;
+    ok = ok && ring->overruns[PROF_BROADCAST] == 1 && ring->overruns[PROF_SYSTEM] == 1;
+    
+    // Dar la vuelta: quedan los últimos PROF_RING_EVENTS menos el más viejo,
+    // que el export descarta porque el escritor podría estar pisándolo
+    for (uint32_t i = 0; i < PROF_RING_EVENTS + 100; i++) {
+        prof_record(ring, PROF_SEND, 50000000 + i * 1000ULL, 50000000 + i * 1000ULL + 500, 4 + i);
+    }
+    prof_export_chrome(&text, &ring, 1);
+    
+    int events = 0;
+    for (const char *p = text.data; p != NULL && (p = strstr(p, "\"ph\":\"X\"")) != NULL; p++) {
+        events++;
+    }
+    char last[64];
+    snprintf(last, sizeof(last), "\"args\":{\"tick\":%u}}\n]}", 4 + PROF_RING_EVENTS + 99);
+    ok = ok && events == PROF_RING_EVENTS - 1 && strstr(text.data, "sendmmsg") != NULL &&
+         strstr(text.data, "\"causa\"") == NULL && strstr(text.data, last) != NULL;
+    
+    free(text.data);
+    free(ring);
+    if (!ok) {
+        printf("❌ Perfilador: causa de desborde o export incorrectos\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Lee el archivo completo
+ * @return Bytes leídos (buf termina en '\0') o -1
+ */
+ssize_t read_back(int fd, char *buf, size_t size) {
+    ssize_t len = pread(fd, buf, size - 1, 0);
+    if (len >= 0) buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Verifica el log: cada mensaje sale igual que con printf, por la cola y
+ * por el archivo binario ida y vuelta, también con LOG_MAX_ARGS argumentos;
+ * los niveles filtran y, con la cola llena o argumentos de más, se cuenta
+ * y se avisa cuántos
+ * @return 0 si todo coincide
+ */
+#define VERIFY_LOG_LINES 9
+
+#define VERIFY_LOG(...) do { \
+        snprintf(expected[n++], sizeof(expected[0]), __VA_ARGS__); \
+        log_msg(__VA_ARGS__); \
+    } while (0)
+
+int verify_log(void) {
+    static char expected[VERIFY_LOG_LINES][256];
+    static char buf[65536];
+    char path[] = "/tmp/pong_bench_logXXXXXX";
+    int ok = 1;
+    
+    for (int output = LOG_OUTPUT_TEXT; ok && output <= LOG_OUTPUT_BINARY; output += 2) {
+        int fd = mkstemp(path);
+        if (fd < 0 || log_init(LOG_LEVEL_INFO, (enum log_output)output, fd) < 0) {
+            return -1;
+        }
+        unlink(path);
+        memcpy(path + strlen(path) - 6, "XXXXXX", 6);
+        
+        int n = 0;
+        log_debug("no debería salir: %d", 1);
+        VERIFY_LOG("⚽ [shard %d] GOL en sala %d! Jugador 2 anota. Marcador: %d - %d", 1, 42, 3, 2);
+        VERIFY_LOG("📶 %.0f rx/s | %.1f KB/s | %.2f%% | %u ajenos", 12345.6, 78.91, 0.125, 7u);
+        VERIFY_LOG("%llu/%llu us %5.1f%%", 123ULL, 4567ULL, 99.25);
+        VERIFY_LOG("[%-8s] [%8s] %c %x %X %o %#x", "bot", "p2", 'z', 255u, 48879u, 8u, 16u);
+        VERIFY_LOG("%hhd %hu %ld %zu %jd %+05d %e %g", 253, 65535, -123456789L, (size_t)42,
+                   (intmax_t)-7, 42, 1.5e-7, 0.0001);
+        VERIFY_LOG("nombre \"%s\" y %s", "a\\b", "");
+        VERIFY_LOG("100%%");
+        VERIFY_LOG("sin argumentos");
+        VERIFY_LOG("⏱️ [shard %d] p50/p90/p99/p99.9 | Tick: %llu/%llu/%llu/%llu us | "
+                   "Input->envío: %.1f/%.1f/%.1f/%.1f ms | RTT: %.1f/%.1f/%.1f/%.1f ms | "
+                   "%u ticks descartados por atraso", 3, 120ULL, 250ULL, 900ULL, 4100ULL,
+                   0.4, 0.9, 2.5, 7.1, 0.8, 1.7, 7.0, 12.5, 2u);
+        log_drain();
+        
+        ssize_t len = read_back(fd, buf, sizeof(buf));
+        close(fd);
+        if (len < 0) {
+            return -1;
+        }
+        
+        // El binario se vuelve a texto con el lector
+        char *text = buf;
+        static char decoded[65536];
+        if (output == LOG_OUTPUT_BINARY) {
+            static struct log_reader reader;
+            struct log_record rec;
+            size_t used = 0;
+            ok = log_reader_init(&reader, (const uint8_t *)buf, (size_t)len) == 0;
+            while (ok && log_reader_next(&reader, &rec) > 0) {
+                used += log_render(&rec, LOG_OUTPUT_TEXT, decoded + used, sizeof(decoded) - used);
+            }
+            log_reader_free(&reader);
+            text = decoded;
+        }
+        
+        // "[HH:MM:SS] " + el mensaje, una línea por mensaje
+        for (int i = 0; ok && i < n; i++) {
+            char *end = strchr(text, '\n');
+            ok = end != NULL && end - text > 11 && text[0] == '[';
+            if (!ok) break;
+            *end = '\0';
+            ok = strcmp(text + 11, expected[i]) == 0;
+            if (!ok) {
+                printf("❌ Log: \"%s\" en vez de \"%s\"\n", text + 11, expected[i]);
+            }
+            text = end + 1;
+        }
+        ok = ok && *text == '\0';
+    }
+    
+    // Con la cola llena se descarta y el escritor lo avisa
+    int fd = mkstemp(path);
+    if (!ok || fd < 0 || log_init(LOG_LEVEL_INFO, LOG_OUTPUT_TEXT, fd) < 0) {
+        printf("❌ Log: la salida no coincide con printf\n");
+        return -1;
+    }
+    unlink(path);
+    for (int i = 0; i < LOG_QUEUE_CAPACITY + 5; i++) {
+        log_msg("mensaje %d", i);
+    }
+    ok = log_dropped() == 5 && log_drain() == LOG_QUEUE_CAPACITY;
+    
+    // El aviso es la última línea
+    off_t end = lseek(fd, 0, SEEK_END);
+    ok = ok && end > 256 && pread(fd, buf, 256, end - 256) == 256;
+    buf[256] = '\0';
+    ok = ok && strstr(buf, "WARN 📝 5 mensajes de log descartados") != NULL;
+    close(fd);
+    if (!ok) {
+        printf("❌ Log: la cola llena no descartó lo esperado\n");
+        return -1;
+    }
+    
+    // Más de LOG_MAX_ARGS: lo que sobra sale sin reemplazar y se avisa
+    memcpy(path + strlen(path) - 6, "XXXXXX", 6);
+    fd = mkstemp(path);
+    if (fd < 0 || log_init(LOG_LEVEL_INFO, LOG_OUTPUT_TEXT, fd) < 0) {
+        return -1;
+    }
+    unlink(path);
+    log_msg("%d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d | %d %s", 1, 2, 3, 4, 5, 6, 7, 8,
+            9, 10, 11, 12, 13, 14, 15, 16, 17, "x");
+    ok = log_truncated() == 1 && log_drain() == 1 && read_back(fd, buf, sizeof(buf)) > 0 &&
+         strstr(buf, "] 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 | %d %s\n") != NULL &&
+         strstr(buf, "WARN 📝 1 mensajes de log con más argumentos") != NULL;
+    close(fd);
+    if (!ok) {
+        printf("❌ Log: los argumentos de más no se avisaron\n");
+        return -1;
+    }
+    return 0;
+}
+
+// --- Línea base ------------------------------------------------------------
+
+/**
+ * Busca un caso en la línea base
+ * @return ns/op de la línea base o -1 si no está
+ */
+double baseline_lookup(FILE *f, const char *name) {
+    char line[128];
+    char case_name[BENCH_NAME_LEN];
+    double ns;
+    
+    rewind(f);
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%31s %lf", case_name, &ns) == 2 && strcmp(case_name, name) == 0) {
+            return ns;
+        }
+    }
+    return -1;
+}
+
+int write_baseline(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror("No se pudo escribir la línea base");
+        return -1;
+    }
+    
+    fprintf(f, "# caso ns/op (generado por pong_bench -w)\n");
+    for (int i = 0; i < num_results; i++) {
+        fprintf(f, "%s %.3f\n", results[i].name, results[i].ns_per_op);
+    }
+    fclose(f);
+    printf("Línea base guardada en %s\n", path);
+    return 0;
+}
+
+/**
+ * Imprime los resultados y los compara con la línea base
+ * @return Cantidad de casos que empeoraron más del umbral
+ */
+int report(FILE *baseline, double threshold) {
+    int regressions = 0;
+    
+    printf("\n%-24s %10s %10s %10s %8s\n", "caso", "ns/op", "allocs/op", "base", "cambio");
+    printf("%-24s %10s %10s %10s %8s\n", "------------------------", "----------",
+           "----------", "----------", "--------");
+    
+    for (int i = 0; i < num_results; i++) {
+        struct bench_result *r = &results[i];
+        double base = baseline ? baseline_lookup(baseline, r->name) : -1;
+        
+        printf("%-24s %10.2f %10.2f", r->name, r->ns_per_op, r->allocs_per_op);
+        if (base > 0) {
+            double change = (r->ns_per_op - base) / base * 100.0;
+            int regressed = change > threshold;
+            regressions += regressed;
+            printf(" %10.2f %+7.1f%%%s\n", base, change, regressed ? "  ⚠️ REGRESIÓN" : "");
+        } else {
+            printf(" %10s %8s\n", "-", "-");
+        }
+    }
+    
+    return regressions;
+}
+
+/**
+ * Muestra el uso
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [-b base] [-w base] [-t umbral] [-s escala]\n", prog);
+    printf("  -b ARCHIVO  Comparar contra la línea base (falla si hay regresiones)\n");
+    printf("  -w ARCHIVO  Guardar los resultados como nueva línea base\n");
+    printf("  -t PCT      Empeoramiento tolerado en %% (por defecto %.0f)\n",
+           BENCH_DEFAULT_THRESHOLD);
+    printf("  -s N        Multiplicar las iteraciones (por defecto 1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *baseline_path = NULL;
+    const char *write_path = NULL;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    uint64_t scale = 1;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "b:w:t:s:h")) != -1) {
+        if (opt == 'b') {
+            baseline_path = optarg;
+        } else if (opt == 'w') {
+            write_path = optarg;
+        } else if (opt == 't') {
+            threshold = atof(optarg);
+        } else if (opt == 's') {
+            scale = strtoull(optarg, NULL, 10);
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (scale == 0) scale = 1;
+    
+    prepare_states();
+    if (verify_snapshot() < 0) {
+        return 1;
+    }
+    dgram_batch_init(&bench_batch);
+    if (session_table_init(&sessions, BENCH_SESSIONS, 0x5eed) < 0 || verify_sessions() < 0) {
+        return 1;
+    }
+    if (verify_stats_rtt() < 0 || verify_timer_wheel() < 0 || verify_lfqueue() < 0 ||
+        verify_replay() < 0 || verify_log() < 0 || verify_input() < 0 || verify_rollback(1) < 0 ||
+        verify_rollback(2) < 0) {
+        return 1;
+    }
+    if (lf_queue_init(&bench_queue, 1024, 32) < 0 ||
+        match_queue_init(&bench_match, 0, 1024) < 0 ||
+        replay_stream_init(&bench_replay, open("/dev/null", O_WRONLY), -1, 0, TARGET_FPS) < 0 ||
+        log_init(LOG_LEVEL_INFO, LOG_OUTPUT_TEXT, open("/dev/null", O_WRONLY)) < 0) {
+        return 1;
+    }
+    
+    // Después del log: los avisos de desborde van a la cola y se descartan
+    prof_ring_init(&bench_ring, 0);
+    if (verify_profiler() < 0) {
+        return 1;
+    }
+    
+    // Los kernels en lote tienen que ser idénticos al escalar antes de medirlos
+    enum game_kernel kernels[] = {GAME_KERNEL_SCALAR, GAME_KERNEL_SSE2, GAME_KERNEL_AVX2};
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!game_kernel_supported(kernels[k])) continue;
+        if (verify_kernel(kernels[k], 1) < 0 || verify_kernel(kernels[k], 2) < 0 ||
+            verify_kernel(kernels[k], 3) < 0) {
+            return 1;
+        }
+    }
+    if (verify_frame_ticks() < 0) {
+        return 1;
+    }
+    
+    run_case("game_step", bench_game_step, 5000000 * scale);
+    run_case("game_batch_scalar", bench_game_batch_scalar, 5000000 * scale);
+    if (game_kernel_supported(GAME_KERNEL_SSE2)) {
+        run_case("game_batch_sse2", bench_game_batch_sse2, 20000000 * scale);
+    }
+    if (game_kernel_supported(GAME_KERNEL_AVX2)) {
+        run_case("game_batch_avx2", bench_game_batch_avx2, 20000000 * scale);
+    }
+    run_case("snapshot_encode_delta", bench_snapshot_delta, 5000000 * scale);
+    run_case("snapshot_encode_key", bench_snapshot_keyframe, 5000000 * scale);
+    run_case("snapshot_decode_delta", bench_snapshot_decode, 5000000 * scale);
+    run_case("spectator_queue", bench_spectator_queue, 10000000 * scale);
+    run_case("server_message_build", bench_server_message, 5000000 * scale);
+    run_case("stats_update_rtt", bench_stats_update_rtt, 5000000 * scale);
+    run_case("stats_update_rtt_hist", bench_stats_update_rtt_hist, 5000000 * scale);
+    run_case("stats_packet_sent", bench_stats_packet_sent, 2000000 * scale);
+    run_case("stats_track_sequence", bench_stats_track_sequence, 5000000 * scale);
+    run_case("histogram_record", bench_histogram_record, 5000000 * scale);
+    run_case("session_find_100k", bench_session_find, 5000000 * scale);
+    run_case("session_churn_100k", bench_session_churn, 2000000 * scale);
+    run_case("idle_wheel_1k", bench_idle_wheel_1k, 5000000 * scale);
+    run_case("idle_wheel_100k", bench_idle_wheel_100k, 5000000 * scale);
+    run_case("lfqueue_push_pop", bench_lfqueue_push_pop, 10000000 * scale);
+    run_case("match_publish_take", bench_match_publish_take, 5000000 * scale);
+    run_case("replay_append_input", bench_replay_append, 10000000 * scale);
+    run_case("log_msg_async", bench_log_msg, 10000000 * scale);
+    run_case("log_msg_async_string", bench_log_msg_string, 10000000 * scale);
+    run_case("input_buffer_frame", bench_input_buffer, 10000000 * scale);
+    run_case("rollback_resim_12", bench_rollback, 200000 * scale);
+    run_case("prof_scope", bench_prof_scope, 5000000 * scale);
+    run_case("get_time_ms", bench_get_time_ms, 2000000 * scale);
+    run_case("get_time_us", bench_get_time_us, 2000000 * scale);
+    run_case("get_time_ns", bench_get_time_ns, 2000000 * scale);
+    run_case("clock_now_ns", bench_clock_now_ns, 5000000 * scale);
+    
+    FILE *baseline = NULL;
+    if (baseline_path != NULL) {
+        baseline = fopen(baseline_path, "r");
+        if (baseline == NULL) {
+            printf("Sin línea base en %s (crearla con -w)\n", baseline_path);
+        }
+    }
+    
+    int regressions = report(baseline, threshold);
+    if (baseline != NULL) fclose(baseline);
+    
+    if (write_path != NULL && write_baseline(write_path) < 0) {
+        return 1;
+    }
+    
+    if (regressions > 0) {
+        printf("\n%d %s más de %.0f%% respecto de la línea base\n", regressions,
+               regressions == 1 ? "caso empeoró" : "casos empeoraron", threshold);
+        return 1;
+    }
+    return 0;
+}
+
+// --- Conteo de asignaciones (-Wl,--wrap=...) -------------------------------
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
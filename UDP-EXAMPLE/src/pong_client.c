@@ -1,14 +1,22 @@
-#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <fcntl.h>
+#include <errno.h>
 #include <ncurses.h>
+#include <sys/epoll.h>
 #include "protocol.h"
 #include "utils.h"
 #include "stats.h"
+#include "netio.h"
+#include "snapshot.h"
+#include "game.h"
+#include "interp.h"
+#include "histogram.h"
+#include "input.h"
+#include "rollback.h"
 
 // Ventanas de ncurses
 WINDOW *game_win;
@@ -18,9 +26,64 @@ WINDOW *stats_win;
 struct sockaddr_in server_addr;
 int sockfd;
 uint8_t my_player_id = 0;
+uint16_t my_room_id = 0;
+uint32_t session_token = 0;     // Token de sesión entregado en el JOIN
+int peer_left_reason = -1;      // Último MSG_PEER_LEFT sin partida nueva (-1 = ninguno)
 struct server_message last_state;
 struct network_stats client_stats;
+struct histogram rtt_hist;     // Percentiles de RTT (µs) de toda la sesión
 uint32_t last_send_time = 0;
+uint16_t packet_seq = 0;       // Secuencia del próximo paquete enviado
+
+// Modo espectador (-w): mira una sala sin jugar
+int spectating = 0;
+uint16_t spectate_room = SPECTATE_ANY_ROOM;
+uint8_t spectate_shard = SPECTATE_ANY_SHARD;
+uint16_t snapshots_received = 0; // Se informa en cada mensaje (pérdida de bajada)
+uint32_t last_keepalive_ms = 0;
+int room_closed = 0;           // El servidor cerró la sala que se miraba
+
+// El servidor elige cada cuánto manda snapshots: la pérdida de bajada de un
+// jugador sale de comparar lo que dice haber enviado (SNAP_STATS) con lo que
+// llegó desde las estadísticas anteriores
+uint32_t stats_snap_sent = 0;  // packets_sent del último SNAP_STATS
+uint16_t stats_snap_recv = 0;  // snapshots_received en ese momento
+int server_tick_rate = TARGET_FPS; // Ticks por segundo del servidor (respuesta al JOIN)
+
+// Snapshots recibidos (bases para decodificar deltas), indexados por tick
+struct snapshot snap_history[SNAP_HISTORY];
+uint16_t last_tick = 0;        // Snapshot más reciente aplicado (0 = ninguno)
+uint32_t last_full_tick = 0;   // last_tick extendido a 32 bits
+uint32_t last_tick_recv_ms = 0; // Cuándo llegó last_tick (espera informada con el ack)
+
+// Buffer de reproducción con interpolación y retardo adaptativo
+struct interp_buffer interp;
+struct interp_sample view;     // Estado interpolado que se dibuja
+int view_mode = INTERP_NONE;
+
+// Predicción de la paleta propia: inputs enviados que el servidor aún no procesó
+#define PREDICTION_BUFFER 128  // Potencia de 2; cubre ~2 s de inputs a 60 FPS
+
+struct pending_input {
+    uint16_t seq;
+    int8_t action;
+};
+
+struct pending_input pending_inputs[PREDICTION_BUFFER];
+uint16_t input_seq = 0;        // Último input generado
+uint16_t acked_input_seq = 0;  // Último input procesado por el servidor
+uint16_t input_history = INPUT_HISTORY_EMPTY;  // Acciones de los frames anteriores (redundancia)
+
+// Ritmo de envío de inputs (-r), independiente del de dibujo: cada paquete
+// lleva los frames que pasaron desde el anterior en input_history
+#define MIN_SEND_RATE (TARGET_FPS / (INPUT_REDUNDANCY + 1) + 1)
+int send_interval = 1;         // Frames entre dos INPUT programados
+float server_paddle_y = FIELD_HEIGHT / 2.0f;  // Paleta propia según el servidor
+
+// Modo rollback (-k): la partida se simula aquí, adelantada a lo que
+// confirmó el servidor, y se corrige al llegar las acciones reales
+int rollback_mode = 0;
+struct rollback rb;
 
 /**
  * Inicializa ncurses
@@ -62,6 +125,34 @@ void cleanup_ncurses(void) {
     endwin();
 }
 
+/**
+ * Predice la paleta propia: parte de la última posición confirmada por el
+ * servidor y reaplica los inputs que éste todavía no procesó, con las
+ * mismas reglas que usa la simulación del servidor (game_move_paddle).
+ */
+float predict_paddle(void) {
+    game_scalar y = GAME_FROM_FLOAT(server_paddle_y);
+    uint16_t pending = input_seq - acked_input_seq;
+    
+    if (pending >= PREDICTION_BUFFER) {
+        pending = PREDICTION_BUFFER - 1;
+    }
+    
+    for (uint16_t seq = input_seq - pending + 1; seq != (uint16_t)(input_seq + 1); seq++) {
+        y = game_move_paddle(y, pending_inputs[seq % PREDICTION_BUFFER].action);
+    }
+    
+    return GAME_TO_FLOAT(y);
+}
+
+/**
+ * Registra la acción del frame actual como input pendiente de confirmar
+ */
+void record_input(uint16_t seq, int8_t action) {
+    pending_inputs[seq % PREDICTION_BUFFER].seq = seq;
+    pending_inputs[seq % PREDICTION_BUFFER].action = action;
+}
+
 /**
  * Renderiza el campo de juego
  */
@@ -86,9 +177,15 @@ void render_game(void) {
         mvwaddch(game_win, y, win_width / 2, ':');
     }
     
+    // La paleta propia se dibuja predicha; la del rival y la pelota,
+    // interpoladas. En modo rollback todo sale de la simulación local.
+    int predict = !(rollback_mode && rb.synced);
+    float paddle1_y = predict && my_player_id == 1 ? predict_paddle() : view.paddle1_y;
+    float paddle2_y = predict && my_player_id == 2 ? predict_paddle() : view.paddle2_y;
+    
     // Dibujar paleta jugador 1 (izquierda)
     wattron(game_win, COLOR_PAIR(2));
-    int paddle1_screen_y = (int)(last_state.paddle1_y * scale_y);
+    int paddle1_screen_y = (int)(paddle1_y * scale_y);
     int paddle_height_screen = (int)(PADDLE_HEIGHT * scale_y);
     for (int i = 0; i < paddle_height_screen; i++) {
         int y = paddle1_screen_y - paddle_height_screen / 2 + i + 1;
@@ -100,7 +197,7 @@ void render_game(void) {
     
     // Dibujar paleta jugador 2 (derecha)
     wattron(game_win, COLOR_PAIR(2));
-    int paddle2_screen_y = (int)(last_state.paddle2_y * scale_y);
+    int paddle2_screen_y = (int)(paddle2_y * scale_y);
     for (int i = 0; i < paddle_height_screen; i++) {
         int y = paddle2_screen_y - paddle_height_screen / 2 + i + 1;
         if (y >= 1 && y < win_height) {
@@ -111,8 +208,8 @@ void render_game(void) {
     
     // Dibujar pelota
     wattron(game_win, COLOR_PAIR(3) | A_BOLD);
-    int ball_screen_x = (int)(last_state.ball_x * scale_x) + 1;
-    int ball_screen_y = (int)(last_state.ball_y * scale_y) + 1;
+    int ball_screen_x = (int)(view.ball_x * scale_x) + 1;
+    int ball_screen_y = (int)(view.ball_y * scale_y) + 1;
     if (ball_screen_x >= 1 && ball_screen_x < win_width && 
         ball_screen_y >= 1 && ball_screen_y < win_height) {
         mvwaddch(game_win, ball_screen_y, ball_screen_x, 'O');
@@ -126,7 +223,11 @@ void render_game(void) {
     wattroff(game_win, A_BOLD);
     
     // Controles
-    mvwprintw(game_win, win_height + 2, 2, "Controles: W=Arriba S=Abajo Q=Salir");
+    if (spectating) {
+        mvwprintw(game_win, win_height + 2, 2, "Espectador: Q=Salir");
+    } else {
+        mvwprintw(game_win, win_height + 2, 2, "Controles: W=Arriba S=Abajo Q=Salir");
+    }
     
     wrefresh(game_win);
 }
@@ -149,11 +250,18 @@ void render_stats(void) {
     mvwprintw(stats_win, 2, 2, "=== RED ===");
     mvwprintw(stats_win, 3, 2, "RTT:        %5.1f ms", client_stats.rtt_current);
     mvwprintw(stats_win, 4, 2, "RTT Prom:   %5.1f ms", client_stats.rtt_avg);
-    mvwprintw(stats_win, 5, 2, "Perdida:    %5u %%", stats_get_loss_percent(&client_stats));
-    
-    mvwprintw(stats_win, 7, 2, "Enviados:   %5u", client_stats.packets_sent);
-    mvwprintw(stats_win, 8, 2, "Recibidos:  %5u", client_stats.packets_received);
-    mvwprintw(stats_win, 9, 2, "Perdidos:   %5u", client_stats.packets_lost);
+    mvwprintw(stats_win, 5, 2, "RTT p50/90: %5.1f/%5.1f",
+              histogram_percentile(&rtt_hist, 50) / 1000.0,
+              histogram_percentile(&rtt_hist, 90) / 1000.0);
+    mvwprintw(stats_win, 6, 2, "RTT p99/.9: %5.1f/%5.1f",
+              histogram_percentile(&rtt_hist, 99) / 1000.0,
+              histogram_percentile(&rtt_hist, 99.9) / 1000.0);
+    mvwprintw(stats_win, 7, 2, "Perdida:    %5u %% (sub %u %%)",
+              stats_get_loss_percent(&client_stats), last_state.loss_percent);
+    
+    mvwprintw(stats_win, 8, 2, "Enviados:   %5u", client_stats.packets_sent);
+    mvwprintw(stats_win, 9, 2, "Recibidos:  %5u", client_stats.packets_received);
+    mvwprintw(stats_win, 10, 2, "Perdidos:   %5u", client_stats.packets_lost);
     
     // Estadísticas del juego
     mvwprintw(stats_win, 11, 2, "=== JUEGO ===");
@@ -167,18 +275,44 @@ void render_stats(void) {
     
     // Estado de conexión
     mvwprintw(stats_win, 19, 2, "=== CONEXION ===");
-    if (my_player_id > 0) {
+    if (spectating) {
+        wattron(stats_win, A_BOLD);
+        mvwprintw(stats_win, 20, 2, "Estado:     ESPECTADOR");
+        mvwprintw(stats_win, 21, 2, "Snapshots:  %u", snapshots_received);
+        mvwprintw(stats_win, 22, 2, "Sala:       %u", my_room_id);
+        if (peer_left_reason >= 0) {
+            mvwprintw(stats_win, 23, 2, "Partida:    JUGADOR SALIO");
+        }
+        wattroff(stats_win, A_BOLD);
+    } else if (my_player_id > 0) {
         wattron(stats_win, A_BOLD);
         mvwprintw(stats_win, 20, 2, "Estado:     CONECTADO");
         mvwprintw(stats_win, 21, 2, "ID:         Jugador %d", my_player_id);
+        mvwprintw(stats_win, 22, 2, "Sala:       %u", my_room_id);
+        if (peer_left_reason >= 0) {
+            mvwprintw(stats_win, 23, 2, "Rival:      %s",
+                      peer_left_reason == PEER_LEFT_TIMEOUT ? "SIN RESPUESTA" : "SALIO");
+        }
         wattroff(stats_win, A_BOLD);
     } else {
         mvwprintw(stats_win, 20, 2, "Estado:     ESPERANDO...");
     }
     
     // Información del servidor
-    mvwprintw(stats_win, 23, 2, "=== SERVIDOR ===");
-    mvwprintw(stats_win, 24, 2, "Timestamp:  %u", last_state.timestamp);
+    mvwprintw(stats_win, 24, 2, "=== SERVIDOR ===");
+    mvwprintw(stats_win, 25, 2, "Tick:       %u (%d Hz)", last_full_tick, server_tick_rate);
+    if (rollback_mode) {
+        mvwprintw(stats_win, 26, 2, "Adelanto:   %5d frames %s", (int32_t)(rb.frame - rb.confirmed),
+                  rb.synced ? "" : "(sync)");
+        mvwprintw(stats_win, 27, 2, "Rollbacks:  %5u (%u fr)", rb.rollbacks, rb.resimulated);
+        mvwprintw(stats_win, 28, 2, "Desincr.:   %5u", rb.desyncs);
+    } else {
+        mvwprintw(stats_win, 26, 2, "Retardo:    %5.1f ms %s", interp.delay_ms,
+                  view_mode == INTERP_EXTRAPOLATED ? "(extrap)" :
+                  view_mode == INTERP_HELD ? "(pausa)" : "");
+        mvwprintw(stats_win, 27, 2, "Jitter:     %5.1f ms", interp.jitter_ms);
+        mvwprintw(stats_win, 28, 2, "Desorden:   %5u", client_stats.packets_reordered);
+    }
     
     wattroff(stats_win, COLOR_PAIR(4));
     
@@ -190,6 +324,15 @@ void render_stats(void) {
  */
 void send_message(struct client_message *msg) {
     msg->timestamp = get_time_ms();
+    msg->seq = packet_seq++;
+    msg->session_token = session_token;
+    msg->snapshots_recv = snapshots_received;
+    
+    // Lo que el snapshot confirmado esperó aquí se descuenta del RTT del servidor
+    if (msg->ack_tick != 0) {
+        uint32_t hold = msg->timestamp - last_tick_recv_ms;
+        msg->ack_hold_ms = hold > 255 ? 255 : (uint8_t)hold;
+    }
     sendto(sockfd, msg, sizeof(*msg), 0, 
            (struct sockaddr *)&server_addr, sizeof(server_addr));
     stats_packet_sent(&client_stats, sizeof(*msg));
@@ -197,14 +340,171 @@ void send_message(struct client_message *msg) {
 }
 
 /**
- * Conecta al servidor
+ * Decodifica un snapshot y, si es el más nuevo, lo aplica al estado mostrado
+ * @return 1 si se aplicó, 0 si se descartó
+ */
+int handle_snapshot(const uint8_t *buf, size_t len) {
+    struct snapshot_header header;
+    if (snapshot_read_header(buf, len, &header) < 0) return 0;
+    
+    // Buscar la base en el historial (debe ser exactamente ese tick)
+    const struct snapshot *base = NULL;
+    if (header.base_offset != 0) {
+        uint16_t base_tick = header.tick - header.base_offset;
+        base = &snap_history[base_tick % SNAP_HISTORY];
+        if ((uint16_t)base->tick != base_tick) return 0;
+    }
+    
+    // El servidor no manda todos los ticks: la pérdida se cuenta por snapshots
+    snapshots_received++;
+    
+    struct snapshot snap;
+    struct snapshot_extra extra;
+    if (snapshot_decode(buf, len, base, &snap, &extra) < 0) return 0;
+    
+    // RTT = ahora - timestamp devuelto - lo que esperó en el servidor
+    if (extra.mask & SNAP_ECHO) {
+        int rtt = (uint16_t)((uint16_t)get_time_ms() - extra.echo_ts) - extra.echo_hold_ms;
+        stats_update_rtt(&client_stats, rtt > 0 ? rtt : 0);
+    }
+    
+    snap.tick = header.tick;
+    snap_history[header.tick % SNAP_HISTORY] = snap;
+    
+    // Extender el tick a 32 bits respecto del último aceptado
+    uint32_t full_tick = last_tick == 0 ? header.tick :
+                         last_full_tick + (int16_t)(header.tick - last_tick);
+    
+    // Un snapshot viejo sirve como base pero no se muestra
+    if (last_tick != 0 && (int32_t)(full_tick - last_full_tick) <= 0) {
+        interp.dropped++;
+        return 0;
+    }
+    last_tick = header.tick;
+    last_full_tick = full_tick;
+    last_tick_recv_ms = get_time_ms();
+    
+    last_state.paddle1_y = snapshot_dequantize(snap.paddle1_y);
+    last_state.paddle2_y = snapshot_dequantize(snap.paddle2_y);
+    last_state.ball_x = snapshot_dequantize(snap.ball_x);
+    last_state.ball_y = snapshot_dequantize(snap.ball_y);
+    last_state.score1 = snap.score1;
+    last_state.score2 = snap.score2;
+    
+    struct interp_sample sample;
+    sample.tick = full_tick;
+    sample.paddle1_y = last_state.paddle1_y;
+    sample.paddle2_y = last_state.paddle2_y;
+    sample.ball_x = last_state.ball_x;
+    sample.ball_y = last_state.ball_y;
+    interp_push(&interp, &sample, get_time_us() / 1000.0);
+    
+    // Reconciliación: la paleta propia del servidor corresponde al input confirmado
+    server_paddle_y = my_player_id == 1 ? last_state.paddle1_y : last_state.paddle2_y;
+    if (extra.mask & SNAP_INPUT_ACK) {
+        // Extender los 8 bits del ack con el último seq enviado
+        acked_input_seq = input_seq - (uint8_t)((uint8_t)input_seq - extra.input_ack);
+    }
+    
+    // Estadísticas del enlace vistas desde el servidor
+    if (extra.mask & SNAP_STATS) {
+        last_state.rtt_ms = extra.stats.rtt_ms;
+        last_state.loss_percent = extra.stats.loss_percent;
+        last_state.packets_sent = extra.stats.packets_sent;
+        last_state.packets_recv = extra.stats.packets_recv;
+        
+        // Si el contador del servidor volvió a empezar (otra sala), todo es nuevo
+        uint32_t sent = extra.stats.packets_sent -
+                        (extra.stats.packets_sent >= stats_snap_sent ? stats_snap_sent : 0);
+        uint16_t recv = snapshots_received - stats_snap_recv;
+        if (sent > recv) {
+            client_stats.packets_lost += sent - recv;
+        }
+        stats_snap_sent = extra.stats.packets_sent;
+        stats_snap_recv = snapshots_received;
+    }
+    
+    return 1;
+}
+
+/**
+ * Aplica un MSG_STATE recibido durante el juego: empieza una partida o el
+ * emparejamiento llevó al jugador a otra sala (quizás de otro shard y del
+ * otro lado). En ese caso los ticks y la predicción vuelven a empezar.
+ */
+void handle_state(const struct server_message *msg) {
+    if (msg->player_id != my_player_id || msg->room_id != my_room_id) {
+        my_player_id = msg->player_id;
+        my_room_id = msg->room_id;
+        last_tick = 0;
+        server_tick_rate = msg->tick_rate;
+        interp_init(&interp, server_tick_rate);
+        rollback_init(&rb, my_player_id - 1);
+        acked_input_seq = input_seq;
+        server_paddle_y = my_player_id == 1 ? msg->paddle1_y : msg->paddle2_y;
+    }
+    session_token = msg->session_token;
+    
+    last_state.paddle1_y = msg->paddle1_y;
+    last_state.paddle2_y = msg->paddle2_y;
+    last_state.ball_x = msg->ball_x;
+    last_state.ball_y = msg->ball_y;
+    last_state.score1 = msg->score1;
+    last_state.score2 = msg->score2;
+    peer_left_reason = -1;
+}
+
+/**
+ * Modo rollback: corrige lo simulado con las acciones reales que llegaron
+ * y avanza la simulación local. Va delante de lo confirmado tantos frames
+ * como inputs propios le faltan confirmar al servidor (lo que tarda un
+ * input en aplicarse): si se atrasó avanza dos frames, si se adelantó
+ * espera uno.
+ */
+void step_rollback(int8_t action) {
+    rollback_resimulate(&rb);
+    if (!rb.synced) return;
+    
+    uint32_t target = rb.confirmed + (uint16_t)(input_seq - acked_input_seq);
+    for (int i = 0; i < 2 && (int32_t)(target - rb.frame) > 0; i++) {
+        rollback_advance(&rb, action);
+    }
+    
+    const struct game_state *game = rollback_state(&rb);
+    view.paddle1_y = GAME_TO_FLOAT(game->paddle1_y);
+    view.paddle2_y = GAME_TO_FLOAT(game->paddle2_y);
+    view.ball_x = GAME_TO_FLOAT(game->ball_x);
+    view.ball_y = GAME_TO_FLOAT(game->ball_y);
+}
+
+/**
+ * Keepalive del espectador: confirma el último snapshot y cuántos llegaron
+ */
+void send_keepalive(void) {
+    struct client_message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.type = MSG_SPECTATE;
+    msg.ack_tick = last_tick;
+    
+    send_message(&msg);
+}
+
+/**
+ * Conecta al servidor como jugador o, con -w, como espectador
  */
 int connect_to_server(const char *player_name) {
     struct client_message msg;
     memset(&msg, 0, sizeof(msg));
     
-    msg.type = MSG_JOIN;
-    strncpy(msg.player_name, player_name, PLAYER_NAME_LEN - 1);
+    if (spectating) {
+        msg.type = MSG_SPECTATE;
+        msg.input_seq = spectate_room;
+        msg.ack_hold_ms = spectate_shard;
+    } else {
+        msg.type = MSG_JOIN;
+        msg.action = rollback_mode ? JOIN_ROLLBACK : 0;
+        strncpy(msg.player_name, player_name, PLAYER_NAME_LEN - 1);
+    }
     
     send_message(&msg);
     
@@ -224,33 +524,91 @@ int connect_to_server(const char *player_name) {
     if (received > 0 && last_state.type == MSG_STATE) {
         stats_packet_received(&client_stats, received);
         
-        // Calcular RTT
+        // RTT del JOIN: es la única petición con respuesta directa
         uint32_t rtt = get_time_ms() - last_send_time;
         stats_update_rtt(&client_stats, rtt);
         
-        // Obtener ID asignado por el servidor
+        // Obtener ID y sala asignados por el servidor
         my_player_id = last_state.player_id;
+        my_room_id = last_state.room_id;
+        session_token = last_state.session_token;
+        server_tick_rate = last_state.tick_rate;
         
         // Volver a non-blocking
-        int flags = fcntl(sockfd, F_GETFL, 0);
-        fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+        set_nonblocking(sockfd);
         
         return 1;
     }
+    if (received > 0 && last_state.type == MSG_ERROR) {
+        printf("La sala no existe o el servidor no admite más espectadores\n");
+    }
     
     return 0;
 }
 
-int main(void) {
-    char player_name[PLAYER_NAME_LEN];
+/**
+ * Muestra el uso del cliente
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [-w sala] [-r hz] [-k]\n", prog);
+    printf("  -w SALA  Mirar una sala sin jugar: SALA, SHARD:SALA o 'auto' (la primera\n");
+    printf("           partida en curso del shard que atiende al cliente)\n");
+    printf("  -r HZ    Inputs enviados por segundo, %d-%d (por defecto %d); cada paquete\n",
+           MIN_SEND_RATE, TARGET_FPS, TARGET_FPS);
+    printf("           repite los %d frames anteriores\n", INPUT_REDUNDANCY);
+    printf("  -k       Modo rollback: simula la partida localmente, sin esperar al\n");
+    printf("           servidor, y la corrige al llegar las acciones del rival\n");
+}
+
+/**
+ * Lee el destino de -w
+ * @return 0 si es válido, -1 si no
+ */
+int parse_spectate_target(const char *arg) {
+    if (strcmp(arg, "auto") == 0) {
+        return 0;
+    }
     
-    // Solicitar nombre del jugador
-    printf("Ingresa tu nombre: ");
-    fgets(player_name, PLAYER_NAME_LEN, stdin);
-    player_name[strcspn(player_name, "\n")] = 0; // Remover newline
+    unsigned int shard, room;
+    if (sscanf(arg, "%u:%u", &shard, &room) == 2) {
+        if (shard >= SPECTATE_ANY_SHARD || room >= MAX_ROOMS) return -1;
+        spectate_shard = (uint8_t)shard;
+        spectate_room = (uint16_t)room;
+        return 0;
+    }
+    if (sscanf(arg, "%u", &room) == 1 && room < MAX_ROOMS) {
+        spectate_room = (uint16_t)room;
+        return 0;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    char player_name[PLAYER_NAME_LEN] = "";
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "w:r:kh")) != -1) {
+        if (opt == 'w' && parse_spectate_target(optarg) == 0) {
+            spectating = 1;
+        } else if (opt == 'k') {
+            rollback_mode = 1;
+        } else if (opt == 'r' && atoi(optarg) >= MIN_SEND_RATE && atoi(optarg) <= TARGET_FPS) {
+            send_interval = TARGET_FPS / atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
     
-    if (strlen(player_name) == 0) {
-        strcpy(player_name, "Player");
+    // Solicitar nombre del jugador (un espectador no lo necesita)
+    if (!spectating) {
+        printf("Ingresa tu nombre: ");
+        fgets(player_name, PLAYER_NAME_LEN, stdin);
+        player_name[strcspn(player_name, "\n")] = 0; // Remover newline
+        
+        if (strlen(player_name) == 0) {
+            strcpy(player_name, "Player");
+        }
     }
     
     // Crear socket UDP
@@ -268,6 +626,8 @@ int main(void) {
     
     // Inicializar estadísticas
     stats_init(&client_stats);
+    histogram_init(&rtt_hist);
+    client_stats.rtt_hist = &rtt_hist;
     memset(&last_state, 0, sizeof(last_state));
     
     printf("Conectando al servidor...\n");
@@ -277,88 +637,215 @@ int main(void) {
         close(sockfd);
         return 1;
     }
+    interp_init(&interp, server_tick_rate);
+    rollback_init(&rb, my_player_id - 1);
+    rollback_mode = rollback_mode && !spectating;
     
-    printf("Conectado! Eres el Jugador %d\n", my_player_id);
+    if (spectating) {
+        printf("Conectado! Mirando la sala %u\n", my_room_id);
+    } else {
+        printf("Conectado! Eres el Jugador %d en la sala %u\n", my_player_id, my_room_id);
+    }
     sleep(1);
     
     // Inicializar ncurses
     init_ncurses();
     
+    // Loop de eventos: socket + teclado + timer de frame a 60 FPS
+    int timer_fd = create_tick_timer(FRAME_TIME_NS);
+    int epoll_fd = epoll_create1(0);
+    if (timer_fd < 0 || epoll_fd < 0 ||
+        epoll_add_reader(epoll_fd, sockfd) < 0 ||
+        epoll_add_reader(epoll_fd, STDIN_FILENO) < 0 ||
+        epoll_add_reader(epoll_fd, timer_fd) < 0) {
+        cleanup_ncurses();
+        perror("Error al crear el loop de eventos");
+        close(sockfd);
+        return 1;
+    }
+    
     int8_t current_action = ACTION_IDLE;
+    int key_this_frame = 0;
+    int change_sent = 0;       // Ya salió un INPUT por cambio de acción en este frame
+    int frames_unsent = 0;     // Frames desde el último INPUT programado
     int running = 1;
-    uint32_t last_frame = get_time_ms();
+    struct epoll_event events[3];
     
     // Loop principal del cliente
     while (running) {
-        uint32_t current_time = get_time_ms();
-        
-        // Leer input del teclado
-        int ch = getch();
-        int8_t new_action = ACTION_IDLE;
-        
-        if (ch == 'w' || ch == 'W') {
-            new_action = ACTION_UP;
-        } else if (ch == 's' || ch == 'S') {
-            new_action = ACTION_DOWN;
-        } else if (ch == 'q' || ch == 'Q') {
-            running = 0;
+        // Bloquear hasta tener teclas, datagramas o un frame vencido
+        int n = epoll_wait(epoll_fd, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
+        clock_refresh();
         
-        // Enviar input si cambió o cada 16ms
-        if (new_action != current_action || current_time - last_send_time >= FRAME_TIME_MS) {
-            current_action = new_action;
-            
-            struct client_message msg;
-            memset(&msg, 0, sizeof(msg));
-            msg.type = MSG_INPUT;
-            msg.player_id = my_player_id;
-            msg.action = current_action;
-            
-            send_message(&msg);
-        }
-        
-        // Recibir estado del servidor (non-blocking)
-        struct sockaddr_in from_addr;
-        socklen_t from_len = sizeof(from_addr);
-        
-        ssize_t received = recvfrom(sockfd, &last_state, sizeof(last_state), 
-                                    MSG_DONTWAIT,
-                                    (struct sockaddr *)&from_addr, &from_len);
-        
-        if (received > 0) {
-            stats_packet_received(&client_stats, received);
+        for (int e = 0; e < n; e++) {
+            int fd = events[e].data.fd;
             
-            // Calcular RTT
-            uint32_t rtt = current_time - last_send_time;
-            stats_update_rtt(&client_stats, rtt);
-        } else if (received < 0 && current_time - last_send_time > 1000) {
-            // Si no recibimos nada en 1 segundo, contar como pérdida
-            stats_packet_lost(&client_stats);
+            if (fd == STDIN_FILENO) {
+                // Leer todas las teclas pendientes
+                int8_t new_action = current_action;
+                int ch;
+                while ((ch = getch()) != ERR) {
+                    if (spectating) {
+                        // Solo puede salir
+                        if (ch == 'q' || ch == 'Q') running = 0;
+                    } else if (ch == 'w' || ch == 'W') {
+                        new_action = ACTION_UP;
+                        key_this_frame = 1;
+                    } else if (ch == 's' || ch == 'S') {
+                        new_action = ACTION_DOWN;
+                        key_this_frame = 1;
+                    } else if (ch == 'q' || ch == 'Q') {
+                        running = 0;
+                    }
+                }
+                
+                // Enviar input en cuanto cambia, sin esperar al frame
+                // (mismo seq del frame en curso: reemplaza su acción). Los
+                // cambios siguientes del mismo frame viajan con el próximo.
+                if (new_action != current_action) {
+                    current_action = new_action;
+                    record_input(input_seq, current_action);
+                    
+                    if (!change_sent) {
+                        struct client_message msg;
+                        memset(&msg, 0, sizeof(msg));
+                        msg.type = MSG_INPUT;
+                        msg.ack_tick = last_tick;
+                        msg.input_seq = input_seq;
+                        msg.action = current_action;
+                        msg.input_history = input_history;
+                        
+                        send_message(&msg);
+                        change_sent = 1;
+                    }
+                }
+                
+            } else if (fd == sockfd) {
+                // Vaciar la cola: quedarse con el último estado recibido
+                while (1) {
+                    uint8_t buf[BUFFER_SIZE];
+                    struct sockaddr_in from_addr;
+                    socklen_t from_len = sizeof(from_addr);
+                    
+                    ssize_t received = recvfrom(sockfd, buf, sizeof(buf), MSG_DONTWAIT,
+                                                (struct sockaddr *)&from_addr, &from_len);
+                    if (received < 0) {
+                        if (errno == EINTR) continue;
+                        break;
+                    }
+                    
+                    if (received > 0 && (buf[0] == MSG_SNAPSHOT || buf[0] == MSG_SNAPSHOT_NEXT)) {
+                        handle_snapshot(buf, received);
+                    } else if (received >= (ssize_t)sizeof(struct peer_left_message) &&
+                               buf[0] == MSG_PEER_LEFT) {
+                        peer_left_reason = ((struct peer_left_message *)buf)->reason;
+                    } else if (received >= (ssize_t)sizeof(struct server_message) && buf[0] == MSG_STATE) {
+                        handle_state((const struct server_message *)buf);
+                    } else if (received >= (ssize_t)sizeof(struct input_relay) &&
+                               buf[0] == MSG_INPUTS && rollback_mode) {
+                        rollback_confirm(&rb, (const struct input_relay *)buf);
+                    } else if (received >= (ssize_t)sizeof(struct sync_message) &&
+                               buf[0] == MSG_SYNC && rollback_mode) {
+                        rollback_sync(&rb, (const struct sync_message *)buf,
+                                      (uint8_t)(server_tick_rate / TARGET_FPS));
+                    } else if (received >= (ssize_t)sizeof(struct server_message) &&
+                               buf[0] == MSG_ERROR && spectating) {
+                        // La sala que se miraba quedó vacía
+                        room_closed = 1;
+                        running = 0;
+                    }
+                    
+                    stats_packet_received(&client_stats, received);
+                }
+                
+            } else if (fd == timer_fd) {
+                read_timer_expirations(timer_fd);
+                
+                if (spectating) {
+                    // El espectador solo confirma lo recibido, a baja frecuencia
+                    if (get_time_ms() - last_keepalive_ms >= SPECTATE_KEEPALIVE_MS) {
+                        send_keepalive();
+                        last_keepalive_ms = get_time_ms();
+                    }
+                } else {
+                    // Sin teclas durante el frame: la paleta se detiene
+                    if (!key_this_frame) {
+                        current_action = ACTION_IDLE;
+                    }
+                    key_this_frame = 0;
+                    
+                    // Nuevo input por frame: se predice ya y se confirma con el
+                    // snapshot. El del frame que termina pasa al historial.
+                    int8_t ended = pending_inputs[input_seq % PREDICTION_BUFFER].action;
+                    input_history = input_history_push(input_history, ended);
+                    input_seq++;
+                    record_input(input_seq, current_action);
+                    change_sent = 0;
+                    
+                    // Enviar cada send_interval frames (cada frame por defecto),
+                    // confirmando el último snapshot; los frames intermedios van
+                    // en el historial
+                    if (++frames_unsent >= send_interval) {
+                        struct client_message msg;
+                        memset(&msg, 0, sizeof(msg));
+                        msg.type = MSG_INPUT;
+                        msg.ack_tick = last_tick;
+                        msg.input_seq = input_seq;
+                        msg.action = current_action;
+                        msg.input_history = input_history;
+                        
+                        send_message(&msg);
+                        frames_unsent = 0;
+                    }
+                    
+                    if (rollback_mode) {
+                        step_rollback(current_action);
+                    }
+                }
+                
+                // Renderizar a 60 FPS el estado interpolado (o el simulado aquí)
+                if (!(rollback_mode && rb.synced)) {
+                    view_mode = interp_sample_at(&interp, get_time_us() / 1000.0, &view);
+                }
+                if (view_mode == INTERP_NONE && !(rollback_mode && rb.synced)) {
+                    view.paddle1_y = last_state.paddle1_y;
+                    view.paddle2_y = last_state.paddle2_y;
+                    view.ball_x = last_state.ball_x;
+                    view.ball_y = last_state.ball_y;
+                }
+                render_game();
+                render_stats();
+            }
         }
-        
-        // Renderizar a 60 FPS
-        if (current_time - last_frame >= FRAME_TIME_MS) {
-            render_game();
-            render_stats();
-            last_frame = current_time;
-        }
-        
-        usleep(1000); // 1ms
     }
     
+    close(epoll_fd);
+    close(timer_fd);
+    
     // Enviar mensaje de desconexión
     struct client_message msg;
     memset(&msg, 0, sizeof(msg));
     msg.type = MSG_LEAVE;
-    msg.player_id = my_player_id;
     send_message(&msg);
     
     // Limpiar
     cleanup_ncurses();
     close(sockfd);
     
+    if (room_closed) {
+        printf("\nLa sala %u se cerró: no quedan jugadores\n", my_room_id);
+    }
     printf("\n¡Gracias por jugar!\n");
     stats_print(&client_stats);
+    if (rollback_mode) {
+        printf("Rollback: %u vueltas atrás (%u frames re-simulados), %u esperas, "
+               "%u desincronizaciones, %u resincronizaciones\n",
+               rb.rollbacks, rb.resimulated, rb.stalls, rb.desyncs, rb.lost);
+    }
     
     return 0;
 }
@@ -0,0 +1,596 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "protocol.h"
+#include "utils.h"
+#include "stats.h"
+#include "netio.h"
+#include "snapshot.h"
+#include "histogram.h"
+#include "log.h"
+#include "input.h"
+
+/**
+ * Generador de carga: simula muchos jugadores sin interfaz desde un solo
+ * proceso. Cada bot tiene su propio socket (el servidor identifica al
+ * jugador por dirección origen), hace JOIN, genera un input por frame con
+ * acciones guionadas y lo envía con los anteriores en el historial (cada
+ * frame o al ritmo de -r, con pérdida de subida simulada con -l), decodifica y valida cada snapshot, y mide RTT con
+ * el eco de timestamps, pérdida por secuencia y el atraso de los ticks
+ * del servidor respecto de su ritmo ideal. Con -w se suman espectadores
+ * que miran la primera partida en curso de su shard.
+ */
+
+// Valores por defecto
+#define DEFAULT_BOTS 100
+#define DEFAULT_DURATION_S 10
+#define MAX_BOTS 16384
+
+// JOINs enviados por frame al arrancar (evita una ráfaga que desborde el socket)
+#define JOINS_PER_FRAME 200
+
+// Reintento de un JOIN sin respuesta (ms)
+#define JOIN_RETRY_MS 1000
+
+// Frames entre dos keepalives de un espectador
+#define KEEPALIVE_FRAMES (SPECTATE_KEEPALIVE_MS / FRAME_TIME_MS)
+
+// Snapshots que recibe un bot antes de medir el atraso de tick
+// (la referencia de cada bot es el snapshot más temprano visto)
+#define LATENESS_WARMUP TARGET_FPS
+
+// Margen para validar posiciones cuantizadas
+#define POSITION_EPSILON 0.01f
+
+struct bot {
+    int fd;
+    int spectator;              // Mira una sala en vez de jugar
+    int joined;
+    uint32_t join_sent_ms;      // 0 = JOIN aún no enviado
+    uint32_t session_token;     // Entregado en la respuesta al JOIN
+    
+    // Secuencias propias
+    uint16_t packet_seq;
+    uint16_t input_seq;
+    uint16_t input_history;     // Acciones de los frames anteriores
+    
+    // Snapshots recibidos (bases de los deltas)
+    struct snapshot history[SNAP_HISTORY];
+    uint16_t last_tick;         // 0 = ninguno
+    uint32_t last_full_tick;
+    uint32_t last_tick_recv_ms;
+    uint8_t score1;
+    uint8_t score2;
+    
+    // Atraso de tick: llegada - tick * frame, relativo al mínimo visto
+    int64_t tick_offset_us;
+    uint32_t snapshots;
+    uint16_t received;          // Snapshots recibidos (se informan en cada mensaje)
+    uint32_t stats_sent;        // packets_sent del último SNAP_STATS
+    uint16_t stats_received;    // received en ese momento
+    
+    struct network_stats stats;
+};
+
+// Contadores globales (desde el último reporte / totales)
+struct loadgen_counters {
+    uint64_t snapshots;
+    uint64_t bytes_received;
+    uint64_t inputs_sent;
+    uint64_t inputs_dropped;    // Descartados a propósito (-l)
+    uint64_t undecodable;       // Falta la base del delta
+    uint64_t invalid;           // Estado fuera de las reglas del juego
+};
+
+struct bot *bots;
+int num_bots = DEFAULT_BOTS;
+int num_spectators = 0;         // Los últimos num_spectators bots son espectadores
+int send_interval = 1;          // Frames entre dos INPUT de un bot (-r)
+int drop_percent = 0;           // Pérdida de subida simulada (-l)
+unsigned int drop_seed = 1;
+struct sockaddr_in server_addr;
+struct dgram_batch rx_batch;
+int server_tick_rate = TARGET_FPS; // Ticks por segundo del servidor (respuesta al JOIN)
+
+struct loadgen_counters window, total;
+struct histogram rtt_window, rtt_total;            // RTT (µs)
+struct histogram lateness_window, lateness_total;  // Atraso de tick (µs)
+
+/**
+ * Acción guionada: cada bot alterna subir/quieto/bajar con su propia fase
+ */
+int8_t scripted_action(int bot_idx, uint32_t frame) {
+    return (int8_t)(((frame + bot_idx * 7) / 30) % 3) - 1;
+}
+
+/**
+ * Envía un mensaje de un bot
+ */
+void bot_send(struct bot *bot, struct client_message *msg) {
+    msg->timestamp = get_time_ms();
+    msg->seq = bot->packet_seq++;
+    msg->session_token = bot->session_token;
+    msg->snapshots_recv = bot->received;
+    
+    if (bot->last_tick != 0) {
+        uint32_t hold = msg->timestamp - bot->last_tick_recv_ms;
+        msg->ack_tick = bot->last_tick;
+        msg->ack_hold_ms = hold > 255 ? 255 : (uint8_t)hold;
+    }
+    
+    if (sendto(bot->fd, msg, sizeof(*msg), 0,
+               (struct sockaddr *)&server_addr, sizeof(server_addr)) == (ssize_t)sizeof(*msg)) {
+        stats_packet_sent(&bot->stats, sizeof(*msg));
+    }
+}
+
+/**
+ * Envía (o reenvía) el JOIN de un bot, o el pedido de un espectador
+ */
+void bot_join(struct bot *bot, int bot_idx) {
+    struct client_message msg;
+    memset(&msg, 0, sizeof(msg));
+    if (bot->spectator) {
+        msg.type = MSG_SPECTATE;
+        msg.input_seq = SPECTATE_ANY_ROOM;
+        msg.ack_hold_ms = SPECTATE_ANY_SHARD;
+    } else {
+        msg.type = MSG_JOIN;
+        snprintf(msg.player_name, PLAYER_NAME_LEN, "bot%d", bot_idx);
+    }
+    
+    bot_send(bot, &msg);
+    bot->join_sent_ms = msg.timestamp;
+}
+
+/**
+ * Comprueba que un snapshot respete las reglas del juego
+ */
+int snapshot_is_valid(const struct bot *bot, const struct snapshot *snap) {
+    float paddle_min = PADDLE_HEIGHT / 2 - POSITION_EPSILON;
+    float paddle_max = FIELD_HEIGHT - PADDLE_HEIGHT / 2 + POSITION_EPSILON;
+    float paddle1 = snapshot_dequantize(snap->paddle1_y);
+    float paddle2 = snapshot_dequantize(snap->paddle2_y);
+    float ball_y = snapshot_dequantize(snap->ball_y);
+    
+    if (paddle1 < paddle_min || paddle1 > paddle_max) return 0;
+    if (paddle2 < paddle_min || paddle2 > paddle_max) return 0;
+    if (ball_y < BALL_SIZE / 2 - POSITION_EPSILON ||
+        ball_y > FIELD_HEIGHT - BALL_SIZE / 2 + POSITION_EPSILON) return 0;
+    
+    // El marcador solo avanza (módulo 256)
+    if ((int8_t)(snap->score1 - bot->score1) < 0 ||
+        (int8_t)(snap->score2 - bot->score2) < 0) return 0;
+    
+    return 1;
+}
+
+/**
+ * Procesa un snapshot recibido por un bot
+ */
+void bot_handle_snapshot(struct bot *bot, const uint8_t *buf, size_t len, uint64_t now_us) {
+    struct snapshot_header header;
+    if (snapshot_read_header(buf, len, &header) < 0) return;
+    
+    // El servidor no manda todos los ticks: la pérdida se cuenta por snapshots
+    bot->received++;
+    window.snapshots++;
+    
+    const struct snapshot *base = NULL;
+    if (header.base_offset != 0) {
+        uint16_t base_tick = header.tick - header.base_offset;
+        base = &bot->history[base_tick % SNAP_HISTORY];
+        if ((uint16_t)base->tick != base_tick) {
+            window.undecodable++;
+            return;
+        }
+    }
+    
+    struct snapshot snap;
+    struct snapshot_extra extra;
+    if (snapshot_decode(buf, len, base, &snap, &extra) < 0) {
+        window.undecodable++;
+        return;
+    }
+    snap.tick = header.tick;
+    bot->history[header.tick % SNAP_HISTORY] = snap;
+    
+    if (extra.mask & SNAP_ECHO) {
+        int rtt = (uint16_t)((uint16_t)get_time_ms() - extra.echo_ts) - extra.echo_hold_ms;
+        histogram_record(&rtt_window, (uint64_t)(rtt > 0 ? rtt : 0) * 1000);
+    }
+    
+    // Pérdida de bajada: enviados según el servidor contra recibidos desde
+    // las estadísticas anteriores (si su contador volvió a empezar, todo es nuevo)
+    if (extra.mask & SNAP_STATS) {
+        uint32_t sent = extra.stats.packets_sent -
+                        (extra.stats.packets_sent >= bot->stats_sent ? bot->stats_sent : 0);
+        uint16_t recv = bot->received - bot->stats_received;
+        if (sent > recv) {
+            bot->stats.packets_lost += sent - recv;
+        }
+        bot->stats_sent = extra.stats.packets_sent;
+        bot->stats_received = bot->received;
+    }
+    
+    // El ack de input nunca puede adelantarse a lo enviado
+    if ((extra.mask & SNAP_INPUT_ACK) &&
+        (uint8_t)((uint8_t)bot->input_seq - extra.input_ack) >= 128) {
+        window.invalid++;
+    }
+    
+    // Solo el más nuevo avanza el estado
+    uint32_t full_tick = bot->last_tick == 0 ? header.tick :
+                         bot->last_full_tick + (int16_t)(header.tick - bot->last_tick);
+    if (bot->last_tick != 0 && (int32_t)(full_tick - bot->last_full_tick) <= 0) return;
+    
+    if (!snapshot_is_valid(bot, &snap)) window.invalid++;
+    bot->score1 = snap.score1;
+    bot->score2 = snap.score2;
+    bot->last_tick = header.tick;
+    bot->last_full_tick = full_tick;
+    bot->last_tick_recv_ms = get_time_ms();
+    
+    // Atraso del tick respecto del ritmo ideal del servidor (más jitter de red)
+    int64_t offset = (int64_t)now_us - (int64_t)(full_tick * 1000000ULL / server_tick_rate);
+    if (bot->snapshots == 0 || offset < bot->tick_offset_us) {
+        bot->tick_offset_us = offset;
+    }
+    if (++bot->snapshots > LATENESS_WARMUP) {
+        histogram_record(&lateness_window, (uint64_t)(offset - bot->tick_offset_us));
+    }
+}
+
+/**
+ * Lee todo lo pendiente en el socket de un bot
+ */
+void bot_drain(struct bot *bot) {
+    int received;
+    
+    do {
+        received = dgram_batch_recv(bot->fd, &rx_batch);
+        uint64_t now_us = clock_refresh() / 1000;
+        
+        for (int i = 0; i < received; i++) {
+            const uint8_t *buf = rx_batch.bufs[i];
+            unsigned int len = rx_batch.msgs[i].msg_len;
+            if (len == 0) continue;
+            
+            stats_packet_received(&bot->stats, len);
+            window.bytes_received += len;
+            
+            if (buf[0] == MSG_SNAPSHOT || buf[0] == MSG_SNAPSHOT_NEXT) {
+                bot_handle_snapshot(bot, buf, len, now_us);
+            } else if (buf[0] == MSG_STATE && !bot->joined &&
+                       len >= sizeof(struct server_message)) {
+                const struct server_message *reply = (const struct server_message *)buf;
+                bot->session_token = reply->session_token;
+                bot->joined = 1;
+                server_tick_rate = reply->tick_rate;
+                histogram_record(&rtt_window, (uint64_t)(get_time_ms() - bot->join_sent_ms) * 1000);
+            }
+        }
+    } while (received == NETIO_BATCH);
+}
+
+/**
+ * Envía el INPUT del frame de todos los bots unidos y los JOIN pendientes
+ */
+void send_frame(uint32_t frame) {
+    int joins = 0;
+    uint32_t now_ms = (uint32_t)(clock_refresh() / 1000000);
+    
+    for (int i = 0; i < num_bots; i++) {
+        struct bot *bot = &bots[i];
+        
+        if (!bot->joined) {
+            int due = bot->join_sent_ms == 0 || now_ms - bot->join_sent_ms >= JOIN_RETRY_MS;
+            if (due && joins < JOINS_PER_FRAME) {
+                bot_join(bot, i);
+                joins++;
+            }
+            continue;
+        }
+        
+        struct client_message msg;
+        memset(&msg, 0, sizeof(msg));
+        if (bot->spectator) {
+            // Keepalive con fase propia: confirma el último y cuenta lo recibido
+            if ((frame + i) % KEEPALIVE_FRAMES != 0) continue;
+            msg.type = MSG_SPECTATE;
+            bot_send(bot, &msg);
+            continue;
+        }
+        // Un input por frame; se envía cada send_interval frames (con fase
+        // propia) y los intermedios viajan en el historial
+        int8_t action = scripted_action(i, frame);
+        bot->input_seq++;
+        if ((frame + i) % send_interval == 0) {
+            msg.type = MSG_INPUT;
+            msg.input_seq = bot->input_seq;
+            msg.action = action;
+            msg.input_history = bot->input_history;
+            if (drop_percent > 0 && (int)(rand_r(&drop_seed) % 100) < drop_percent) {
+                bot->packet_seq++;  // Se "envió": el servidor ve el hueco
+                window.inputs_dropped++;
+            } else {
+                bot_send(bot, &msg);
+                window.inputs_sent++;
+            }
+        }
+        bot->input_history = input_history_push(bot->input_history, action);
+    }
+}
+
+/**
+ * Suma la pérdida y el desorden de todos los bots
+ */
+void sum_bot_stats(uint64_t *lost, uint64_t *reordered, uint64_t *received, int *joined) {
+    *lost = *reordered = *received = 0;
+    *joined = 0;
+    for (int i = 0; i < num_bots; i++) {
+        *lost += bots[i].stats.packets_lost;
+        *reordered += bots[i].stats.packets_reordered;
+        *received += bots[i].stats.packets_received;
+        *joined += bots[i].joined;
+    }
+}
+
+/**
+ * Reporte de la ventana del último segundo; acumula en los totales
+ */
+void report_window(double seconds) {
+    uint64_t lost, reordered, received;
+    int joined;
+    sum_bot_stats(&lost, &reordered, &received, &joined);
+    
+    log_msg("🤖 Bots: %d/%d | Snapshots: %.0f/s (%.1f KB/s) | Inputs: %.0f/s | "
+            "RTT p50/p99: %.1f/%.1f ms | Atraso tick p50/p99: %.1f/%.1f ms | "
+            "Pérdida: %.2f%% | Inválidos: %llu",
+            joined, num_bots, window.snapshots / seconds,
+            window.bytes_received / seconds / 1024.0, window.inputs_sent / seconds,
+            histogram_percentile(&rtt_window, 50) / 1000.0,
+            histogram_percentile(&rtt_window, 99) / 1000.0,
+            histogram_percentile(&lateness_window, 50) / 1000.0,
+            histogram_percentile(&lateness_window, 99) / 1000.0,
+            lost + received ? 100.0 * lost / (lost + received) : 0.0,
+            (unsigned long long)(window.invalid + window.undecodable));
+    
+    histogram_merge(&rtt_total, &rtt_window);
+    histogram_merge(&lateness_total, &lateness_window);
+    histogram_init(&rtt_window);
+    histogram_init(&lateness_window);
+    
+    total.snapshots += window.snapshots;
+    total.bytes_received += window.bytes_received;
+    total.inputs_sent += window.inputs_sent;
+    total.inputs_dropped += window.inputs_dropped;
+    total.undecodable += window.undecodable;
+    total.invalid += window.invalid;
+    memset(&window, 0, sizeof(window));
+}
+
+/**
+ * Resumen final de la corrida
+ */
+void print_summary(double seconds) {
+    uint64_t lost, reordered, received;
+    int joined;
+    sum_bot_stats(&lost, &reordered, &received, &joined);
+    
+    printf("\n╔════════════════════════════════════════════════╗\n");
+    printf("║     RESULTADO DEL GENERADOR DE CARGA           ║\n");
+    printf("╠════════════════════════════════════════════════╣\n");
+    printf("║ Bots unidos:          %6d / %-15d ║\n", joined, num_bots);
+    printf("║ Duración:             %-22.1f s ║\n", seconds);
+    printf("║ Snapshots:            %-21.0f /s ║\n", total.snapshots / seconds);
+    printf("║ Inputs:               %-21.0f /s ║\n", total.inputs_sent / seconds);
+    if (drop_percent > 0) {
+        printf("║ Inputs descartados:   %-24llu ║\n", (unsigned long long)total.inputs_dropped);
+    }
+    printf("║ Recibido:             %-19.1f KB/s ║\n", total.bytes_received / seconds / 1024.0);
+    printf("║ Pérdida (bajada):     %-22.2f %% ║\n",
+           lost + received ? 100.0 * lost / (lost + received) : 0.0);
+    printf("║ Desordenados:         %-24llu ║\n", (unsigned long long)reordered);
+    printf("║ Sin base (delta):     %-24llu ║\n", (unsigned long long)total.undecodable);
+    printf("║ Estados inválidos:    %-24llu ║\n", (unsigned long long)total.invalid);
+    printf("║                                                ║\n");
+    printf("║ RTT (ms)          p50 %6.1f  p90 %6.1f       ║\n",
+           histogram_percentile(&rtt_total, 50) / 1000.0,
+           histogram_percentile(&rtt_total, 90) / 1000.0);
+    printf("║                   p99 %6.1f  p99.9 %6.1f     ║\n",
+           histogram_percentile(&rtt_total, 99) / 1000.0,
+           histogram_percentile(&rtt_total, 99.9) / 1000.0);
+    printf("║ Atraso tick (ms)  p50 %6.1f  p90 %6.1f       ║\n",
+           histogram_percentile(&lateness_total, 50) / 1000.0,
+           histogram_percentile(&lateness_total, 90) / 1000.0);
+    printf("║                   p99 %6.1f  p99.9 %6.1f     ║\n",
+           histogram_percentile(&lateness_total, 99) / 1000.0,
+           histogram_percentile(&lateness_total, 99.9) / 1000.0);
+    printf("║ Ticks > 1 frame tarde: %-22.2f%% ║\n",
+           lateness_total.count ? 100.0 - 100.0 * histogram_count_below(&lateness_total,
+                                      FRAME_TIME_NS / 1000) / lateness_total.count : 0.0);
+    printf("╚════════════════════════════════════════════════╝\n\n");
+}
+
+/**
+ * Crea el socket de un bot (puerto efímero propio)
+ */
+int open_bot_socket(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    
+    // Buffer amplio: a 60 Hz el bot no lee en cada snapshot
+    int rcvbuf = 64 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    set_nonblocking(fd);
+    return fd;
+}
+
+/**
+ * Muestra el uso del generador
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [-s ip] [-p puerto] [-n bots] [-w espectadores] [-d segundos] [-r hz] [-l pct]\n",
+           prog);
+    printf("  -s IP       Servidor (por defecto 127.0.0.1)\n");
+    printf("  -p PUERTO   Puerto del servidor (por defecto %d)\n", SERVER_PORT);
+    printf("  -n N        Bots, 1-%d (por defecto %d; pares para llenar salas)\n",
+           MAX_BOTS, DEFAULT_BOTS);
+    printf("  -w N        Espectadores además de los bots (por defecto 0)\n");
+    printf("  -d S        Duración en segundos (por defecto %d)\n", DEFAULT_DURATION_S);
+    printf("  -r HZ       INPUT por segundo de cada bot, %d-%d (por defecto %d)\n",
+           TARGET_FPS / (INPUT_REDUNDANCY + 1) + 1, TARGET_FPS, TARGET_FPS);
+    printf("  -l PCT      Descartar ese %% de los INPUT antes de enviarlos (por defecto 0)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *server_ip = "127.0.0.1";
+    int port = SERVER_PORT;
+    int duration_s = DEFAULT_DURATION_S;
+    int send_rate = TARGET_FPS;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:n:w:d:r:l:h")) != -1) {
+        if (opt == 's') {
+            server_ip = optarg;
+        } else if (opt == 'p') {
+            port = atoi(optarg);
+        } else if (opt == 'n') {
+            num_bots = atoi(optarg);
+        } else if (opt == 'w') {
+            num_spectators = atoi(optarg);
+        } else if (opt == 'd') {
+            duration_s = atoi(optarg);
+        } else if (opt == 'r') {
+            send_rate = atoi(optarg);
+        } else if (opt == 'l') {
+            drop_percent = atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    
+    if (num_bots < 1 || num_spectators < 0 || num_bots + num_spectators > MAX_BOTS ||
+        duration_s < 1 || port <= 0 || port > 65535 || drop_percent < 0 || drop_percent > 100 ||
+        send_rate <= TARGET_FPS / (INPUT_REDUNDANCY + 1) || send_rate > TARGET_FPS) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    send_interval = TARGET_FPS / send_rate;
+    num_bots += num_spectators;
+    
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Dirección inválida: %s\n", server_ip);
+        return 1;
+    }
+    
+    // Un descriptor por bot: subir el límite blando hasta donde se pueda
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < (rlim_t)num_bots + 16) {
+        limit.rlim_cur = limit.rlim_max < (rlim_t)num_bots + 16 ? limit.rlim_max : (rlim_t)num_bots + 16;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    
+    bots = calloc(num_bots, sizeof(struct bot));
+    int epoll_fd = epoll_create1(0);
+    int timer_fd = create_tick_timer(FRAME_TIME_NS);
+    if (bots == NULL || epoll_fd < 0 || timer_fd < 0) {
+        perror("Error al inicializar");
+        return 1;
+    }
+    
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = (uint32_t)num_bots;   // El timer va después de los bots
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &ev);
+    
+    for (int i = 0; i < num_bots; i++) {
+        bots[i].fd = open_bot_socket();
+        if (bots[i].fd < 0) {
+            fprintf(stderr, "Error al crear el socket del bot %d: %s\n", i, strerror(errno));
+            return 1;
+        }
+        stats_init(&bots[i].stats);
+        bots[i].input_history = INPUT_HISTORY_EMPTY;
+        bots[i].spectator = i >= num_bots - num_spectators;
+        
+        ev.data.u32 = (uint32_t)i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bots[i].fd, &ev);
+    }
+    
+    dgram_batch_init(&rx_batch);
+    histogram_init(&rtt_window);
+    histogram_init(&rtt_total);
+    histogram_init(&lateness_window);
+    histogram_init(&lateness_total);
+    
+    log_msg("🚀 %d bots (%d espectadores) contra %s:%d durante %d s | INPUT a %d Hz%s",
+            num_bots, num_spectators, server_ip, port, duration_s, TARGET_FPS / send_interval,
+            drop_percent > 0 ? " con pérdida simulada" : "");
+    
+    uint64_t start_us = get_time_us();
+    uint64_t end_us = start_us + (uint64_t)duration_s * 1000000;
+    uint64_t last_report_us = start_us;
+    uint32_t frame = 0;
+    struct epoll_event events[256];
+    
+    while (get_time_us() < end_us) {
+        int n = epoll_wait(epoll_fd, events, 256, 100);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error en epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            uint32_t idx = events[i].data.u32;
+            if (idx == (uint32_t)num_bots) {
+                // Un frame por expiración: los frames perdidos no se compensan
+                read_timer_expirations(timer_fd);
+                send_frame(frame++);
+            } else {
+                bot_drain(&bots[idx]);
+            }
+        }
+        
+        uint64_t now_us = get_time_us();
+        if (now_us - last_report_us >= 1000000) {
+            report_window((now_us - last_report_us) / 1e6);
+            last_report_us = now_us;
+        }
+    }
+    
+    uint64_t elapsed_us = get_time_us() - start_us;
+    if (window.snapshots || window.inputs_sent) {
+        report_window((get_time_us() - last_report_us) / 1e6);
+    }
+    
+    // Despedirse para liberar las salas del servidor
+    for (int i = 0; i < num_bots; i++) {
+        if (bots[i].joined) {
+            struct client_message msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.type = MSG_LEAVE;
+            bot_send(&bots[i], &msg);
+        }
+        close(bots[i].fd);
+    }
+    
+    print_summary(elapsed_us / 1e6);
+    
+    close(timer_fd);
+    close(epoll_fd);
+    free(bots);
+    return 0;
+}
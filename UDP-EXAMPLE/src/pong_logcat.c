@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log.h"
+
+/**
+ * Lector de logs binarios: convierte lo que escribió pong_server -F bin
+ * en las mismas líneas de texto o JSON que hubiera escrito el servidor
+ * (el formateo es el de log.c)
+ */
+
+/**
+ * Muestra el uso
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [-j] [-l nivel] ARCHIVO\n", prog);
+    printf("  -j        Una línea JSON por mensaje (por defecto texto)\n");
+    printf("  -l NIVEL  Solo mensajes desde NIVEL: debug, info, warn, error\n");
+}
+
+int main(int argc, char *argv[]) {
+    enum log_output output = LOG_OUTPUT_TEXT;
+    enum log_level level = LOG_LEVEL_DEBUG;
+    int level_ok = 1;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "jl:h")) != -1) {
+        if (opt == 'j') {
+            output = LOG_OUTPUT_JSON;
+        } else if (opt == 'l') {
+            level_ok = log_parse_level(optarg, &level) == 0;
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || !level_ok) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    size_t len = (size_t)st.st_size;
+    if (len < sizeof(struct log_header)) {
+        fprintf(stderr, "%s: no es un log binario\n", path);
+        return 1;
+    }
+    const uint8_t *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+    
+    struct log_reader *reader = malloc(sizeof(*reader));
+    if (reader == NULL || log_reader_init(reader, data, len) < 0) {
+        fprintf(stderr, "%s: no es un log binario (o es de otra versión)\n", path);
+        return 1;
+    }
+    
+    struct log_record rec;
+    char line[LOG_LINE_MAX];
+    int result;
+    while ((result = log_reader_next(reader, &rec)) > 0) {
+        if (rec.level < level) continue;
+        log_render(&rec, output, line, sizeof(line));
+        fputs(line, stdout);
+    }
+    if (result < 0) {
+        fprintf(stderr, "%s: archivo dañado en el byte %zu\n", path, reader->offset);
+    }
+    
+    log_reader_free(reader);
+    free(reader);
+    munmap((void *)data, len);
+    return result < 0 ? 1 : 0;
+}
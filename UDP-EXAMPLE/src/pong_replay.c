@@ -0,0 +1,457 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "protocol.h"
+#include "utils.h"
+#include "game.h"
+#include "replay.h"
+
+/**
+ * Reproductor de repeticiones: abre con mmap un archivo grabado por el
+ * servidor (-R) y, sin copiarlo, lista sus partidas, re-simula una
+ * verificando cada keyframe contra la simulación (para encontrar
+ * desincronizaciones y revisar marcadores discutidos) o salta a un tick
+ * cualquiera desde el keyframe anterior.
+ */
+
+// Una partida del archivo: de su MATCH_START a su MATCH_END
+struct match_entry {
+    uint16_t room;
+    size_t start;              // Offset del MATCH_START
+    size_t end;                // Offset tras su último registro
+    const struct replay_match_start *info;
+    const struct replay_match_end *result;  // NULL si el archivo termina antes
+    uint32_t last_tick;
+    uint32_t keyframes;
+    int gap;                   // Se perdieron registros mientras se jugaba
+};
+
+// Registros de una partida, en orden (índice para saltar por keyframes)
+struct match_records {
+    const struct replay_record **records;
+    size_t count;
+    size_t *keyframes;         // Posiciones de los KEYFRAME en records
+    size_t num_keyframes;
+};
+
+const uint8_t *data;
+size_t data_len;
+struct match_entry *matches;
+size_t num_matches;
+int tick_rate = TARGET_FPS;    // Ticks por segundo de la grabación
+
+/**
+ * Datos de un registro (justo después de su cabecera)
+ */
+const void *record_data(const struct replay_record *record) {
+    return (const uint8_t *)record + sizeof(*record);
+}
+
+/**
+ * Agrega un elemento a un arreglo dinámico
+ * @return Puntero al nuevo elemento (sin inicializar)
+ */
+void *grow(void **array, size_t *count, size_t elem_size) {
+    if ((*count & (*count - 1)) == 0) {
+        size_t capacity = *count == 0 ? 16 : *count * 2;
+        void *bigger = realloc(*array, capacity * elem_size);
+        if (bigger == NULL) {
+            perror("Sin memoria");
+            exit(1);
+        }
+        *array = bigger;
+    }
+    return (uint8_t *)*array + (*count)++ * elem_size;
+}
+
+/**
+ * Recorre el archivo una vez y arma la lista de partidas
+ */
+void index_matches(size_t first) {
+    static int open[MAX_ROOMS];  // Partida en curso por sala (-1 = ninguna)
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        open[i] = -1;
+    }
+    
+    size_t offset = first;
+    const struct replay_record *record;
+    while ((record = replay_next(data, data_len, &offset)) != NULL) {
+        if (record->type == REPLAY_GAP) {
+            for (size_t i = 0; i < num_matches; i++) {
+                if (open[matches[i].room] == (int)i) matches[i].gap = 1;
+            }
+            continue;
+        }
+        if (record->room >= MAX_ROOMS) continue;
+        
+        if (record->type == REPLAY_MATCH_START && record->size >= sizeof(struct replay_match_start)) {
+            struct match_entry *match = grow((void **)&matches, &num_matches, sizeof(*match));
+            memset(match, 0, sizeof(*match));
+            match->room = record->room;
+            match->start = offset - sizeof(*record) - record->size;
+            match->info = record_data(record);
+            open[record->room] = (int)(num_matches - 1);
+        }
+        
+        int idx = open[record->room];
+        if (idx < 0) continue;  // Partida que empezó antes de un hueco
+        
+        struct match_entry *match = &matches[idx];
+        match->end = offset;
+        if (record->tick > match->last_tick) match->last_tick = record->tick;
+        if (record->type == REPLAY_KEYFRAME) {
+            match->keyframes++;
+        } else if (record->type == REPLAY_MATCH_END && record->size >= sizeof(struct replay_match_end)) {
+            match->result = record_data(record);
+            open[record->room] = -1;
+        }
+    }
+}
+
+/**
+ * Junta los registros de una partida y la posición de sus keyframes
+ */
+void collect_records(const struct match_entry *match, struct match_records *recs) {
+    memset(recs, 0, sizeof(*recs));
+    
+    size_t offset = match->start;
+    const struct replay_record *record;
+    while (offset < match->end && (record = replay_next(data, data_len, &offset)) != NULL) {
+        if (record->room != match->room) continue;
+        if (record->type == REPLAY_KEYFRAME && record->size >= sizeof(struct replay_keyframe)) {
+            *(size_t *)grow((void **)&recs->keyframes, &recs->num_keyframes, sizeof(size_t)) =
+                recs->count;
+        }
+        *(const struct replay_record **)grow((void **)&recs->records, &recs->count,
+                                             sizeof(record)) = record;
+    }
+}
+
+/**
+ * Formatea un tick de partida como mm:ss.cc
+ */
+void format_tick(uint32_t tick, char *buf, size_t len) {
+    uint32_t cs = (uint32_t)((uint64_t)tick * 100 / tick_rate);
+    snprintf(buf, len, "%02u:%02u.%02u", cs / 6000, cs / 100 % 60, cs % 100);
+}
+
+/**
+ * Simula pasos hasta llegar al tick indicado
+ * @param show_goals Imprime cada gol con su tick
+ */
+void advance_to(struct game_state *game, uint32_t tick, const int8_t actions[2], int show_goals) {
+    while (game->tick < tick) {
+        int events = game_step(game, actions[0], actions[1]);
+        if (show_goals && events != 0) {
+            char when[16];
+            format_tick(game->tick, when, sizeof(when));
+            printf("  ⚽ %s (tick %u) Jugador %d anota: %d - %d\n", when, game->tick,
+                   (events & GAME_EVENT_GOAL_P1) ? 1 : 2, game->score1, game->score2);
+        }
+    }
+}
+
+/**
+ * Compara el estado simulado con el grabado campo por campo, bit a bit
+ * @param diff Nombres de los campos que difieren (salida)
+ * @return 1 si coinciden
+ */
+int state_matches(const struct game_state *game, const struct game_state *expected,
+                  char *diff, size_t len) {
+    struct {
+        const char *name;
+        const void *a;
+        const void *b;
+        size_t size;
+    } fields[] = {
+        {"paddle1_y", &game->paddle1_y, &expected->paddle1_y, sizeof(game_scalar)},
+        {"paddle2_y", &game->paddle2_y, &expected->paddle2_y, sizeof(game_scalar)},
+        {"ball_x", &game->ball_x, &expected->ball_x, sizeof(game_scalar)},
+        {"ball_y", &game->ball_y, &expected->ball_y, sizeof(game_scalar)},
+        {"ball_vx", &game->ball_vx, &expected->ball_vx, sizeof(game_scalar)},
+        {"ball_vy", &game->ball_vy, &expected->ball_vy, sizeof(game_scalar)},
+        {"score1", &game->score1, &expected->score1, sizeof(game->score1)},
+        {"score2", &game->score2, &expected->score2, sizeof(game->score2)},
+        {"rng", &game->rng, &expected->rng, sizeof(game->rng)},
+    };
+    
+    size_t used = 0;
+    diff[0] = '\0';
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (memcmp(fields[i].a, fields[i].b, fields[i].size) != 0 && used < len) {
+            used += (size_t)snprintf(diff + used, len - used, "%s%s", used ? ", " : "",
+                                     fields[i].name);
+        }
+    }
+    return used == 0;
+}
+
+/**
+ * Imprime un estado de partida
+ */
+void print_state(const char *label, const struct game_state *game) {
+    printf("  %s: paletas %.6g / %.6g | pelota (%.9g, %.9g) vel (%.9g, %.9g) | "
+           "marcador %d - %d | rng %08x\n", label,
+           GAME_TO_FLOAT(game->paddle1_y), GAME_TO_FLOAT(game->paddle2_y),
+           GAME_TO_FLOAT(game->ball_x), GAME_TO_FLOAT(game->ball_y),
+           GAME_TO_FLOAT(game->ball_vx), GAME_TO_FLOAT(game->ball_vy),
+           game->score1, game->score2, game->rng);
+}
+
+/**
+ * Re-simula los registros desde el keyframe en la posición first hasta el
+ * tick target. Con verify compara cada keyframe y el marcador final con lo
+ * simulado.
+ * @return Cantidad de diferencias encontradas
+ */
+int simulate(const struct match_records *recs, size_t first, uint32_t target,
+             struct game_state *game, int verify) {
+    const struct replay_record *start = recs->records[first];
+    const struct replay_keyframe *kf = record_data(start);
+    int8_t actions[2] = {kf->action1, kf->action2};
+    int mismatches = 0;
+    
+    replay_keyframe_to_state(kf, start->tick, game);
+    game->frame_ticks = (uint8_t)(tick_rate / TARGET_FPS);
+    
+    for (size_t i = first + 1; i < recs->count; i++) {
+        const struct replay_record *record = recs->records[i];
+        if (record->tick > target) break;
+        advance_to(game, record->tick, actions, verify);
+        
+        if (record->type == REPLAY_INPUT && record->size >= sizeof(struct replay_input)) {
+            const struct replay_input *input = record_data(record);
+            actions[0] = input->action1;
+            actions[1] = input->action2;
+        } else if (verify && record->type == REPLAY_KEYFRAME &&
+                   record->size >= sizeof(struct replay_keyframe)) {
+            const struct replay_keyframe *recorded = record_data(record);
+            struct game_state expected;
+            char diff[128];
+            replay_keyframe_to_state(recorded, record->tick, &expected);
+            expected.frame_ticks = game->frame_ticks;
+            if (!state_matches(game, &expected, diff, sizeof(diff))) {
+                printf("❌ Desincronización en el tick %u (difieren: %s)\n", record->tick, diff);
+                print_state("grabado ", &expected);
+                print_state("simulado", game);
+                mismatches++;
+                
+                // Seguir desde lo grabado para ver si hay más diferencias
+                *game = expected;
+                actions[0] = recorded->action1;
+                actions[1] = recorded->action2;
+            }
+        } else if (verify && record->type == REPLAY_MATCH_END &&
+                   record->size >= sizeof(struct replay_match_end)) {
+            const struct replay_match_end *end = record_data(record);
+            if (end->score1 != game->score1 || end->score2 != game->score2) {
+                printf("❌ Marcador final grabado %d - %d, simulado %d - %d\n",
+                       end->score1, end->score2, game->score1, game->score2);
+                mismatches++;
+            }
+        }
+    }
+    
+    advance_to(game, target, actions, verify);
+    return mismatches;
+}
+
+/**
+ * Lista las partidas del archivo
+ */
+void list_matches(void) {
+    printf("\n%4s %5s %-8s %9s  %-35s %8s  %s\n", "#", "sala", "inicio", "duración",
+           "jugadores", "marcador", "fin");
+    for (size_t i = 0; i < num_matches; i++) {
+        const struct match_entry *match = &matches[i];
+        time_t start_s = (time_t)(match->info->wall_ms / 1000);
+        char start[16], duration[16], players[48];
+        strftime(start, sizeof(start), "%H:%M:%S", localtime(&start_s));
+        format_tick(match->last_tick, duration, sizeof(duration));
+        snprintf(players, sizeof(players), "%.16s vs %.16s",
+                 match->info->names[0], match->info->names[1]);
+        
+        if (match->result != NULL) {
+            printf("%4zu %5u %-8s %9s  %-35s %3d - %-3d  jugador %d %s%s\n", i, match->room,
+                   start, duration, players, match->result->score1, match->result->score2,
+                   match->result->player_id,
+                   match->result->reason == PEER_LEFT_TIMEOUT ? "sin respuesta" : "salió",
+                   match->gap ? " (incompleta)" : "");
+        } else {
+            printf("%4zu %5u %-8s %9s  %-35s %9s  %s\n", i, match->room, start, duration,
+                   players, "-", match->gap ? "sin final (incompleta)" : "sin final");
+        }
+    }
+}
+
+/**
+ * Re-simula una partida entera verificando sus keyframes
+ * @return 0 si todo coincide
+ */
+int verify_match(const struct match_entry *match, const struct match_records *recs) {
+    printf("\n🎞️ Partida en sala %u: %.16s vs %.16s (%u keyframes)\n", match->room,
+           match->info->names[0], match->info->names[1], match->keyframes);
+    
+    struct game_state game;
+    uint64_t start = get_time_ns();
+    int mismatches = simulate(recs, recs->keyframes[0], match->last_tick, &game, 1);
+    uint64_t elapsed = get_time_ns() - start;
+    
+    char duration[16];
+    format_tick(game.tick, duration, sizeof(duration));
+    if (mismatches == 0) {
+        printf("✅ %zu keyframes coinciden con la simulación | Marcador final %d - %d | "
+               "%s de partida re-simulados en %.2f ms\n", recs->num_keyframes,
+               game.score1, game.score2, duration, elapsed / 1e6);
+    } else {
+        printf("❌ %d diferencias entre lo grabado y la simulación\n", mismatches);
+    }
+    if (match->gap) {
+        printf("⚠️ Se perdieron registros durante esta partida: la verificación no es confiable\n");
+    }
+    return mismatches == 0 ? 0 : -1;
+}
+
+/**
+ * Salta a un tick: busca el último keyframe anterior y simula desde ahí
+ */
+void seek_tick(const struct match_records *recs, uint32_t target) {
+    uint64_t start = get_time_ns();
+    
+    // Búsqueda binaria del último keyframe con tick <= target
+    size_t lo = 0, hi = recs->num_keyframes;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (recs->records[recs->keyframes[mid]]->tick <= target) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t from = recs->records[recs->keyframes[lo]]->tick;
+    
+    struct game_state game;
+    simulate(recs, recs->keyframes[lo], target, &game, 0);
+    uint64_t elapsed = get_time_ns() - start;
+    
+    char when[16];
+    format_tick(game.tick, when, sizeof(when));
+    printf("\n⏩ Tick %u (%s), desde el keyframe del tick %u + %u pasos en %.1f us\n",
+           game.tick, when, from, game.tick - from, elapsed / 1e3);
+    print_state("estado", &game);
+}
+
+/**
+ * Muestra el uso
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s ARCHIVO [-m partida] [-t tick]\n", prog);
+    printf("  (sin -m)   Listar las partidas del archivo\n");
+    printf("  -m N       Re-simular la partida N verificando cada keyframe\n");
+    printf("  -t TICK    Con -m: saltar a ese tick y mostrar el estado\n");
+}
+
+int main(int argc, char *argv[]) {
+    long match_idx = -1;
+    long target = -1;
+    
+    int opt;
+    while ((opt = getopt(argc, argv, "m:t:h")) != -1) {
+        if (opt == 'm') {
+            match_idx = atol(optarg);
+        } else if (opt == 't') {
+            target = atol(optarg);
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1 || (target >= 0 && match_idx < 0)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+    data_len = (size_t)st.st_size;
+    if (data_len < sizeof(struct replay_header)) {
+        fprintf(stderr, "%s: no es una repetición\n", path);
+        return 1;
+    }
+    data = mmap(NULL, data_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+    
+    const struct replay_header *header = (const struct replay_header *)data;
+    if (memcmp(header->magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+        header->version != REPLAY_VERSION) {
+        fprintf(stderr, "%s: no es una repetición (o es de otra versión)\n", path);
+        return 1;
+    }
+#ifdef GAME_FIXED_POINT
+    int fixed_point = 1;
+#else
+    int fixed_point = 0;
+#endif
+    if (header->fixed_point != fixed_point) {
+        fprintf(stderr, "%s: grabada con simulación en %s; compilar pong_replay igual "
+                "(make %s)\n", path, header->fixed_point ? "punto fijo" : "float",
+                header->fixed_point ? "FIXED_POINT=1" : "sin FIXED_POINT");
+        return 1;
+    }
+    if (header->tick_rate == 0 || header->tick_rate % TARGET_FPS != 0) {
+        fprintf(stderr, "%s: ritmo de simulación no soportado (%u Hz)\n", path, header->tick_rate);
+        return 1;
+    }
+    tick_rate = header->tick_rate;
+    
+    madvise((void *)data, data_len, MADV_SEQUENTIAL);
+    index_matches(sizeof(*header));
+    
+    time_t start_s = (time_t)(header->start_ms / 1000);
+    char start[32];
+    strftime(start, sizeof(start), "%Y-%m-%d %H:%M:%S", localtime(&start_s));
+    printf("🎞️ %s: shard %u, desde %s, %.1f MB, %zu partidas\n", path, header->shard, start,
+           data_len / 1e6, num_matches);
+    
+    if (match_idx < 0) {
+        list_matches();
+        return 0;
+    }
+    if ((size_t)match_idx >= num_matches) {
+        fprintf(stderr, "No existe la partida %ld (hay %zu)\n", match_idx, num_matches);
+        return 1;
+    }
+    
+    const struct match_entry *match = &matches[match_idx];
+    struct match_records recs;
+    collect_records(match, &recs);
+    if (recs.num_keyframes == 0) {
+        fprintf(stderr, "La partida %ld no tiene keyframes\n", match_idx);
+        return 1;
+    }
+    
+    if (target >= 0) {
+        if (target > match->last_tick) {
+            printf("La partida termina en el tick %u\n", match->last_tick);
+            target = match->last_tick;
+        }
+        seek_tick(&recs, (uint32_t)target);
+        return 0;
+    }
+    return verify_match(match, &recs) == 0 ? 0 : 1;
+}
@@ -1,308 +1,2649 @@
-#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <fcntl.h>
-#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include "protocol.h"
 #include "utils.h"
 #include "stats.h"
+#include "netio.h"
+#include "snapshot.h"
+#include "game.h"
+#include "game_batch.h"
+#include "session.h"
+#include "timer_wheel.h"
+#include "lfqueue.h"
+#include "matchmaking.h"
+#include "histogram.h"
+#include "replay.h"
+#include "log.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "input.h"
+#include "rollback.h"
+
+// Snapshot enviado a un destinatario: con el ack se sabe cuántos le
+// habían salido hasta ese tick
+struct sent_mark {
+    uint16_t tick;
+    uint16_t count;
+};
+
+/**
+ * Pérdida de bajada de un jugador o espectador: los snapshots enviados
+ * hasta el que confirma un ack contra los recibidos que informa el
+ * cliente (snapshots_recv), entre dos acks de referencia
+ */
+struct downlink {
+    uint16_t sent;             // Snapshots enviados (total, 16 bits)
+    struct sent_mark sent_log[SNAP_HISTORY];  // Total enviado por tick
+    uint16_t report_sent;      // Enviados hasta el ack de referencia
+    uint16_t report_recv;      // Recibidos según ese ack
+    int reported;              // Ya hay un ack de referencia
+    float loss;                // Media móvil (0-1)
+};
 
 // Estructura para información del jugador
 struct player_info {
     struct sockaddr_in addr;
     socklen_t addr_len;
     uint8_t id;
+    uint8_t rx_shard;          // Shard cuyo socket recibe sus paquetes (los reenvía si no es este)
+    uint32_t token;            // Token de sesión entregado en el JOIN
     char name[PLAYER_NAME_LEN];
-    time_t last_seen;
+    uint64_t last_seen;        // ns (clock_now_ns) del último paquete
+    int active;                // Lugar ocupado (con sesión abierta)
+    int8_t last_action;        // Acción del último input aplicado (se repite si falta el siguiente)
+    struct input_buffer inputs;  // Inputs recibidos por secuencia, pendientes de su tick
+    uint16_t ack_tick;         // Último snapshot confirmado (0 = ninguno)
+    uint32_t first_snap_tick;  // Primer snapshot enviado en esta sala (0 = ninguno todavía)
+    int has_input;             // Ya se aplicó alguno (inputs.applied se devuelve como ack)
+    
+    // Medición de red del enlace con este jugador
+    struct network_stats stats;  // Pérdida de subida por secuencia, RTT por acks
+    uint16_t rtt_samples;      // Mediciones de RTT por ack (0 = todavía sin medir)
+    uint32_t echo_ts;          // Timestamp del paquete más nuevo aún no devuelto
+    uint64_t echo_recv_us;     // Cuándo llegó ese paquete
+    int echo_pending;
+    uint32_t last_echo_tick;
+    uint64_t input_recv_us;    // Llegada del input aún no reflejado en un snapshot (0 = ninguno)
+    
+    // Ritmo de snapshots según su enlace (ver update_snapshot_rate)
+    uint8_t rate_level;        // Índice en snap_rate_frames (0 = todos los frames)
+    uint32_t next_snap_tick;   // Próximo tick con snapshot para este jugador
+    uint32_t last_stats_tick;  // Último snapshot con SNAP_STATS
+    struct downlink downlink;
+    
+    // Modo rollback: recibe las acciones de cada frame y el estado completo
+    int rollback;
+    int sync_pending;          // Enviarle MSG_SYNC al empezar el próximo frame
+};
+
+// Sala: una partida independiente de MAX_PLAYERS jugadores
+struct room {
+    struct player_info players[MAX_PLAYERS];
+    int num_players;           // Lugares ocupados
     int active;
-    int8_t last_action;
+    struct snapshot history[SNAP_HISTORY];  // Snapshots enviados, base de los deltas
+    
+    // Acciones aplicadas por frame, para los jugadores en modo rollback
+    uint32_t relay_tick;       // Tick de la partida en que empezó el frame actual
+    uint16_t relay_history[MAX_PLAYERS];  // Las de los frames anteriores (ver input.h)
+    int relay_frames;          // Frames registrados en esta partida (0 = ninguno)
+    
+    // Emparejamiento, mientras un jugador espera rival
+    int waiting_pos;           // Índice en waiting_rooms o -1
+    uint64_t wait_since_ns;
+    uint64_t match_retry_ns;   // Próxima pasada por la cola (UINT64_MAX = publicada, sin revisión)
+    
+    // Últimas acciones grabadas en la repetición (solo se graban los cambios)
+    int8_t rec_action1;
+    int8_t rec_action2;
+    
+    // Espectadores (lista enlazada por índice en shard->spectators)
+    int spectator_head;        // -1 = ninguno
+    int num_spectators;
+    int watched_pos;           // Índice en watched_rooms o -1
+    int fanout_resume;         // Espectador donde sigue el fan-out cortado (-1 = el primero)
+};
+
+// Espectador: recibe los snapshots de una sala sin jugar
+struct spectator {
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+    uint8_t rx_shard;          // Shard cuyo socket recibe sus paquetes
+    uint8_t rate_level;        // Índice en snap_rate_frames (ver update_snapshot_rate)
+    uint32_t token;
+    int room;                  // Sala que mira (-1 = lugar libre)
+    int prev;                  // Vecinos en la lista de la sala (-1 = ninguno)
+    int next;
+    uint64_t last_seen;        // ns (clock_now_ns) del último paquete
+    uint16_t ack_tick;         // Último snapshot confirmado (0 = ninguno)
+    struct downlink downlink;  // Pérdida de bajada entre keepalives
+    struct network_stats stats;  // RTT por acks
+};
+
+// Mensajes entre shards (bandeja sin locks de cada shard)
+#define SHARD_MSG_PACKET 1     // Datagrama de un jugador que vive en el shard destino
+#define SHARD_MSG_SEAT 2       // Sentar a un jugador en una sala del shard destino
+#define SHARD_MSG_BIND 3       // Reenviar los paquetes de una dirección a otro shard
+#define SHARD_MSG_UNBIND 4     // Dejar de reenviarlos (el jugador salió)
+
+struct shard_msg {
+    uint8_t type;
+    uint8_t shard;             // PACKET/SEAT: shard que recibe sus datagramas; BIND/UNBIND: dueño
+    socklen_t addr_len;
+    struct sockaddr_in addr;
+    uint64_t recv_us;          // PACKET: llegada al socket
+    struct client_message packet;  // PACKET; en SEAT lleva el JOIN o el nombre
+    struct match_ticket ticket;    // SEAT: sala elegida
+    uint32_t token;            // SEAT: sesión existente (0 = jugador nuevo)
+};
+
+// Ritmo de snapshots de jugadores y espectadores según su enlace: uno
+// cada snap_rate_frames[nivel] frames (60, 30, 20 o 10 Hz), sin importar
+// el ritmo de la simulación. Con pérdida o RTT muy altos va directo al
+// mínimo; con pérdida o RTT altos baja un nivel por muestra, hasta el
+// anterior al mínimo; y vuelve a subir de a uno cuando la pérdida queda
+// por debajo de la mitad y el RTT por debajo del umbral. Así un enlace
+// congestionado no empeora su propia pérdida con snapshots que no llegan.
+#define SNAP_RATE_LEVELS 4
+const uint8_t snap_rate_frames[SNAP_RATE_LEVELS] = {1, 2, 3, 6};
+#define SNAP_RATE_LOSS_SLOW 0.03f
+#define SNAP_RATE_LOSS_SLOWEST 0.10f
+#define SNAP_RATE_RTT_SLOW_MS 150.0f
+#define SNAP_RATE_RTT_SLOWEST_MS 300.0f
+
+// Snapshots enviados entre dos acks para estimar la pérdida de bajada
+#define DOWNLINK_LOSS_SAMPLE 8
+
+// Límites de los buckets del histograma de duración del tick, en 1/64 del
+// presupuesto de un tick: del 1.5% al presupuesto y después hasta 6 ticks
+#define TICK_METRIC_BUCKETS 10
+const uint16_t tick_metric_budget_64ths[TICK_METRIC_BUCKETS] = {
+    1, 2, 4, 8, 16, 32, 48, 64, 128, 384
+};
+uint32_t tick_metric_bounds_us[TICK_METRIC_BUCKETS];  // Según tick_rate (main)
+
+/**
+ * Lo que un shard publica para el endpoint de métricas. Solo lo escribe el
+ * hilo del shard (metrics_add/metrics_set) y el hilo del endpoint lo lee
+ * sin locks. Los contadores del camino por paquete se copian una vez por
+ * despertar del tick (publish_metrics); los del tick y los JOIN se suman
+ * en el momento.
+ */
+struct shard_metrics {
+    _Atomic uint64_t packets_received;
+    _Atomic uint64_t packets_sent;
+    _Atomic uint64_t bytes_received;
+    _Atomic uint64_t bytes_sent;
+    _Atomic uint64_t packets_lost;      // Subida, por huecos en la secuencia
+    _Atomic uint64_t inputs_recovered;  // Llegaron solo en el historial de otro paquete
+    _Atomic uint64_t inputs_lost;       // Perdidos aun con la redundancia
+    _Atomic uint64_t inputs_trimmed;    // Descartados para acotar la espera
+    _Atomic uint64_t inputs_starved;    // Ticks de un jugador sin input nuevo
+    _Atomic uint64_t dropped_no_session;
+    _Atomic uint64_t dropped_short;     // Más corto que un client_message
+    _Atomic uint64_t dropped_send;      // El kernel no aceptó el datagrama
+    _Atomic uint64_t dropped_inbox;     // Bandeja de otro shard llena
+    _Atomic uint64_t joins;
+    _Atomic uint64_t joins_rejected;
+    _Atomic uint64_t ticks;
+    _Atomic uint64_t ticks_skipped;
+    _Atomic uint64_t tick_buckets[TICK_METRIC_BUCKETS + 1];
+    _Atomic uint64_t tick_sum_us;
+    _Atomic uint64_t rooms_active;
+    _Atomic uint64_t rooms_waiting;
+    _Atomic uint64_t players;
+    _Atomic uint64_t remote_players;
+    _Atomic uint64_t spectators;
+    _Atomic uint64_t players_by_rate[SNAP_RATE_LEVELS];  // Por ritmo de snapshots (en cada reporte)
+    _Atomic uint64_t tick_overruns[PROF_PHASES + 1];  // Por causa (solo con PONG_PROFILE)
+};
+
+/**
+ * Shard: un hilo de trabajo con su propio socket SO_REUSEPORT, sus salas
+ * y sus estadísticas. Nada de esto se comparte entre hilos, así que el
+ * camino caliente no toma locks. El kernel reparte los datagramas entre
+ * los sockets por hash de (ip, puerto) origen: mientras el conjunto de
+ * sockets no cambie, todos los paquetes de un cliente llegan al mismo
+ * shard. Si el emparejamiento lo sienta en una sala de otro shard, el que
+ * recibe sus paquetes se los reenvía al dueño por la bandeja.
+ */
+struct shard {
+    int id;
+    int sockfd;
+    int timer_fd;
+    int epoll_fd;
+    pthread_t thread;
+    unsigned int rng_seed;      // Semillas de las partidas nuevas
+    uint32_t tick;              // Próximo tick a simular (paso fijo de 1 / tick_rate)
+    uint64_t sim_epoch_us;      // Instante en que venció el tick 1
+    uint32_t ticks_dropped;     // Ticks no simulados por atraso (desde el reporte anterior)
+    uint64_t tick_sent_us[SNAP_HISTORY];  // Cuándo salió cada tick (RTT por ack)
+    
+    // Tabla de salas; el estado de cada partida vive en games, en el
+    // carril con el mismo índice que la sala
+    struct room rooms[MAX_ROOMS];
+    struct game_batch games;
+    int free_rooms[MAX_ROOMS];  // Pila de salas libres (LIFO para reutilizar índices bajos)
+    int num_free_rooms;
+    int room_high_water;        // Índice máximo de sala usada + 1
+    int waiting_rooms[MAX_ROOMS];  // Salas con lugar libre y alguien esperando rival
+    int num_waiting;
+    uint64_t match_next_ns;     // Próxima revisión de emparejamiento que vence
+    _Atomic uint32_t room_gen[MAX_ROOMS];  // Generación de espera por sala (la leen otros shards)
+    struct session_table sessions; // ip:puerto -> sala * MAX_PLAYERS + lugar (o SESSION_REMOTE/SPECTATOR)
+    struct timer_wheel idle_wheel; // Revisión de inactividad por lugar (mismo índice; espectadores después)
+    int live_rooms;
+    
+    struct network_stats stats;
+    uint32_t packets_misrouted; // Paquetes sin sesión o con token inválido
+    uint32_t packets_short;    // Datagramas más cortos que un client_message
+    struct input_stats input_stats;  // Inputs de sus jugadores (redundancia, pérdida, espera)
+    struct input_stats report_inputs; // input_stats en el reporte anterior
+    
+    // Bandeja de mensajes de otros shards (reenvíos y traspasos de jugadores)
+    struct lf_queue inbox;
+    int wake_fd;                // eventfd: lo escribe quien deja un mensaje
+    _Atomic int inbox_signaled; // Ya hay un aviso pendiente en wake_fd
+    uint32_t inbox_dropped;     // Mensajes propios que no entraron en una bandeja llena
+    int remote_players;         // Jugadores de este shard cuyos paquetes llegan a otro
+    struct replay_stream *replay;  // Repetición de sus partidas (NULL = sin grabar)
+    
+    // Espectadores: MAX_SPECTATORS lugares, los libres en una pila
+    struct spectator *spectators;
+    int *free_spectators;
+    int num_free_spectators;
+    int watched_rooms[MAX_ROOMS];  // Salas con al menos un espectador
+    int num_watched;
+    int fanout_cursor;          // Primera sala del próximo fan-out (rota entre ticks)
+    uint64_t fanout_time_us;    // Costo del fan-out desde el reporte anterior
+    uint32_t fanouts;
+    uint32_t spectator_snapshots;
+    uint32_t fanout_deferred;   // Salas que no entraron en el presupuesto de su tick
+    
+    // Lotes de E/S (recvmmsg/sendmmsg)
+    struct dgram_batch rx_batch;
+    struct dgram_batch tx_batch;
+    
+    // Medición de costo del tick para el reporte de capacidad
+    uint64_t tick_time_us;
+    uint32_t ticks_measured;
+    uint64_t rooms_simulated;
+    uint32_t report_packets_sent;
+    uint32_t report_packets_received;
+    uint32_t last_report;
+    uint64_t batch_recv_us;     // Cuándo se leyó el lote de datagramas en curso
+    
+    // Percentiles (µs) desde el reporte anterior
+    struct histogram rtt_hist;
+    struct histogram tick_hist;
+    struct histogram input_hist;  // Llegada del input -> snapshot que lo refleja
+    uint64_t snapshot_bytes;    // Bytes de snapshots enviados desde el reporte anterior
+    uint32_t snapshots_sent;
+    
+    // Métricas publicadas y los contadores de 32 bits ya sumados a ellas
+    struct shard_metrics metrics;
+    int num_players;
+    uint32_t published_received;
+    uint32_t published_sent;
+    uint32_t published_lost;
+    uint32_t published_misrouted;
+    uint32_t published_short;
+    uint32_t published_inbox_dropped;
+    struct input_stats published_inputs;
+    
+    // Perfilador de fases (NULL salvo con make PROFILE=1)
+    struct prof_ring *prof;
+    uint64_t last_tick_ns;      // Duración del último tick
 };
 
-// Estructura para el estado del juego
-struct game_state {
-    float paddle1_y;
-    float paddle2_y;
-    float ball_x;
-    float ball_y;
-    float ball_vx;
-    float ball_vy;
-    uint8_t score1;
-    uint8_t score2;
-};
+// Objetivo de capacidad: salas de 2 jugadores simuladas por núcleo a tick_rate
+#define ROOMS_PER_CORE_TARGET 5000
+
+// Intervalo del reporte de capacidad (ms)
+#define CAPACITY_REPORT_MS 5000
+
+// Máximo de frames atrasados que se recuperan en un despertar; el resto
+// del atraso se descarta desplazando el reloj de simulación
+#define MAX_CATCHUP_TICKS 4
+
+// Máximo de hilos de trabajo (shards)
+#define MAX_SHARDS 64
+
+// Sin paquetes de un jugador durante este tiempo su sesión se cierra
+#define PLAYER_TIMEOUT_MS 5000
+#define PLAYER_TIMEOUT_NS (PLAYER_TIMEOUT_MS * 1000000ULL)
+
+// Resolución de la rueda de inactividad; PLAYER_TIMEOUT_MS / IDLE_SWEEP_MS
+// tiene que ser menor que TIMER_WHEEL_SLOTS
+#define IDLE_SWEEP_MS 100
+
+// Valor de sesión de un jugador que vive en otro shard: sus paquetes se
+// reenvían al shard (valor & SESSION_SHARD_MASK)
+#define SESSION_REMOTE 0x80000000u
+#define SESSION_SHARD_MASK 0xffu
+
+// Capacidad de cada bucket de la cola de emparejamiento y de cada bandeja
+#define MATCH_QUEUE_CAPACITY 16384
+#define INBOX_CAPACITY 16384
+
+// Agrupando por RTT: espera máxima por la primera medición y cada cuánto
+// la búsqueda se abre un bucket más
+#define MATCH_PROBE_MS 500
+#define MATCH_WIDEN_MS 1000
+
+// Reintento de publicación si el bucket estaba lleno
+#define MATCH_RETRY_MS 100
+
+// Salas revisadas como máximo por tick (una ráfaga de JOIN no frena el tick)
+#define MATCH_BUDGET 512
+
+// Las salas esperando rival reciben un snapshot cada tantos frames: el
+// cliente ve el campo y sus acks miden el RTT antes de emparejar
+#define WAITING_SNAPSHOT_INTERVAL 6
+
+// Espectadores por shard, repartidos entre sus salas como sea
+#define MAX_SPECTATORS 16384
+
+// Valor de sesión de un espectador: SESSION_SPECTATOR | índice
+#define SESSION_SPECTATOR 0x40000000u
+#define SESSION_SPECTATOR_MASK 0x3fffffffu
+
+// Ids de los espectadores en la rueda de inactividad (después de los lugares)
+#define SPECTATOR_WHEEL_BASE (MAX_ROOMS * MAX_PLAYERS)
+
+// Tiempo máximo del fan-out a espectadores por tick. Se revisa entre
+// salas y cada NETIO_BATCH espectadores; lo que no entra se saltea y va
+// primero en el tick siguiente.
+#define SPECTATOR_BUDGET_US 2000
+
+// Ritmo de simulación más alto (-r): TARGET_FPS por este factor
+#define MAX_FRAME_TICKS 4
+
+// Ritmo de la simulación (-r), un múltiplo de TARGET_FPS: cada frame de
+// los clientes (un input, la unidad de las velocidades) son frame_ticks ticks
+int tick_rate = TARGET_FPS;
+int frame_ticks = 1;
+
+// Shards del proceso (los mensajes entre shards se direccionan por id)
+struct shard *shards[MAX_SHARDS];
+int num_shards = 1;
+
+// Cola de emparejamiento compartida por todos los shards
+struct match_queue matchmaking;
+
+// Hilo escritor de las repeticiones (-R), con un archivo por shard
+struct replay_writer replays;
+
+// Endpoint de métricas (-m)
+struct metrics_server metrics;
+
+/**
+ * Inicializa la tabla de salas de un shard
+ */
+void init_rooms(struct shard *sh) {
+    memset(sh->rooms, 0, sizeof(sh->rooms));
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        sh->rooms[i].waiting_pos = -1;
+        sh->rooms[i].spectator_head = -1;
+        sh->rooms[i].watched_pos = -1;
+        sh->rooms[i].fanout_resume = -1;
+    }
+    
+    // Apilar en orden inverso para que la primera sala asignada sea la 0
+    sh->num_free_rooms = 0;
+    for (int i = MAX_ROOMS - 1; i >= 0; i--) {
+        sh->free_rooms[sh->num_free_rooms++] = i;
+    }
+    
+    sh->room_high_water = 0;
+    sh->num_waiting = 0;
+    sh->live_rooms = 0;
+    stats_init(&sh->stats);
+    histogram_init(&sh->rtt_hist);
+    histogram_init(&sh->tick_hist);
+    histogram_init(&sh->input_hist);
+    sh->stats.rtt_hist = &sh->rtt_hist;
+    dgram_batch_init(&sh->rx_batch);
+    dgram_batch_init(&sh->tx_batch);
+}
+
+/**
+ * Obtiene una sala libre y la deja lista para una nueva partida
+ * @return Índice de la sala o -1 si no quedan salas
+ */
+int allocate_room(struct shard *sh) {
+    if (sh->num_free_rooms == 0) {
+        return -1;
+    }
+    
+    int room_idx = sh->free_rooms[--sh->num_free_rooms];
+    struct room *room = &sh->rooms[room_idx];
+    
+    memset(room, 0, sizeof(*room));
+    game_batch_init_lane(&sh->games, room_idx, (uint32_t)rand_r(&sh->rng_seed));
+    room->active = 1;
+    room->waiting_pos = -1;
+    room->spectator_head = -1;
+    room->watched_pos = -1;
+    room->fanout_resume = -1;
+    
+    sh->live_rooms++;
+    if (room_idx + 1 > sh->room_high_water) {
+        sh->room_high_water = room_idx + 1;
+    }
+    
+    return room_idx;
+}
+
+/**
+ * Cambia la generación de espera de una sala: los tickets que publicó
+ * quedan vencidos
+ */
+void bump_room_gen(struct shard *sh, int room_idx) {
+    atomic_fetch_add_explicit(&sh->room_gen[room_idx], 1, memory_order_release);
+}
+
+/**
+ * Agrega una sala a las que esperan rival (tiene jugadores y lugar libre);
+ * la próxima pasada de emparejamiento la revisa
+ */
+void push_waiting_room(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    room->waiting_pos = sh->num_waiting;
+    room->wait_since_ns = clock_now_ns();
+    room->match_retry_ns = 0;
+    sh->waiting_rooms[sh->num_waiting++] = room_idx;
+    sh->match_next_ns = 0;
+    bump_room_gen(sh, room_idx);
+}
+
+/**
+ * Quita una sala de las que esperan rival (si está)
+ */
+void remove_waiting_room(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    if (room->waiting_pos < 0) return;
+    
+    int last = sh->waiting_rooms[--sh->num_waiting];
+    sh->waiting_rooms[room->waiting_pos] = last;
+    sh->rooms[last].waiting_pos = room->waiting_pos;
+    room->waiting_pos = -1;
+    bump_room_gen(sh, room_idx);
+}
+
+/**
+ * Libera una sala cuando ya no tiene jugadores
+ */
+void release_room(struct shard *sh, int room_idx) {
+    sh->rooms[room_idx].active = 0;
+    sh->free_rooms[sh->num_free_rooms++] = room_idx;
+    sh->live_rooms--;
+    remove_waiting_room(sh, room_idx);
+    
+    // Recortar el límite superior de iteración si quedó libre el final
+    while (sh->room_high_water > 0 && !sh->rooms[sh->room_high_water - 1].active) {
+        sh->room_high_water--;
+    }
+}
+
+/**
+ * Genera un token de sesión (nunca 0)
+ */
+uint32_t new_session_token(struct shard *sh) {
+    uint32_t token;
+    do {
+        token = ((uint32_t)rand_r(&sh->rng_seed) << 16) ^ (uint32_t)rand_r(&sh->rng_seed);
+    } while (token == 0);
+    return token;
+}
+
+/**
+ * Instante de la rueda de inactividad (unidades de IDLE_SWEEP_MS)
+ */
+uint32_t idle_wheel_time(uint64_t ns) {
+    return (uint32_t)(ns / (IDLE_SWEEP_MS * 1000000ULL));
+}
+
+/**
+ * Programa la revisión de inactividad de un lugar para cuando vencería
+ * si no llega nada más desde last_seen (redondeado hacia arriba)
+ */
+void schedule_idle_check(struct shard *sh, uint32_t slot, uint64_t last_seen) {
+    uint64_t unit_ns = IDLE_SWEEP_MS * 1000000ULL;
+    uint64_t deadline_ns = last_seen + PLAYER_TIMEOUT_NS;
+    timer_wheel_schedule(&sh->idle_wheel, slot, (uint32_t)((deadline_ns + unit_ns - 1) / unit_ns));
+}
+
+/**
+ * Deja un mensaje en la bandeja de otro shard y lo despierta si no tenía
+ * ya un aviso pendiente
+ * @return 0 si se entregó, -1 si la bandeja estaba llena
+ */
+int send_to_shard(struct shard *sh, int dst_id, const struct shard_msg *msg) {
+    struct shard *dst = shards[dst_id];
+    if (lf_queue_push(&dst->inbox, msg) < 0) {
+        sh->inbox_dropped++;
+        return -1;
+    }
+    
+    if (!atomic_exchange(&dst->inbox_signaled, 1)) {
+        uint64_t one = 1;
+        if (write(dst->wake_fd, &one, sizeof(one)) < 0) {
+            // Solo falla si el contador del eventfd desborda: ya está despierto
+        }
+    }
+    return 0;
+}
+
+/**
+ * Pide a otro shard que reenvíe los paquetes de una dirección a owner
+ * @return 0 si se entregó, -1 si la bandeja del destino estaba llena
+ */
+int send_bind(struct shard *sh, int rx_shard, int owner, const struct sockaddr_in *addr) {
+    struct shard_msg bind;
+    memset(&bind, 0, sizeof(bind));
+    bind.type = SHARD_MSG_BIND;
+    bind.shard = (uint8_t)owner;
+    bind.addr = *addr;
+    return send_to_shard(sh, rx_shard, &bind);
+}
+
+/**
+ * Avisa a otro shard que deje de reenviar los paquetes de una dirección
+ */
+void send_unbind(struct shard *sh, int rx_shard, const struct sockaddr_in *addr) {
+    struct shard_msg unbind;
+    memset(&unbind, 0, sizeof(unbind));
+    unbind.type = SHARD_MSG_UNBIND;
+    unbind.shard = (uint8_t)sh->id;
+    unbind.addr = *addr;
+    send_to_shard(sh, rx_shard, &unbind);
+}
+
+/**
+ * Envía el estado de una sala con el lugar del destinatario (ID, sala,
+ * token). El player_id de un espectador es SPECTATOR_PLAYER_ID.
+ */
+void send_room_state(struct shard *sh, int room_idx, const struct sockaddr_in *addr,
+                     uint8_t player_id, uint32_t token) {
+    struct game_state game;
+    game_batch_load(&sh->games, room_idx, &game);
+    
+    struct server_message response;
+    memset(&response, 0, sizeof(response));
+    response.type = MSG_STATE;
+    response.timestamp = get_time_ms();
+    response.player_id = player_id;
+    response.room_id = room_idx;
+    response.session_token = token;
+    response.tick_rate = (uint16_t)tick_rate;
+    response.paddle1_y = GAME_TO_FLOAT(game.paddle1_y);
+    response.paddle2_y = GAME_TO_FLOAT(game.paddle2_y);
+    response.ball_x = GAME_TO_FLOAT(game.ball_x);
+    response.ball_y = GAME_TO_FLOAT(game.ball_y);
+    response.score1 = game.score1;
+    response.score2 = game.score2;
+    
+    dgram_batch_queue(sh->sockfd, &sh->tx_batch, &response, sizeof(response), addr);
+    stats_packet_sent(&sh->stats, sizeof(response));
+}
+
+/**
+ * Envía a un jugador su lugar y el estado de su sala. Es la respuesta al
+ * JOIN y el aviso de que empieza una partida.
+ */
+void send_join_reply(struct shard *sh, int room_idx, struct player_info *player) {
+    send_room_state(sh, room_idx, &player->addr, player->id, player->token);
+}
+
+/**
+ * Graba el estado de la partida de una sala con las acciones vigentes
+ */
+void record_keyframe(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    struct game_state game;
+    struct replay_keyframe kf;
+    
+    game_batch_load(&sh->games, room_idx, &game);
+    replay_keyframe_from_state(&kf, &game, room->rec_action1, room->rec_action2);
+    replay_append(sh->replay, REPLAY_KEYFRAME, (uint16_t)room_idx, game.tick, &kf, sizeof(kf));
+}
+
+/**
+ * Graba el inicio de una partida: jugadores y estado inicial
+ */
+void record_match_start(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    struct replay_match_start start;
+    
+    memset(&start, 0, sizeof(start));
+    start.wall_ms = replay_wall_ms();
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        memcpy(start.names[i], room->players[i].name, PLAYER_NAME_LEN);
+    }
+    replay_append(sh->replay, REPLAY_MATCH_START, (uint16_t)room_idx, 0, &start, sizeof(start));
+    
+    room->rec_action1 = ACTION_IDLE;
+    room->rec_action2 = ACTION_IDLE;
+    record_keyframe(sh, room_idx);
+}
+
+/**
+ * Graba las acciones del próximo paso de una sala si cambiaron
+ */
+void record_inputs(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    struct game_batch *games = &sh->games;
+    
+    if (games->action1[room_idx] == room->rec_action1 &&
+        games->action2[room_idx] == room->rec_action2) {
+        return;
+    }
+    
+    struct replay_input input = {games->action1[room_idx], games->action2[room_idx]};
+    replay_append(sh->replay, REPLAY_INPUT, (uint16_t)room_idx, games->tick[room_idx],
+                  &input, sizeof(input));
+    room->rec_action1 = input.action1;
+    room->rec_action2 = input.action2;
+}
+
+/**
+ * Graba el fin de una partida porque un jugador dejó la sala
+ */
+void record_match_end(struct shard *sh, int room_idx, const struct player_info *player,
+                      uint8_t reason) {
+    struct game_batch *games = &sh->games;
+    struct replay_match_end end = {games->score1[room_idx], games->score2[room_idx],
+                                   player->id, reason};
+    replay_append(sh->replay, REPLAY_MATCH_END, (uint16_t)room_idx, games->tick[room_idx],
+                  &end, sizeof(end));
+}
+
+/**
+ * Sienta a un jugador en el primer lugar libre de una sala, le abre una
+ * sesión en este shard y le responde con su lugar. Si la sala se llena
+ * empieza una partida y ambos reciben el aviso.
+ * @param room_idx Sala que espera rival o -1 para abrir una nueva
+ * @param join JOIN del jugador, o su nombre y modo si viene de otra sala
+ * @param token Sesión que trae de otra sala (0 = jugador nuevo)
+ * @param rx_shard Shard cuyo socket recibe sus paquetes
+ * @param room_out Sala asignada (salida)
+ * @return Jugador sentado o NULL si el shard (o su tabla de sesiones) está lleno
+ */
+struct player_info *seat_player(struct shard *sh, int room_idx, const struct sockaddr_in *addr,
+                                socklen_t addr_len, const struct client_message *join,
+                                uint32_t token, int rx_shard, int *room_out) {
+    int new_room = room_idx < 0;
+    if (new_room) {
+        room_idx = allocate_room(sh);
+        if (room_idx < 0) {
+            return NULL; // Servidor lleno
+        }
+    }
+    
+    struct room *room = &sh->rooms[room_idx];
+    int player_idx = 0;
+    while (room->players[player_idx].active) {
+        player_idx++;
+    }
+    struct player_info *player = &room->players[player_idx];
+    
+    // Sin sesión no le llegaría ningún paquete: tabla llena cuenta como shard lleno
+    uint32_t slot = (uint32_t)(room_idx * MAX_PLAYERS + player_idx);
+    if (session_insert(&sh->sessions, addr, slot) < 0) {
+        if (new_room) {
+            release_room(sh, room_idx);
+        }
+        return NULL;
+    }
+    
+    memset(player, 0, sizeof(*player));
+    player->addr = *addr;
+    player->addr_len = addr_len;
+    player->id = player_idx + 1;
+    player->rx_shard = (uint8_t)rx_shard;
+    player->token = token != 0 ? token : new_session_token(sh);
+    memcpy(player->name, join->player_name, PLAYER_NAME_LEN - 1);
+    player->rollback = join->action == JOIN_ROLLBACK;
+    player->sync_pending = player->rollback;
+    player->last_seen = clock_now_ns();
+    player->active = 1;
+    player->last_action = ACTION_IDLE;
+    input_buffer_init(&player->inputs);
+    stats_init(&player->stats);
+    player->next_snap_tick = sh->tick;
+    schedule_idle_check(sh, slot, player->last_seen);
+    if (rx_shard != sh->id) {
+        sh->remote_players++;
+    }
+    
+    room->num_players++;
+    sh->num_players++;
+    metrics_add(&sh->metrics.joins, 1);
+    
+    log_msg("🎮 [shard %d] Jugador %d conectado a sala %d: %s%s",
+            sh->id, player->id, room_idx, player->name, player->rollback ? " (rollback)" : "");
+    
+    if (room->num_players == MAX_PLAYERS) {
+        // Partida nueva (también si el lugar quedó libre a mitad de otra)
+        remove_waiting_room(sh, room_idx);
+        game_batch_init_lane(&sh->games, room_idx, (uint32_t)rand_r(&sh->rng_seed));
+        room->relay_frames = 0;
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            room->players[i].sync_pending = room->players[i].rollback;
+        }
+        log_msg("🏓 [shard %d] Sala %d: partida iniciada (%s vs %s)", sh->id, room_idx,
+                room->players[0].name, room->players[1].name);
+        if (sh->replay != NULL) {
+            record_match_start(sh, room_idx);
+        }
+        for (int i = 0; i < MAX_PLAYERS; i++) {
+            send_join_reply(sh, room_idx, &room->players[i]);
+        }
+    } else {
+        if (new_room) {
+            push_waiting_room(sh, room_idx);
+        }
+        send_join_reply(sh, room_idx, player);
+    }
+    
+    *room_out = room_idx;
+    return player;
+}
+
+/**
+ * Cierra la sesión de un espectador y libera su lugar, sin avisarle
+ */
+void close_spectator(struct shard *sh, int idx) {
+    struct spectator *spec = &sh->spectators[idx];
+    struct room *room = &sh->rooms[spec->room];
+    
+    if (spec->prev >= 0) {
+        sh->spectators[spec->prev].next = spec->next;
+    } else {
+        room->spectator_head = spec->next;
+    }
+    if (spec->next >= 0) {
+        sh->spectators[spec->next].prev = spec->prev;
+    }
+    
+    // Sala sin espectadores: sale del fan-out
+    if (--room->num_spectators == 0) {
+        int last = sh->watched_rooms[--sh->num_watched];
+        sh->watched_rooms[room->watched_pos] = last;
+        sh->rooms[last].watched_pos = room->watched_pos;
+        room->watched_pos = -1;
+    }
+    
+    session_remove(&sh->sessions, &spec->addr);
+    timer_wheel_cancel(&sh->idle_wheel, SPECTATOR_WHEEL_BASE + (uint32_t)idx);
+    if (spec->rx_shard != sh->id) {
+        send_unbind(sh, spec->rx_shard, &spec->addr);
+    }
+    spec->room = -1;
+    sh->free_spectators[sh->num_free_spectators++] = idx;
+}
+
+/**
+ * Cierra a los espectadores de una sala que se libera, con un MSG_ERROR
+ * para que sepan que no hay más partida
+ */
+void drop_room_spectators(struct shard *sh, int room_idx) {
+    struct server_message notice;
+    memset(&notice, 0, sizeof(notice));
+    notice.type = MSG_ERROR;
+    notice.timestamp = get_time_ms();
+    notice.room_id = (uint16_t)room_idx;
+    
+    while (sh->rooms[room_idx].spectator_head >= 0) {
+        int idx = sh->rooms[room_idx].spectator_head;
+        notice.session_token = sh->spectators[idx].token;
+        dgram_batch_queue(sh->sockfd, &sh->tx_batch, &notice, sizeof(notice),
+                          &sh->spectators[idx].addr);
+        stats_packet_sent(&sh->stats, sizeof(notice));
+        close_spectator(sh, idx);
+    }
+}
+
+/**
+ * Saca a un jugador de su sala y cierra su sesión en este shard, sin
+ * avisar a nadie. El lugar queda libre: la sala vuelve a esperar rival o
+ * se libera si quedó vacía.
+ */
+void detach_player(struct shard *sh, int room_idx, struct player_info *player) {
+    struct room *room = &sh->rooms[room_idx];
+    
+    session_remove(&sh->sessions, &player->addr);
+    timer_wheel_cancel(&sh->idle_wheel, (uint32_t)(room_idx * MAX_PLAYERS + (player->id - 1)));
+    if (player->rx_shard != sh->id) {
+        sh->remote_players--;
+    }
+    player->active = 0;
+    room->num_players--;
+    sh->num_players--;
+    
+    if (room->num_players == 0) {
+        drop_room_spectators(sh, room_idx);
+        release_room(sh, room_idx);
+    } else if (room->num_players == MAX_PLAYERS - 1) {
+        push_waiting_room(sh, room_idx);
+    }
+}
+
+/**
+ * Saca a un jugador que se fue: avisa al rival y a los espectadores, libera su lugar y, si
+ * sus paquetes llegan a otro shard, le pide que deje de reenviarlos
+ * @param reason PEER_LEFT_QUIT o PEER_LEFT_TIMEOUT
+ */
+void remove_player(struct shard *sh, int room_idx, struct player_info *player, uint8_t reason) {
+    struct room *room = &sh->rooms[room_idx];
+    
+    if (sh->replay != NULL && room->num_players == MAX_PLAYERS) {
+        record_match_end(sh, room_idx, player, reason);
+    }
+    
+    struct peer_left_message notice;
+    notice.type = MSG_PEER_LEFT;
+    notice.player_id = player->id;
+    notice.reason = reason;
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        struct player_info *other = &room->players[i];
+        if (other->active && other != player) {
+            dgram_batch_queue(sh->sockfd, &sh->tx_batch, &notice, sizeof(notice), &other->addr);
+            stats_packet_sent(&sh->stats, sizeof(notice));
+        }
+    }
+    for (int idx = room->spectator_head; idx >= 0; idx = sh->spectators[idx].next) {
+        dgram_batch_queue(sh->sockfd, &sh->tx_batch, &notice, sizeof(notice),
+                          &sh->spectators[idx].addr);
+        stats_packet_sent(&sh->stats, sizeof(notice));
+    }
+    
+    if (player->rx_shard != sh->id) {
+        send_unbind(sh, player->rx_shard, &player->addr);
+    }
+    
+    detach_player(sh, room_idx, player);
+}
+
+/**
+ * Busca al remitente de un mensaje a partir de su entrada en la tabla de
+ * sesiones; el token tiene que coincidir con el que se entregó en el JOIN
+ * @param slot Valor de session_find para su dirección
+ * @param room_out Sala del jugador (salida)
+ * @return Puntero al jugador o NULL si no hay sesión válida
+ */
+struct player_info *find_session(struct shard *sh, uint32_t slot, uint32_t token, int *room_out) {
+    if (slot == SESSION_NONE) {
+        sh->packets_misrouted++;
+        return NULL;
+    }
+    
+    struct player_info *player = &sh->rooms[slot / MAX_PLAYERS].players[slot % MAX_PLAYERS];
+    if (player->token != token) {
+        sh->packets_misrouted++;
+        return NULL;
+    }
+    
+    *room_out = (int)(slot / MAX_PLAYERS);
+    return player;
+}
+
+/**
+ * Un ticket sigue vigente si su sala todavía espera con la misma
+ * generación (lectura atómica: la sala puede ser de otro shard)
+ */
+int ticket_is_live(void *ctx, const struct match_ticket *ticket) {
+    (void)ctx;
+    if (ticket->shard >= num_shards || ticket->room >= MAX_ROOMS) {
+        return 0;
+    }
+    return atomic_load_explicit(&shards[ticket->shard]->room_gen[ticket->room],
+                                memory_order_acquire) == ticket->gen;
+}
+
+/**
+ * Entrega un jugador a la sala de un ticket de otro shard, que pasa a ser
+ * su dueño. El shard que recibe sus paquetes empieza a reenviárselos.
+ * Si sus paquetes llegan a un tercer shard, el BIND sale antes que el SEAT:
+ * si no se puede entregar no se movió nada y el jugador sigue aquí.
+ * @param seat Mensaje SEAT con el jugador (dirección, nombre, token, shard de recepción)
+ * @return 0 si se entregó, -1 si la bandeja de alguno de los dos estaba llena
+ */
+int hand_over_player(struct shard *sh, struct shard_msg *seat) {
+    int owner = seat->ticket.shard;
+    int rebind = seat->shard != sh->id && seat->shard != owner;
+    if (rebind && send_bind(sh, seat->shard, owner, &seat->addr) < 0) {
+        return -1;
+    }
+    
+    // Recibiendo aquí, el reenvío se anota antes: sin lugar en la tabla no se entrega
+    int local_rx = seat->shard == sh->id;
+    if (local_rx && session_insert(&sh->sessions, &seat->addr,
+                                   SESSION_REMOTE | (uint32_t)owner) < 0) {
+        return -1;
+    }
+    
+    if (send_to_shard(sh, owner, seat) < 0) {
+        // El llamador lo vuelve a sentar aquí: que el reenvío vuelva a este shard
+        if (local_rx) {
+            session_remove(&sh->sessions, &seat->addr);
+        }
+        if (rebind && send_bind(sh, seat->shard, sh->id, &seat->addr) < 0) {
+            log_warn("⚠️ [shard %d] El shard %d sigue reenviando a %s al shard %d",
+                     sh->id, seat->shard, seat->packet.player_name, owner);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Devuelve a la cola un ticket tomado que no se pudo usar (la bandeja de
+ * su dueño estaba llena). Sin agrupar por RTT su sala no se vuelve a
+ * publicar sola; agrupando, el dueño la republica en su próxima pasada.
+ */
+void return_ticket(struct shard *sh, const struct match_ticket *ticket) {
+    if (matchmaking.bucket_ms == 0 && match_publish(&matchmaking, 0, ticket) < 0) {
+        log_warn("⚠️ [shard %d] Cola de emparejamiento llena: la sala %d del shard %d "
+                 "espera sin ticket", sh->id, ticket->room, ticket->shard);
+    }
+}
+
+/**
+ * Lleva al jugador de una sala que espera a la sala de un ticket (de este
+ * shard o de otro); su sala queda vacía y se libera
+ */
+void move_player(struct shard *sh, int room_idx, struct player_info *player,
+                 const struct match_ticket *ticket) {
+    struct shard_msg seat;
+    memset(&seat, 0, sizeof(seat));
+    seat.type = SHARD_MSG_SEAT;
+    seat.shard = player->rx_shard;
+    seat.addr = player->addr;
+    seat.addr_len = player->addr_len;
+    seat.ticket = *ticket;
+    seat.token = player->token;
+    memcpy(seat.packet.player_name, player->name, PLAYER_NAME_LEN);
+    seat.packet.action = player->rollback ? JOIN_ROLLBACK : 0;
+    
+    detach_player(sh, room_idx, player);
+    
+    // Si no se pudo entregar, vuelve a esperar en una sala propia
+    int seated;
+    if (ticket->shard == sh->id) {
+        seat_player(sh, ticket->room, &seat.addr, seat.addr_len, &seat.packet,
+                    seat.token, seat.shard, &seated);
+    } else if (hand_over_player(sh, &seat) < 0) {
+        return_ticket(sh, ticket);
+        seat_player(sh, -1, &seat.addr, seat.addr_len, &seat.packet,
+                    seat.token, seat.shard, &seated);
+    }
+}
+
+/**
+ * Busca rival para el jugador de una sala que espera: toma un ticket de
+ * la cola y lo lleva a esa sala o, si no hay, publica el de su sala.
+ * Agrupando por RTT espera primero a tener su RTT medido y, mientras
+ * nadie lo toma, vuelve cada MATCH_WIDEN_MS a buscar un bucket más lejos.
+ */
+void match_room(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    struct player_info *player = room->players[0].active ? &room->players[0] : &room->players[1];
+    uint64_t now = clock_now_ns();
+    uint64_t waited_ms = (now - room->wait_since_ns) / 1000000;
+    int bucket = 0;
+    int widen = 0;
+    
+    if (matchmaking.bucket_ms != 0) {
+        if (player->rtt_samples == 0 && waited_ms < MATCH_PROBE_MS) {
+            room->match_retry_ns = room->wait_since_ns + MATCH_PROBE_MS * 1000000ULL;
+            return;
+        }
+        
+        // Sin medición a tiempo cuenta como el bucket más lento
+        bucket = player->rtt_samples > 0 ? match_bucket(&matchmaking, player->stats.rtt_avg)
+                                         : matchmaking.num_buckets - 1;
+        widen = (int)(waited_ms / MATCH_WIDEN_MS);
+        
+        // Vuelve a la cola: su ticket anterior vence
+        bump_room_gen(sh, room_idx);
+    }
+    
+    struct match_ticket ticket;
+    if (match_take(&matchmaking, bucket, widen, ticket_is_live, NULL, &ticket) == 0) {
+        move_player(sh, room_idx, player, &ticket);
+        return;
+    }
+    
+    ticket.shard = (uint16_t)sh->id;
+    ticket.room = (uint16_t)room_idx;
+    ticket.gen = atomic_load_explicit(&sh->room_gen[room_idx], memory_order_relaxed);
+    if (match_publish(&matchmaking, bucket, &ticket) < 0) {
+        room->match_retry_ns = now + MATCH_RETRY_MS * 1000000ULL;
+    } else if (matchmaking.bucket_ms != 0) {
+        room->match_retry_ns = now + MATCH_WIDEN_MS * 1000000ULL;
+    } else {
+        room->match_retry_ns = UINT64_MAX;
+    }
+}
+
+/**
+ * Pasada de emparejamiento: revisa las salas en espera cuya revisión
+ * venció, hasta MATCH_BUDGET por llamada
+ */
+void run_matchmaking(struct shard *sh) {
+    uint64_t now = clock_now_ns();
+    if (now < sh->match_next_ns) return;
+    
+    uint64_t next = UINT64_MAX;
+    int budget = MATCH_BUDGET;
+    int changed = 0;
+    int i = 0;
+    while (i < sh->num_waiting) {
+        int room_idx = sh->waiting_rooms[i];
+        struct room *room = &sh->rooms[room_idx];
+        
+        if (room->match_retry_ns <= now && budget > 0) {
+            budget--;
+            match_room(sh, room_idx);
+            if (room->waiting_pos != i) {
+                // Dejó la espera y otra sala ocupó su índice
+                changed = 1;
+                continue;
+            }
+        }
+        if (room->match_retry_ns < next) {
+            next = room->match_retry_ns;
+        }
+        i++;
+    }
+    
+    // Los cambios pueden haber movido salas a índices ya recorridos
+    sh->match_next_ns = changed ? 0 : next;
+}
+
+/**
+ * Carga en el lote las acciones de una sala y si su partida avanza
+ * @return 1 si la sala tiene partida en curso
+ */
+int load_room_inputs(struct shard *sh, int room_idx) {
+    struct room *room = &sh->rooms[room_idx];
+    struct player_info *players = room->players;
+    struct game_batch *games = &sh->games;
+    
+    // Un input por frame (cada frame_ticks ticks) y por jugador, también
+    // esperando rival (así no se acumulan para el comienzo de la partida).
+    // Entre dos inputs la paleta sigue con la misma acción.
+    for (int i = 0; i < MAX_PLAYERS && sh->tick % frame_ticks == 0; i++) {
+        if (players[i].active &&
+            input_buffer_next(&players[i].inputs, &sh->input_stats, &players[i].last_action)) {
+            players[i].has_input = 1;
+        }
+    }
+    
+    games->live[room_idx] = room->active && room->num_players == MAX_PLAYERS;
+    if (!games->live[room_idx]) return 0;
+    
+    // Frame nuevo: el anterior pasa al historial que se reenvía a los
+    // jugadores en modo rollback, si fue de esta partida y sin cortes
+    if (sh->tick % frame_ticks == 0) {
+        if (room->relay_frames > 0 &&
+            games->tick[room_idx] - room->relay_tick == (uint32_t)frame_ticks) {
+            room->relay_history[0] = input_history_push(room->relay_history[0],
+                                                        games->action1[room_idx]);
+            room->relay_history[1] = input_history_push(room->relay_history[1],
+                                                        games->action2[room_idx]);
+        } else {
+            room->relay_history[0] = INPUT_HISTORY_EMPTY;
+            room->relay_history[1] = INPUT_HISTORY_EMPTY;
+        }
+        room->relay_tick = games->tick[room_idx];
+        room->relay_frames++;
+    }
+    
+    // Un jugador inactivo deja su paleta quieta
+    games->action1[room_idx] = players[0].active ? players[0].last_action : ACTION_IDLE;
+    games->action2[room_idx] = players[1].active ? players[1].last_action : ACTION_IDLE;
+    if (sh->replay != NULL) {
+        record_inputs(sh, room_idx);
+    }
+    return 1;
+}
+
+/**
+ * Actualiza la física de todas las partidas en curso del shard con un solo
+ * paso del kernel en lote y registra los goles
+ * @return Cantidad de salas simuladas
+ */
+int update_physics(struct shard *sh) {
+    struct game_batch *games = &sh->games;
+    int simulated = 0;
+    
+    for (int i = 0; i < sh->room_high_water; i++) {
+        simulated += load_room_inputs(sh, i);
+    }
+    
+    game_batch_step(games, sh->room_high_water);
+    
+    for (int i = 0; i < sh->room_high_water; i++) {
+        if (games->events[i] & GAME_EVENT_GOAL_P2) {
+            log_msg("⚽ [shard %d] GOL en sala %d! Jugador 2 anota. Marcador: %d - %d",
+                    sh->id, i, games->score1[i], games->score2[i]);
+        }
+        if (games->events[i] & GAME_EVENT_GOAL_P1) {
+            log_msg("⚽ [shard %d] GOL en sala %d! Jugador 1 anota. Marcador: %d - %d",
+                    sh->id, i, games->score1[i], games->score2[i]);
+        }
+        if (sh->replay != NULL && games->live[i] && games->tick[i] % REPLAY_KEYFRAME_TICKS == 0) {
+            record_keyframe(sh, i);
+        }
+    }
+    
+    return simulated;
+}
+
+/**
+ * Contabiliza un paquete de un jugador: pérdida y desorden por su
+ * secuencia, y guarda su timestamp para devolverlo como eco
+ */
+void track_client_packet(struct shard *sh, struct player_info *player,
+                         const struct client_message *msg) {
+    uint32_t lost_before = player->stats.packets_lost;
+    uint32_t reordered_before = player->stats.packets_reordered;
+    
+    player->last_seen = clock_now_ns();
+    stats_packet_received(&player->stats, sizeof(*msg));
+    int newest = stats_track_sequence(&player->stats, msg->seq);
+    
+    // Reflejar en el agregado del shard (la resta modular cubre el descuento)
+    sh->stats.packets_lost += player->stats.packets_lost - lost_before;
+    sh->stats.packets_reordered += player->stats.packets_reordered - reordered_before;
+    
+    // Solo el timestamp más nuevo sirve de eco: uno viejo inflaría el RTT.
+    // El JOIN no: el cliente ya lo mide con la respuesta y luego hace una
+    // pausa antes de leer el socket, lo que arruinaría la muestra.
+    if (newest && msg->type != MSG_JOIN) {
+        player->echo_ts = msg->timestamp;
+        player->echo_recv_us = sh->batch_recv_us;
+        player->echo_pending = 1;
+    }
+}
+
+/**
+ * RTT de un ack: tiempo desde que salió ese tick menos lo que el snapshot
+ * esperó en el cliente antes de confirmarse. Los lotes llenos salen antes
+ * del envío final que marca tick_sent_us, así que un ack reenviado desde
+ * otro shard puede llegar con una hora anterior a esa marca: esa muestra
+ * no sirve y se descarta.
+ * @return RTT en ms o -1 si el tick ya salió del historial o la muestra es negativa
+ */
+float ack_rtt_ms(struct shard *sh, uint16_t ack_tick, uint8_t hold_ms) {
+    uint32_t acked = sh->tick - (uint16_t)(sh->tick - ack_tick);
+    uint32_t age = sh->tick - acked;
+    if (age == 0 || age >= SNAP_HISTORY) return -1;
+    
+    int64_t elapsed_us = (int64_t)sh->batch_recv_us -
+                         (int64_t)sh->tick_sent_us[acked % SNAP_HISTORY];
+    if (elapsed_us < 0) return -1;
+    
+    float rtt = elapsed_us / 1000.0f - hold_ms;
+    return rtt < 0 ? 0 : rtt;
+}
+
+/**
+ * Mide el RTT de un jugador con un ack nuevo
+ */
+void measure_ack_rtt(struct shard *sh, struct player_info *player,
+                     uint16_t ack_tick, uint8_t hold_ms) {
+    float rtt = ack_rtt_ms(sh, ack_tick, hold_ms);
+    if (rtt < 0) return;
+    
+    stats_update_rtt(&player->stats, rtt);
+    stats_update_rtt(&sh->stats, rtt);
+    if (player->rtt_samples < UINT16_MAX) {
+        player->rtt_samples++;
+    }
+}
+
+/**
+ * Reenvía el datagrama de un jugador al shard donde vive
+ * @return 0 si se entregó, -1 si la bandeja del destino estaba llena
+ */
+int forward_packet(struct shard *sh, int owner, const struct client_message *msg,
+                    const struct sockaddr_in *addr, socklen_t addr_len) {
+    struct shard_msg fwd;
+    memset(&fwd, 0, sizeof(fwd));
+    fwd.type = SHARD_MSG_PACKET;
+    fwd.shard = (uint8_t)sh->id;
+    fwd.addr = *addr;
+    fwd.addr_len = addr_len;
+    fwd.recv_us = sh->batch_recv_us;
+    fwd.packet = *msg;
+    return send_to_shard(sh, owner, &fwd);
+}
+
+/**
+ * JOIN de una dirección sin sesión. Sin agrupar por RTT toma en el acto
+ * el lugar de una sala que espera (aunque sea de otro shard); si no hay,
+ * o si se agrupa, abre una sala y pasa por la cola de emparejamiento.
+ * @param rx_shard Shard cuyo socket recibe sus paquetes
+ */
+void handle_join(struct shard *sh, const struct client_message *msg,
+                 const struct sockaddr_in *addr, socklen_t addr_len, int rx_shard) {
+    int room_idx = -1;
+    struct match_ticket ticket;
+    
+    if (matchmaking.bucket_ms == 0 &&
+        match_take(&matchmaking, 0, 0, ticket_is_live, NULL, &ticket) == 0) {
+        if (ticket.shard == sh->id) {
+            room_idx = ticket.room;
+        } else {
+            // La sala es de otro shard: el JOIN viaja con el ticket y allí
+            // se le abre la sesión y se le responde
+            struct shard_msg seat;
+            memset(&seat, 0, sizeof(seat));
+            seat.type = SHARD_MSG_SEAT;
+            seat.shard = (uint8_t)rx_shard;
+            seat.addr = *addr;
+            seat.addr_len = addr_len;
+            seat.packet = *msg;
+            seat.ticket = ticket;
+            if (hand_over_player(sh, &seat) == 0) {
+                return;
+            }
+            return_ticket(sh, &ticket);
+        }
+    }
+    
+    struct player_info *player = seat_player(sh, room_idx, addr, addr_len, msg, 0, rx_shard,
+                                             &room_idx);
+    if (player == NULL) {
+        log_warn("⛔ [shard %d] Servidor lleno (%d salas), JOIN rechazado: %s",
+                 sh->id, MAX_ROOMS, msg->player_name);
+        metrics_add(&sh->metrics.joins_rejected, 1);
+        return;
+    }
+    track_client_packet(sh, player, msg);
+    
+    // Sala nueva: publicarla ya, para que la encuentre el próximo JOIN
+    // aunque llegue en este mismo lote
+    if (sh->rooms[room_idx].waiting_pos >= 0) {
+        match_room(sh, room_idx);
+    }
+}
+
+/**
+ * Pedido de un espectador (MSG_SPECTATE sin sesión). Si apunta a otro
+ * shard viaja hasta su dueño y los paquetes siguientes de esa dirección
+ * se le reenvían, igual que los de un jugador sentado allí. Si la sala no
+ * existe o no quedan lugares se responde MSG_ERROR.
+ * @param rx_shard Shard cuyo socket recibe sus paquetes
+ */
+void handle_spectate(struct shard *sh, const struct client_message *msg,
+                     const struct sockaddr_in *addr, socklen_t addr_len, int rx_shard) {
+    int owner = msg->ack_hold_ms == SPECTATE_ANY_SHARD ? sh->id : msg->ack_hold_ms;
+    if (owner != sh->id && owner < num_shards && rx_shard == sh->id) {
+        // Sin entregar no queda una sesión a medias: otro pedido vuelve a
+        // intentar. Sin lugar en la tabla se responde MSG_ERROR (abajo).
+        if (session_insert(&sh->sessions, addr, SESSION_REMOTE | (uint32_t)owner) == 0) {
+            if (forward_packet(sh, owner, msg, addr, addr_len) < 0) {
+                session_remove(&sh->sessions, addr);
+            }
+            return;
+        }
+    }
+    
+    int room_idx = msg->input_seq;
+    if (room_idx == SPECTATE_ANY_ROOM) {
+        room_idx = -1;
+        for (int i = 0; i < sh->room_high_water && room_idx < 0; i++) {
+            if (sh->rooms[i].active && sh->rooms[i].num_players == MAX_PLAYERS) {
+                room_idx = i;
+            }
+        }
+    }
+    
+    int idx = -1;
+    if (owner == sh->id && room_idx >= 0 && room_idx < MAX_ROOMS &&
+        sh->rooms[room_idx].active && sh->num_free_spectators > 0) {
+        idx = sh->free_spectators[sh->num_free_spectators - 1];
+        if (session_insert(&sh->sessions, addr, SESSION_SPECTATOR | (uint32_t)idx) < 0) {
+            idx = -1;
+        }
+    }
+    
+    if (idx < 0) {
+        struct server_message reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.type = MSG_ERROR;
+        reply.timestamp = get_time_ms();
+        reply.room_id = msg->input_seq;
+        dgram_batch_queue(sh->sockfd, &sh->tx_batch, &reply, sizeof(reply), addr);
+        stats_packet_sent(&sh->stats, sizeof(reply));
+        if (rx_shard != sh->id) {
+            send_unbind(sh, rx_shard, addr);
+        }
+        return;
+    }
+    sh->num_free_spectators--;
+    
+    struct room *room = &sh->rooms[room_idx];
+    struct spectator *spec = &sh->spectators[idx];
+    memset(spec, 0, sizeof(*spec));
+    spec->addr = *addr;
+    spec->addr_len = addr_len;
+    spec->rx_shard = (uint8_t)rx_shard;
+    spec->token = new_session_token(sh);
+    spec->room = room_idx;
+    spec->prev = -1;
+    spec->next = room->spectator_head;
+    spec->last_seen = clock_now_ns();
+    stats_init(&spec->stats);
+    
+    if (spec->next >= 0) {
+        sh->spectators[spec->next].prev = idx;
+    }
+    room->spectator_head = idx;
+    if (room->num_spectators++ == 0) {
+        room->watched_pos = sh->num_watched;
+        sh->watched_rooms[sh->num_watched++] = room_idx;
+    }
+    
+    schedule_idle_check(sh, SPECTATOR_WHEEL_BASE + (uint32_t)idx, spec->last_seen);
+    send_room_state(sh, room_idx, addr, SPECTATOR_PLAYER_ID, spec->token);
+}
+
+/**
+ * Anota un snapshot enviado
+ */
+void downlink_sent(struct downlink *dl, uint32_t tick) {
+    dl->sent++;
+    dl->sent_log[tick % SNAP_HISTORY].tick = (uint16_t)tick;
+    dl->sent_log[tick % SNAP_HISTORY].count = dl->sent;
+}
+
+/**
+ * Toma un ack nuevo: enviados hasta el snapshot confirmado (el último que
+ * recibió) contra recibidos según el cliente, desde el ack de referencia
+ * @return 1 si actualizó la pérdida (ya hubo DOWNLINK_LOSS_SAMPLE envíos)
+ */
+int downlink_ack(struct downlink *dl, uint16_t ack_tick, uint16_t recv_total) {
+    const struct sent_mark *mark = &dl->sent_log[ack_tick % SNAP_HISTORY];
+    if (mark->tick != ack_tick) return 0;
+    
+    int updated = 0;
+    if (dl->reported) {
+        uint16_t sent = mark->count - dl->report_sent;
+        uint16_t recv = recv_total - dl->report_recv;
+        if (sent < DOWNLINK_LOSS_SAMPLE) return 0;
+        float loss = recv >= sent ? 0.0f : 1.0f - (float)recv / sent;
+        dl->loss += (loss - dl->loss) * 0.25f;
+        updated = 1;
+    }
+    dl->report_sent = mark->count;
+    dl->report_recv = recv_total;
+    dl->reported = 1;
+    return updated;
+}
+
+/**
+ * Ajusta el nivel de ritmo de snapshots a la pérdida y el RTT del enlace
+ */
+void update_snapshot_rate(uint8_t *level, float loss, float rtt) {
+    if (loss >= SNAP_RATE_LOSS_SLOWEST || rtt >= SNAP_RATE_RTT_SLOWEST_MS) {
+        *level = SNAP_RATE_LEVELS - 1;
+    } else if (loss >= SNAP_RATE_LOSS_SLOW || rtt >= SNAP_RATE_RTT_SLOW_MS) {
+        if (*level < SNAP_RATE_LEVELS - 2) {
+            (*level)++;
+        }
+    } else if (loss < SNAP_RATE_LOSS_SLOW / 2 && *level > 0) {
+        (*level)--;
+    }
+}
+
+/**
+ * Paquete de un espectador con sesión: keepalive (ack, RTT y pérdida de
+ * bajada), reintento del pedido o LEAVE. Un espectador no juega: sus
+ * JOIN e INPUT se ignoran hasta que envíe LEAVE.
+ */
+void handle_spectator_packet(struct shard *sh, int idx, const struct client_message *msg) {
+    struct spectator *spec = &sh->spectators[idx];
+    
+    // Reintento del pedido (se perdió la respuesta): la misma sesión
+    if (msg->type == MSG_SPECTATE && msg->session_token == 0) {
+        spec->last_seen = clock_now_ns();
+        send_room_state(sh, spec->room, &spec->addr, SPECTATOR_PLAYER_ID, spec->token);
+        return;
+    }
+    if (msg->session_token != spec->token) {
+        sh->packets_misrouted++;
+        return;
+    }
+    if (msg->type == MSG_LEAVE) {
+        close_spectator(sh, idx);
+        return;
+    }
+    if (msg->type != MSG_SPECTATE) return;
+    
+    spec->last_seen = clock_now_ns();
+    stats_packet_received(&spec->stats, sizeof(*msg));
+    
+    // Solo un ack más nuevo que el anterior (los keepalives pueden llegar desordenados)
+    if (msg->ack_tick == 0 ||
+        (spec->ack_tick != 0 && (int16_t)(msg->ack_tick - spec->ack_tick) <= 0)) {
+        return;
+    }
+    spec->ack_tick = msg->ack_tick;
+    
+    float rtt = ack_rtt_ms(sh, msg->ack_tick, msg->ack_hold_ms);
+    if (rtt >= 0) {
+        stats_update_rtt(&spec->stats, rtt);
+    }
+    
+    if (downlink_ack(&spec->downlink, msg->ack_tick, msg->snapshots_recv)) {
+        update_snapshot_rate(&spec->rate_level, spec->downlink.loss, spec->stats.rtt_avg);
+    }
+}
+
+/**
+ * Procesa un mensaje del cliente
+ * @param rx_shard Shard que lo recibió del socket (este, o quien lo reenvió)
+ */
+void process_client_message(struct shard *sh, struct client_message *msg,
+                            struct sockaddr_in *client_addr, socklen_t addr_len, int rx_shard) {
+    uint32_t slot = session_find(&sh->sessions, client_addr);
+    
+    // Jugador que vive en otro shard: su dueño procesa el paquete. Uno que
+    // ya llegó reenviado no se vuelve a reenviar.
+    if (slot != SESSION_NONE && (slot & SESSION_REMOTE)) {
+        if (rx_shard == sh->id) {
+            forward_packet(sh, (int)(slot & SESSION_SHARD_MASK), msg, client_addr, addr_len);
+        } else {
+            sh->packets_misrouted++;
+        }
+        return;
+    }
+    if (slot != SESSION_NONE && (slot & SESSION_SPECTATOR)) {
+        handle_spectator_packet(sh, (int)(slot & SESSION_SPECTATOR_MASK), msg);
+        return;
+    }
+    
+    if (msg->type == MSG_JOIN) {
+        // Un JOIN desde una dirección con sesión es un reintento (se perdió
+        // la respuesta): se contesta con la misma sesión en vez de duplicarla
+        if (slot != SESSION_NONE) {
+            int room_idx = (int)(slot / MAX_PLAYERS);
+            struct player_info *player = &sh->rooms[room_idx].players[slot % MAX_PLAYERS];
+            track_client_packet(sh, player, msg);
+            send_join_reply(sh, room_idx, player);
+        } else {
+            handle_join(sh, msg, client_addr, addr_len, rx_shard);
+        }
+        
+    } else if (msg->type == MSG_INPUT) {
+        // Actualizar acción del jugador
+        int room_idx;
+        struct player_info *player = find_session(sh, slot, msg->session_token, &room_idx);
+        if (player != NULL) {
+            track_client_packet(sh, player, msg);
+            
+            // Guardar el input y los que repite el historial; cada uno se
+            // aplica en su tick. El mismo seq puede repetirse si la acción
+            // cambió dentro del frame (reemplaza la pendiente).
+            if (input_buffer_receive(&player->inputs, &sh->input_stats, msg->input_seq,
+                                     msg->action, msg->input_history) > 0) {
+                // Solo cuenta con la partida en curso (antes no hay snapshots)
+                if (player->input_recv_us == 0 && sh->rooms[room_idx].num_players == MAX_PLAYERS) {
+                    player->input_recv_us = sh->batch_recv_us;
+                }
+            }
+            // Quedarse con el ack más reciente (los paquetes pueden llegar desordenados).
+            // Un ack anterior al primer snapshot de esta sala es de la sala de
+            // la que vino el jugador y no sirve de base.
+            if (msg->ack_tick != 0 && player->first_snap_tick != 0 &&
+                (int16_t)(msg->ack_tick - (uint16_t)player->first_snap_tick) >= 0 &&
+                (player->ack_tick == 0 || (int16_t)(msg->ack_tick - player->ack_tick) > 0)) {
+                player->ack_tick = msg->ack_tick;
+                measure_ack_rtt(sh, player, msg->ack_tick, msg->ack_hold_ms);
+                if (downlink_ack(&player->downlink, msg->ack_tick, msg->snapshots_recv)) {
+                    update_snapshot_rate(&player->rate_level, player->downlink.loss,
+                                         player->stats.rtt_avg);
+                }
+            }
+        }
+        
+    } else if (msg->type == MSG_LEAVE) {
+        // Desconectar jugador: su lugar queda libre para otro
+        int room_idx;
+        struct player_info *player = find_session(sh, slot, msg->session_token, &room_idx);
+        if (player != NULL) {
+            log_msg("👋 [shard %d] Jugador %d desconectado de sala %d: %s", 
+                   sh->id, player->id, room_idx, player->name);
+            remove_player(sh, room_idx, player, PEER_LEFT_QUIT);
+        }
+        
+    } else if (msg->type == MSG_SPECTATE) {
+        // Un jugador sentado primero tiene que dejar su lugar
+        if (slot != SESSION_NONE) {
+            sh->packets_misrouted++;
+        } else {
+            handle_spectate(sh, msg, client_addr, addr_len, rx_shard);
+        }
+    }
+}
+
+/**
+ * Busca el snapshot confirmado por un jugador para usarlo como base
+ * @return Snapshot base o NULL si hay que enviar un keyframe
+ */
+const struct snapshot *find_baseline(struct shard *sh, struct room *room,
+                                     struct player_info *player) {
+    if (player->ack_tick == 0) return NULL;
+    
+    const struct snapshot *base = &room->history[player->ack_tick % SNAP_HISTORY];
+    uint32_t age = sh->tick - base->tick;
+    
+    // Debe ser exactamente el tick confirmado y seguir dentro del historial
+    if ((uint16_t)base->tick != player->ack_tick || age == 0 || age >= SNAP_HISTORY) {
+        return NULL;
+    }
+    return base;
+}
 
-// Variables globales
-struct player_info players[MAX_PLAYERS];
-struct game_state game;
-struct network_stats stats;
-int num_players = 0;
+/**
+ * Envía a un jugador en modo rollback las acciones del frame en curso de
+ * su sala y las de los anteriores
+ */
+void send_input_relay(struct shard *sh, int room_idx, const struct player_info *player) {
+    const struct room *room = &sh->rooms[room_idx];
+    struct input_relay relay;
+    
+    relay.type = MSG_INPUTS;
+    relay.tick = room->relay_tick;
+    relay.action1 = sh->games.action1[room_idx];
+    relay.action2 = sh->games.action2[room_idx];
+    relay.history1 = room->relay_history[0];
+    relay.history2 = room->relay_history[1];
+    dgram_batch_queue(sh->sockfd, &sh->tx_batch, &relay, sizeof(relay), &player->addr);
+    stats_packet_sent(&sh->stats, sizeof(relay));
+}
 
 /**
- * Inicializa el estado del juego
+ * Envía a un jugador en modo rollback el estado completo de su partida.
+ * Solo al terminar un frame: el estado es el del comienzo del siguiente.
  */
-void init_game(void) {
-    game.paddle1_y = FIELD_HEIGHT / 2.0f;
-    game.paddle2_y = FIELD_HEIGHT / 2.0f;
-    game.ball_x = FIELD_WIDTH / 2.0f;
-    game.ball_y = FIELD_HEIGHT / 2.0f;
-    game.ball_vx = BALL_SPEED;
-    game.ball_vy = BALL_SPEED * 0.5f;
-    game.score1 = 0;
-    game.score2 = 0;
+void send_sync(struct shard *sh, int room_idx, const struct player_info *player) {
+    struct game_state game;
+    struct sync_message sync;
     
-    memset(players, 0, sizeof(players));
-    stats_init(&stats);
+    game_batch_load(&sh->games, room_idx, &game);
+    sync.type = MSG_SYNC;
+    sync.tick = game.tick;
+    replay_keyframe_from_state(&sync.state, &game, sh->games.action1[room_idx],
+                               sh->games.action2[room_idx]);
+    dgram_batch_queue(sh->sockfd, &sh->tx_batch, &sync, sizeof(sync), &player->addr);
+    stats_packet_sent(&sh->stats, sizeof(sync));
 }
 
 /**
- * Reinicia la pelota al centro
+ * Guarda el estado del tick en el historial de la sala y se lo envía a
+ * los jugadores activos a los que les toca según su ritmo. Cada jugador
+ * recibe un delta contra el último snapshot que confirmó; los que están en
+ * modo rollback también las acciones del frame y, al empezar la partida y
+ * cada ROLLBACK_SYNC_FRAMES, el estado completo.
  */
-void reset_ball(void) {
-    game.ball_x = FIELD_WIDTH / 2.0f;
-    game.ball_y = FIELD_HEIGHT / 2.0f;
+void broadcast_state(struct shard *sh, struct room *room) {
+    const struct game_batch *games = &sh->games;
+    int lane = (int)(room - sh->rooms);
+    struct snapshot *cur = &room->history[sh->tick % SNAP_HISTORY];
+    
+    cur->tick = sh->tick;
+    cur->paddle1_y = snapshot_quantize(GAME_TO_FLOAT(games->paddle1_y[lane]));
+    cur->paddle2_y = snapshot_quantize(GAME_TO_FLOAT(games->paddle2_y[lane]));
+    cur->ball_x = snapshot_quantize(GAME_TO_FLOAT(games->ball_x[lane]));
+    cur->ball_y = snapshot_quantize(GAME_TO_FLOAT(games->ball_y[lane]));
+    cur->score1 = games->score1[lane];
+    cur->score2 = games->score2[lane];
+    
+    uint64_t now_us = clock_now_ns() / 1000;
     
-    // Velocidad aleatoria
-    game.ball_vx = (rand() % 2 == 0 ? 1 : -1) * BALL_SPEED;
-    game.ball_vy = ((rand() % 100) / 100.0f - 0.5f) * BALL_SPEED;
+    // El próximo tick empieza un frame (estado apto para MSG_SYNC); la fase
+    // por sala reparte los MSG_SYNC periódicos entre los ticks
+    int frame_done = games->live[lane] && (sh->tick + 1) % frame_ticks == 0;
+    int sync_due = frame_done &&
+                   (sh->tick + 1 + (uint32_t)lane * frame_ticks) %
+                   (ROLLBACK_SYNC_FRAMES * frame_ticks) == 0;
+    
+    // Encolar para los jugadores activos de la sala (se envía en lote)
+    uint8_t buf[SNAP_MAX_SIZE];
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        struct player_info *player = &room->players[i];
+        if (!player->active) continue;
+        
+        // El MSG_SYNC va detrás de las acciones del frame que termina: el
+        // cliente lo recibe con todo confirmado y puede compararlo
+        int sync = player->rollback && frame_done && (player->sync_pending || sync_due);
+        if (sync) {
+            if (room->relay_frames > 0) {
+                send_input_relay(sh, lane, player);
+            }
+            send_sync(sh, lane, player);
+            player->sync_pending = 0;
+        }
+        if ((int32_t)(sh->tick - player->next_snap_tick) < 0) continue;
+        player->next_snap_tick = sh->tick + snap_rate_frames[player->rate_level] * frame_ticks;
+        if (player->first_snap_tick == 0) {
+            player->first_snap_tick = sh->tick;
+        }
+        
+        struct snapshot_extra extra;
+        extra.mask = 0;
+        
+        // Estadísticas del enlace de este jugador, solo a baja frecuencia
+        if (sh->tick - player->last_stats_tick >= (uint32_t)(SNAPSHOT_STATS_INTERVAL * frame_ticks)) {
+            player->last_stats_tick = sh->tick;
+            extra.mask |= SNAP_STATS;
+            extra.stats.rtt_ms = (uint16_t)player->stats.rtt_avg;
+            extra.stats.loss_percent = stats_get_loss_percent(&player->stats);
+            extra.stats.packets_sent = player->stats.packets_sent;
+            extra.stats.packets_recv = player->stats.packets_received;
+        }
+        
+        // Latencia del servidor: desde que llegó el input hasta este envío
+        if (player->input_recv_us != 0) {
+            histogram_record(&sh->input_hist, now_us - player->input_recv_us);
+            player->input_recv_us = 0;
+        }
+        
+        if (player->has_input) {
+            extra.mask |= SNAP_INPUT_ACK;
+            extra.input_ack = (uint8_t)player->inputs.applied;
+        }
+        
+        // Eco del timestamp del cliente a frecuencia reducida
+        if (player->echo_pending &&
+            sh->tick - player->last_echo_tick >= (uint32_t)(RTT_ECHO_INTERVAL * frame_ticks)) {
+            uint64_t hold_ms = (now_us - player->echo_recv_us) / 1000;
+            extra.mask |= SNAP_ECHO;
+            extra.echo_ts = (uint16_t)player->echo_ts;
+            extra.echo_hold_ms = hold_ms > 255 ? 255 : (uint8_t)hold_ms;
+            player->echo_pending = 0;
+            player->last_echo_tick = sh->tick;
+        }
+        
+        size_t len = snapshot_encode(buf, cur, find_baseline(sh, room, player), &extra);
+        dgram_batch_queue(sh->sockfd, &sh->tx_batch, buf, len, &player->addr);
+        downlink_sent(&player->downlink, sh->tick);
+        stats_packet_sent(&player->stats, len);
+        stats_packet_sent(&sh->stats, len);
+        sh->snapshot_bytes += len;
+        sh->snapshots_sent++;
+        
+        // Las acciones viajan al ritmo de los snapshots: el historial cubre
+        // los frames entre dos envíos
+        if (player->rollback && games->live[lane] && room->relay_frames > 0 && !sync) {
+            send_input_relay(sh, lane, player);
+        }
+    }
 }
 
 /**
- * Registra un nuevo jugador
+ * Envía el snapshot de una sala a sus espectadores, empezando por donde
+ * quedó el tick anterior si el presupuesto lo cortó
+ * @return 1 si terminó, 0 si se acabó el presupuesto (room->fanout_resume
+ *         queda en el primero que faltó)
  */
-int register_player(struct sockaddr_in *addr, socklen_t addr_len, const char *name) {
-    if (num_players >= MAX_PLAYERS) {
-        return -1; // Servidor lleno
+int fan_out_room(struct shard *sh, int room_idx, uint64_t start) {
+    struct room *room = &sh->rooms[room_idx];
+    const struct snapshot *cur = &room->history[sh->tick % SNAP_HISTORY];
+    
+    // Sala esperando rival: solo tiene snapshot cada tantos ticks
+    if (cur->tick != sh->tick) return 1;
+    
+    uint8_t buf[SNAP_MAX_SIZE];
+    size_t len = snapshot_encode(buf, cur, NULL, NULL);
+    
+    int first = room->fanout_resume;
+    if (first < 0 || sh->spectators[first].room != room_idx) {
+        first = room->spectator_head;
     }
+    room->fanout_resume = -1;
     
-    int player_idx = num_players;
-    players[player_idx].addr = *addr;
-    players[player_idx].addr_len = addr_len;
-    players[player_idx].id = player_idx + 1;
-    strncpy(players[player_idx].name, name, PLAYER_NAME_LEN - 1);
-    players[player_idx].last_seen = time(NULL);
-    players[player_idx].active = 1;
-    players[player_idx].last_action = ACTION_IDLE;
+    // La lista se recorre circular desde first
+    int idx = first;
+    int visited = 0;
+    do {
+        struct spectator *spec = &sh->spectators[idx];
+        if (++visited % NETIO_BATCH == 0 && get_time_us() - start >= SPECTATOR_BUDGET_US) {
+            room->fanout_resume = idx;
+            return 0;
+        }
+        
+        if ((sh->tick + (uint32_t)idx) % (snap_rate_frames[spec->rate_level] * frame_ticks) == 0) {
+            dgram_batch_queue(sh->sockfd, &sh->tx_batch, buf, len, &spec->addr);
+            downlink_sent(&spec->downlink, sh->tick);
+            stats_packet_sent(&sh->stats, len);
+            sh->spectator_snapshots++;
+        }
+        idx = spec->next >= 0 ? spec->next : room->spectator_head;
+    } while (idx != first);
+    return 1;
+}
+
+/**
+ * Envía el snapshot del tick a los espectadores, después de que salieron
+ * los de los jugadores. El keyframe de cada sala se codifica una sola vez
+ * y se encola igual para todos sus espectadores (sin base propia, así que
+ * saltear ticks o perder snapshots no les cuesta nada); sendmmsg los manda
+ * en lotes de NETIO_BATCH. Cada espectador recibe uno según su ritmo, con
+ * fase propia para no juntar a todos en el mismo tick.
+ */
+void fan_out_spectators(struct shard *sh) {
+    if (sh->num_watched == 0) return;
     
-    num_players++;
+    uint64_t start = get_time_us();
+    int total = sh->num_watched;
+    int done = 0;
     
-    log_msg("🎮 Jugador %d conectado: %s", players[player_idx].id, name);
+    while (done < total) {
+        if (done > 0 && get_time_us() - start >= SPECTATOR_BUDGET_US) {
+            break;
+        }
+        int room_idx = sh->watched_rooms[(sh->fanout_cursor + done) % total];
+        if (!fan_out_room(sh, room_idx, start)) {
+            break;
+        }
+        done++;
+    }
+    dgram_batch_flush(sh->sockfd, &sh->tx_batch);
     
-    return players[player_idx].id;
+    // Las salas que no entraron (o no terminaron) van primero en el próximo tick
+    sh->fanout_deferred += total - done;
+    sh->fanout_cursor = (sh->fanout_cursor + done) % total;
+    sh->fanout_time_us += get_time_us() - start;
+    sh->fanouts++;
+}
+
+/**
+ * Cuenta un tick en el histograma de métricas
+ */
+void record_tick_metric(struct shard *sh, uint64_t elapsed_us) {
+    int bucket = 0;
+    while (bucket < TICK_METRIC_BUCKETS && elapsed_us > tick_metric_bounds_us[bucket]) {
+        bucket++;
+    }
+    metrics_add(&sh->metrics.tick_buckets[bucket], 1);
+    metrics_add(&sh->metrics.tick_sum_us, elapsed_us);
+    metrics_add(&sh->metrics.ticks, 1);
 }
 
 /**
- * Actualiza la física del juego
+ * Simula y difunde un frame de todas las salas con partida en curso
  */
-void update_physics(void) {
-    // Actualizar posiciones de paletas según acciones
-    if (num_players > 0 && players[0].active) {
-        game.paddle1_y += players[0].last_action * PADDLE_SPEED;
-        game.paddle1_y = clamp(game.paddle1_y, PADDLE_HEIGHT / 2, 
-                               FIELD_HEIGHT - PADDLE_HEIGHT / 2);
+void run_tick(struct shard *sh) {
+    uint64_t start = clock_refresh() / 1000;
+    PROF_BEGIN(physics_ns);
+    int simulated = update_physics(sh);
+    PROF_END(sh->prof, PROF_PHYSICS, physics_ns, sh->tick);
+    
+    PROF_BEGIN(broadcast_ns);
+    for (int i = 0; i < sh->room_high_water; i++) {
+        if (sh->games.live[i]) {
+            broadcast_state(sh, &sh->rooms[i]);
+        } else if (sh->rooms[i].waiting_pos >= 0 &&
+                   sh->tick % (WAITING_SNAPSHOT_INTERVAL * frame_ticks) == 0) {
+            broadcast_state(sh, &sh->rooms[i]);
+        }
     }
+    PROF_END(sh->prof, PROF_BROADCAST, broadcast_ns, sh->tick);
+    
+    // Enviar el fan-out del tick con sendmmsg
+    PROF_BEGIN(send_ns);
+    dgram_batch_flush(sh->sockfd, &sh->tx_batch);
+    PROF_END(sh->prof, PROF_SEND, send_ns, sh->tick);
+    uint64_t sent = get_time_us();
+    sh->tick_sent_us[sh->tick % SNAP_HISTORY] = sent;
+    
+    // Los espectadores después: no suman latencia a los jugadores ni al
+    // costo medido del tick
+    PROF_BEGIN(spectators_ns);
+    fan_out_spectators(sh);
+    PROF_END(sh->prof, PROF_SPECTATORS, spectators_ns, sh->tick);
+    sh->tick++;
+    sh->last_tick_ns = get_time_ns() - start * 1000;
     
-    if (num_players > 1 && players[1].active) {
-        game.paddle2_y += players[1].last_action * PADDLE_SPEED;
-        game.paddle2_y = clamp(game.paddle2_y, PADDLE_HEIGHT / 2, 
-                               FIELD_HEIGHT - PADDLE_HEIGHT / 2);
+    uint64_t elapsed = sent - start;
+    histogram_record(&sh->tick_hist, elapsed);
+    record_tick_metric(sh, elapsed);
+    sh->tick_time_us += elapsed;
+    sh->ticks_measured++;
+    sh->rooms_simulated += simulated;
+}
+
+/**
+ * Reporta el costo medio del tick y la capacidad estimada por núcleo
+ */
+void report_capacity(struct shard *sh) {
+    // Tasa de paquetes desde el reporte anterior
+    uint32_t sent = sh->stats.packets_sent - sh->report_packets_sent;
+    uint32_t received = sh->stats.packets_received - sh->report_packets_received;
+    sh->report_packets_sent = sh->stats.packets_sent;
+    sh->report_packets_received = sh->stats.packets_received;
+    
+    log_msg("📶 [shard %d] Paquetes: %.0f rx/s | %.0f tx/s | %u de remitente ajeno | "
+            "%u cortos | Subida: %u%% perdidos, %u desordenados | RTT: %.1f ms | "
+            "Snapshot: %.1f bytes/cliente/tick",
+            sh->id, received * 1000.0 / CAPACITY_REPORT_MS, sent * 1000.0 / CAPACITY_REPORT_MS,
+            sh->packets_misrouted, sh->packets_short, stats_get_loss_percent(&sh->stats),
+            sh->stats.packets_reordered, sh->stats.rtt_avg,
+            sh->snapshots_sent ? (double)sh->snapshot_bytes / sh->snapshots_sent : 0.0);
+    sh->snapshot_bytes = 0;
+    sh->snapshots_sent = 0;
+    
+    // Inputs desde el reporte anterior
+    struct input_stats *in = &sh->input_stats;
+    uint32_t recovered = in->recovered - sh->report_inputs.recovered;
+    uint32_t lost = in->lost - sh->report_inputs.lost;
+    uint32_t trimmed = in->trimmed - sh->report_inputs.trimmed;
+    uint32_t starved = in->starved - sh->report_inputs.starved;
+    sh->report_inputs = *in;
+    if (recovered > 0 || lost > 0 || trimmed > 0) {
+        log_msg("🎮 [shard %d] Inputs: %u recuperados del historial | %u perdidos | "
+                "%u descartados por espera | %u ticks sin input nuevo",
+                sh->id, recovered, lost, trimmed, starved);
     }
     
-    // Actualizar posición de la pelota
-    game.ball_x += game.ball_vx;
-    game.ball_y += game.ball_vy;
+    if (sh->num_waiting > 0 || sh->remote_players > 0 || sh->inbox_dropped > 0) {
+        log_msg("🤝 [shard %d] Emparejamiento: %d salas esperando rival | "
+                "%d jugadores con sus paquetes en otro shard | %u mensajes entre shards perdidos",
+                sh->id, sh->num_waiting, sh->remote_players, sh->inbox_dropped);
+    }
     
-    // Rebote en paredes superior e inferior
-    if (game.ball_y <= BALL_SIZE / 2 || game.ball_y >= FIELD_HEIGHT - BALL_SIZE / 2) {
-        game.ball_vy = -game.ball_vy;
-        game.ball_y = clamp(game.ball_y, BALL_SIZE / 2, FIELD_HEIGHT - BALL_SIZE / 2);
+    // Jugadores por ritmo de snapshots (solo si alguno bajó)
+    int players_by_rate[SNAP_RATE_LEVELS] = {0};
+    for (int i = 0; i < sh->room_high_water; i++) {
+        for (int p = 0; p < MAX_PLAYERS; p++) {
+            const struct player_info *player = &sh->rooms[i].players[p];
+            if (player->active) {
+                players_by_rate[player->rate_level]++;
+            }
+        }
+    }
+    for (int level = 0; level < SNAP_RATE_LEVELS; level++) {
+        metrics_set(&sh->metrics.players_by_rate[level], (uint64_t)players_by_rate[level]);
+    }
+    if (sh->num_players > players_by_rate[0]) {
+        log_msg("📉 [shard %d] Snapshots a jugadores a 60/30/20/10 Hz: %d/%d/%d/%d",
+                sh->id, players_by_rate[0], players_by_rate[1], players_by_rate[2], players_by_rate[3]);
     }
     
-    // Colisión con paleta izquierda (jugador 1)
-    if (game.ball_x <= PADDLE_WIDTH + BALL_SIZE / 2) {
-        if (fabs(game.ball_y - game.paddle1_y) <= PADDLE_HEIGHT / 2) {
-            game.ball_vx = fabs(game.ball_vx); // Rebote hacia la derecha
-            game.ball_x = PADDLE_WIDTH + BALL_SIZE / 2;
-            
-            // Agregar efecto según dónde golpea
-            float hit_pos = (game.ball_y - game.paddle1_y) / (PADDLE_HEIGHT / 2);
-            game.ball_vy += hit_pos * 0.5f;
+    if (sh->num_watched > 0 || sh->spectator_snapshots > 0) {
+        // Espectadores por ritmo de snapshots
+        int by_rate[SNAP_RATE_LEVELS] = {0};
+        for (int i = 0; i < sh->num_watched; i++) {
+            int idx = sh->rooms[sh->watched_rooms[i]].spectator_head;
+            for (; idx >= 0; idx = sh->spectators[idx].next) {
+                by_rate[sh->spectators[idx].rate_level]++;
+            }
         }
+        log_msg("🎥 [shard %d] Espectadores: %d en %d salas | %.0f snapshots/s | "
+                "Fan-out: %.1f us/tick | A 60/30/20/10 Hz: %d/%d/%d/%d | "
+                "%u salas postergadas por presupuesto",
+                sh->id, MAX_SPECTATORS - sh->num_free_spectators, sh->num_watched,
+                sh->spectator_snapshots * 1000.0 / CAPACITY_REPORT_MS,
+                sh->fanouts ? (double)sh->fanout_time_us / sh->fanouts : 0.0,
+                by_rate[0], by_rate[1], by_rate[2], by_rate[3], sh->fanout_deferred);
+        sh->spectator_snapshots = 0;
+        sh->fanout_time_us = 0;
+        sh->fanouts = 0;
+        sh->fanout_deferred = 0;
     }
     
-    // Colisión con paleta derecha (jugador 2)
-    if (game.ball_x >= FIELD_WIDTH - PADDLE_WIDTH - BALL_SIZE / 2) {
-        if (fabs(game.ball_y - game.paddle2_y) <= PADDLE_HEIGHT / 2) {
-            game.ball_vx = -fabs(game.ball_vx); // Rebote hacia la izquierda
-            game.ball_x = FIELD_WIDTH - PADDLE_WIDTH - BALL_SIZE / 2;
-            
-            // Agregar efecto según dónde golpea
-            float hit_pos = (game.ball_y - game.paddle2_y) / (PADDLE_HEIGHT / 2);
-            game.ball_vy += hit_pos * 0.5f;
+    if (sh->prof != NULL) {
+        // Desbordes del tick por causa desde el reporte anterior
+        char causes[256];
+        size_t len = 0;
+        uint32_t total = 0;
+        causes[0] = '\0';
+        for (int i = 0; i <= PROF_PHASES && len < sizeof(causes); i++) {
+            if (sh->prof->overruns[i] == 0) continue;
+            int n = snprintf(causes + len, sizeof(causes) - len, "%s%s %u", len > 0 ? ", " : "",
+                             prof_phase_name(i), sh->prof->overruns[i]);
+            if (n > 0) len += (size_t)n;
+            total += sh->prof->overruns[i];
+            sh->prof->overruns[i] = 0;
         }
+        log_msg("🐢 [shard %d] Desbordes del tick: %u | Por causa: %s",
+                sh->id, total, total > 0 ? causes : "-");
     }
     
-    // Gol del jugador 2 (pelota sale por la izquierda)
-    if (game.ball_x < 0) {
-        game.score2++;
-        log_msg("⚽ GOL! Jugador 2 anota. Marcador: %d - %d", game.score1, game.score2);
-        reset_ball();
+    if (sh->replay != NULL) {
+        log_msg("🎞️ [shard %d] Repetición: %.1f MB escritos | %llu registros descartados",
+                sh->id, atomic_load_explicit(&sh->replay->written, memory_order_relaxed) / 1e6,
+                (unsigned long long)sh->replay->dropped);
     }
     
-    // Gol del jugador 1 (pelota sale por la derecha)
-    if (game.ball_x > FIELD_WIDTH) {
-        game.score1++;
-        log_msg("⚽ GOL! Jugador 1 anota. Marcador: %d - %d", game.score1, game.score2);
-        reset_ball();
+    log_msg("⏱️ [shard %d] p50/p90/p99/p99.9 | Tick: %llu/%llu/%llu/%llu us | "
+            "Input->envío: %.1f/%.1f/%.1f/%.1f ms | RTT: %.1f/%.1f/%.1f/%.1f ms | "
+            "%u ticks descartados por atraso",
+            sh->id,
+            (unsigned long long)histogram_percentile(&sh->tick_hist, 50),
+            (unsigned long long)histogram_percentile(&sh->tick_hist, 90),
+            (unsigned long long)histogram_percentile(&sh->tick_hist, 99),
+            (unsigned long long)histogram_percentile(&sh->tick_hist, 99.9),
+            histogram_percentile(&sh->input_hist, 50) / 1000.0,
+            histogram_percentile(&sh->input_hist, 90) / 1000.0,
+            histogram_percentile(&sh->input_hist, 99) / 1000.0,
+            histogram_percentile(&sh->input_hist, 99.9) / 1000.0,
+            histogram_percentile(&sh->rtt_hist, 50) / 1000.0,
+            histogram_percentile(&sh->rtt_hist, 90) / 1000.0,
+            histogram_percentile(&sh->rtt_hist, 99) / 1000.0,
+            histogram_percentile(&sh->rtt_hist, 99.9) / 1000.0,
+            sh->ticks_dropped);
+    sh->ticks_dropped = 0;
+    histogram_init(&sh->tick_hist);
+    histogram_init(&sh->input_hist);
+    histogram_init(&sh->rtt_hist);
+    
+    if (sh->ticks_measured == 0) return;
+    
+    double avg_tick_us = (double)sh->tick_time_us / sh->ticks_measured;
+    double avg_rooms = (double)sh->rooms_simulated / sh->ticks_measured;
+    
+    if (avg_rooms >= 1.0 && avg_tick_us > 0.0) {
+        // Salas que cabrían en el presupuesto de un tick a este costo por sala
+        double us_per_room = avg_tick_us / avg_rooms;
+        double capacity = (1000000.0 / tick_rate) / us_per_room;
+        
+        log_msg("📊 [shard %d] Salas: %d activas | Tick: %.1f us (%.2f us/sala) | "
+                "Capacidad: %.0f salas/núcleo a %d Hz (objetivo %d)%s",
+                sh->id, sh->live_rooms, avg_tick_us, us_per_room, capacity, tick_rate,
+                ROOMS_PER_CORE_TARGET,
+                capacity < ROOMS_PER_CORE_TARGET ? " ⚠️" : "");
     }
+    
+    sh->tick_time_us = 0;
+    sh->ticks_measured = 0;
+    sh->rooms_simulated = 0;
 }
 
 /**
- * Procesa un mensaje del cliente
+ * Vencimiento de un espectador en la rueda de inactividad: se cierra sin
+ * aviso si dejó de enviar keepalives
+ */
+void expire_idle_spectator(struct shard *sh, int idx) {
+    struct spectator *spec = &sh->spectators[idx];
+    if (clock_now_ns() - spec->last_seen < PLAYER_TIMEOUT_NS) {
+        schedule_idle_check(sh, SPECTATOR_WHEEL_BASE + (uint32_t)idx, spec->last_seen);
+        return;
+    }
+    close_spectator(sh, idx);
+}
+
+/**
+ * Vencimiento de la rueda de inactividad. La rueda no se toca con cada
+ * paquete: al vencer se mira last_seen y, si el jugador siguió enviando,
+ * se reprograma una sola vez hasta su nuevo plazo. Así cada sesión cuesta
+ * a lo sumo una revisión por PLAYER_TIMEOUT_MS.
  */
-void process_client_message(int sockfd, struct client_message *msg, 
-                            struct sockaddr_in *client_addr, socklen_t addr_len) {
+void expire_idle_player(void *ctx, uint32_t slot) {
+    struct shard *sh = ctx;
+    if (slot >= SPECTATOR_WHEEL_BASE) {
+        expire_idle_spectator(sh, (int)(slot - SPECTATOR_WHEEL_BASE));
+        return;
+    }
     
-    if (msg->type == MSG_JOIN) {
-        // Registrar nuevo jugador
-        int player_id = register_player(client_addr, addr_len, msg->player_name);
-        
-        // Enviar confirmación (estado actual)
-        struct server_message response;
-        memset(&response, 0, sizeof(response));
-        response.type = MSG_STATE;
-        response.timestamp = get_time_ms();
-        response.player_id = player_id;  // Enviar ID asignado
-        response.paddle1_y = game.paddle1_y;
-        response.paddle2_y = game.paddle2_y;
-        response.ball_x = game.ball_x;
-        response.ball_y = game.ball_y;
-        response.score1 = game.score1;
-        response.score2 = game.score2;
-        
-        if (player_id > 0) {
-            sendto(sockfd, &response, sizeof(response), 0, 
-                   (struct sockaddr *)client_addr, addr_len);
-            stats_packet_sent(&stats, sizeof(response));
-        }
+    int room_idx = (int)(slot / MAX_PLAYERS);
+    struct player_info *player = &sh->rooms[room_idx].players[slot % MAX_PLAYERS];
+    
+    uint64_t idle_ns = clock_now_ns() - player->last_seen;
+    if (idle_ns < PLAYER_TIMEOUT_NS) {
+        schedule_idle_check(sh, slot, player->last_seen);
+        return;
+    }
+    
+    log_msg("💤 [shard %d] Jugador %d de sala %d sin responder hace %llu ms, sesión cerrada: %s",
+            sh->id, player->id, room_idx, (unsigned long long)(idle_ns / 1000000), player->name);
+    remove_player(sh, room_idx, player, PEER_LEFT_TIMEOUT);
+}
+
+/**
+ * Cierra las sesiones inactivas que vencieron desde la pasada anterior
+ */
+void sweep_idle_players(struct shard *sh) {
+    uint32_t now = idle_wheel_time(clock_now_ns());
+    if (timer_wheel_advance(&sh->idle_wheel, now, expire_idle_player, sh) > 0) {
+        // Avisos a los rivales
+        dgram_batch_flush(sh->sockfd, &sh->tx_batch);
+    }
+}
+
+/**
+ * Lee todos los datagramas encolados en el socket hasta vaciarlo
+ */
+void drain_socket(struct shard *sh) {
+    struct dgram_batch *rx = &sh->rx_batch;
+    int received;
+    
+    // Cada recvmmsg trae hasta NETIO_BATCH datagramas
+    do {
+        PROF_BEGIN(recv_ns);
+        received = dgram_batch_recv(sh->sockfd, rx);
+        PROF_END(sh->prof, PROF_RECV, recv_ns, sh->tick);
+        sh->batch_recv_us = clock_refresh() / 1000;
         
-    } else if (msg->type == MSG_INPUT) {
-        // Actualizar acción del jugador
-        int player_idx = msg->player_id - 1;
-        if (player_idx >= 0 && player_idx < num_players) {
-            players[player_idx].last_action = msg->action;
-            players[player_idx].last_seen = time(NULL);
+        PROF_BEGIN(process_ns);
+        for (int i = 0; i < received; i++) {
+            unsigned int len = rx->msgs[i].msg_len;
+            if (len == 0) continue;
+            
+            stats_packet_received(&sh->stats, len);
+            
+            // Un datagrama corto no llena el buffer: lo que falta sería del anterior
+            if (len < sizeof(struct client_message)) {
+                sh->packets_short++;
+                continue;
+            }
+            process_client_message(sh, (struct client_message *)rx->bufs[i],
+                                   &rx->addrs[i], rx->msgs[i].msg_hdr.msg_namelen, sh->id);
         }
-        
-    } else if (msg->type == MSG_LEAVE) {
-        // Desconectar jugador
-        int player_idx = msg->player_id - 1;
-        if (player_idx >= 0 && player_idx < num_players) {
-            players[player_idx].active = 0;
-            log_msg("👋 Jugador %d desconectado: %s", 
-                   players[player_idx].id, players[player_idx].name);
+        PROF_END(sh->prof, PROF_PROCESS, process_ns, sh->tick);
+    } while (received == NETIO_BATCH);
+    
+    // Respuestas generadas al procesar (confirmaciones de JOIN)
+    dgram_batch_flush(sh->sockfd, &sh->tx_batch);
+}
+
+/**
+ * Sienta a un jugador que otro shard trajo a una sala de este. Si la sala
+ * del ticket ya no espera, el jugador abre una propia aquí.
+ */
+void handle_seat(struct shard *sh, const struct shard_msg *seat) {
+    int room_idx = ticket_is_live(NULL, &seat->ticket) ? seat->ticket.room : -1;
+    struct player_info *player = seat_player(sh, room_idx, &seat->addr, seat->addr_len,
+                                             &seat->packet, seat->token, seat->shard,
+                                             &room_idx);
+    if (player == NULL) {
+        log_warn("⛔ [shard %d] Servidor lleno (%d salas), JOIN rechazado: %s",
+                 sh->id, MAX_ROOMS, seat->packet.player_name);
+        metrics_add(&sh->metrics.joins_rejected, 1);
+        if (seat->shard != sh->id) {
+            send_unbind(sh, seat->shard, &seat->addr);
         }
+        return;
+    }
+    
+    if (seat->token == 0) {
+        track_client_packet(sh, player, &seat->packet);
     }
 }
 
 /**
- * Envía el estado del juego a todos los jugadores activos
+ * Procesa los mensajes que dejaron otros shards en la bandeja
  */
-void broadcast_state(int sockfd) {
-    struct server_message state;
-    memset(&state, 0, sizeof(state));
-    
-    state.type = MSG_STATE;
-    state.timestamp = get_time_ms();
-    state.paddle1_y = game.paddle1_y;
-    state.paddle2_y = game.paddle2_y;
-    state.ball_x = game.ball_x;
-    state.ball_y = game.ball_y;
-    state.score1 = game.score1;
-    state.score2 = game.score2;
+void drain_inbox(struct shard *sh) {
+    uint64_t pending;
+    if (read(sh->wake_fd, &pending, sizeof(pending)) < 0) {
+        // Sin aviso: igual se revisa la bandeja
+    }
     
-    // Estadísticas
-    state.rtt_ms = (uint16_t)stats.rtt_avg;
-    state.loss_percent = stats_get_loss_percent(&stats);
-    state.packets_sent = stats.packets_sent;
-    state.packets_recv = stats.packets_received;
+    // Bajar la bandera antes de vaciar: un mensaje que llegue durante el
+    // vaciado vuelve a escribir el eventfd
+    atomic_store(&sh->inbox_signaled, 0);
+    clock_refresh();
     
-    // Enviar a todos los jugadores activos
-    for (int i = 0; i < num_players; i++) {
-        if (players[i].active) {
-            sendto(sockfd, &state, sizeof(state), 0, 
-                   (struct sockaddr *)&players[i].addr, players[i].addr_len);
-            stats_packet_sent(&stats, sizeof(state));
+    struct shard_msg msg;
+    while (lf_queue_pop(&sh->inbox, &msg) == 0) {
+        if (msg.type == SHARD_MSG_PACKET) {
+            sh->batch_recv_us = msg.recv_us;
+            process_client_message(sh, &msg.packet, &msg.addr, msg.addr_len, msg.shard);
+        } else if (msg.type == SHARD_MSG_SEAT) {
+            handle_seat(sh, &msg);
+        } else if (msg.type == SHARD_MSG_BIND) {
+            if (session_insert(&sh->sessions, &msg.addr, SESSION_REMOTE | msg.shard) < 0) {
+                log_warn("⚠️ [shard %d] Tabla de sesiones llena: los paquetes de un jugador "
+                         "del shard %d no se le reenvían", sh->id, msg.shard);
+            }
+        } else if (msg.type == SHARD_MSG_UNBIND) {
+            // Solo si todavía apunta al shard que avisa (pudo mudarse después)
+            if (session_find(&sh->sessions, &msg.addr) == (SESSION_REMOTE | msg.shard)) {
+                session_remove(&sh->sessions, &msg.addr);
+            }
         }
     }
+    
+    dgram_batch_flush(sh->sockfd, &sh->tx_batch);
 }
 
-int main(void) {
-    int sockfd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    struct client_message msg;
-    
-    // Inicializar juego
-    srand(time(NULL));
-    init_game();
-    
-    // Crear socket UDP
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+/**
+ * Crea el socket UDP de un shard, con SO_REUSEPORT para compartir el puerto
+ * @return Descriptor del socket o -1 en error
+ */
+int open_shard_socket(uint16_t port) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("Error al crear socket");
-        return 1;
+        return -1;
+    }
+    
+    int one = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("Error en SO_REUSEPORT");
+        close(sockfd);
+        return -1;
     }
     
     // Configurar socket como non-blocking
-    int flags = fcntl(sockfd, F_GETFL, 0);
-    fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+    set_nonblocking(sockfd);
     
     // Configurar dirección del servidor
+    struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(SERVER_PORT);
+    server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = INADDR_ANY;
     
     // Bind
     if (bind(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("Error en bind");
         close(sockfd);
-        return 1;
+        return -1;
+    }
+    
+    return sockfd;
+}
+
+/**
+ * Prepara un shard: salas, socket y loop de eventos (socket + timer del tick)
+ * @return 0 si tuvo éxito, -1 en error
+ */
+int init_shard(struct shard *sh, int id) {
+    sh->id = id;
+    sh->tick = 1;
+    sh->rng_seed = (unsigned int)time(NULL) ^ (unsigned int)(id * 2654435761u);
+    sh->games.frame_ticks = (uint8_t)frame_ticks;
+    init_rooms(sh);
+    
+    uint64_t hash_seed = ((uint64_t)rand_r(&sh->rng_seed) << 32) ^ (uint64_t)rand_r(&sh->rng_seed);
+    if (session_table_init(&sh->sessions, MAX_ROOMS * MAX_PLAYERS + MAX_SPECTATORS, hash_seed) < 0) {
+        perror("Error al crear la tabla de sesiones");
+        return -1;
+    }
+    if (timer_wheel_init(&sh->idle_wheel, SPECTATOR_WHEEL_BASE + MAX_SPECTATORS,
+                         idle_wheel_time(get_time_ns())) < 0) {
+        perror("Error al crear la rueda de inactividad");
+        return -1;
+    }
+    
+    // Lugares de espectadores, apilados para que el primero sea el 0
+    sh->spectators = malloc(MAX_SPECTATORS * sizeof(struct spectator));
+    sh->free_spectators = malloc(MAX_SPECTATORS * sizeof(int));
+    if (sh->spectators == NULL || sh->free_spectators == NULL) {
+        perror("Error al reservar los espectadores");
+        return -1;
+    }
+    for (int i = MAX_SPECTATORS - 1; i >= 0; i--) {
+        sh->spectators[i].room = -1;
+        sh->free_spectators[sh->num_free_spectators++] = i;
+    }
+    if (lf_queue_init(&sh->inbox, INBOX_CAPACITY, sizeof(struct shard_msg)) < 0) {
+        perror("Error al crear la bandeja del shard");
+        return -1;
+    }
+    
+    sh->sockfd = open_shard_socket(SERVER_PORT);
+    if (sh->sockfd < 0) {
+        return -1;
+    }
+    
+    sh->timer_fd = create_tick_timer(1000000000ULL / tick_rate);
+    sh->wake_fd = eventfd(0, EFD_NONBLOCK);
+    sh->epoll_fd = epoll_create1(0);
+    if (sh->timer_fd < 0 || sh->wake_fd < 0 || sh->epoll_fd < 0 ||
+        epoll_add_reader(sh->epoll_fd, sh->sockfd) < 0 ||
+        epoll_add_reader(sh->epoll_fd, sh->timer_fd) < 0 ||
+        epoll_add_reader(sh->epoll_fd, sh->wake_fd) < 0) {
+        perror("Error al crear el loop de eventos");
+        return -1;
+    }
+    
+#ifdef PONG_PROFILE
+    sh->prof = malloc(sizeof(struct prof_ring));
+    if (sh->prof == NULL) {
+        perror("Error al reservar el anillo del perfilador");
+        return -1;
+    }
+    prof_ring_init(sh->prof, id);
+#endif
+    
+    sh->sim_epoch_us = get_time_us();
+    sh->last_report = get_time_ms();
+    return 0;
+}
+
+/**
+ * Acumulador de paso fijo: simula los ticks que vencieron según el reloj
+ * monotónico (el tick N vence en sim_epoch + (N - 1) / tick_rate). El
+ * timerfd solo despierta al hilo; cuántos ticks tocan lo decide el reloj,
+ * así que un despertar tardío no desplaza la simulación respecto del
+ * tiempo real y cada tick avanza exactamente 1 / tick_rate.
+ */
+void run_due_ticks(struct shard *sh) {
+    uint64_t elapsed_us = clock_refresh() / 1000 - sh->sim_epoch_us;
+    uint32_t due_tick = 1 + (uint32_t)(elapsed_us * tick_rate / 1000000);
+    
+#ifdef PONG_PROFILE
+    // Cuánto tarde arranca el primer tick vencido respecto del despertar
+    // que le toca (el timerfd vence un tick después de sim_epoch)
+    if ((int32_t)(due_tick - sh->tick) >= 0) {
+        uint64_t deadline_us = (uint64_t)sh->tick * 1000000 / tick_rate;
+        uint64_t late_ns = elapsed_us > deadline_us ? (elapsed_us - deadline_us) * 1000 : 0;
+        int cause = prof_frame_end(sh->prof, sh->tick, get_time_ns(), late_ns,
+                                   sh->last_tick_ns, 1000000000ULL / tick_rate);
+        if (cause >= 0) {
+            metrics_add(&sh->metrics.tick_overruns[cause], 1);
+        }
+    }
+#endif
+    
+    int ran = 0;
+    while ((int32_t)(due_tick - sh->tick) >= 0 && ran < MAX_CATCHUP_TICKS) {
+        run_tick(sh);
+        ran++;
+    }
+    
+    // Demasiado atrasado: descartar el resto en lugar de entrar en espiral
+    int32_t behind = (int32_t)(due_tick - sh->tick) + 1;
+    if (behind > 0) {
+        sh->ticks_dropped += behind;
+        metrics_add(&sh->metrics.ticks_skipped, (uint64_t)behind);
+        sh->sim_epoch_us += (uint64_t)behind * 1000000 / tick_rate;
+    }
+}
+
+/**
+ * Copia a las métricas los contadores del camino por paquete. Los de 32
+ * bits pueden dar la vuelta: se suma la diferencia desde la vez anterior.
+ */
+void publish_metrics(struct shard *sh) {
+    struct shard_metrics *m = &sh->metrics;
+    
+    metrics_add(&m->packets_received, sh->stats.packets_received - sh->published_received);
+    metrics_add(&m->packets_sent, sh->stats.packets_sent - sh->published_sent);
+    metrics_add(&m->packets_lost, sh->stats.packets_lost - sh->published_lost);
+    metrics_add(&m->dropped_no_session, sh->packets_misrouted - sh->published_misrouted);
+    metrics_add(&m->dropped_short, sh->packets_short - sh->published_short);
+    metrics_add(&m->dropped_inbox, sh->inbox_dropped - sh->published_inbox_dropped);
+    sh->published_received = sh->stats.packets_received;
+    sh->published_sent = sh->stats.packets_sent;
+    sh->published_lost = sh->stats.packets_lost;
+    sh->published_misrouted = sh->packets_misrouted;
+    sh->published_short = sh->packets_short;
+    sh->published_inbox_dropped = sh->inbox_dropped;
+    
+    struct input_stats *in = &sh->input_stats;
+    metrics_add(&m->inputs_recovered, in->recovered - sh->published_inputs.recovered);
+    metrics_add(&m->inputs_lost, in->lost - sh->published_inputs.lost);
+    metrics_add(&m->inputs_trimmed, in->trimmed - sh->published_inputs.trimmed);
+    metrics_add(&m->inputs_starved, in->starved - sh->published_inputs.starved);
+    sh->published_inputs = *in;
+    
+    metrics_set(&m->bytes_received, sh->stats.bytes_received);
+    metrics_set(&m->bytes_sent, sh->stats.bytes_sent);
+    metrics_set(&m->dropped_send, sh->tx_batch.dropped);
+    metrics_set(&m->rooms_active, (uint64_t)sh->live_rooms);
+    metrics_set(&m->rooms_waiting, (uint64_t)sh->num_waiting);
+    metrics_set(&m->players, (uint64_t)sh->num_players);
+    metrics_set(&m->remote_players, (uint64_t)sh->remote_players);
+    metrics_set(&m->spectators, (uint64_t)(MAX_SPECTATORS - sh->num_free_spectators));
+}
+
+/**
+ * Suma un campo de las métricas de todos los shards
+ */
+uint64_t sum_shard_metric(size_t offset) {
+    uint64_t total = 0;
+    for (int i = 0; i < num_shards; i++) {
+        total += metrics_get((_Atomic uint64_t *)((char *)&shards[i]->metrics + offset));
+    }
+    return total;
+}
+
+#define SHARD_METRIC(field) sum_shard_metric(offsetof(struct shard_metrics, field))
+
+/**
+ * Texto de un scrape (hilo del endpoint): suma lo publicado por los shards
+ */
+void render_metrics(struct metrics_text *text, void *ctx) {
+    (void)ctx;
+    
+    metrics_header(text, "pong_packets_received_total", "counter", "Datagramas recibidos");
+    metrics_uint(text, "pong_packets_received_total", NULL, SHARD_METRIC(packets_received));
+    metrics_header(text, "pong_packets_sent_total", "counter", "Datagramas enviados");
+    metrics_uint(text, "pong_packets_sent_total", NULL, SHARD_METRIC(packets_sent));
+    metrics_header(text, "pong_bytes_received_total", "counter", "Bytes recibidos (carga UDP)");
+    metrics_uint(text, "pong_bytes_received_total", NULL, SHARD_METRIC(bytes_received));
+    metrics_header(text, "pong_bytes_sent_total", "counter", "Bytes enviados (carga UDP)");
+    metrics_uint(text, "pong_bytes_sent_total", NULL, SHARD_METRIC(bytes_sent));
+    metrics_header(text, "pong_packets_lost_total", "counter",
+                   "Inputs perdidos en la subida (huecos en la secuencia)");
+    metrics_uint(text, "pong_packets_lost_total", NULL, SHARD_METRIC(packets_lost));
+    
+    metrics_header(text, "pong_inputs_total", "counter",
+                   "Inputs de jugadores por resultado (los aplicados a tiempo no se cuentan)");
+    metrics_uint(text, "pong_inputs_total", "outcome=\"recovered\"", SHARD_METRIC(inputs_recovered));
+    metrics_uint(text, "pong_inputs_total", "outcome=\"lost\"", SHARD_METRIC(inputs_lost));
+    metrics_uint(text, "pong_inputs_total", "outcome=\"trimmed\"", SHARD_METRIC(inputs_trimmed));
+    metrics_header(text, "pong_input_starved_ticks_total", "counter",
+                   "Ticks en los que un jugador no tenía input nuevo (se repitió su acción)");
+    metrics_uint(text, "pong_input_starved_ticks_total", NULL, SHARD_METRIC(inputs_starved));
+    
+    metrics_header(text, "pong_datagrams_dropped_total", "counter",
+                   "Datagramas descartados por el servidor");
+    metrics_uint(text, "pong_datagrams_dropped_total", "reason=\"no_session\"",
+                 SHARD_METRIC(dropped_no_session));
+    metrics_uint(text, "pong_datagrams_dropped_total", "reason=\"short\"",
+                 SHARD_METRIC(dropped_short));
+    metrics_uint(text, "pong_datagrams_dropped_total", "reason=\"send_failed\"",
+                 SHARD_METRIC(dropped_send));
+    metrics_uint(text, "pong_datagrams_dropped_total", "reason=\"inbox_full\"",
+                 SHARD_METRIC(dropped_inbox));
+    
+    metrics_header(text, "pong_joins_total", "counter", "Jugadores sentados en una sala");
+    metrics_uint(text, "pong_joins_total", NULL, SHARD_METRIC(joins));
+    metrics_header(text, "pong_joins_rejected_total", "counter", "JOIN rechazados (servidor lleno)");
+    metrics_uint(text, "pong_joins_rejected_total", NULL, SHARD_METRIC(joins_rejected));
+    
+    metrics_header(text, "pong_rooms_active", "gauge", "Salas con jugadores");
+    metrics_uint(text, "pong_rooms_active", NULL, SHARD_METRIC(rooms_active));
+    metrics_header(text, "pong_rooms_waiting", "gauge", "Salas esperando rival");
+    metrics_uint(text, "pong_rooms_waiting", NULL, SHARD_METRIC(rooms_waiting));
+    metrics_header(text, "pong_players", "gauge", "Jugadores en salas");
+    metrics_uint(text, "pong_players", NULL, SHARD_METRIC(players));
+    metrics_header(text, "pong_players_remote", "gauge",
+                   "Jugadores cuyos paquetes llegan a otro shard");
+    metrics_uint(text, "pong_players_remote", NULL, SHARD_METRIC(remote_players));
+    metrics_header(text, "pong_spectators", "gauge", "Espectadores conectados");
+    metrics_uint(text, "pong_spectators", NULL, SHARD_METRIC(spectators));
+    metrics_header(text, "pong_players_snapshot_rate", "gauge",
+                   "Jugadores por ritmo de snapshots según su enlace (al último reporte)");
+    for (int i = 0; i < SNAP_RATE_LEVELS; i++) {
+        char labels[32];
+        snprintf(labels, sizeof(labels), "hz=\"%d\"", TARGET_FPS / snap_rate_frames[i]);
+        metrics_uint(text, "pong_players_snapshot_rate", labels, SHARD_METRIC(players_by_rate[i]));
+    }
+    metrics_header(text, "pong_tick_rate_hz", "gauge", "Ticks por segundo de la simulación");
+    metrics_uint(text, "pong_tick_rate_hz", NULL, (uint64_t)tick_rate);
+    
+    metrics_header(text, "pong_ticks_total", "counter", "Ticks simulados");
+    metrics_uint(text, "pong_ticks_total", NULL, SHARD_METRIC(ticks));
+    metrics_header(text, "pong_ticks_skipped_total", "counter", "Ticks descartados por atraso");
+    metrics_uint(text, "pong_ticks_skipped_total", NULL, SHARD_METRIC(ticks_skipped));
+    
+    uint64_t buckets[TICK_METRIC_BUCKETS + 1];
+    for (int i = 0; i <= TICK_METRIC_BUCKETS; i++) {
+        buckets[i] = SHARD_METRIC(tick_buckets[i]);
+    }
+    metrics_histogram(text, "pong_tick_duration_seconds",
+                      "Simulación y envío de un tick (sin espectadores)",
+                      tick_metric_bounds_us, buckets, TICK_METRIC_BUCKETS, SHARD_METRIC(tick_sum_us));
+    
+#ifdef PONG_PROFILE
+    metrics_header(text, "pong_tick_overruns_total", "counter",
+                   "Ticks que arrancaron tarde o se pasaron del frame, por causa");
+    for (int i = 0; i <= PROF_PHASES; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "cause=\"%s\"", prof_phase_name(i));
+        metrics_uint(text, "pong_tick_overruns_total", labels, SHARD_METRIC(tick_overruns[i]));
     }
+#endif
     
-    log_msg("🟢 Servidor UDP-PONG activo en puerto %d", SERVER_PORT);
-    log_msg("⏳ Esperando jugadores...");
+    metrics_header(text, "pong_shards", "gauge", "Hilos de trabajo");
+    metrics_uint(text, "pong_shards", NULL, (uint64_t)num_shards);
+    metrics_header(text, "pong_log_dropped_total", "counter", "Mensajes de log descartados");
+    metrics_uint(text, "pong_log_dropped_total", NULL, log_dropped());
+    if (replays.streams != NULL) {
+        uint64_t written = 0;
+        for (int i = 0; i < replays.num_streams; i++) {
+            written += atomic_load_explicit(&replays.streams[i].written, memory_order_relaxed);
+        }
+        metrics_header(text, "pong_replay_bytes_written_total", "counter",
+                       "Bytes de repeticiones escritos");
+        metrics_uint(text, "pong_replay_bytes_written_total", NULL, written);
+    }
+}
+
+#ifdef PONG_PROFILE
+/**
+ * Traza de Chrome de las fases de todos los shards (GET /trace)
+ */
+void render_trace(struct metrics_text *text, void *ctx) {
+    struct prof_ring *rings[MAX_SHARDS];
+    (void)ctx;
     
-    uint32_t last_frame = get_time_ms();
+    for (int i = 0; i < num_shards; i++) {
+        rings[i] = shards[i]->prof;
+    }
+    prof_export_chrome(text, rings, num_shards);
+}
+#endif
+
+/**
+ * Loop principal de un shard (se ejecuta en su propio hilo)
+ */
+void *shard_main(void *arg) {
+    struct shard *sh = arg;
+    struct epoll_event events[3];
     
-    // Loop principal del servidor
+    log_set_thread(sh->id);
     while (1) {
-        uint32_t current_time = get_time_ms();
-        
-        // Recibir mensajes de clientes (non-blocking)
-        ssize_t received = recvfrom(sockfd, &msg, sizeof(msg), 0, 
-                                    (struct sockaddr *)&client_addr, &client_len);
-        
-        if (received > 0) {
-            stats_packet_received(&stats, received);
-            process_client_message(sockfd, &msg, &client_addr, client_len);
+        // Bloquear hasta que lleguen datagramas, mensajes de otro shard o venza el tick
+        int n = epoll_wait(sh->epoll_fd, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error en epoll_wait");
+            break;
         }
         
-        // Actualizar física a 60 FPS
-        if (current_time - last_frame >= FRAME_TIME_MS) {
-            if (num_players == MAX_PLAYERS) {
-                update_physics();
-                broadcast_state(sockfd);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == sh->sockfd) {
+                drain_socket(sh);
+            } else if (events[i].data.fd == sh->wake_fd) {
+                PROF_BEGIN(inbox_ns);
+                drain_inbox(sh);
+                PROF_END(sh->prof, PROF_INBOX, inbox_ns, sh->tick);
+            } else if (events[i].data.fd == sh->timer_fd) {
+                // Ejecutar los frames vencidos (acotado para no entrar en espiral)
+                read_timer_expirations(sh->timer_fd);
+                run_due_ticks(sh);
+                PROF_BEGIN(sweep_ns);
+                sweep_idle_players(sh);
+                PROF_END(sh->prof, PROF_SWEEP, sweep_ns, sh->tick);
+                
+                // Emparejar las salas en espera (respuestas y avisos en lote)
+                PROF_BEGIN(match_ns);
+                run_matchmaking(sh);
+                dgram_batch_flush(sh->sockfd, &sh->tx_batch);
+                PROF_END(sh->prof, PROF_MATCHMAKING, match_ns, sh->tick);
+                
+                publish_metrics(sh);
+                
+                // Pasar al escritor lo grabado aunque el bloque no se haya llenado
+                if (sh->replay != NULL) {
+                    replay_flush_due(sh->replay, clock_now_ns());
+                }
+                
+                // Reporte periódico de capacidad
+                uint32_t current_time = (uint32_t)(clock_now_ns() / 1000000);
+                if (current_time - sh->last_report >= CAPACITY_REPORT_MS) {
+                    PROF_BEGIN(report_ns);
+                    report_capacity(sh);
+                    PROF_END(sh->prof, PROF_REPORT, report_ns, sh->tick);
+                    sh->last_report = current_time;
+                }
             }
-            last_frame = current_time;
         }
-        
-        // Pequeña pausa para no consumir 100% CPU
-        usleep(1000); // 1ms
     }
     
-    close(sockfd);
+    return NULL;
+}
+
+/**
+ * Muestra el uso del servidor
+ */
+void print_usage(const char *prog) {
+    printf("Uso: %s [-t hilos] [-r hz] [-g ms] [-R dir] [-L nivel] [-F salida] [-m endpoint]\n",
+           prog);
+    printf("  -t N   Hilos de trabajo (shards SO_REUSEPORT), 1-%d (por defecto 1)\n",
+           MAX_SHARDS);
+    printf("  -r HZ  Ticks por segundo de la simulación, múltiplo de %d hasta %d (por defecto %d)\n",
+           TARGET_FPS, TARGET_FPS * MAX_FRAME_TICKS, TARGET_FPS);
+    printf("  -g MS  Emparejar por RTT en buckets de MS ms (por defecto 0 = sin agrupar)\n");
+    printf("  -R DIR Grabar repeticiones de las partidas en DIR (ver pong_replay)\n");
+    printf("  -L NIV Nivel mínimo del log: debug, info, warn, error (por defecto info)\n");
+    printf("  -F OUT Salida del log: text, json o bin (ver pong_logcat; por defecto text)\n");
+    printf("  -m EP  Métricas de Prometheus en GET /metrics: EP es PUERTO (en 127.0.0.1),\n");
+    printf("         IP:PUERTO o la ruta de un socket Unix\n");
+    printf("         (compilado con make PROFILE=1 también sirve GET /trace)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int bucket_ms = 0;
+    const char *replay_dir = NULL;
+    const char *metrics_addr = NULL;
+    enum log_level log_level = LOG_LEVEL_INFO;
+    enum log_output log_output = LOG_OUTPUT_TEXT;
+    int log_ok = 1;
+    
+    // Argumentos de línea de comandos
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:g:R:L:F:m:h")) != -1) {
+        if (opt == 't') {
+            num_shards = atoi(optarg);
+        } else if (opt == 'r') {
+            tick_rate = atoi(optarg);
+        } else if (opt == 'g') {
+            bucket_ms = atoi(optarg);
+        } else if (opt == 'R') {
+            replay_dir = optarg;
+        } else if (opt == 'm') {
+            metrics_addr = optarg;
+        } else if (opt == 'L') {
+            log_ok = log_ok && log_parse_level(optarg, &log_level) == 0;
+        } else if (opt == 'F') {
+            log_ok = log_ok && log_parse_output(optarg, &log_output) == 0;
+        } else {
+            print_usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    
+    if (num_shards < 1 || num_shards > MAX_SHARDS || bucket_ms < 0 || !log_ok ||
+        tick_rate < TARGET_FPS || tick_rate > TARGET_FPS * MAX_FRAME_TICKS ||
+        tick_rate % TARGET_FPS != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    frame_ticks = tick_rate / TARGET_FPS;
+    for (int i = 0; i < TICK_METRIC_BUCKETS; i++) {
+        tick_metric_bounds_us[i] =
+            (uint32_t)(1000000ULL * tick_metric_budget_64ths[i] / (64ULL * (uint64_t)tick_rate));
+    }
+    
+    // Los shards registran en una cola; el hilo del log formatea y escribe
+    if (log_init(log_level, log_output, STDOUT_FILENO) < 0 || log_start() < 0) {
+        perror("Error al iniciar el log");
+        return 1;
+    }
+    
+    if (match_queue_init(&matchmaking, (uint32_t)bucket_ms, MATCH_QUEUE_CAPACITY) < 0) {
+        perror("Error al crear la cola de emparejamiento");
+        return 1;
+    }
+    
+    // Cada shard en su propia reserva: sin false sharing entre hilos.
+    // Todos los sockets se crean antes de arrancar los hilos para que el
+    // reparto por hash de SO_REUSEPORT sea estable desde el primer JOIN.
+    for (int i = 0; i < num_shards; i++) {
+        shards[i] = calloc(1, sizeof(struct shard));
+        if (shards[i] == NULL || init_shard(shards[i], i) < 0) {
+            fprintf(stderr, "Error al inicializar shard %d\n", i);
+            return 1;
+        }
+    }
+    
+    if (replay_dir != NULL) {
+        if (replay_writer_start(&replays, replay_dir, num_shards, tick_rate) < 0) {
+            fprintf(stderr, "Error al preparar las repeticiones en %s\n", replay_dir);
+            return 1;
+        }
+        for (int i = 0; i < num_shards; i++) {
+            shards[i]->replay = &replays.streams[i];
+        }
+    }
+    
+    if (metrics_addr != NULL) {
+#ifdef PONG_PROFILE
+        metrics_server_route(&metrics, "/trace", "application/json", render_trace, NULL);
+#endif
+        if (metrics_server_start(&metrics, metrics_addr, render_metrics, NULL) < 0) {
+            fprintf(stderr, "Error al abrir el endpoint de métricas en %s\n", metrics_addr);
+            return 1;
+        }
+    }
+    
+    log_msg("🟢 Servidor UDP-PONG activo en puerto %d (%d shard%s)",
+            SERVER_PORT, num_shards, num_shards == 1 ? "" : "s");
+    log_msg("⏳ Esperando jugadores... (hasta %d salas y %d espectadores por shard)",
+            MAX_ROOMS, MAX_SPECTATORS);
+    log_msg("🧮 Física en lote: kernel %s | Simulación a %d Hz (%d tick%s por frame de los clientes)",
+            game_kernel_name(game_kernel_best()), tick_rate, frame_ticks, frame_ticks == 1 ? "" : "s");
+    if (bucket_ms > 0) {
+        log_msg("🤝 Emparejamiento entre shards por RTT: %d buckets de %d ms",
+                matchmaking.num_buckets, bucket_ms);
+    } else {
+        log_msg("🤝 Emparejamiento entre shards: el primero que llega toma la sala que espera");
+    }
+    if (replay_dir != NULL) {
+        log_msg("🎞️ Grabando repeticiones en %s (un archivo por shard)", replay_dir);
+    }
+    if (metrics_addr != NULL) {
+        log_msg("📈 Métricas de Prometheus en %s (GET /metrics)", metrics_addr);
+    }
+#ifdef PONG_PROFILE
+    log_msg("🔬 Perfilador de fases activo%s", metrics_addr != NULL ?
+            " (traza de Chrome en GET /trace del endpoint de métricas)" : " (sin -m no hay /trace)");
+#endif
+    
+    for (int i = 0; i < num_shards; i++) {
+        if (pthread_create(&shards[i]->thread, NULL, shard_main, shards[i]) != 0) {
+            fprintf(stderr, "Error al crear hilo del shard %d\n", i);
+            return 1;
+        }
+    }
+    
+    for (int i = 0; i < num_shards; i++) {
+        pthread_join(shards[i]->thread, NULL);
+        close(shards[i]->epoll_fd);
+        close(shards[i]->timer_fd);
+        close(shards[i]->sockfd);
+        close(shards[i]->wake_fd);
+        free(shards[i]->spectators);
+        free(shards[i]->free_spectators);
+        free(shards[i]);
+    }
+    
     return 0;
 }
@@ -0,0 +1,173 @@
+#include "profiler.h"
+#include "utils.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Nombres: las funciones que mide cada fase
+static const char *phase_names[PROF_PHASES + 1] = {
+    "recvmmsg", "process_client_message", "drain_inbox", "update_physics", "broadcast_state",
+    "sendmmsg", "fan_out_spectators", "run_matchmaking", "sweep_idle_players",
+    "report_capacity", "sistema"
+};
+
+/**
+ * Prepara un anillo vacío
+ */
+void prof_ring_init(struct prof_ring *ring, int id) {
+    memset(ring->frame_ns, 0, sizeof(ring->frame_ns));
+    memset(ring->overruns, 0, sizeof(ring->overruns));
+    ring->id = id;
+    ring->last_warn_ns = 0;
+    atomic_init(&ring->head, 0);
+}
+
+/**
+ * Nombre de una fase
+ */
+const char *prof_phase_name(int phase) {
+    return phase >= 0 && phase <= PROF_PHASES ? phase_names[phase] : "?";
+}
+
+/**
+ * Escribe un evento y lo publica
+ */
+static void push_event(struct prof_ring *ring, int phase, int flags, uint64_t start_ns,
+                       uint64_t dur_ns, uint32_t tick) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct prof_event *ev = &ring->events[head % PROF_RING_EVENTS];
+    ev->start_ns = start_ns;
+    ev->dur_ns = dur_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)dur_ns;
+    ev->tick = tick;
+    ev->phase = (uint8_t)phase;
+    ev->flags = (uint8_t)flags;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * Guarda una fase
+ */
+void prof_record(struct prof_ring *ring, int phase, uint64_t start_ns, uint64_t end_ns,
+                 uint32_t tick) {
+    ring->frame_ns[phase] += end_ns - start_ns;
+    push_event(ring, phase, 0, start_ns, end_ns - start_ns, tick);
+}
+
+/**
+ * Cierra el cuadro de un tick
+ */
+int prof_frame_end(struct prof_ring *ring, uint32_t tick, uint64_t now_ns, uint64_t late_ns,
+                   uint64_t prev_tick_ns, uint64_t budget_ns) {
+    int cause = -1;
+    
+    if (late_ns > budget_ns / 2 || prev_tick_ns > budget_ns) {
+        // La fase que más ocupó al hilo; si ni eso explica el atraso, el
+        // hilo estaba libre y fue el sistema el que no lo despertó a tiempo
+        int top = 0;
+        for (int i = 1; i < PROF_PHASES; i++) {
+            if (ring->frame_ns[i] > ring->frame_ns[top]) top = i;
+        }
+        cause = prev_tick_ns > budget_ns || ring->frame_ns[top] * 2 >= late_ns ? top : PROF_SYSTEM;
+        ring->overruns[cause]++;
+        push_event(ring, cause, PROF_EVENT_OVERRUN, now_ns, late_ns, tick);
+        
+        if (now_ns - ring->last_warn_ns >= PROF_WARN_INTERVAL_MS * 1000000ULL) {
+            ring->last_warn_ns = now_ns;
+            
+            // Las fases con tiempo en el cuadro, en ms
+            char detail[256];
+            size_t len = 0;
+            detail[0] = '\0';
+            for (int i = 0; i < PROF_PHASES && len < sizeof(detail); i++) {
+                if (ring->frame_ns[i] < 100000) continue;
+                int n = snprintf(detail + len, sizeof(detail) - len, "%s%s %.1f",
+                                 len > 0 ? ", " : "", phase_names[i], ring->frame_ns[i] / 1e6);
+                if (n > 0) len += (size_t)n;
+            }
+            log_warn("🐢 [shard %d] Tick %u atrasado %.1f ms (anterior: %.1f ms) | Causa: %s | "
+                     "Desde el tick anterior (ms): %s",
+                     ring->id, tick, late_ns / 1e6, prev_tick_ns / 1e6, phase_names[cause],
+                     len > 0 ? detail : "-");
+        }
+    }
+    
+    memset(ring->frame_ns, 0, sizeof(ring->frame_ns));
+    return cause;
+}
+
+/**
+ * Copia lo que sigue vigente del anillo. El escritor puede pisar eventos
+ * mientras se copian: después de copiar se vuelve a leer head y se
+ * descartan los que ya pueden haber sido reemplazados.
+ * @return Cantidad de eventos válidos en out (desde out[0])
+ */
+static size_t copy_ring(struct prof_ring *ring, struct prof_event *out) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = head > PROF_RING_EVENTS ? head - PROF_RING_EVENTS : 0;
+    
+    for (uint64_t i = first; i < head; i++) {
+        out[i - first] = ring->events[i % PROF_RING_EVENTS];
+    }
+    
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t now = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t valid = now > PROF_RING_EVENTS ? now - PROF_RING_EVENTS + 1 : 0;
+    if (valid <= first) {
+        return (size_t)(head - first);
+    }
+    if (valid >= head) {
+        return 0;
+    }
+    memmove(out, out + (valid - first), (size_t)(head - valid) * sizeof(*out));
+    return (size_t)(head - valid);
+}
+
+/**
+ * Exporta como JSON de Chrome trace-event
+ */
+void prof_export_chrome(struct metrics_text *text, struct prof_ring **rings, int num_rings) {
+    struct prof_event *events = malloc((size_t)num_rings * PROF_RING_EVENTS * sizeof(struct prof_event));
+    size_t *counts = calloc((size_t)num_rings, sizeof(size_t));
+    if (events == NULL || counts == NULL) {
+        free(events);
+        free(counts);
+        return;
+    }
+    
+    // Copiar todo primero: los tiempos salen en µs desde el evento más viejo
+    uint64_t origin = UINT64_MAX;
+    for (int r = 0; r < num_rings; r++) {
+        struct prof_event *ring_events = events + (size_t)r * PROF_RING_EVENTS;
+        counts[r] = copy_ring(rings[r], ring_events);
+        if (counts[r] > 0 && ring_events[0].start_ns < origin) {
+            origin = ring_events[0].start_ns;
+        }
+    }
+    
+    metrics_printf(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int r = 0; r < num_rings; r++) {
+        int tid = rings[r]->id;
+        metrics_printf(text, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                       "\"args\":{\"name\":\"shard %d\"}}", r > 0 ? ",\n" : "", tid, tid);
+            
+        for (size_t i = 0; i < counts[r]; i++) {
+            const struct prof_event *ev = &events[(size_t)r * PROF_RING_EVENTS + i];
+            double ts = (ev->start_ns - origin) / 1e3;
+            if (ev->flags & PROF_EVENT_OVERRUN) {
+                metrics_printf(text, ",\n{\"name\":\"desborde\",\"cat\":\"overrun\",\"ph\":\"i\","
+                               "\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"tick\":%u,"
+                               "\"causa\":\"%s\",\"atraso_ms\":%.3f}}",
+                               ts, tid, ev->tick, prof_phase_name(ev->phase), ev->dur_ns / 1e6);
+            } else {
+                metrics_printf(text, ",\n{\"name\":\"%s\",\"cat\":\"tick\",\"ph\":\"X\",\"ts\":%.3f,"
+                               "\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"tick\":%u}}",
+                               prof_phase_name(ev->phase), ts, ev->dur_ns / 1e3, tid, ev->tick);
+            }
+        }
+    }
+    metrics_printf(text, "\n]}\n");
+    
+    free(events);
+    free(counts);
+}
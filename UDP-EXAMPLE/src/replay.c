@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include "replay.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+
+#define REPLAY_FLUSH_NS ((uint64_t)REPLAY_FLUSH_MS * 1000000ULL)
+
+/**
+ * Escribe todo el buffer aunque write() lo haga en partes
+ * @return 0 si tuvo éxito, -1 en error
+ */
+static int write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Hora actual (Unix, ms)
+ */
+uint64_t replay_wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000ULL;
+}
+
+/**
+ * Prepara un archivo de repeticiones
+ */
+int replay_stream_init(struct replay_stream *stream, int fd, int wake_fd, int shard,
+                       int tick_rate) {
+    memset(stream, 0, sizeof(*stream));
+    stream->fd = fd;
+    stream->wake_fd = wake_fd;
+    
+    struct replay_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    header.version = REPLAY_VERSION;
+    header.tick_rate = (uint16_t)tick_rate;
+#ifdef GAME_FIXED_POINT
+    header.fixed_point = 1;
+#endif
+    header.shard = (uint8_t)shard;
+    header.keyframe_ticks = REPLAY_KEYFRAME_TICKS;
+    header.start_ms = replay_wall_ms();
+    if (write_all(fd, &header, sizeof(header)) < 0) {
+        return -1;
+    }
+    
+    stream->chunks = malloc(REPLAY_CHUNKS * sizeof(struct replay_chunk));
+    if (stream->chunks == NULL ||
+        lf_queue_init(&stream->full, REPLAY_CHUNKS, sizeof(struct replay_chunk *)) < 0 ||
+        lf_queue_init(&stream->spare, REPLAY_CHUNKS, sizeof(struct replay_chunk *)) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < REPLAY_CHUNKS; i++) {
+        struct replay_chunk *chunk = &stream->chunks[i];
+        lf_queue_push(&stream->spare, &chunk);
+    }
+    return 0;
+}
+
+/**
+ * Libera los bloques
+ */
+void replay_stream_free(struct replay_stream *stream) {
+    lf_queue_free(&stream->full);
+    lf_queue_free(&stream->spare);
+    free(stream->chunks);
+    stream->chunks = NULL;
+    stream->current = NULL;
+}
+
+/**
+ * Pasa el bloque actual al escritor y lo despierta
+ */
+static void hand_off_chunk(struct replay_stream *stream) {
+    if (stream->current == NULL) return;
+    
+    // Nunca falla: en full no puede haber más bloques que en la reserva
+    lf_queue_push(&stream->full, &stream->current);
+    stream->current = NULL;
+    
+    if (stream->wake_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t n = write(stream->wake_fd, &one, sizeof(one));
+        (void)n;
+    }
+}
+
+/**
+ * Toma un bloque vacío de la reserva
+ * @return 0 si hay bloque, -1 si el escritor todavía no devolvió ninguno
+ */
+static int open_chunk(struct replay_stream *stream, uint64_t now_ns) {
+    if (lf_queue_pop(&stream->spare, &stream->current) < 0) {
+        stream->current = NULL;
+        return -1;
+    }
+    stream->current->used = 0;
+    stream->opened_ns = now_ns;
+    
+    // Avisar al lector que faltan registros entre el bloque anterior y este
+    if (stream->lost) {
+        struct replay_record gap = {REPLAY_GAP, 0, REPLAY_NO_ROOM, 0};
+        memcpy(stream->current->data, &gap, sizeof(gap));
+        stream->current->used = sizeof(gap);
+        stream->lost = 0;
+    }
+    return 0;
+}
+
+/**
+ * Agrega un registro
+ */
+void replay_append(struct replay_stream *stream, uint8_t type, uint16_t room, uint32_t tick,
+                   const void *data, uint8_t size) {
+    size_t needed = sizeof(struct replay_record) + size;
+    
+    if (stream->current != NULL && stream->current->used + needed > REPLAY_CHUNK_SIZE) {
+        hand_off_chunk(stream);
+    }
+    if (stream->current == NULL && open_chunk(stream, clock_now_ns()) < 0) {
+        stream->lost = 1;
+        stream->dropped++;
+        return;
+    }
+    
+    struct replay_record record = {type, size, room, tick};
+    uint8_t *dst = stream->current->data + stream->current->used;
+    memcpy(dst, &record, sizeof(record));
+    memcpy(dst + sizeof(record), data, size);
+    stream->current->used += needed;
+}
+
+/**
+ * Pasa el bloque actual al escritor si ya esperó demasiado
+ */
+void replay_flush_due(struct replay_stream *stream, uint64_t now_ns) {
+    if (stream->current != NULL && now_ns - stream->opened_ns >= REPLAY_FLUSH_NS) {
+        hand_off_chunk(stream);
+    }
+}
+
+/**
+ * Escribe los bloques pendientes
+ */
+int replay_stream_drain(struct replay_stream *stream) {
+    struct replay_chunk *chunk;
+    int count = 0;
+    
+    while (lf_queue_pop(&stream->full, &chunk) == 0) {
+        if (write_all(stream->fd, chunk->data, chunk->used) < 0) {
+            perror("Error al escribir repetición");
+        } else {
+            atomic_fetch_add_explicit(&stream->written, chunk->used, memory_order_relaxed);
+        }
+        lf_queue_push(&stream->spare, &chunk);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Hilo escritor: duerme en el eventfd hasta que algún shard le pasa bloques
+ */
+static void *writer_main(void *arg) {
+    struct replay_writer *writer = arg;
+    
+    for (;;) {
+        uint64_t count;
+        if (read(writer->wake_fd, &count, sizeof(count)) < 0) {
+            continue;
+        }
+        for (int i = 0; i < writer->num_streams; i++) {
+            replay_stream_drain(&writer->streams[i]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Abre un archivo por shard y arranca el escritor
+ */
+int replay_writer_start(struct replay_writer *writer, const char *dir, int num_streams,
+                        int tick_rate) {
+    writer->num_streams = num_streams;
+    writer->streams = calloc((size_t)num_streams, sizeof(struct replay_stream));
+    writer->wake_fd = eventfd(0, 0);
+    if (writer->streams == NULL || writer->wake_fd < 0) {
+        return -1;
+    }
+    
+    char stamp[32];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    
+    for (int i = 0; i < num_streams; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/pong-%s-s%d.rpl", dir, stamp, i);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            perror(path);
+            return -1;
+        }
+        if (replay_stream_init(&writer->streams[i], fd, writer->wake_fd, i, tick_rate) < 0) {
+            perror(path);
+            return -1;
+        }
+    }
+    
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        return -1;
+    }
+    pthread_detach(writer->thread);
+    return 0;
+}
+
+/**
+ * Game_state -> keyframe
+ */
+void replay_keyframe_from_state(struct replay_keyframe *kf, const struct game_state *game,
+                                int8_t action1, int8_t action2) {
+    kf->paddle1_y = game->paddle1_y;
+    kf->paddle2_y = game->paddle2_y;
+    kf->ball_x = game->ball_x;
+    kf->ball_y = game->ball_y;
+    kf->ball_vx = game->ball_vx;
+    kf->ball_vy = game->ball_vy;
+    kf->score1 = game->score1;
+    kf->score2 = game->score2;
+    kf->rng = game->rng;
+    kf->action1 = action1;
+    kf->action2 = action2;
+}
+
+/**
+ * Keyframe -> game_state
+ */
+void replay_keyframe_to_state(const struct replay_keyframe *kf, uint32_t tick,
+                              struct game_state *game) {
+    game->paddle1_y = kf->paddle1_y;
+    game->paddle2_y = kf->paddle2_y;
+    game->ball_x = kf->ball_x;
+    game->ball_y = kf->ball_y;
+    game->ball_vx = kf->ball_vx;
+    game->ball_vy = kf->ball_vy;
+    game->score1 = kf->score1;
+    game->score2 = kf->score2;
+    game->tick = tick;
+    game->rng = kf->rng;
+}
+
+/**
+ * Siguiente registro
+ */
+const struct replay_record *replay_next(const uint8_t *data, size_t len, size_t *offset) {
+    if (*offset + sizeof(struct replay_record) > len) {
+        return NULL;
+    }
+    const struct replay_record *record = (const struct replay_record *)(data + *offset);
+    if (*offset + sizeof(*record) + record->size > len) {
+        return NULL;  // Cortado a la mitad (el servidor terminó mientras escribía)
+    }
+    *offset += sizeof(*record) + record->size;
+    return record;
+}
@@ -0,0 +1,225 @@
+#include "rollback.h"
+#include "input.h"
+#include <string.h>
+
+/**
+ * Deja la simulación sin estado
+ */
+void rollback_init(struct rollback *rb, int own) {
+    memset(rb, 0, sizeof(*rb));
+    for (int i = 0; i < ROLLBACK_RING; i++) {
+        rb->real_frame[i] = UINT32_MAX;
+    }
+    rb->resim_from = UINT32_MAX;
+    rb->own = own;
+    rb->frame_ticks = 1;
+}
+
+/**
+ * Simula un frame con las acciones guardadas en used y deja el resultado
+ * como estado inicial del siguiente
+ */
+static void simulate_frame(struct rollback *rb, uint32_t frame) {
+    uint32_t slot = frame % ROLLBACK_RING;
+    struct game_state *next = &rb->states[(frame + 1) % ROLLBACK_RING];
+    
+    *next = rb->states[slot];
+    for (int i = 0; i < rb->frame_ticks; i++) {
+        game_step(next, rb->used[slot][0], rb->used[slot][1]);
+    }
+}
+
+/**
+ * Elige las acciones de un frame: las reales si ya llegaron; si no, la
+ * propia que se usó y la del rival predicha
+ */
+static void choose_actions(struct rollback *rb, uint32_t frame) {
+    uint32_t slot = frame % ROLLBACK_RING;
+    
+    if (rb->real_frame[slot] == frame) {
+        rb->used[slot][0] = rb->real[slot][0];
+        rb->used[slot][1] = rb->real[slot][1];
+    } else {
+        rb->used[slot][1 - rb->own] = rb->last_real[1 - rb->own];
+    }
+}
+
+/**
+ * Marca un frame para re-simular desde él (si ya se simuló)
+ */
+static void mark_resim(struct rollback *rb, uint32_t frame) {
+    if ((int32_t)(frame - rb->frame) >= 0) return;
+    if (rb->resim_from == UINT32_MAX || (int32_t)(frame - rb->resim_from) < 0) {
+        rb->resim_from = frame;
+    }
+}
+
+/**
+ * Compara dos estados campo por campo (sin el relleno de la estructura)
+ */
+static int same_state(const struct game_state *a, const struct game_state *b) {
+    return a->paddle1_y == b->paddle1_y && a->paddle2_y == b->paddle2_y &&
+           a->ball_x == b->ball_x && a->ball_y == b->ball_y &&
+           a->ball_vx == b->ball_vx && a->ball_vy == b->ball_vy &&
+           a->score1 == b->score1 && a->score2 == b->score2 &&
+           a->tick == b->tick && a->rng == b->rng;
+}
+
+/**
+ * Aplica un MSG_SYNC
+ */
+int rollback_sync(struct rollback *rb, const struct sync_message *msg, uint8_t frame_ticks) {
+    if (frame_ticks == 0) return -1;
+    
+    struct game_state state;
+    replay_keyframe_to_state(&msg->state, msg->tick, &state);
+    state.frame_ticks = frame_ticks;
+    uint32_t frame = msg->tick / frame_ticks;
+    int same_rate = rb->synced && rb->frame_ticks == frame_ticks;
+    int32_t behind = (int32_t)(rb->frame - frame);
+    
+    // Frame al que se llegó solo con acciones reales: tiene que coincidir
+    rollback_resimulate(rb);
+    if (same_rate && behind >= 0 && behind < ROLLBACK_RING &&
+        (int32_t)(frame - rb->confirmed) <= 0) {
+        struct game_state *local = &rb->states[frame % ROLLBACK_RING];
+        if (same_state(local, &state)) {
+            return 0;
+        }
+        rb->desyncs++;
+        *local = state;
+        mark_resim(rb, frame);
+        rollback_resimulate(rb);
+        return 1;
+    }
+    
+    // Frame todavía sin confirmar (se perdieron MSG_INPUTS): parte de él
+    if (same_rate && behind >= 0 && behind < ROLLBACK_FRAMES) {
+        rb->states[frame % ROLLBACK_RING] = state;
+        rb->confirmed = frame;
+        rb->last_real[0] = msg->state.action1;
+        rb->last_real[1] = msg->state.action2;
+        mark_resim(rb, frame);
+        rollback_resimulate(rb);
+        return 1;
+    }
+    
+    // Sin estado, otro ritmo o demasiado lejos: empezar de nuevo aquí
+    for (int i = 0; i < ROLLBACK_RING; i++) {
+        rb->real_frame[i] = UINT32_MAX;
+    }
+    rb->states[frame % ROLLBACK_RING] = state;
+    rb->frame = frame;
+    rb->confirmed = frame;
+    rb->resim_from = UINT32_MAX;
+    rb->last_real[0] = msg->state.action1;
+    rb->last_real[1] = msg->state.action2;
+    rb->frame_ticks = frame_ticks;
+    rb->synced = 1;
+    return 1;
+}
+
+/**
+ * Guarda las acciones reales de un frame
+ * @return 0 si tuvo éxito, -1 si el frame queda fuera del anillo
+ */
+static int store_real(struct rollback *rb, uint32_t frame, int8_t action1, int8_t action2) {
+    int32_t ahead = (int32_t)(frame - rb->confirmed);
+    if (ahead < 0) return 0;
+    if (ahead >= ROLLBACK_RING) return -1;
+    
+    uint32_t slot = frame % ROLLBACK_RING;
+    rb->real[slot][0] = action1;
+    rb->real[slot][1] = action2;
+    rb->real_frame[slot] = frame;
+    
+    // Ya simulado con otras acciones: hay que volver
+    if ((int32_t)(frame - rb->frame) < 0 &&
+        (rb->used[slot][0] != action1 || rb->used[slot][1] != action2)) {
+        mark_resim(rb, frame);
+    }
+    return 0;
+}
+
+/**
+ * Guarda las acciones reales de un MSG_INPUTS
+ */
+int rollback_confirm(struct rollback *rb, const struct input_relay *relay) {
+    if (!rb->synced) return 0;
+    
+    uint32_t newest = relay->tick / rb->frame_ticks;
+    
+    // Falta algún frame entre lo confirmado y el historial: sin él no se
+    // puede seguir (el próximo MSG_SYNC retoma)
+    if ((int32_t)(newest - INPUT_REDUNDANCY - rb->confirmed) > 0) {
+        rb->synced = 0;
+        rb->lost++;
+        return -1;
+    }
+    
+    // Del más viejo al más nuevo
+    for (int age = INPUT_REDUNDANCY; age >= 1; age--) {
+        int8_t action1, action2;
+        if (input_history_get(relay->history1, age, &action1) == 0 &&
+            input_history_get(relay->history2, age, &action2) == 0 &&
+            store_real(rb, newest - (uint32_t)age, action1, action2) < 0) {
+            break;
+        }
+    }
+    if (store_real(rb, newest, relay->action1, relay->action2) < 0) {
+        rb->synced = 0;
+        rb->lost++;
+        return -1;
+    }
+    
+    // Avanzar lo confirmado; si cambia la acción del rival, los frames sin
+    // confirmar se simularon con otra predicción
+    int8_t predicted = rb->last_real[1 - rb->own];
+    while (rb->real_frame[rb->confirmed % ROLLBACK_RING] == rb->confirmed) {
+        uint32_t slot = rb->confirmed % ROLLBACK_RING;
+        rb->last_real[0] = rb->real[slot][0];
+        rb->last_real[1] = rb->real[slot][1];
+        rb->confirmed++;
+    }
+    if (rb->last_real[1 - rb->own] != predicted) {
+        mark_resim(rb, rb->confirmed);
+    }
+    return 0;
+}
+
+/**
+ * Vuelve al primer frame marcado y re-simula hasta el presente
+ */
+int rollback_resimulate(struct rollback *rb) {
+    if (rb->resim_from == UINT32_MAX) return 0;
+    
+    uint32_t from = rb->resim_from;
+    rb->resim_from = UINT32_MAX;
+    
+    for (uint32_t frame = from; frame != rb->frame; frame++) {
+        choose_actions(rb, frame);
+        simulate_frame(rb, frame);
+    }
+    
+    int count = (int)(rb->frame - from);
+    rb->rollbacks++;
+    rb->resimulated += (uint32_t)count;
+    return count;
+}
+
+/**
+ * Simula el frame presente
+ */
+int rollback_advance(struct rollback *rb, int8_t own_action) {
+    if (!rb->synced) return 0;
+    if ((int32_t)(rb->frame - rb->confirmed) >= ROLLBACK_FRAMES) {
+        rb->stalls++;
+        return 0;
+    }
+    
+    rb->used[rb->frame % ROLLBACK_RING][rb->own] = own_action;
+    choose_actions(rb, rb->frame);
+    simulate_frame(rb, rb->frame);
+    rb->frame++;
+    return 1;
+}
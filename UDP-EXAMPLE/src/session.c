@@ -0,0 +1,124 @@
+#include "session.h"
+#include <stdlib.h>
+
+/**
+ * Posición inicial de una dirección (hash multiplicativo de Fibonacci)
+ */
+static uint32_t home_slot(const struct session_table *table, uint32_t ip, uint16_t port) {
+    uint64_t key = ((uint64_t)ip << 16 | port) ^ table->seed;
+    return (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> table->shift);
+}
+
+/**
+ * Busca la entrada de una dirección
+ * @return Índice de la entrada o -1 si no está
+ */
+static int64_t find_slot(const struct session_table *table, uint32_t ip, uint16_t port) {
+    uint32_t i = home_slot(table, ip, port);
+    
+    // Siempre hay huecos (ocupación <= 50%): el sondeo termina
+    while (table->entries[i].value != SESSION_NONE) {
+        if (table->entries[i].ip == ip && table->entries[i].port == port) {
+            return i;
+        }
+        i = (i + 1) & table->mask;
+    }
+    return -1;
+}
+
+/**
+ * Reserva la tabla
+ */
+int session_table_init(struct session_table *table, uint32_t max_sessions, uint64_t seed) {
+    uint32_t capacity = 16;
+    uint32_t bits = 4;
+    while (capacity < 2 * (uint64_t)max_sessions) {
+        capacity <<= 1;
+        bits++;
+    }
+    
+    table->entries = malloc(capacity * sizeof(struct session_entry));
+    if (table->entries == NULL) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < capacity; i++) {
+        table->entries[i].value = SESSION_NONE;
+    }
+    
+    table->mask = capacity - 1;
+    table->shift = 64 - bits;
+    table->count = 0;
+    table->max_sessions = max_sessions;
+    table->seed = seed;
+    return 0;
+}
+
+/**
+ * Libera la tabla
+ */
+void session_table_free(struct session_table *table) {
+    free(table->entries);
+    table->entries = NULL;
+}
+
+/**
+ * Busca la sesión de una dirección
+ */
+uint32_t session_find(const struct session_table *table, const struct sockaddr_in *addr) {
+    int64_t slot = find_slot(table, addr->sin_addr.s_addr, addr->sin_port);
+    return slot < 0 ? SESSION_NONE : table->entries[slot].value;
+}
+
+/**
+ * Asocia una dirección a una sesión
+ */
+int session_insert(struct session_table *table, const struct sockaddr_in *addr, uint32_t value) {
+    uint32_t ip = addr->sin_addr.s_addr;
+    uint16_t port = addr->sin_port;
+    uint32_t i = home_slot(table, ip, port);
+    
+    while (table->entries[i].value != SESSION_NONE) {
+        if (table->entries[i].ip == ip && table->entries[i].port == port) {
+            table->entries[i].value = value;
+            return 0;
+        }
+        i = (i + 1) & table->mask;
+    }
+    
+    if (table->count >= table->max_sessions) {
+        return -1;
+    }
+    
+    table->entries[i].ip = ip;
+    table->entries[i].port = port;
+    table->entries[i].value = value;
+    table->count++;
+    return 0;
+}
+
+/**
+ * Quita una sesión desplazando hacia atrás las entradas de su racha
+ */
+int session_remove(struct session_table *table, const struct sockaddr_in *addr) {
+    int64_t slot = find_slot(table, addr->sin_addr.s_addr, addr->sin_port);
+    if (slot < 0) {
+        return -1;
+    }
+    
+    uint32_t hole = (uint32_t)slot;
+    uint32_t j = (hole + 1) & table->mask;
+    while (table->entries[j].value != SESSION_NONE) {
+        // Una entrada puede ocupar el hueco si su posición inicial no
+        // queda entre el hueco y ella (en orden circular)
+        uint32_t home = home_slot(table, table->entries[j].ip, table->entries[j].port);
+        if (((j - home) & table->mask) >= ((j - hole) & table->mask)) {
+            table->entries[hole] = table->entries[j];
+            hole = j;
+        }
+        j = (j + 1) & table->mask;
+    }
+    
+    table->entries[hole].value = SESSION_NONE;
+    table->count--;
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include "snapshot.h"
+#include "protocol.h"
+#include <string.h>
+#include <math.h>
+
+// Posiciones en el orden en que se escriben en el cable
+#define SNAP_NUM_POSITIONS 4
+
+/**
+ * Cuantiza una coordenada del campo (0-100) a 16 bits
+ */
+uint16_t snapshot_quantize(float value) {
+    float scaled = value * (65535.0f / FIELD_HEIGHT);
+    if (scaled <= 0.0f) return 0;
+    if (scaled >= 65535.0f) return 65535;
+    return (uint16_t)lrintf(scaled);
+}
+
+/**
+ * Convierte una coordenada cuantizada de vuelta a unidades del campo
+ */
+float snapshot_dequantize(uint16_t value) {
+    return value * (FIELD_HEIGHT / 65535.0f);
+}
+
+/**
+ * Escribe un entero con signo como varint zigzag
+ */
+static size_t put_varint(uint8_t *buf, int32_t value) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    size_t n = 0;
+    
+    while (zz >= 0x80) {
+        buf[n++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    buf[n++] = (uint8_t)zz;
+    return n;
+}
+
+/**
+ * Lee un varint zigzag
+ * @return Bytes consumidos o 0 si el buffer está truncado
+ */
+static size_t get_varint(const uint8_t *buf, size_t len, int32_t *value) {
+    uint32_t zz = 0;
+    size_t n = 0;
+    
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (n >= len) return 0;
+        uint8_t byte = buf[n++];
+        zz |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            return n;
+        }
+    }
+    return 0;
+}
+
+static void put_u16(uint8_t *buf, uint16_t v) {
+    buf[0] = (uint8_t)v;
+    buf[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *buf, uint32_t v) {
+    put_u16(buf, (uint16_t)v);
+    put_u16(buf + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *buf) {
+    return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *buf) {
+    return get_u16(buf) | ((uint32_t)get_u16(buf + 2) << 16);
+}
+
+/**
+ * Codifica un snapshot, como delta contra base o completo si base es NULL
+ */
+size_t snapshot_encode(uint8_t *buf, const struct snapshot *cur, const struct snapshot *base,
+                       const struct snapshot_extra *extra) {
+    const uint16_t cur_pos[SNAP_NUM_POSITIONS] = {
+        cur->paddle1_y, cur->paddle2_y, cur->ball_x, cur->ball_y
+    };
+    
+    uint8_t base_offset = base ? (uint8_t)(cur->tick - base->tick) : 0;
+    put_u16(buf + 1, (uint16_t)cur->tick);
+    
+    // Base en el tick anterior: el tipo ya lo dice y se ahorra el byte
+    size_t n;
+    if (base_offset == 1) {
+        buf[0] = MSG_SNAPSHOT_NEXT;
+        n = 4;
+    } else {
+        buf[0] = MSG_SNAPSHOT;
+        buf[3] = base_offset;
+        n = 5;
+    }
+    size_t mask_at = n - 1;
+    uint8_t mask = 0;
+    
+    if (base == NULL) {
+        // Keyframe: todo absoluto
+        for (int i = 0; i < SNAP_NUM_POSITIONS; i++) {
+            put_u16(buf + n, cur_pos[i]);
+            n += 2;
+        }
+        mask |= SNAP_PADDLE1 | SNAP_PADDLE2 | SNAP_BALL_X | SNAP_BALL_Y;
+        buf[n++] = cur->score1;
+        buf[n++] = cur->score2;
+        mask |= SNAP_SCORE;
+    } else {
+        // Delta: solo los campos que cambiaron
+        const uint16_t base_pos[SNAP_NUM_POSITIONS] = {
+            base->paddle1_y, base->paddle2_y, base->ball_x, base->ball_y
+        };
+        
+        for (int i = 0; i < SNAP_NUM_POSITIONS; i++) {
+            if (cur_pos[i] != base_pos[i]) {
+                n += put_varint(buf + n, (int32_t)cur_pos[i] - (int32_t)base_pos[i]);
+                mask |= (uint8_t)(SNAP_PADDLE1 << i);
+            }
+        }
+        
+        if (cur->score1 != base->score1 || cur->score2 != base->score2) {
+            buf[n++] = cur->score1;
+            buf[n++] = cur->score2;
+            mask |= SNAP_SCORE;
+        }
+    }
+    
+    uint8_t extra_mask = extra ? extra->mask : 0;
+    
+    if (extra_mask & SNAP_STATS) {
+        put_u16(buf + n, extra->stats.rtt_ms);
+        buf[n + 2] = extra->stats.loss_percent;
+        put_u32(buf + n + 3, extra->stats.packets_sent);
+        put_u32(buf + n + 7, extra->stats.packets_recv);
+        n += 11;
+        mask |= SNAP_STATS;
+    }
+    
+    if (extra_mask & SNAP_INPUT_ACK) {
+        buf[n++] = extra->input_ack;
+        mask |= SNAP_INPUT_ACK;
+    }
+    
+    if (extra_mask & SNAP_ECHO) {
+        put_u16(buf + n, extra->echo_ts);
+        buf[n + 2] = extra->echo_hold_ms;
+        n += 3;
+        mask |= SNAP_ECHO;
+    }
+    
+    buf[mask_at] = mask;
+    return n;
+}
+
+/**
+ * Lee la cabecera de un snapshot para poder buscar su base
+ */
+int snapshot_read_header(const uint8_t *buf, size_t len, struct snapshot_header *header) {
+    if (len >= 4 && buf[0] == MSG_SNAPSHOT_NEXT) {
+        header->tick = get_u16(buf + 1);
+        header->base_offset = 1;
+        header->mask = buf[3];
+        header->size = 4;
+        return 0;
+    }
+    if (len < 5 || buf[0] != MSG_SNAPSHOT) return -1;
+    
+    header->tick = get_u16(buf + 1);
+    header->base_offset = buf[3];
+    header->mask = buf[4];
+    header->size = 5;
+    return 0;
+}
+
+/**
+ * Decodifica un snapshot
+ */
+int snapshot_decode(const uint8_t *buf, size_t len, const struct snapshot *base,
+                    struct snapshot *out, struct snapshot_extra *extra) {
+    struct snapshot_header header;
+    if (snapshot_read_header(buf, len, &header) < 0) return -1;
+    
+    int keyframe = header.base_offset == 0;
+    if (!keyframe && base == NULL) return -1;
+    
+    uint16_t pos[SNAP_NUM_POSITIONS] = {0, 0, 0, 0};
+    uint8_t score1 = 0, score2 = 0;
+    if (!keyframe) {
+        pos[0] = base->paddle1_y;
+        pos[1] = base->paddle2_y;
+        pos[2] = base->ball_x;
+        pos[3] = base->ball_y;
+        score1 = base->score1;
+        score2 = base->score2;
+    }
+    
+    size_t n = header.size;
+    for (int i = 0; i < SNAP_NUM_POSITIONS; i++) {
+        if (!(header.mask & (SNAP_PADDLE1 << i))) continue;
+        
+        if (keyframe) {
+            if (n + 2 > len) return -1;
+            pos[i] = get_u16(buf + n);
+            n += 2;
+        } else {
+            int32_t delta;
+            size_t used = get_varint(buf + n, len - n, &delta);
+            if (used == 0) return -1;
+            pos[i] = (uint16_t)(pos[i] + delta);
+            n += used;
+        }
+    }
+    
+    if (header.mask & SNAP_SCORE) {
+        if (n + 2 > len) return -1;
+        score1 = buf[n];
+        score2 = buf[n + 1];
+        n += 2;
+    }
+    
+    extra->mask = header.mask & (SNAP_STATS | SNAP_INPUT_ACK | SNAP_ECHO);
+    
+    if (header.mask & SNAP_STATS) {
+        if (n + 11 > len) return -1;
+        extra->stats.rtt_ms = get_u16(buf + n);
+        extra->stats.loss_percent = buf[n + 2];
+        extra->stats.packets_sent = get_u32(buf + n + 3);
+        extra->stats.packets_recv = get_u32(buf + n + 7);
+        n += 11;
+    }
+    
+    if (header.mask & SNAP_INPUT_ACK) {
+        if (n + 1 > len) return -1;
+        extra->input_ack = buf[n];
+        n += 1;
+    }
+    
+    if (header.mask & SNAP_ECHO) {
+        if (n + 3 > len) return -1;
+        extra->echo_ts = get_u16(buf + n);
+        extra->echo_hold_ms = buf[n + 2];
+        n += 3;
+    }
+    
+    out->paddle1_y = pos[0];
+    out->paddle2_y = pos[1];
+    out->ball_x = pos[2];
+    out->ball_y = pos[3];
+    out->score1 = score1;
+    out->score2 = score2;
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "stats.h"
+#include "utils.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -8,7 +9,7 @@
  */
 void stats_init(struct network_stats *stats) {
     memset(stats, 0, sizeof(struct network_stats));
-    stats->start_time = time(NULL);
+    stats->start_time = clock_now_ns();
     stats->last_update = stats->start_time;
     stats->rtt_min = INFINITY;
     stats->rtt_max = 0;
@@ -25,8 +26,14 @@ void stats_update_rtt(struct network_stats *stats, float rtt_ms) {
     if (rtt_ms < stats->rtt_min) stats->rtt_min = rtt_ms;
     if (rtt_ms > stats->rtt_max) stats->rtt_max = rtt_ms;
     
-    // Calcular promedio móvil (EWMA - Exponentially Weighted Moving Average)
-    if (stats->rtt_avg == 0) {
+    if (stats->rtt_hist != NULL) {
+        histogram_record(stats->rtt_hist, (uint64_t)(rtt_ms * 1000.0f));
+    }
+    
+    // Calcular promedio móvil (EWMA - Exponentially Weighted Moving Average).
+    // Un promedio de 0 es válido (la red local redondea a 0): el primero se
+    // reconoce por la cuenta, no por el valor
+    if (stats->rtt_samples++ == 0) {
         stats->rtt_avg = rtt_ms;
     } else {
         stats->rtt_avg = 0.9 * stats->rtt_avg + 0.1 * rtt_ms;
@@ -39,7 +46,7 @@ void stats_update_rtt(struct network_stats *stats, float rtt_ms) {
 void stats_packet_sent(struct network_stats *stats, int bytes) {
     stats->packets_sent++;
     stats->bytes_sent += bytes;
-    stats->last_update = time(NULL);
+    stats->last_update = clock_now_ns();
 }
 
 /**
@@ -48,7 +55,7 @@ void stats_packet_sent(struct network_stats *stats, int bytes) {
 void stats_packet_received(struct network_stats *stats, int bytes) {
     stats->packets_received++;
     stats->bytes_received += bytes;
-    stats->last_update = time(NULL);
+    stats->last_update = clock_now_ns();
 }
 
 /**
@@ -59,12 +66,38 @@ void stats_packet_lost(struct network_stats *stats) {
 }
 
 /**
- * Calcula el porcentaje de pérdida de paquetes
+ * Registra la secuencia de un paquete recibido
+ */
+int stats_track_sequence(struct network_stats *stats, uint16_t seq) {
+    if (!stats->seq_started) {
+        stats->highest_seq = seq;
+        stats->seq_started = 1;
+        return 1;
+    }
+    
+    int16_t gap = (int16_t)(seq - stats->highest_seq);
+    if (gap > 0) {
+        stats->packets_lost += gap - 1;
+        stats->highest_seq = seq;
+        return 1;
+    }
+    
+    if (gap < 0) {
+        // Llegó tarde: ya se había contado como perdido
+        stats->packets_reordered++;
+        if (stats->packets_lost > 0) stats->packets_lost--;
+    }
+    return 0;
+}
+
+/**
+ * Calcula el porcentaje de pérdida de paquetes (perdidos / esperados)
  */
 uint8_t stats_get_loss_percent(struct network_stats *stats) {
-    if (stats->packets_sent == 0) return 0;
+    uint32_t expected = stats->packets_received + stats->packets_lost;
+    if (expected == 0) return 0;
     
-    float loss = (float)stats->packets_lost / (float)stats->packets_sent * 100.0f;
+    float loss = (float)stats->packets_lost / (float)expected * 100.0f;
     
     if (loss > 100) loss = 100;
     if (loss < 0) loss = 0;
@@ -76,8 +109,7 @@ uint8_t stats_get_loss_percent(struct network_stats *stats) {
  * Calcula el throughput en bits por segundo
  */
 void stats_calculate_throughput(struct network_stats *stats) {
-    time_t now = time(NULL);
-    time_t elapsed = now - stats->start_time;
+    double elapsed = (get_time_ns() - stats->start_time) / 1e9;
     
     if (elapsed > 0) {
         stats->throughput_bps = (stats->bytes_sent * 8.0f) / elapsed;
@@ -96,12 +128,19 @@ void stats_print(struct network_stats *stats) {
     printf("║ Paquetes Enviados:    %-16u ║\n", stats->packets_sent);
     printf("║ Paquetes Recibidos:   %-16u ║\n", stats->packets_received);
     printf("║ Paquetes Perdidos:    %-16u ║\n", stats->packets_lost);
+    printf("║ Desordenados:         %-16u ║\n", stats->packets_reordered);
     printf("║ Pérdida:              %-15u%% ║\n", stats_get_loss_percent(stats));
     printf("║                                        ║\n");
     printf("║ RTT Actual:           %-13.1f ms ║\n", stats->rtt_current);
     printf("║ RTT Promedio:         %-13.1f ms ║\n", stats->rtt_avg);
     printf("║ RTT Mínimo:           %-13.1f ms ║\n", stats->rtt_min);
     printf("║ RTT Máximo:           %-13.1f ms ║\n", stats->rtt_max);
+    if (stats->rtt_hist != NULL) {
+        printf("║ RTT p50:              %-13.1f ms ║\n", histogram_percentile(stats->rtt_hist, 50) / 1000.0);
+        printf("║ RTT p90:              %-13.1f ms ║\n", histogram_percentile(stats->rtt_hist, 90) / 1000.0);
+        printf("║ RTT p99:              %-13.1f ms ║\n", histogram_percentile(stats->rtt_hist, 99) / 1000.0);
+        printf("║ RTT p99.9:            %-13.1f ms ║\n", histogram_percentile(stats->rtt_hist, 99.9) / 1000.0);
+    }
     printf("║                                        ║\n");
     printf("║ Throughput:           %-13.1f bps ║\n", stats->throughput_bps);
     printf("║ Bytes Enviados:       %-16llu ║\n", (unsigned long long)stats->bytes_sent);
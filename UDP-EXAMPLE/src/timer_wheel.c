@@ -0,0 +1,122 @@
+#include "timer_wheel.h"
+#include <stdlib.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * Reserva la rueda
+ */
+int timer_wheel_init(struct timer_wheel *wheel, uint32_t max_ids, uint32_t now) {
+    wheel->next = malloc(max_ids * sizeof(uint32_t));
+    wheel->prev = malloc(max_ids * sizeof(uint32_t));
+    wheel->slot = malloc(max_ids * sizeof(uint32_t));
+    if (wheel->next == NULL || wheel->prev == NULL || wheel->slot == NULL) {
+        timer_wheel_free(wheel);
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel->heads[i] = TIMER_NONE;
+    }
+    for (uint32_t i = 0; i < max_ids; i++) {
+        wheel->slot[i] = TIMER_NONE;
+    }
+    
+    wheel->now = now;
+    wheel->count = 0;
+    return 0;
+}
+
+/**
+ * Libera la rueda
+ */
+void timer_wheel_free(struct timer_wheel *wheel) {
+    free(wheel->next);
+    free(wheel->prev);
+    free(wheel->slot);
+    wheel->next = NULL;
+    wheel->prev = NULL;
+    wheel->slot = NULL;
+}
+
+/**
+ * Quita el plazo de un id
+ */
+void timer_wheel_cancel(struct timer_wheel *wheel, uint32_t id) {
+    uint32_t slot = wheel->slot[id];
+    if (slot == TIMER_NONE) {
+        return;
+    }
+    
+    uint32_t next = wheel->next[id];
+    uint32_t prev = wheel->prev[id];
+    if (prev == TIMER_NONE) {
+        wheel->heads[slot] = next;
+    } else {
+        wheel->next[prev] = next;
+    }
+    if (next != TIMER_NONE) {
+        wheel->prev[next] = prev;
+    }
+    
+    wheel->slot[id] = TIMER_NONE;
+    wheel->count--;
+}
+
+/**
+ * Programa un id al frente de la lista de su ranura
+ */
+void timer_wheel_schedule(struct timer_wheel *wheel, uint32_t id, uint32_t due) {
+    timer_wheel_cancel(wheel, id);
+    
+    // Con el plazo dentro de una vuelta, todo lo que hay en una ranura
+    // vence justo cuando la rueda pasa por ella
+    int32_t ahead = (int32_t)(due - wheel->now);
+    if (ahead < 1) {
+        due = wheel->now + 1;
+    } else if (ahead > TIMER_WHEEL_SLOTS - 1) {
+        due = wheel->now + TIMER_WHEEL_SLOTS - 1;
+    }
+    
+    uint32_t slot = due & SLOT_MASK;
+    uint32_t head = wheel->heads[slot];
+    wheel->next[id] = head;
+    wheel->prev[id] = TIMER_NONE;
+    if (head != TIMER_NONE) {
+        wheel->prev[head] = id;
+    }
+    wheel->heads[slot] = id;
+    wheel->slot[id] = slot;
+    wheel->count++;
+}
+
+/**
+ * Avanza la rueda ranura por ranura; un salto de más de una vuelta
+ * recorre cada ranura una sola vez
+ */
+uint32_t timer_wheel_advance(struct timer_wheel *wheel, uint32_t now, timer_wheel_fn fn, void *ctx) {
+    uint32_t expired = 0;
+    
+    if ((int32_t)(now - wheel->now) <= 0) {
+        return 0;
+    }
+    if (now - wheel->now > TIMER_WHEEL_SLOTS) {
+        wheel->now = now - TIMER_WHEEL_SLOTS;
+    }
+    
+    while (wheel->now != now) {
+        wheel->now++;
+        uint32_t slot = wheel->now & SLOT_MASK;
+        
+        // Releer la cabeza en cada vuelta: el callback puede reprogramar
+        // (siempre a otra ranura) o cancelar ids de esta lista
+        uint32_t id;
+        while ((id = wheel->heads[slot]) != TIMER_NONE) {
+            timer_wheel_cancel(wheel, id);
+            fn(ctx, id);
+            expired++;
+        }
+    }
+    
+    return expired;
+}
@@ -1,16 +1,47 @@
+#define _DEFAULT_SOURCE
 #include "utils.h"
-#include <sys/time.h>
-#include <stdio.h>
-#include <stdarg.h>
 #include <time.h>
 
+// "Ahora" de cada hilo (0 = todavía sin clock_refresh)
+static _Thread_local uint64_t cached_now_ns;
+
+/**
+ * Reloj monotónico en nanosegundos
+ */
+uint64_t get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
 /**
- * Obtiene el tiempo actual en milisegundos
+ * Tiempo monotónico en milisegundos (32 bits, da la vuelta)
  */
 uint32_t get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+    return (uint32_t)(get_time_ns() / 1000000ULL);
+}
+
+/**
+ * Tiempo monotónico en microsegundos
+ */
+uint64_t get_time_us(void) {
+    return get_time_ns() / 1000ULL;
+}
+
+/**
+ * Actualiza el "ahora" del hilo
+ */
+uint64_t clock_refresh(void) {
+    cached_now_ns = get_time_ns();
+    return cached_now_ns;
+}
+
+/**
+ * "Ahora" del hilo sin leer el reloj
+ */
+uint64_t clock_now_ns(void) {
+    if (cached_now_ns == 0) return clock_refresh();
+    return cached_now_ns;
 }
 
 /**
@@ -21,21 +52,3 @@ float clamp(float value, float min, float max) {
     if (value > max) return max;
     return value;
 }
-
-/**
- * Imprime un mensaje con timestamp
- */
-void log_msg(const char *format, ...) {
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    
-    printf("[%02d:%02d:%02d] ", t->tm_hour, t->tm_min, t->tm_sec);
-    
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-    
-    printf("\n");
-    fflush(stdout);
-}